@@ -23,6 +23,7 @@
 #include "IdleFlags.hxx"
 #include "StateFile.hxx"
 #include "Stats.hxx"
+#include "PlaylistFile.hxx"
 #include "client/List.hxx"
 #include "input/cache/Manager.hxx"
 
@@ -47,6 +48,8 @@
 #endif
 #endif
 
+#include <iterator>
+
 Instance::Instance()
 	:rtio_thread(true),
 #ifdef ENABLE_SYSTEMD_DAEMON
@@ -77,6 +80,17 @@ Instance::OnStateModified() noexcept
 		state_file->CheckModified();
 }
 
+EventLoop *
+Instance::GetClientOutputLoop() noexcept
+{
+	if (client_output_threads.empty())
+		return nullptr;
+
+	auto i = client_output_threads.begin();
+	std::advance(i, next_client_output_thread++ % client_output_threads.size());
+	return &i->GetEventLoop();
+}
+
 Partition *
 Instance::FindPartition(const char *name) noexcept
 {
@@ -121,6 +135,7 @@ Instance::OnDatabaseModified() noexcept
 	/* propagate the change to all subsystems */
 
 	stats_invalidate();
+	spl_invalidate_resolved();
 
 	for (auto &partition : partitions)
 		partition.DatabaseModified(*database);
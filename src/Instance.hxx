@@ -95,6 +95,19 @@ struct Instance final
 	 */
 	EventThread rtio_thread;
 
+	/**
+	 * Optional threads which send responses to clients; see
+	 * GetClientOutputLoop().  Configured with
+	 * "client_output_threads".
+	 */
+	std::list<EventThread> client_output_threads;
+
+	/**
+	 * Counter for distributing clients among
+	 * #client_output_threads.
+	 */
+	unsigned next_client_output_thread = 0;
+
 #ifdef ENABLE_SYSTEMD_DAEMON
 	Systemd::Watchdog systemd_watchdog;
 #endif
@@ -164,6 +177,13 @@ struct Instance final
 	 */
 	void OnStateModified() noexcept;
 
+	/**
+	 * Choose the #EventLoop which shall send responses to a new
+	 * client (round-robin).  Returns nullptr if there are no
+	 * #client_output_threads, i.e. the main thread sends them.
+	 */
+	EventLoop *GetClientOutputLoop() noexcept;
+
 	/**
 	 * Find a #Partition with the given name.  Returns nullptr if
 	 * no such partition was found.
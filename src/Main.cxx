@@ -337,8 +337,13 @@ Instance::BeginShutdownUpdate() noexcept
 	mpd_inotify_finish();
 #endif
 
-	if (update != nullptr)
+	if (update != nullptr) {
 		update->CancelAllAsync();
+
+		/* the analysis uses the decoder and input plugins,
+		   which are going to be deinitialized */
+		update->StopLoudnessAnalysis();
+	}
 #endif
 }
 
@@ -423,7 +428,8 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 	glue_mapper_init(raw_config);
 
 	initPermissions(raw_config);
-	spl_global_init(raw_config);
+	spl_global_init(raw_config, &instance.event_loop);
+	AtScopeExit() { spl_global_finish(); };
 #ifdef ENABLE_ARCHIVE
 	const ScopeArchivePluginsInit archive_plugins_init;
 #endif
@@ -468,6 +474,9 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 	instance.io_thread.Start();
 	instance.rtio_thread.Start();
 
+	for (unsigned i = 0; i < client_output_threads; ++i)
+		instance.client_output_threads.emplace_back().Start();
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance.neighbors != nullptr)
 		instance.neighbors->Open();
@@ -486,6 +495,10 @@ MainConfigured(const struct options &options, const ConfigData &raw_config)
 		   database */
 		instance.update->Enqueue("", true);
 	}
+
+	if (instance.update != nullptr)
+		/* this needs the decoder and input plugins */
+		instance.update->StartLoudnessAnalysis();
 #endif
 
 	glue_state_file_init(instance, raw_config);
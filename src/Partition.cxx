@@ -20,16 +20,14 @@
 #include "config.h"
 #include "Partition.hxx"
 #include "Instance.hxx"
-#include "Log.hxx"
 #include "song/DetachedSong.hxx"
 #include "mixer/Volume.hxx"
 #include "IdleFlags.hxx"
 #include "client/Listener.hxx"
 #include "client/Client.hxx"
+#include "client/Config.hxx"
 #include "input/cache/Manager.hxx"
-#include "util/Domain.hxx"
-
-static constexpr Domain cache_domain("cache");
+#include "Log.hxx"
 
 Partition::Partition(Instance &_instance,
 		     const char *_name,
@@ -41,6 +39,8 @@ Partition::Partition(Instance &_instance,
 	 name(_name),
 	 listener(new ClientListener(instance.event_loop, *this)),
 	 idle_monitor(instance.event_loop, BIND_THIS_METHOD(OnIdleMonitor)),
+	 mixer_idle_limiter(instance.event_loop, IDLE_MIXER,
+			    BIND_THIS_METHOD(DispatchIdle)),
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
 	 playlist(max_length, *this),
 	 outputs(pc, *this),
@@ -52,7 +52,12 @@ Partition::Partition(Instance &_instance,
 	UpdateEffectiveReplayGainMode();
 }
 
-Partition::~Partition() noexcept = default;
+Partition::~Partition() noexcept
+{
+	if (instance.input_cache)
+		/* cancel this partition's prefetches */
+		instance.input_cache->RemovePrefetchWindow(name);
+}
 
 void
 Partition::BeginShutdown() noexcept
@@ -61,41 +66,53 @@ Partition::BeginShutdown() noexcept
 	listener.reset();
 }
 
-static void
-PrefetchSong(InputCacheManager &cache, const char *uri) noexcept
-{
-	if (cache.Contains(uri))
-		return;
-
-	FormatDebug(cache_domain, "Prefetch '%s'", uri);
-
-	try {
-		cache.Prefetch(uri);
-	} catch (...) {
-		FormatError(std::current_exception(),
-			    "Prefetch '%s' failed", uri);
-	}
-}
-
-static void
-PrefetchSong(InputCacheManager &cache, const DetachedSong &song) noexcept
-{
-	PrefetchSong(cache, song.GetURI());
-}
-
 inline void
 Partition::PrefetchQueue() noexcept
-{
+try {
 	if (!instance.input_cache)
 		return;
 
 	auto &cache = *instance.input_cache;
+	const auto &queue = playlist.queue;
+
+	std::vector<std::string> uris;
 
-	int next = playlist.GetNextPosition();
-	if (next >= 0)
-		PrefetchSong(cache, playlist.queue.Get(next));
+	const int next = playlist.GetNextPosition();
+	if (next >= 0) {
+		const SongTime max_time = SongTime::FromS(cache.GetPrefetchTime());
+		SongTime total_time = SongTime::zero();
 
-	// TODO: prefetch more songs
+		const unsigned first = queue.PositionToOrder(next);
+		unsigned order = first;
+
+		while (true) {
+			const auto &song = queue.GetOrder(order);
+			uris.emplace_back(song.GetRealURI());
+
+			/* in "single" mode, playback stops after the
+			   next song (or repeats it) */
+			if (uris.size() >= cache.GetPrefetchSongs() ||
+			    queue.single != SingleMode::OFF)
+				break;
+
+			const auto duration = song.GetDuration();
+			if (!duration.IsNegative())
+				total_time = total_time + SongTime(duration);
+
+			if (max_time.IsPositive() && total_time >= max_time)
+				break;
+
+			const int next_order = queue.GetNextOrder(order);
+			if (next_order < 0 || unsigned(next_order) == first)
+				break;
+
+			order = next_order;
+		}
+	}
+
+	cache.SetPrefetchWindow(name, std::move(uris));
+} catch (...) {
+	LogError(std::current_exception(), "Failed to prefetch the queue");
 }
 
 void
@@ -169,12 +186,19 @@ void
 Partition::OnQueueModified() noexcept
 {
 	EmitIdle(IDLE_PLAYLIST);
+
+	/* the upcoming songs may have changed */
+	EmitGlobalEvent(PREFETCH);
 }
 
 void
 Partition::OnQueueOptionsChanged() noexcept
 {
 	EmitIdle(IDLE_OPTIONS);
+
+	/* "random", "repeat" and "single" change the playback
+	   order */
+	EmitGlobalEvent(PREFETCH);
 }
 
 void
@@ -211,7 +235,7 @@ Partition::OnMixerVolumeChanged(Mixer &, int) noexcept
 }
 
 void
-Partition::OnIdleMonitor(unsigned mask) noexcept
+Partition::DispatchIdle(unsigned mask) noexcept
 {
 	/* send "idle" notifications to all subscribed
 	   clients */
@@ -222,11 +246,22 @@ Partition::OnIdleMonitor(unsigned mask) noexcept
 		instance.OnStateModified();
 }
 
+void
+Partition::OnIdleMonitor(unsigned mask) noexcept
+{
+	mask = mixer_idle_limiter.Filter(mask, client_idle_mixer_interval);
+	if (mask != 0)
+		DispatchIdle(mask);
+}
+
 void
 Partition::OnGlobalEvent(unsigned mask) noexcept
 {
 	if ((mask & SYNC_WITH_PLAYER) != 0)
+		/* this calls PrefetchQueue() */
 		SyncWithPlayer();
+	else if ((mask & PREFETCH) != 0)
+		PrefetchQueue();
 
 	if ((mask & TAG_MODIFIED) != 0)
 		TagModified();
@@ -21,6 +21,7 @@
 #define MPD_PARTITION_HXX
 
 #include "event/MaskMonitor.hxx"
+#include "client/IdleRateLimiter.hxx"
 #include "queue/Playlist.hxx"
 #include "queue/Listener.hxx"
 #include "output/MultipleOutputs.hxx"
@@ -52,6 +53,13 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	static constexpr unsigned SYNC_WITH_PLAYER = 0x2;
 	static constexpr unsigned BORDER_PAUSE = 0x4;
 
+	/**
+	 * The queue or its playback order has been modified; call
+	 * PrefetchQueue() (deferred, so several modifications are
+	 * handled at once).
+	 */
+	static constexpr unsigned PREFETCH = 0x8;
+
 	Instance &instance;
 
 	const std::string name;
@@ -68,6 +76,12 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	 */
 	MaskMonitor idle_monitor;
 
+	/**
+	 * Rate-limits #IDLE_MIXER notifications, see
+	 * #client_idle_mixer_interval.
+	 */
+	IdleRateLimiter mixer_idle_limiter;
+
 	MaskMonitor global_events;
 
 	struct playlist playlist;
@@ -104,7 +118,10 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	/**
 	 * Populate the #InputCacheManager with soon-to-be-played song
-	 * files.
+	 * files.  This submits the upcoming songs (in playback order,
+	 * limited by the "prefetch_songs" and "prefetch_time"
+	 * settings) to the cache's worker threads and returns
+	 * immediately.
 	 *
 	 * Errors will be logged.
 	 */
@@ -288,6 +305,12 @@ private:
 	/* virtual methods from class MixerListener */
 	void OnMixerVolumeChanged(Mixer &mixer, int volume) noexcept override;
 
+	/**
+	 * Send "idle" notifications to all clients.  This is also the
+	 * callback for #mixer_idle_limiter.
+	 */
+	void DispatchIdle(unsigned mask) noexcept;
+
 	/* callback for #idle_monitor */
 	void OnIdleMonitor(unsigned mask) noexcept;
 
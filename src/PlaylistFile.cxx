@@ -33,6 +33,8 @@
 #include "config/Option.hxx"
 #include "config/Defaults.hxx"
 #include "Idle.hxx"
+#include "Log.hxx"
+#include "event/TimerEvent.hxx"
 #include "fs/Limits.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
@@ -42,16 +44,141 @@
 #include "util/StringCompare.hxx"
 #include "util/UriExtract.hxx"
 
+#ifdef ENABLE_INOTIFY
+#include "db/update/InotifySource.hxx"
+
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <map>
+#include <memory>
 
 static const char PLAYLIST_COMMENT = '#';
 
+/**
+ * Modified stored playlists are written to disk after this delay,
+ * which combines a burst of edits into one rewrite.
+ */
+static constexpr std::chrono::steady_clock::duration SPL_WRITE_DELAY =
+	std::chrono::seconds(2);
+
+/**
+ * If writing a modified stored playlist fails, it is retried after
+ * a delay which starts at #SPL_WRITE_DELAY and doubles after each
+ * failure, up to this value.
+ */
+static constexpr std::chrono::steady_clock::duration SPL_WRITE_MAX_DELAY =
+	std::chrono::minutes(10);
+
+/**
+ * The number of stored playlists kept in #spl_cache.  Modified
+ * playlists are never evicted.
+ */
+static constexpr std::size_t SPL_CACHE_SIZE = 8;
+
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * A stored playlist which has been loaded into memory for editing.
+ */
+struct CachedPlaylistFile {
+	PlaylistFileContents contents;
+
+	/**
+	 * The modification time and size of the file when it was
+	 * loaded or written.  If the file does not match these
+	 * anymore, it has been modified by somebody else, and this
+	 * copy is discarded.
+	 */
+	std::chrono::system_clock::time_point mtime;
+	uint64_t size = 0;
+
+	/**
+	 * Has #contents been modified, but not yet been written to
+	 * the file?
+	 */
+	bool dirty = false;
+};
+
+/**
+ * Recently edited stored playlists, indexed by their name.  Edits
+ * operate on these copies instead of loading and rewriting the file
+ * each time.
+ */
+static std::map<std::string, CachedPlaylistFile> spl_cache;
+
+/**
+ * A copy of the resolved songs of a stored playlist, see
+ * spl_put_resolved().
+ */
+struct ResolvedPlaylistFile {
+	ResolvedPlaylist songs;
+
+	/**
+	 * The modification time and size of the file when it was
+	 * read; used to detect modifications by somebody else.
+	 */
+	std::chrono::system_clock::time_point mtime;
+	uint64_t size;
+};
+
+/**
+ * Resolved songs of recently listed stored playlists, indexed by
+ * their name.  This saves the database lookups for each
+ * "listplaylistinfo" command.  The whole map is cleared when the
+ * database is modified.
+ */
+static std::map<std::string, ResolvedPlaylistFile> spl_resolved;
+
+/**
+ * Writes modified playlists in #spl_cache after #SPL_WRITE_DELAY.
+ * If this is nullptr, they are written immediately.
+ */
+static std::unique_ptr<TimerEvent> spl_write_timer;
+
+/**
+ * The delay of the next retry after writing a modified playlist has
+ * failed; see #SPL_WRITE_MAX_DELAY.
+ */
+static std::chrono::steady_clock::duration spl_write_retry_delay =
+	SPL_WRITE_DELAY;
+
+/**
+ * A copy of the playlist directory listing, to avoid reading the
+ * directory for each "listplaylists" command.  It is kept up to
+ * date by MPD's own modifications and by inotify.
+ */
+static PlaylistVector spl_list;
+
+/**
+ * Is #spl_list up to date?
+ */
+static bool spl_list_valid = false;
+
+/**
+ * The modification time of the playlist directory when #spl_list was
+ * read.  Without inotify, this detects playlist files which have
+ * been created, deleted or renamed by somebody else.
+ */
+static std::chrono::system_clock::time_point spl_list_mtime;
+
+#ifdef ENABLE_INOTIFY
+static std::unique_ptr<InotifySource> spl_inotify;
+
+static void
+spl_inotify_callback(int wd, unsigned mask, unsigned cookie,
+		     const char *name, void *ctx) noexcept;
+#endif
+
+static void
+spl_write_modified() noexcept;
+
 void
-spl_global_init(const ConfigData &config)
+spl_global_init(const ConfigData &config, EventLoop *event_loop)
 {
 	playlist_max_length =
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
@@ -60,6 +187,50 @@ spl_global_init(const ConfigData &config)
 	playlist_saveAbsolutePaths =
 		config.GetBool(ConfigOption::SAVE_ABSOLUTE_PATHS,
 			       DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS);
+
+	if (event_loop == nullptr)
+		return;
+
+	spl_write_timer = std::make_unique<TimerEvent>(*event_loop,
+						       BIND_FUNCTION(spl_write_modified));
+
+#ifdef ENABLE_INOTIFY
+	const auto &path_fs = map_spl_path();
+	if (path_fs.IsNull())
+		return;
+
+	try {
+		auto inotify = std::make_unique<InotifySource>(*event_loop,
+							       spl_inotify_callback,
+							       nullptr);
+		inotify->Add(path_fs.c_str(),
+			     IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|
+			     IN_CLOSE_WRITE|IN_ATTRIB|
+			     IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR);
+		spl_inotify = std::move(inotify);
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to watch the playlist directory");
+	}
+#endif
+}
+
+void
+spl_global_finish() noexcept
+{
+	/* no retries after this last attempt */
+	spl_write_timer.reset();
+	spl_write_modified();
+	spl_write_retry_delay = SPL_WRITE_DELAY;
+
+#ifdef ENABLE_INOTIFY
+	spl_inotify.reset();
+#endif
+
+	spl_cache.clear();
+	spl_resolved.clear();
+	spl_list.erase(spl_list.begin(), spl_list.end());
+	spl_list_valid = false;
 }
 
 bool
@@ -118,13 +289,18 @@ spl_map_to_fs(const char *name_utf8)
 	return path_fs;
 }
 
-static bool
-LoadPlaylistFileInfo(PlaylistInfo &info,
-		     const Path parent_path_fs,
-		     const Path name_fs)
+/**
+ * Determine the playlist name from a file name in the playlist
+ * directory.
+ *
+ * @return the UTF-8 name or an empty string if this is not a
+ * playlist file
+ */
+static std::string
+GetPlaylistFileName(const Path name_fs) noexcept
 {
 	if (name_fs.HasNewline())
-		return false;
+		return {};
 
 	const auto *const name_fs_str = name_fs.c_str();
 	const auto *const name_fs_end =
@@ -133,6 +309,24 @@ LoadPlaylistFileInfo(PlaylistInfo &info,
 	if (name_fs_end == nullptr ||
 	    /* no empty playlist names (raw file name = ".m3u") */
 	    name_fs_end == name_fs_str)
+		return {};
+
+	const auto name = AllocatedPath::FromFS(name_fs_str, name_fs_end);
+
+	try {
+		return name.ToUTF8Throw();
+	} catch (...) {
+		return {};
+	}
+}
+
+static bool
+LoadPlaylistFileInfo(PlaylistInfo &info,
+		     const Path parent_path_fs,
+		     const Path name_fs)
+{
+	auto name = GetPlaylistFileName(name_fs);
+	if (name.empty())
 		return false;
 
 	FileInfo fi;
@@ -140,36 +334,126 @@ LoadPlaylistFileInfo(PlaylistInfo &info,
 	    !fi.IsRegular())
 		return false;
 
-	const auto name = AllocatedPath::FromFS(name_fs_str, name_fs_end);
+	info.name = std::move(name);
+	info.mtime = fi.GetModificationTime();
+	return true;
+}
 
-	try {
-		info.name = name.ToUTF8Throw();
-	} catch (...) {
-		return false;
+void
+spl_update_list(const char *name_utf8) noexcept
+{
+	spl_resolved.erase(name_utf8);
+
+	if (!spl_list_valid)
+		return;
+
+	const auto i = std::find_if(spl_list.begin(), spl_list.end(),
+				    PlaylistInfo::CompareName(name_utf8));
+
+	const auto path_fs = spl_valid_name(name_utf8)
+		? map_spl_utf8_to_fs(name_utf8)
+		: nullptr;
+
+	FileInfo fi;
+	if (path_fs.IsNull() || !GetFileInfo(path_fs, fi) ||
+	    !fi.IsRegular()) {
+		if (i != spl_list.end())
+			spl_list.erase(i);
+	} else if (i != spl_list.end())
+		i->mtime = fi.GetModificationTime();
+	else
+		spl_list.push_back(PlaylistInfo(name_utf8,
+						fi.GetModificationTime()));
+}
+
+#ifdef ENABLE_INOTIFY
+
+static void
+spl_inotify_callback([[maybe_unused]] int wd, unsigned mask,
+		     [[maybe_unused]] unsigned cookie,
+		     const char *name, [[maybe_unused]] void *ctx) noexcept
+{
+	if (mask & (IN_Q_OVERFLOW|IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF)) {
+		/* events have been lost, or the directory is
+		   gone */
+		spl_list_valid = false;
+		return;
 	}
 
-	info.mtime = fi.GetModificationTime();
-	return true;
+	if (name == nullptr)
+		return;
+
+	const auto name_utf8 = GetPlaylistFileName(Path::FromFS(name));
+	if (!name_utf8.empty())
+		spl_update_list(name_utf8.c_str());
 }
 
-PlaylistVector
-ListPlaylistFiles()
+#endif
+
+/**
+ * Has the playlist directory been modified since #spl_list was
+ * read?
+ */
+static bool
+IsPlaylistDirectoryModified(Path path_fs) noexcept
+{
+#ifdef ENABLE_INOTIFY
+	if (spl_inotify != nullptr)
+		/* inotify has already told us */
+		return false;
+#endif
+
+	FileInfo fi;
+	return !GetFileInfo(path_fs, fi) ||
+		fi.GetModificationTime() != spl_list_mtime;
+}
+
+/**
+ * Remember the modification time of the playlist directory for
+ * IsPlaylistDirectoryModified().
+ */
+static void
+RememberPlaylistDirectoryTime(Path path_fs) noexcept
 {
-	PlaylistVector list;
+	spl_list_mtime = std::chrono::system_clock::time_point::min();
 
+	FileInfo fi;
+	if (GetFileInfo(path_fs, fi) &&
+	    /* the time stamp may be too coarse to see another
+	       modification within the same second */
+	    fi.GetModificationTime() + std::chrono::seconds(1) <
+	    std::chrono::system_clock::now())
+		spl_list_mtime = fi.GetModificationTime();
+}
+
+const PlaylistVector &
+ListPlaylistFiles()
+{
 	const auto &parent_path_fs = spl_map();
 	assert(!parent_path_fs.IsNull());
 
+	/* the modification times shall be up to date */
+	spl_write_modified();
+
+	if (spl_list_valid && !IsPlaylistDirectoryModified(parent_path_fs))
+		return spl_list;
+
+	spl_list_valid = false;
+	spl_list.erase(spl_list.begin(), spl_list.end());
+
+	RememberPlaylistDirectoryTime(parent_path_fs);
+
 	DirectoryReader reader(parent_path_fs);
 
 	PlaylistInfo info;
 	while (reader.ReadEntry()) {
 		const auto entry = reader.GetEntry();
 		if (LoadPlaylistFileInfo(info, parent_path_fs, entry))
-			list.push_back(std::move(info));
+			spl_list.push_back(std::move(info));
 	}
 
-	return list;
+	spl_list_valid = true;
+	return spl_list;
 }
 
 static void
@@ -191,8 +475,8 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
 	fos.Commit();
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path)
+static PlaylistFileContents
+ReadPlaylistFile(const char *utf8path)
 try {
 	PlaylistFileContents contents;
 
@@ -251,6 +535,214 @@ try {
 	throw;
 }
 
+static void
+RememberFileInfo(CachedPlaylistFile &file, Path path_fs) noexcept
+{
+	FileInfo fi;
+	if (GetFileInfo(path_fs, fi)) {
+		file.mtime = fi.GetModificationTime();
+		file.size = fi.GetSize();
+	}
+}
+
+/**
+ * Has the file been modified since it was loaded into the
+ * #CachedPlaylistFile?
+ */
+static bool
+IsModifiedOnDisk(const CachedPlaylistFile &file, Path path_fs) noexcept
+{
+	FileInfo fi;
+	return !GetFileInfo(path_fs, fi) ||
+		fi.GetModificationTime() != file.mtime ||
+		fi.GetSize() != file.size;
+}
+
+static void
+WriteCachedPlaylistFile(const char *utf8path, CachedPlaylistFile &file)
+{
+	assert(file.dirty);
+
+	SavePlaylistFile(file.contents, utf8path);
+	RememberFileInfo(file, spl_map_to_fs(utf8path));
+	file.dirty = false;
+
+	spl_update_list(utf8path);
+}
+
+static void
+spl_write_modified() noexcept
+{
+	bool failed = false;
+
+	for (auto &[name, file] : spl_cache) {
+		if (!file.dirty)
+			continue;
+
+		try {
+			WriteCachedPlaylistFile(name.c_str(), file);
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "Failed to save playlist \"%s\"",
+				    name.c_str());
+			failed = true;
+		}
+	}
+
+	if (!failed) {
+		spl_write_retry_delay = SPL_WRITE_DELAY;
+		return;
+	}
+
+	/* the playlists remain dirty (and therefore in #spl_cache)
+	   until they have been written; retry later, and log the
+	   error again each time */
+	if (spl_write_timer != nullptr && !spl_write_timer->IsActive()) {
+		spl_write_timer->Schedule(spl_write_retry_delay);
+		spl_write_retry_delay = std::min(spl_write_retry_delay * 2,
+						 SPL_WRITE_MAX_DELAY);
+	}
+}
+
+/**
+ * Discard playlists which have not been modified, to make room for
+ * another one.
+ */
+static void
+EvictPlaylistCache() noexcept
+{
+	if (spl_cache.size() < SPL_CACHE_SIZE)
+		return;
+
+	for (auto i = spl_cache.begin(); i != spl_cache.end();) {
+		if (i->second.dirty)
+			++i;
+		else
+			i = spl_cache.erase(i);
+	}
+}
+
+/**
+ * Look up the playlist in #spl_cache, or load it from the file.
+ */
+static CachedPlaylistFile &
+LoadCachedPlaylistFile(const char *utf8path)
+{
+	const auto path_fs = spl_map_to_fs(utf8path);
+
+	auto i = spl_cache.find(utf8path);
+	if (i != spl_cache.end()) {
+		if (i->second.dirty || !IsModifiedOnDisk(i->second, path_fs))
+			return i->second;
+
+		/* edited by somebody else */
+		spl_cache.erase(i);
+	}
+
+	EvictPlaylistCache();
+
+	CachedPlaylistFile file;
+	RememberFileInfo(file, path_fs);
+	file.contents = ReadPlaylistFile(utf8path);
+
+	return spl_cache.emplace(utf8path, std::move(file)).first->second;
+}
+
+/**
+ * The #CachedPlaylistFile has been edited; write it to disk soon.
+ */
+static void
+spl_modified(const char *utf8path, CachedPlaylistFile &file)
+{
+	file.dirty = true;
+	spl_resolved.erase(utf8path);
+
+	if (spl_write_timer != nullptr) {
+		if (!spl_write_timer->IsActive())
+			spl_write_timer->Schedule(SPL_WRITE_DELAY);
+	} else
+		WriteCachedPlaylistFile(utf8path, file);
+
+	idle_add(IDLE_STORED_PLAYLIST);
+}
+
+void
+spl_forget(const char *utf8path) noexcept
+{
+	auto i = spl_cache.find(utf8path);
+	if (i != spl_cache.end())
+		spl_cache.erase(i);
+
+	spl_resolved.erase(utf8path);
+}
+
+const ResolvedPlaylist *
+spl_get_resolved(const char *utf8path) noexcept
+{
+	auto i = spl_resolved.find(utf8path);
+	if (i == spl_resolved.end())
+		return nullptr;
+
+	const auto path_fs = spl_valid_name(utf8path)
+		? map_spl_utf8_to_fs(utf8path)
+		: nullptr;
+
+	FileInfo fi;
+	if (path_fs.IsNull() || !GetFileInfo(path_fs, fi) ||
+	    fi.GetModificationTime() != i->second.mtime ||
+	    fi.GetSize() != i->second.size) {
+		/* edited by somebody else */
+		spl_resolved.erase(i);
+		return nullptr;
+	}
+
+	return &i->second.songs;
+}
+
+void
+spl_put_resolved(const char *utf8path, ResolvedPlaylist &&songs) noexcept
+{
+	const auto path_fs = spl_valid_name(utf8path)
+		? map_spl_utf8_to_fs(utf8path)
+		: nullptr;
+
+	FileInfo fi;
+	if (path_fs.IsNull() || !GetFileInfo(path_fs, fi) ||
+	    !fi.IsRegular())
+		/* not a stored playlist */
+		return;
+
+	if (spl_resolved.size() >= SPL_CACHE_SIZE &&
+	    spl_resolved.find(utf8path) == spl_resolved.end())
+		/* make room */
+		spl_resolved.erase(spl_resolved.begin());
+
+	auto &file = spl_resolved[utf8path];
+	file.songs = std::move(songs);
+	file.mtime = fi.GetModificationTime();
+	file.size = fi.GetSize();
+}
+
+void
+spl_invalidate_resolved() noexcept
+{
+	spl_resolved.clear();
+}
+
+void
+spl_flush(const char *utf8path)
+{
+	auto i = spl_cache.find(utf8path);
+	if (i != spl_cache.end() && i->second.dirty)
+		WriteCachedPlaylistFile(utf8path, i->second);
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path)
+{
+	return LoadCachedPlaylistFile(utf8path).contents;
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 {
@@ -259,21 +751,20 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = LoadCachedPlaylistFile(utf8path);
+	auto &contents = file.contents;
 
 	if (src >= contents.size() || dest >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
 	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
-
 	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
-
-	SavePlaylistFile(contents, utf8path);
+	if (src < dest)
+		std::rotate(src_i, std::next(src_i), std::next(dest_i));
+	else
+		std::rotate(dest_i, src_i, std::next(src_i));
 
-	idle_add(IDLE_STORED_PLAYLIST);
+	spl_modified(utf8path, file);
 }
 
 void
@@ -282,6 +773,8 @@ spl_clear(const char *utf8path)
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	spl_forget(utf8path);
+
 	try {
 		TruncateFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -292,6 +785,7 @@ spl_clear(const char *utf8path)
 			throw;
 	}
 
+	spl_update_list(utf8path);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -301,6 +795,8 @@ spl_delete(const char *name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	spl_forget(name_utf8);
+
 	try {
 		RemoveFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -311,21 +807,22 @@ spl_delete(const char *name_utf8)
 			throw;
 	}
 
+	spl_update_list(name_utf8);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
 void
 spl_remove_index(const char *utf8path, unsigned pos)
 {
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = LoadCachedPlaylistFile(utf8path);
+	auto &contents = file.contents;
 
 	if (pos >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
 	contents.erase(std::next(contents.begin(), pos));
 
-	SavePlaylistFile(contents, utf8path);
-	idle_add(IDLE_STORED_PLAYLIST);
+	spl_modified(utf8path, file);
 }
 
 void
@@ -334,6 +831,28 @@ try {
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	auto i = spl_cache.find(utf8path);
+	if (i != spl_cache.end()) {
+		auto &file = i->second;
+		if (file.dirty) {
+			/* the file is outdated; append to the
+			   modified copy */
+			if (file.contents.size() >= playlist_max_length)
+				throw PlaylistError(PlaylistResult::TOO_LARGE,
+						    "Stored playlist is too large");
+
+			file.contents.emplace_back(playlist_saveAbsolutePaths
+						   ? song.GetRealURI()
+						   : song.GetURI());
+			spl_modified(utf8path, file);
+			return;
+		}
+
+		/* appending to the file is cheaper than keeping
+		   the copy up to date */
+		spl_cache.erase(i);
+	}
+
 	FileOutputStream fos(path_fs, FileOutputStream::Mode::APPEND_OR_CREATE);
 
 	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length)
@@ -347,6 +866,7 @@ try {
 	bos.Flush();
 	fos.Commit();
 
+	spl_update_list(utf8path);
 	idle_add(IDLE_STORED_PLAYLIST);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
@@ -390,5 +910,12 @@ spl_rename(const char *utf8from, const char *utf8to)
 	const auto to_path_fs = spl_map_to_fs(utf8to);
 	assert(!to_path_fs.IsNull());
 
+	spl_flush(utf8from);
+	spl_forget(utf8from);
+	spl_forget(utf8to);
+
 	spl_rename_internal(from_path_fs, to_path_fs);
+
+	spl_update_list(utf8from);
+	spl_update_list(utf8to);
 }
@@ -20,24 +20,50 @@
 #ifndef MPD_PLAYLIST_FILE_HXX
 #define MPD_PLAYLIST_FILE_HXX
 
+#include "song/DetachedSong.hxx"
+
 #include <vector>
 #include <string>
 
 struct ConfigData;
-class DetachedSong;
+class EventLoop;
 class SongLoader;
 class PlaylistVector;
 class AllocatedPath;
 
 typedef std::vector<std::string> PlaylistFileContents;
 
+/**
+ * A song of a stored playlist with metadata resolved from the
+ * database, as printed by "listplaylistinfo".
+ */
+struct ResolvedPlaylistSong {
+	DetachedSong song;
+
+	/**
+	 * Was the song found?  If not, only its URI is printed.
+	 */
+	bool found;
+};
+
+typedef std::vector<ResolvedPlaylistSong> ResolvedPlaylist;
+
 extern bool playlist_saveAbsolutePaths;
 
 /**
  * Perform some global initialization, e.g. load configuration values.
+ *
+ * @param event_loop the #EventLoop which writes modified playlists
+ * in the background; if nullptr, they are written immediately
+ */
+void
+spl_global_init(const ConfigData &config, EventLoop *event_loop=nullptr);
+
+/**
+ * Write all modified stored playlists to disk and free memory.
  */
 void
-spl_global_init(const ConfigData &config);
+spl_global_finish() noexcept;
 
 /**
  * Determines whether the specified string is a valid name for a
@@ -50,14 +76,66 @@ AllocatedPath
 spl_map_to_fs(const char *name_utf8);
 
 /**
- * Returns a list of stored_playlist_info struct pointers.
+ * Returns the list of stored playlists.  The listing is cached and
+ * the reference remains valid until the next call.
  */
-PlaylistVector
+const PlaylistVector &
 ListPlaylistFiles();
 
+/**
+ * The specified playlist file may have been created, modified or
+ * deleted by code outside of this library; update the cached
+ * listing.
+ */
+void
+spl_update_list(const char *name_utf8) noexcept;
+
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path);
 
+/**
+ * Write pending modifications of the specified stored playlist to
+ * its file.  This must be called before accessing the file
+ * directly.
+ *
+ * Throws on error.
+ */
+void
+spl_flush(const char *utf8path);
+
+/**
+ * Discard the in-memory copy of the specified stored playlist,
+ * including modifications which have not been written yet.  This
+ * must be called before replacing the file.
+ */
+void
+spl_forget(const char *utf8path) noexcept;
+
+/**
+ * Look up the resolved songs of the specified stored playlist which
+ * were passed to spl_put_resolved() earlier.
+ *
+ * @return nullptr if there is no valid copy, e.g. because the
+ * playlist or the database has been modified meanwhile
+ */
+const ResolvedPlaylist *
+spl_get_resolved(const char *utf8path) noexcept;
+
+/**
+ * Remember the resolved songs of the specified stored playlist,
+ * which were read from its file.  The caller must only pass songs
+ * which do not depend on the client's permissions, i.e. no local
+ * files outside of the music directory.
+ */
+void
+spl_put_resolved(const char *utf8path, ResolvedPlaylist &&songs) noexcept;
+
+/**
+ * The database has been modified; discard all resolved songs.
+ */
+void
+spl_invalidate_resolved() noexcept;
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest);
 
@@ -91,6 +91,10 @@ spl_save_queue(const char *name_utf8, const Queue &queue)
 		throw PlaylistError(PlaylistResult::LIST_EXISTS,
 				    "Playlist already exists");
 
+	/* a copy of a file which has been deleted by somebody else
+	   must not overwrite the new one */
+	spl_forget(name_utf8);
+
 	FileOutputStream fos(path_fs);
 	BufferedOutputStream bos(fos);
 
@@ -100,6 +104,7 @@ spl_save_queue(const char *name_utf8, const Queue &queue)
 	bos.Flush();
 	fos.Commit();
 
+	spl_update_list(name_utf8);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
@@ -23,9 +23,15 @@
 #include "TimePrint.hxx"
 #include "TagPrint.hxx"
 #include "client/Response.hxx"
+#include "protocol/SongRecord.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Mask.hxx"
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/UriUtil.hxx"
+#include "util/StringView.hxx"
+
+#include <string.h>
 
 #define SONG_FILE "file: "
 
@@ -42,7 +48,7 @@ song_print_uri(Response &r, const char *uri, bool base) noexcept
 			uri = allocated.c_str();
 	}
 
-	r.Format(SONG_FILE "%s\n", uri);
+	r.WriteField("file", uri);
 }
 
 void
@@ -78,9 +84,215 @@ PrintRange(Response &r, SongTime start_time, SongTime end_time) noexcept
 			 start_ms % 1000);
 }
 
+namespace {
+
+/**
+ * The attributes of a song which are encoded in a binary song
+ * record.
+ */
+struct SongRecord {
+	/**
+	 * The directory which is prepended to #uri, or nullptr.
+	 */
+	const char *directory = nullptr;
+
+	const char *uri;
+
+	SongTime start_time, end_time;
+
+	std::chrono::system_clock::time_point mtime;
+
+	/**
+	 * The formatted audio format, or nullptr.
+	 */
+	const char *format = nullptr;
+
+	SignedSongTime duration;
+
+	const Tag *tag;
+};
+
+/**
+ * Serializes a #SongRecord.  If no #Response is given, the record
+ * is only measured, to be able to announce its size before writing
+ * it.
+ */
+class SongRecordWriter {
+	Response *const r;
+
+	size_t size = 0;
+
+	size_t fill = 0;
+	uint8_t buffer[1024];
+
+public:
+	explicit SongRecordWriter(Response *_r) noexcept:r(_r) {}
+
+	size_t GetSize() const noexcept {
+		return size;
+	}
+
+	void Append(const void *data, size_t length) noexcept {
+		size += length;
+
+		if (r == nullptr)
+			return;
+
+		if (fill + length > sizeof(buffer)) {
+			Flush();
+
+			if (length > sizeof(buffer)) {
+				r->Write(data, length);
+				return;
+			}
+		}
+
+		memcpy(buffer + fill, data, length);
+		fill += length;
+	}
+
+	void Flush() noexcept {
+		if (fill > 0) {
+			r->Write(buffer, fill);
+			fill = 0;
+		}
+	}
+
+	void AppendHeader(uint8_t id, size_t length) noexcept {
+		uint8_t header[1 + (sizeof(length) * 8 + 6) / 7];
+		size_t n = 0;
+		header[n++] = id;
+
+		/* unsigned LEB128 */
+		do {
+			uint8_t byte = length & 0x7f;
+			length >>= 7;
+			if (length > 0)
+				byte |= 0x80;
+			header[n++] = byte;
+		} while (length > 0);
+
+		Append(header, n);
+	}
+
+	void AppendField(uint8_t id, StringView value) noexcept {
+		AppendHeader(id, value.size);
+		Append(value.data, value.size);
+	}
+
+	void AppendField(SongRecordField id, StringView value) noexcept {
+		AppendField(uint8_t(id), value);
+	}
+
+	void AppendLE(uint64_t value, size_t length) noexcept {
+		uint8_t le[sizeof(value)];
+		for (size_t i = 0; i < length; ++i, value >>= 8)
+			le[i] = uint8_t(value);
+		Append(le, length);
+	}
+
+	void AppendField(SongRecordField id, uint32_t value) noexcept {
+		AppendHeader(uint8_t(id), sizeof(value));
+		AppendLE(value, sizeof(value));
+	}
+
+	void Write(const SongRecord &song, TagMask tag_mask) noexcept;
+};
+
+void
+SongRecordWriter::Write(const SongRecord &song, TagMask tag_mask) noexcept
+{
+	if (song.directory != nullptr) {
+		const size_t directory_length = strlen(song.directory);
+		const size_t uri_length = strlen(song.uri);
+		AppendHeader(uint8_t(SongRecordField::URI),
+			     directory_length + 1 + uri_length);
+		Append(song.directory, directory_length);
+		Append("/", 1);
+		Append(song.uri, uri_length);
+	} else
+		AppendField(SongRecordField::URI, song.uri);
+
+	const unsigned start_ms = song.start_time.ToMS();
+	const unsigned end_ms = song.end_time.ToMS();
+	if (start_ms > 0 || end_ms > 0) {
+		AppendHeader(uint8_t(SongRecordField::RANGE), 8);
+		AppendLE(start_ms, 4);
+		AppendLE(end_ms, 4);
+	}
+
+	if (!IsNegative(song.mtime)) {
+		AppendHeader(uint8_t(SongRecordField::LAST_MODIFIED), 8);
+		AppendLE(std::chrono::system_clock::to_time_t(song.mtime), 8);
+	}
+
+	if (song.format != nullptr)
+		AppendField(SongRecordField::FORMAT, song.format);
+
+	if (!song.duration.IsNegative())
+		AppendField(SongRecordField::DURATION,
+			    uint32_t(song.duration.ToMS()));
+
+	for (const auto &i : *song.tag)
+		if (tag_mask.Test(i.type))
+			AppendField(uint8_t(i.type), i.value);
+}
+
+} // namespace
+
+/**
+ * Send a binary song record; see #SongRecordField.
+ */
+static void
+song_print_record(Response &r, const SongRecord &song) noexcept
+{
+	const auto tag_mask = r.GetTagMask();
+
+	SongRecordWriter measure(nullptr);
+	measure.Write(song, tag_mask);
+
+	r.WriteField("songrec", unsigned(measure.GetSize()));
+
+	SongRecordWriter w(&r);
+	w.Write(song, tag_mask);
+	w.Flush();
+
+	r.Write("\n");
+}
+
+static const char *
+GetRecordURI(const char *uri, bool base, std::string &allocated) noexcept
+{
+	if (base)
+		return PathTraitsUTF8::GetBase(uri);
+
+	allocated = uri_remove_auth(uri);
+	return allocated.empty() ? uri : allocated.c_str();
+}
+
 void
 song_print_info(Response &r, const LightSong &song, bool base) noexcept
 {
+	if (r.WantsBinarySongs()) {
+		SongRecord record;
+		std::string allocated;
+		if (!base && song.directory != nullptr) {
+			record.directory = song.directory;
+			record.uri = song.uri;
+		} else
+			record.uri = GetRecordURI(song.uri, base, allocated);
+		record.start_time = song.start_time;
+		record.end_time = song.end_time;
+		record.mtime = song.mtime;
+		const auto format = ToString(song.audio_format);
+		if (song.audio_format.IsDefined())
+			record.format = format.c_str();
+		record.duration = song.tag.duration;
+		record.tag = &song.tag;
+		song_print_record(r, record);
+		return;
+	}
+
 	song_print_uri(r, song, base);
 
 	PrintRange(r, song.start_time, song.end_time);
@@ -89,7 +301,7 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 		time_print(r, "Last-Modified", song.mtime);
 
 	if (song.audio_format.IsDefined())
-		r.Format("Format: %s\n", ToString(song.audio_format).c_str());
+		r.WriteField("Format", ToString(song.audio_format).c_str());
 
 	tag_print(r, song.tag);
 }
@@ -97,6 +309,22 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 void
 song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 {
+	if (r.WantsBinarySongs()) {
+		SongRecord record;
+		std::string allocated;
+		record.uri = GetRecordURI(song.GetURI(), base, allocated);
+		record.start_time = song.GetStartTime();
+		record.end_time = song.GetEndTime();
+		record.mtime = song.GetLastModified();
+		const auto format = ToString(song.GetAudioFormat());
+		if (song.GetAudioFormat().IsDefined())
+			record.format = format.c_str();
+		record.duration = song.GetDuration();
+		record.tag = &song.GetTag();
+		song_print_record(r, record);
+		return;
+	}
+
 	song_print_uri(r, song, base);
 
 	PrintRange(r, song.GetStartTime(), song.GetEndTime());
@@ -104,6 +332,10 @@ song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 	if (!IsNegative(song.GetLastModified()))
 		time_print(r, "Last-Modified", song.GetLastModified());
 
+	if (song.GetAudioFormat().IsDefined())
+		r.WriteField("Format",
+			     ToString(song.GetAudioFormat()).c_str());
+
 	tag_print_values(r, song.GetTag());
 
 	const auto duration = song.GetDuration();
@@ -38,6 +38,15 @@
 
 #define SONG_MTIME "mtime"
 #define SONG_END "song_end"
+#define SONG_ANALYZED_GAIN "AnalyzedGain"
+
+static void
+analyzed_gain_save(BufferedOutputStream &os, const ReplayGainTuple &tuple)
+{
+	if (tuple.IsDefined())
+		os.Format(SONG_ANALYZED_GAIN ": %.2f %.6f\n",
+			  (double)tuple.gain, (double)tuple.peak);
+}
 
 static void
 range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
@@ -63,6 +72,8 @@ song_save(BufferedOutputStream &os, const Song &song)
 	if (song.audio_format.IsDefined())
 		os.Format("Format: %s\n", ToString(song.audio_format).c_str());
 
+	analyzed_gain_save(os, song.analyzed_gain);
+
 	if (!IsNegative(song.mtime))
 		os.Format(SONG_MTIME ": %li\n",
 			  (long)std::chrono::system_clock::to_time_t(song.mtime));
@@ -78,6 +89,10 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 
 	tag_save(os, song.GetTag());
 
+	/* the analyzed gain is not saved here: it belongs to the
+	   database, and songs from the database are reloaded from
+	   there */
+
 	if (!IsNegative(song.GetLastModified()))
 		os.Format(SONG_MTIME ": %li\n",
 			  (long)std::chrono::system_clock::to_time_t(song.GetLastModified()));
@@ -121,6 +136,17 @@ song_load(TextFile &file, const char *uri,
 					/* ignore parser errors */
 				}
 			}
+		} else if (StringIsEqual(line, SONG_ANALYZED_GAIN)) {
+			char *endptr;
+			ReplayGainTuple tuple;
+			tuple.gain = ParseFloat(value, &endptr);
+			if (endptr > value && *endptr == ' ') {
+				const char *peak = endptr + 1;
+				tuple.peak = ParseFloat(peak, &endptr);
+				if (endptr > peak && *endptr == 0 &&
+				    tuple.IsDefined())
+					song.SetAnalyzedGain(tuple);
+			}
 		} else if (StringIsEqual(line, "Playlist")) {
 			tag.SetHasPlaylist(StringIsEqual(value, "yes"));
 		} else if (StringIsEqual(line, SONG_MTIME)) {
@@ -84,6 +84,7 @@ Song::UpdateFile(Storage &storage)
 
 	mtime = info.mtime;
 	audio_format = new_audio_format;
+	analyzed_gain.Clear();
 	tag_builder.Commit(tag);
 	return true;
 }
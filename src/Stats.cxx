@@ -23,6 +23,7 @@
 #include "client/Response.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
+#include "client/List.hxx"
 #include "db/Selection.hxx"
 #include "db/Interface.hxx"
 #include "db/Stats.hxx"
@@ -128,6 +129,13 @@ stats_print(Response &r, const Partition &partition)
 		 (unsigned)std::chrono::duration_cast<std::chrono::seconds>(uptime).count(),
 		 lround(partition.pc.GetTotalPlayTime().count()));
 
+	const auto write_stats =
+		partition.instance.client_list->GetWriteStats();
+	r.Format("client_send_calls: %llu\n"
+		 "client_bytes_sent: %llu\n",
+		 (unsigned long long)write_stats.n_calls,
+		 (unsigned long long)write_stats.n_bytes);
+
 #ifdef ENABLE_DATABASE
 	const Database *db = partition.instance.GetDatabase();
 	if (db != nullptr)
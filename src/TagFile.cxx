@@ -24,11 +24,21 @@
 #include "fs/Path.hxx"
 #include "decoder/DecoderList.hxx"
 #include "decoder/DecoderPlugin.hxx"
+#include "decoder/Sniff.hxx"
 #include "input/InputStream.hxx"
+#include "input/HeaderInputStream.hxx"
 #include "input/LocalOpen.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <cassert>
 
+/**
+ * The size of the header window which is shared by all decoder
+ * plugins and the generic tag scanners; it fits most tag headers
+ * (e.g. FLAC metadata blocks and ID3v2 without pictures).
+ */
+static constexpr size_t TAG_HEADER_WINDOW = 64 * 1024;
+
 class TagFileScan {
 	const Path path_fs;
 	const char *const suffix;
@@ -38,6 +48,12 @@ class TagFileScan {
 	Mutex mutex;
 	InputStreamPtr is;
 
+	/**
+	 * The format detected from the header window.  Only valid
+	 * after the stream has been opened.
+	 */
+	SniffedFormat sniffed;
+
 public:
 	TagFileScan(Path _path_fs, const char *_suffix,
 		    TagHandler &_handler) noexcept
@@ -54,11 +70,10 @@ public:
 			return false;
 
 		/* open the InputStream (if not already open) */
-		if (is == nullptr) {
-			is = OpenLocalInputStream(path_fs, mutex);
-		} else {
+		if (is == nullptr)
+			Open();
+		else
 			is->LockRewind();
-		}
 
 		/* now try the stream_tag() method */
 		return plugin.ScanStream(*is, handler);
@@ -68,6 +83,59 @@ public:
 		return plugin.SupportsSuffix(suffix) &&
 			(ScanFile(plugin) || ScanStream(plugin));
 	}
+
+	/**
+	 * Try all decoder plugins.  Plugins which match the format
+	 * detected from the file contents are tried first, followed
+	 * by the remaining ones which support the file name suffix.
+	 */
+	bool ScanAll() {
+		/* open the file only once, and only if a plugin will
+		   need the stream anyway */
+		if (decoder_plugins_find([this](const DecoderPlugin &plugin){
+				return plugin.scan_stream != nullptr &&
+					plugin.SupportsSuffix(suffix);
+			}) != nullptr)
+			Open();
+
+		if (sniffed.IsDefined() &&
+		    decoder_plugins_try([this](const DecoderPlugin &plugin){
+				    return sniffed.Match(plugin) &&
+					    (ScanFile(plugin) ||
+					     ScanStream(plugin));
+			    }))
+			return true;
+
+		return decoder_plugins_try([this](const DecoderPlugin &plugin){
+				return !sniffed.Match(plugin) && Scan(plugin);
+			});
+	}
+
+	/**
+	 * Invoke the generic (APE and ID3) tag scanners on the
+	 * stream which was already opened for the decoder plugins.
+	 */
+	bool ScanGeneric() {
+		if (is == nullptr)
+			Open();
+		else
+			is->LockRewind();
+
+		return ScanGenericTags(*is, handler);
+	}
+
+private:
+	void Open() {
+		assert(is == nullptr);
+
+		auto header = std::make_unique<HeaderInputStream>(OpenLocalInputStream(path_fs, mutex),
+								  TAG_HEADER_WINDOW);
+
+		std::unique_lock<Mutex> lock(mutex);
+		header->Fill(lock);
+		sniffed = SniffAudioFormat(header->Peek(lock));
+		is = std::move(header);
+	}
 };
 
 bool
@@ -84,22 +152,31 @@ ScanFileTagsNoGeneric(Path path_fs, TagHandler &handler)
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
 	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+	return tfs.ScanAll();
 }
 
 bool
 ScanFileTagsWithGeneric(Path path, TagBuilder &builder,
 			AudioFormat *audio_format)
 {
+	assert(!path.IsNull());
+
+	const auto *suffix = path.GetSuffix();
+	if (suffix == nullptr)
+		return false;
+
+	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
+
 	FullTagHandler h(builder, audio_format);
 
-	if (!ScanFileTagsNoGeneric(path, h))
+	/* share one InputStream between the decoder plugins and the
+	   generic scanners */
+	TagFileScan tfs(path, suffix_utf8.c_str(), h);
+	if (!tfs.ScanAll())
 		return false;
 
 	if (builder.empty())
-		ScanGenericTags(path, h);
+		tfs.ScanGeneric();
 
 	return true;
 }
@@ -29,20 +29,19 @@ tag_print_types(Response &r) noexcept
 	const auto tag_mask = global_tag_mask & r.GetTagMask();
 	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++)
 		if (tag_mask.Test(TagType(i)))
-			r.Format("tagtype: %s\n", tag_item_names[i]);
+			r.WriteField("tagtype", tag_item_names[i]);
 }
 
 void
 tag_print(Response &r, TagType type, StringView value) noexcept
 {
-	r.Format("%s: %.*s\n", tag_item_names[type],
-		 int(value.size), value.data);
+	r.WriteField(tag_item_names[type], value);
 }
 
 void
 tag_print(Response &r, TagType type, const char *value) noexcept
 {
-	r.Format("%s: %s\n", tag_item_names[type], value);
+	r.WriteField(tag_item_names[type], value);
 }
 
 void
@@ -33,5 +33,5 @@ time_print(Response &r, const char *name,
 		return;
 	}
 
-	r.Format("%s: %s\n", name, s.c_str());
+	r.WriteField(name, s.c_str());
 }
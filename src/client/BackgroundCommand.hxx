@@ -42,6 +42,15 @@ public:
 	 * #Client's #EventLoop thread.
 	 */
 	virtual void Cancel() noexcept = 0;
+
+	/**
+	 * The client's output buffer has been sent completely.
+	 * Commands which generate their response incrementally may
+	 * use this to produce more output.  It will be called from
+	 * the #Client's #EventLoop thread, and it must not write to
+	 * the client directly.
+	 */
+	virtual void OnOutputDrained() noexcept {}
 };
 
 #endif
@@ -25,6 +25,10 @@
 #include "IdleFlags.hxx"
 #include "config.h"
 
+#ifdef ENABLE_ZLIB
+#include "Deflate.hxx"
+#endif
+
 Client::~Client() noexcept
 {
 	if (FullyBufferedSocket::IsDefined())
@@ -20,6 +20,7 @@
 #ifndef MPD_CLIENT_H
 #define MPD_CLIENT_H
 
+#include "config.h"
 #include "Message.hxx"
 #include "command/CommandResult.hxx"
 #include "command/CommandListBuilder.hxx"
@@ -48,6 +49,7 @@ struct playlist;
 class Database;
 class Storage;
 class BackgroundCommand;
+class ClientDeflate;
 
 class Client final
 	: FullyBufferedSocket,
@@ -70,6 +72,9 @@ class Client final
 	/** is this client waiting for an "idle" response? */
 	bool idle_waiting = false;
 
+	/** is a command list being executed right now? */
+	bool in_command_list = false;
+
 	/** idle flags pending on this client, to be sent as soon as
 	    the client enters "idle" */
 	unsigned idle_flags = 0;
@@ -84,6 +89,12 @@ public:
 	 */
 	TagMask tag_mask = TagMask::All();
 
+	/**
+	 * Send binary song records instead of "NAME: VALUE" lines
+	 * (protocol feature "binary_songs")?  See #SongRecordField.
+	 */
+	bool binary_songs = false;
+
 private:
 	static constexpr size_t MAX_SUBSCRIPTIONS = 16;
 
@@ -113,6 +124,22 @@ private:
 	 */
 	std::unique_ptr<BackgroundCommand> background_command;
 
+#ifdef ENABLE_ZLIB
+	/**
+	 * If this is set, all output is compressed (after the
+	 * "compress" command).
+	 */
+	std::unique_ptr<ClientDeflate> deflate;
+
+	/**
+	 * Created by EnableDeflate(); it replaces #deflate after the
+	 * response to the current command has been written.
+	 */
+	std::unique_ptr<ClientDeflate> pending_deflate;
+
+	friend class ClientDeflate;
+#endif
+
 public:
 	Client(EventLoop &loop, Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
@@ -122,6 +149,7 @@ public:
 	~Client() noexcept;
 
 	using FullyBufferedSocket::GetEventLoop;
+	using FullyBufferedSocket::GetWriteStats;
 
 	gcc_pure
 	bool IsExpired() const noexcept {
@@ -138,6 +166,50 @@ public:
 	 */
 	bool Write(const char *data) noexcept;
 
+	/**
+	 * Prepare writing directly into the output buffer.
+	 *
+	 * @return a writable buffer of at least #min_length bytes, or
+	 * nullptr if the client is expired or the output buffer has
+	 * not enough contiguous space
+	 */
+	WritableBuffer<void> BeginWrite(size_t min_length) noexcept;
+
+	/**
+	 * Commit data written to the buffer returned by
+	 * BeginWrite().  A length of 0 cancels the operation.
+	 */
+	void CommitWrite(size_t length) noexcept;
+
+	/**
+	 * Returns the number of bytes in the output buffer which
+	 * have not yet been sent to the socket.
+	 */
+	gcc_pure
+	size_t GetOutputSize() const noexcept;
+
+#ifdef ENABLE_ZLIB
+	/**
+	 * Compress all output after the response to the current
+	 * command.
+	 *
+	 * Throws on error.
+	 */
+	void EnableDeflate();
+
+	bool IsDeflateEnabled() const noexcept {
+		return deflate || pending_deflate;
+	}
+#endif
+
+	/**
+	 * Is the current command part of a command list?  Such
+	 * commands cannot be deferred to a #BackgroundCommand.
+	 */
+	bool IsInCommandList() const noexcept {
+		return in_command_list;
+	}
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -262,15 +334,26 @@ public:
 
 private:
 	CommandResult ProcessCommandList(bool list_ok,
-					 std::list<std::string> &&list) noexcept;
+					 std::string &&list) noexcept;
 
 	CommandResult ProcessLine(char *line) noexcept;
 
+	/**
+	 * Compress pending output now (if compression is enabled).
+	 *
+	 * @return false if the client has been expired
+	 */
+	bool FlushDeflate() noexcept;
+
 	/* virtual methods from class BufferedSocket */
 	InputResult OnSocketInput(void *data, size_t length) noexcept override;
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	void OnOutputDrained() noexcept override;
+	void OnIdle() noexcept override;
+
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
 };
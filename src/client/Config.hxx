@@ -28,6 +28,18 @@ extern std::chrono::steady_clock::duration client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * The minimum interval between two #IDLE_MIXER notifications; zero
+ * disables rate-limiting.
+ */
+extern std::chrono::steady_clock::duration client_idle_mixer_interval;
+
+/**
+ * The number of threads which send responses to clients; zero means
+ * the main thread does it.
+ */
+extern unsigned client_output_threads;
+
 void
 client_manager_init(const ConfigData &config);
 
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Deflate.hxx"
+#include "Client.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <string.h>
+
+/**
+ * Responses smaller than this are not worth compressing; they are
+ * sent as "stored" deflate blocks.
+ */
+static constexpr size_t COMPRESS_THRESHOLD = 1024;
+
+ClientDeflate::ClientDeflate(Client &_client)
+	:client(_client), gzip(*this),
+	 defer_flush(client.GetEventLoop(), BIND_THIS_METHOD(OnDeferredFlush)),
+	 level(Z_DEFAULT_COMPRESSION)
+{
+}
+
+WritableBuffer<void>
+ClientDeflate::BeginWrite(size_t min_length) noexcept
+{
+	if (fill + min_length > sizeof(buffer)) {
+		if (min_length > sizeof(buffer) || !Compress())
+			return nullptr;
+	}
+
+	return {buffer + fill, sizeof(buffer) - fill};
+}
+
+void
+ClientDeflate::CommitWrite(size_t length) noexcept
+{
+	assert(fill + length <= sizeof(buffer));
+
+	fill += length;
+
+	if (length > 0)
+		defer_flush.Schedule();
+}
+
+bool
+ClientDeflate::Append(const void *_data, size_t length) noexcept
+{
+	const char *data = (const char *)_data;
+
+	while (length > 0) {
+		if (fill == sizeof(buffer) && !Compress())
+			return false;
+
+		const size_t nbytes = std::min(length, sizeof(buffer) - fill);
+		memcpy(buffer + fill, data, nbytes);
+		fill += nbytes;
+		data += nbytes;
+		length -= nbytes;
+	}
+
+	defer_flush.Schedule();
+	return true;
+}
+
+bool
+ClientDeflate::Compress() noexcept
+{
+	if (client.IsExpired())
+		return false;
+
+	overflow = true;
+
+	try {
+		/* this is a large response; compress it */
+		if (level != Z_DEFAULT_COMPRESSION) {
+			gzip.SetLevel(Z_DEFAULT_COMPRESSION);
+			level = Z_DEFAULT_COMPRESSION;
+		}
+
+		gzip.Write(buffer, fill);
+	} catch (...) {
+		if (!client.IsExpired())
+			client.OnSocketError(std::current_exception());
+		return false;
+	}
+
+	fill = 0;
+	return true;
+}
+
+bool
+ClientDeflate::Flush() noexcept
+{
+	defer_flush.Cancel();
+
+	if (client.IsExpired())
+		return false;
+
+	const int new_level = overflow || fill >= COMPRESS_THRESHOLD
+		? Z_DEFAULT_COMPRESSION
+		: Z_NO_COMPRESSION;
+	overflow = false;
+
+	try {
+		if (new_level != level) {
+			gzip.SetLevel(new_level);
+			level = new_level;
+		}
+
+		gzip.Write(buffer, fill);
+		fill = 0;
+
+		gzip.SyncFlush();
+	} catch (...) {
+		if (!client.IsExpired())
+			client.OnSocketError(std::current_exception());
+		return false;
+	}
+
+	return true;
+}
+
+void
+ClientDeflate::Write(const void *data, size_t size)
+{
+	if (!client.FullyBufferedSocket::Write(data, size))
+		/* the client has already been expired; this
+		   exception only aborts the compressor */
+		throw std::runtime_error("Output buffer is full");
+}
+
+void
+Client::EnableDeflate()
+{
+	assert(!IsDeflateEnabled());
+
+	pending_deflate = std::make_unique<ClientDeflate>(*this);
+}
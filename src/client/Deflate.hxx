@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_DEFLATE_HXX
+#define MPD_CLIENT_DEFLATE_HXX
+
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/GzipOutputStream.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <cstddef>
+
+class Client;
+
+/**
+ * Compresses everything which is sent to a #Client (after the
+ * "compress" command).  Responses are collected in a plain text
+ * buffer and are compressed at the end of each event loop iteration,
+ * i.e. after each command, with a #Z_SYNC_FLUSH, so the client can
+ * decompress each response as soon as it arrives.
+ */
+class ClientDeflate final : OutputStream {
+	Client &client;
+
+	GzipOutputStream gzip;
+
+	/**
+	 * Compresses the #buffer at the end of this event loop
+	 * iteration.
+	 */
+	DeferEvent defer_flush;
+
+	/**
+	 * The current compression level.
+	 */
+	int level;
+
+	/**
+	 * Has the #buffer been compressed since the last Flush()
+	 * because it was full?
+	 */
+	bool overflow = false;
+
+	/**
+	 * The number of bytes in the #buffer.
+	 */
+	size_t fill = 0;
+
+	char buffer[16384];
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit ClientDeflate(Client &_client);
+
+	/**
+	 * Returns the number of uncompressed bytes.
+	 */
+	size_t GetSize() const noexcept {
+		return fill;
+	}
+
+	/**
+	 * @see Client::BeginWrite()
+	 */
+	WritableBuffer<void> BeginWrite(size_t min_length) noexcept;
+
+	/**
+	 * @see Client::CommitWrite()
+	 */
+	void CommitWrite(size_t length) noexcept;
+
+	/**
+	 * @return false on error (the client has been expired)
+	 */
+	bool Append(const void *data, size_t length) noexcept;
+
+	/**
+	 * Compress the buffer and flush the compressor, so all data
+	 * appended so far can be sent to the client.
+	 *
+	 * @return false on error (the client has been expired)
+	 */
+	bool Flush() noexcept;
+
+private:
+	/**
+	 * Compress the whole #buffer.
+	 *
+	 * @return false on error (the client has been expired)
+	 */
+	bool Compress() noexcept;
+
+	void OnDeferredFlush() noexcept {
+		Flush();
+	}
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+};
+
+#endif
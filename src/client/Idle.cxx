@@ -20,6 +20,7 @@
 #include "Client.hxx"
 #include "Config.hxx"
 #include "Response.hxx"
+#include "IdleResponse.hxx"
 #include "Idle.hxx"
 
 #include <cassert>
@@ -27,11 +28,19 @@
 static void
 WriteIdleResponse(Response &r, unsigned flags) noexcept
 {
+	try {
+		const auto &response = GetIdleResponse(flags);
+		r.Write(response.data(), response.size());
+		return;
+	} catch (...) {
+		/* out of memory; fall back to formatting each
+		   line */
+	}
+
 	const char *const*idle_names = idle_get_names();
-	for (unsigned i = 0; idle_names[i]; ++i) {
+	for (unsigned i = 0; idle_names[i]; ++i)
 		if (flags & (1 << i))
 			r.Format("changed: %s\n", idle_names[i]);
-	}
 
 	r.Write("OK\n");
 }
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "IdleRateLimiter.hxx"
+
+unsigned
+IdleRateLimiter::Filter(unsigned mask,
+			std::chrono::steady_clock::duration _interval) noexcept
+{
+	if ((mask & flag) == 0 ||
+	    _interval <= std::chrono::steady_clock::duration::zero())
+		return mask;
+
+	if (timer.IsActive()) {
+		/* too soon after the previous one; postpone until
+		   the timer expires, which combines all events
+		   meanwhile (e.g. while a volume slider is being
+		   dragged) */
+		pending = true;
+		return mask & ~flag;
+	}
+
+	interval = _interval;
+	timer.Schedule(interval);
+	return mask;
+}
+
+void
+IdleRateLimiter::OnTimer() noexcept
+{
+	if (!pending)
+		return;
+
+	/* deliver the postponed event and start a new interval */
+	pending = false;
+	timer.Schedule(interval);
+	callback(flag);
+}
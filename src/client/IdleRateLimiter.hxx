@@ -0,0 +1,76 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_IDLE_RATE_LIMITER_HXX
+#define MPD_CLIENT_IDLE_RATE_LIMITER_HXX
+
+#include "event/TimerEvent.hxx"
+#include "util/BindMethod.hxx"
+
+#include <chrono>
+
+/**
+ * Limits the rate of one kind of "idle" event (e.g. #IDLE_MIXER).
+ * The first event is passed immediately; further events within the
+ * interval are postponed and combined into one, which is submitted
+ * to the callback when the interval expires.  The last event is
+ * never lost.
+ */
+class IdleRateLimiter {
+	typedef BoundMethod<void(unsigned mask) noexcept> Callback;
+
+	TimerEvent timer;
+
+	const Callback callback;
+
+	/**
+	 * The idle flag which is rate-limited.
+	 */
+	const unsigned flag;
+
+	std::chrono::steady_clock::duration interval =
+		std::chrono::steady_clock::duration::zero();
+
+	/**
+	 * Was an event postponed by #timer?
+	 */
+	bool pending = false;
+
+public:
+	IdleRateLimiter(EventLoop &event_loop, unsigned _flag,
+			Callback _callback) noexcept
+		:timer(event_loop, BIND_THIS_METHOD(OnTimer)),
+		 callback(_callback), flag(_flag) {}
+
+	/**
+	 * Filter a new event mask.
+	 *
+	 * @param _interval the minimum interval between two events;
+	 * zero disables rate-limiting
+	 * @return the flags which shall be dispatched now
+	 */
+	unsigned Filter(unsigned mask,
+			std::chrono::steady_clock::duration _interval) noexcept;
+
+private:
+	/* callback for #timer */
+	void OnTimer() noexcept;
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "IdleResponse.hxx"
+#include "IdleFlags.hxx"
+
+/**
+ * The most recent "idle" response.
+ */
+static struct {
+	unsigned flags = 0;
+	std::string response;
+} idle_response_cache;
+
+const std::string &
+GetIdleResponse(unsigned flags)
+{
+	auto &cache = idle_response_cache;
+	if (flags == cache.flags && !cache.response.empty())
+		return cache.response;
+
+	/* format into a new string, so the cache remains consistent
+	   if this fails */
+	std::string response;
+
+	const char *const*idle_names = idle_get_names();
+	for (unsigned i = 0; idle_names[i]; ++i) {
+		if (flags & (1 << i)) {
+			response += "changed: ";
+			response += idle_names[i];
+			response += '\n';
+		}
+	}
+
+	response += "OK\n";
+
+	cache.response = std::move(response);
+	cache.flags = flags;
+	return cache.response;
+}
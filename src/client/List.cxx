@@ -33,4 +33,14 @@ ClientList::Remove(Client &client) noexcept
 	assert(!list.empty());
 
 	list.erase(list.iterator_to(client));
+	closed_write_stats += client.GetWriteStats();
+}
+
+SocketWriteStats
+ClientList::GetWriteStats() const noexcept
+{
+	SocketWriteStats stats = closed_write_stats;
+	for (const auto &client : list)
+		stats += client.GetWriteStats();
+	return stats;
 }
@@ -21,6 +21,7 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "event/SocketWriteStats.hxx"
 
 #include <boost/intrusive/list.hpp>
 
@@ -33,6 +34,12 @@ class ClientList {
 
 	List list;
 
+	/**
+	 * The accumulated #SocketWriteStats of all clients which have
+	 * been closed already.
+	 */
+	SocketWriteStats closed_write_stats;
+
 public:
 	explicit ClientList(unsigned _max_size) noexcept
 		:max_size(_max_size) {}
@@ -55,7 +62,18 @@ public:
 		list.push_front(client);
 	}
 
+	/**
+	 * Remove the client from the list and remember its
+	 * #SocketWriteStats.
+	 */
 	void Remove(Client &client) noexcept;
+
+	/**
+	 * Returns the #SocketWriteStats of all clients, including
+	 * those which have been closed already.
+	 */
+	gcc_pure
+	SocketWriteStats GetWriteStats() const noexcept;
 };
 
 #endif
@@ -30,6 +30,10 @@
 #include "Log.hxx"
 #include "Version.h"
 
+#ifdef ENABLE_ZLIB
+#include "Deflate.hxx"
+#endif
+
 #include <cassert>
 
 static constexpr char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
@@ -39,7 +43,8 @@ Client::Client(EventLoop &_loop, Partition &_partition,
 	       int _uid, unsigned _permission,
 	       int _num) noexcept
 	:FullyBufferedSocket(_fd.Release(), _loop,
-			     16384, client_max_output_buffer_size),
+			     16384, client_max_output_buffer_size,
+			     _partition.instance.GetClientOutputLoop()),
 	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
 	 partition(&_partition),
 	 permission(_permission),
@@ -82,11 +87,18 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close() noexcept
 {
+	/* stop the writer thread before ClientList::Remove() collects
+	   the final write counters */
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+
 	partition->instance.client_list->Remove(*this);
 	partition->clients.erase(partition->clients.iterator_to(*this));
 
-	if (FullyBufferedSocket::IsDefined())
-		FullyBufferedSocket::Close();
+	const auto stats = GetWriteStats();
+	FormatDebug(client_domain, "[%u] %llu send calls, %llu bytes sent",
+		    num, (unsigned long long)stats.n_calls,
+		    (unsigned long long)stats.n_bytes);
 
 	FormatInfo(client_domain, "[%u] closed", num);
 	delete this;
@@ -24,20 +24,29 @@
 #include "command/AllCommands.hxx"
 #include "Log.hxx"
 #include "util/StringAPI.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/CharUtil.hxx"
 
+#include <string.h>
+
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
 #define CLIENT_LIST_MODE_END "command_list_end"
 
 inline CommandResult
 Client::ProcessCommandList(bool list_ok,
-			   std::list<std::string> &&list) noexcept
+			   std::string &&list) noexcept
 {
 	unsigned n = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	in_command_list = true;
+	AtScopeExit(this) { in_command_list = false; };
+
+	char *const end = list.data() + list.size();
+	for (char *cmd = list.data(), *next; cmd != end; cmd = next) {
+		/* determine the next command before tokenizing this
+		   one in-place, which inserts null bytes */
+		next = cmd + strlen(cmd) + 1;
 
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
 		auto ret = command_process(*this, n++, cmd);
@@ -23,6 +23,10 @@
 #include "Instance.hxx"
 #include "util/StringStrip.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "Deflate.hxx"
+#endif
+
 #include <cstring>
 
 BufferedSocket::InputResult
@@ -60,7 +64,7 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 		return InputResult::CLOSED;
 
 	case CommandResult::FINISH:
-		if (Flush())
+		if (FlushDeflate() && Flush())
 			Close();
 		return InputResult::CLOSED;
 
@@ -69,6 +73,14 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 		return InputResult::CLOSED;
 	}
 
+#ifdef ENABLE_ZLIB
+	if (pending_deflate)
+		/* the response to the "compress" command has been
+		   written uncompressed; compress everything after
+		   it */
+		deflate = std::move(pending_deflate);
+#endif
+
 	if (IsExpired()) {
 		Close();
 		return InputResult::CLOSED;
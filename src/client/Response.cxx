@@ -21,6 +21,13 @@
 #include "Client.hxx"
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/StringView.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
 
 TagMask
 Response::GetTagMask() const noexcept
@@ -28,6 +35,12 @@ Response::GetTagMask() const noexcept
 	return GetClient().tag_mask;
 }
 
+bool
+Response::WantsBinarySongs() const noexcept
+{
+	return GetClient().binary_songs;
+}
+
 bool
 Response::Write(const void *data, size_t length) noexcept
 {
@@ -40,9 +53,62 @@ Response::Write(const char *data) noexcept
 	return client.Write(data);
 }
 
+/**
+ * Format into the given buffer (which must be reserved with
+ * Client::BeginWrite()) and commit it.
+ *
+ * @return the number of bytes needed (excluding the null
+ * terminator) if the buffer was too small and nothing was
+ * committed, 0 on success, -1 on error
+ */
+static ssize_t
+FormatInto(Client &client, WritableBuffer<char> w,
+	   const char *fmt, std::va_list args) noexcept
+{
+	std::va_list copy;
+	va_copy(copy, args);
+	const int length = vsnprintf(w.data, w.size, fmt, copy);
+	va_end(copy);
+
+	if (length < 0) {
+		client.CommitWrite(0);
+		return -1;
+	}
+
+	if (size_t(length) >= w.size) {
+		client.CommitWrite(0);
+		return length;
+	}
+
+	client.CommitWrite(length);
+	return 0;
+}
+
 bool
 Response::FormatV(const char *fmt, std::va_list args) noexcept
 {
+	/* usually, the line fits in the space which is left in the
+	   output buffer; this avoids allocating a temporary
+	   string */
+	const auto w = WritableBuffer<char>::FromVoid(client.BeginWrite(256));
+	if (!w.IsNull()) {
+		auto result = FormatInto(client, w, fmt, args);
+		if (result > 0) {
+			/* try again with the exact size */
+			const auto w2 = WritableBuffer<char>::FromVoid(client.BeginWrite(result + 1));
+			if (!w2.IsNull())
+				result = FormatInto(client, w2, fmt, args);
+		}
+
+		if (result == 0)
+			return true;
+		else if (result < 0)
+			return false;
+	}
+
+	/* the output buffer has no contiguous space for this line
+	   (or the client is expired); Write() splits it or reports
+	   the error */
 	return Write(FormatStringV(fmt, args).c_str());
 }
 
@@ -56,6 +122,48 @@ Response::Format(const char *fmt, ...) noexcept
 	return success;
 }
 
+bool
+Response::WriteField(const char *name, StringView value) noexcept
+{
+	const size_t name_length = strlen(name);
+	const size_t length = name_length + 2 + value.size + 1;
+
+	const auto w = WritableBuffer<char>::FromVoid(client.BeginWrite(length));
+	if (w.IsNull())
+		return Write(name) && Write(": ") &&
+			Write(value.data, value.size) && Write("\n");
+
+	char *p = std::copy_n(name, name_length, w.data);
+	*p++ = ':';
+	*p++ = ' ';
+	p = std::copy_n(value.data, value.size, p);
+	*p++ = '\n';
+
+	client.CommitWrite(length);
+	return true;
+}
+
+bool
+Response::WriteField(const char *name, const char *value) noexcept
+{
+	return WriteField(name, StringView(value));
+}
+
+bool
+Response::WriteField(const char *name, unsigned value) noexcept
+{
+	char buffer[16];
+	char *const end = buffer + sizeof(buffer);
+	char *p = end;
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	return WriteField(name, StringView(p, end));
+}
+
 bool
 Response::WriteBinary(ConstBuffer<void> payload) noexcept
 {
@@ -27,6 +27,7 @@
 #include <cstddef>
 
 template<typename T> struct ConstBuffer;
+struct StringView;
 class Client;
 class TagMask;
 
@@ -68,6 +69,12 @@ public:
 	gcc_pure
 	TagMask GetTagMask() const noexcept;
 
+	/**
+	 * Accessor for Client::binary_songs.
+	 */
+	gcc_pure
+	bool WantsBinarySongs() const noexcept;
+
 	void SetCommand(const char *_command) noexcept {
 		command = _command;
 	}
@@ -77,6 +84,15 @@ public:
 	bool FormatV(const char *fmt, std::va_list args) noexcept;
 	bool Format(const char *fmt, ...) noexcept;
 
+	/**
+	 * Write a "NAME: VALUE" line.  Unlike Format(), this copies
+	 * the strings directly into the output buffer without parsing
+	 * a format string.
+	 */
+	bool WriteField(const char *name, StringView value) noexcept;
+	bool WriteField(const char *name, const char *value) noexcept;
+	bool WriteField(const char *name, unsigned value) noexcept;
+
 	static constexpr size_t MAX_BINARY_SIZE = 8192;
 
 	/**
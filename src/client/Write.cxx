@@ -19,13 +19,25 @@
 
 #include "Client.hxx"
 
+#ifdef ENABLE_ZLIB
+#include "Deflate.hxx"
+#endif
+
 #include <string.h>
 
 bool
 Client::Write(const void *data, size_t length) noexcept
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+#ifdef ENABLE_ZLIB
+	if (deflate)
+		return deflate->Append(data, length);
+#endif
+
+	return FullyBufferedSocket::Write(data, length);
 }
 
 bool
@@ -33,3 +45,64 @@ Client::Write(const char *data) noexcept
 {
 	return Write(data, strlen(data));
 }
+
+WritableBuffer<void>
+Client::BeginWrite(size_t min_length) noexcept
+{
+	if (IsExpired())
+		return nullptr;
+
+#ifdef ENABLE_ZLIB
+	if (deflate)
+		return deflate->BeginWrite(min_length);
+#endif
+
+	return FullyBufferedSocket::BeginWrite(min_length);
+}
+
+void
+Client::CommitWrite(size_t length) noexcept
+{
+#ifdef ENABLE_ZLIB
+	if (deflate) {
+		deflate->CommitWrite(length);
+		return;
+	}
+#endif
+
+	FullyBufferedSocket::CommitWrite(length);
+}
+
+size_t
+Client::GetOutputSize() const noexcept
+{
+	size_t size = FullyBufferedSocket::GetOutputSize();
+
+#ifdef ENABLE_ZLIB
+	if (deflate)
+		size += deflate->GetSize();
+#endif
+
+	return size;
+}
+
+bool
+Client::FlushDeflate() noexcept
+{
+#ifdef ENABLE_ZLIB
+	if (deflate)
+		return deflate->Flush();
+#endif
+
+	return !IsExpired();
+}
+
+void
+Client::OnIdle() noexcept
+{
+	/* ClientDeflate's DeferEvent would run after this
+	   IdleMonitor, and its final block would need another
+	   send() call; compress now, so everything is sent at once */
+	if (FlushDeflate())
+		FullyBufferedSocket::OnIdle();
+}
@@ -51,6 +51,7 @@
 #include <cassert>
 #include <iterator>
 
+#include <stdint.h>
 #include <string.h>
 
 /*
@@ -93,6 +94,9 @@ static constexpr struct command commands[] = {
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+#ifdef ENABLE_ZLIB
+	{ "compress", PERMISSION_NONE, 1, 1, handle_compress },
+#endif
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -114,6 +118,7 @@ static constexpr struct command commands[] = {
 	{ "getfingerprint", PERMISSION_READ, 1, 1, handle_getfingerprint },
 #endif
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
+	{ "inputbuffers", PERMISSION_READ, 0, 0, handle_inputbuffers },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
@@ -166,6 +171,7 @@ static constexpr struct command commands[] = {
 	{ "previous", PERMISSION_CONTROL, 0, 0, handle_previous },
 	{ "prio", PERMISSION_CONTROL, 2, -1, handle_prio },
 	{ "prioid", PERMISSION_CONTROL, 2, -1, handle_prioid },
+	{ "protocol", PERMISSION_NONE, 0, -1, handle_protocol },
 	{ "random", PERMISSION_CONTROL, 1, 1, handle_random },
 	{ "rangeid", PERMISSION_ADD, 2, 2, handle_rangeid },
 	{ "readcomments", PERMISSION_READ, 1, 1, handle_read_comments },
@@ -284,6 +290,67 @@ handle_not_commands(Client &client, [[maybe_unused]] Request request, Response &
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+/**
+ * Size of the command name hash table.  Must be a power of two, and
+ * it is more than twice the number of commands to keep the probe
+ * sequences short.
+ */
+static constexpr unsigned COMMAND_HASH_SIZE = 512;
+static_assert(COMMAND_HASH_SIZE >= 2 * num_commands);
+static_assert(num_commands < 0xffff);
+
+/**
+ * The FNV-1a hash of a command name.
+ */
+gcc_pure
+static constexpr unsigned
+command_hash(const char *name) noexcept
+{
+	unsigned hash = 2166136261U;
+	for (; *name != 0; ++name)
+		hash = (hash ^ (unsigned char)*name) * 16777619U;
+	return hash & (COMMAND_HASH_SIZE - 1);
+}
+
+/**
+ * An open addressing hash table mapping command names to
+ * #commands indexes; it is built at compile time.
+ */
+struct CommandHashTable {
+	/**
+	 * The #commands index plus one; zero marks an empty slot.
+	 */
+	uint16_t slots[COMMAND_HASH_SIZE]{};
+
+	constexpr CommandHashTable() noexcept {
+		for (unsigned i = 0; i < num_commands; ++i) {
+			unsigned j = command_hash(commands[i].cmd);
+			while (slots[j] != 0)
+				j = (j + 1) & (COMMAND_HASH_SIZE - 1);
+
+			slots[j] = i + 1;
+		}
+	}
+};
+
+static constexpr CommandHashTable command_hash_table;
+
+gcc_pure
+static const struct command *
+command_lookup(const char *name) noexcept
+{
+	for (unsigned i = command_hash(name);;
+	     i = (i + 1) & (COMMAND_HASH_SIZE - 1)) {
+		const unsigned slot = command_hash_table.slots[i];
+		if (slot == 0)
+			return nullptr;
+
+		const struct command &cmd = commands[slot - 1];
+		if (StringIsEqual(name, cmd.cmd))
+			return &cmd;
+	}
+}
+
 void
 command_init() noexcept
 {
@@ -291,29 +358,11 @@ command_init() noexcept
 	/* ensure that the command list is sorted */
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
-#endif
-}
 
-gcc_pure
-static const struct command *
-command_lookup(const char *name) noexcept
-{
-	unsigned a = 0, b = num_commands, i;
-
-	/* binary search */
-	do {
-		i = (a + b) / 2;
-
-		const auto cmp = strcmp(name, commands[i].cmd);
-		if (cmp == 0)
-			return &commands[i];
-		else if (cmp < 0)
-			b = i;
-		else if (cmp > 0)
-			a = i + 1;
-	} while (a < b);
-
-	return nullptr;
+	/* ensure that each command can be found in the hash table */
+	for (const auto &i : commands)
+		assert(command_lookup(i.cmd) == &i);
+#endif
 }
 
 static bool
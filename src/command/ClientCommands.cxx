@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include "ClientCommands.hxx"
 #include "Request.hxx"
 #include "Permission.hxx"
@@ -24,8 +25,12 @@
 #include "client/Response.hxx"
 #include "TagPrint.hxx"
 #include "tag/ParseName.hxx"
+#include "tag/Settings.hxx"
 #include "util/StringAPI.hxx"
 
+#include <algorithm>
+#include <iterator>
+
 CommandResult
 handle_close([[maybe_unused]] Client &client, [[maybe_unused]] Request args,
 	     [[maybe_unused]] Response &r)
@@ -109,3 +114,110 @@ handle_tagtypes(Client &client, Request request, Response &r)
 		return CommandResult::ERROR;
 	}
 }
+
+#ifdef ENABLE_ZLIB
+
+CommandResult
+handle_compress(Client &client, Request request, Response &r)
+{
+	if (!StringIsEqual(request.front(), "gzip")) {
+		r.Error(ACK_ERROR_ARG, "Unsupported compression method");
+		return CommandResult::ERROR;
+	}
+
+	if (client.IsDeflateEnabled()) {
+		r.Error(ACK_ERROR_ARG, "Compression is already enabled");
+		return CommandResult::ERROR;
+	}
+
+	client.EnableDeflate();
+	return CommandResult::OK;
+}
+
+#endif
+
+/**
+ * The optional protocol features a client can enable with the
+ * "protocol" command.
+ */
+static constexpr struct {
+	const char *name;
+	bool Client::*flag;
+} protocol_features[] = {
+	{ "binary_songs", &Client::binary_songs },
+};
+
+static void
+SetProtocolFeatures(Client &client, Request request, bool value)
+{
+	if (request.empty())
+		throw ProtocolError(ACK_ERROR_ARG, "Not enough arguments");
+
+	for (const char *name : request) {
+		auto i = std::find_if(std::begin(protocol_features),
+				      std::end(protocol_features),
+				      [name](const auto &f){
+					      return StringIsEqual(f.name, name);
+				      });
+		if (i == std::end(protocol_features))
+			throw ProtocolError(ACK_ERROR_ARG,
+					    "Unknown protocol feature");
+
+		client.*i->flag = value;
+	}
+}
+
+static void
+SetAllProtocolFeatures(Client &client, bool value) noexcept
+{
+	for (const auto &i : protocol_features)
+		client.*i.flag = value;
+}
+
+CommandResult
+handle_protocol(Client &client, Request request, Response &r)
+{
+	if (request.empty()) {
+		for (const auto &i : protocol_features)
+			if (client.*i.flag)
+				r.WriteField("feature", i.name);
+		return CommandResult::OK;
+	}
+
+	const char *cmd = request.shift();
+	if (StringIsEqual(cmd, "available")) {
+		for (const auto &i : protocol_features)
+			r.WriteField("feature", i.name);
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "tagids")) {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++)
+			if (global_tag_mask.Test(TagType(i)))
+				r.WriteField(tag_item_names[i], i);
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "all")) {
+		if (!request.empty()) {
+			r.Error(ACK_ERROR_ARG, "Too many arguments");
+			return CommandResult::ERROR;
+		}
+
+		SetAllProtocolFeatures(client, true);
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "clear")) {
+		if (!request.empty()) {
+			r.Error(ACK_ERROR_ARG, "Too many arguments");
+			return CommandResult::ERROR;
+		}
+
+		SetAllProtocolFeatures(client, false);
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "enable")) {
+		SetProtocolFeatures(client, request, true);
+		return CommandResult::OK;
+	} else if (StringIsEqual(cmd, "disable")) {
+		SetProtocolFeatures(client, request, false);
+		return CommandResult::OK;
+	} else {
+		r.Error(ACK_ERROR_ARG, "Unknown sub command");
+		return CommandResult::ERROR;
+	}
+}
@@ -38,4 +38,12 @@ handle_password(Client &client, Request request, Response &response);
 CommandResult
 handle_tagtypes(Client &client, Request request, Response &response);
 
+#ifdef ENABLE_ZLIB
+CommandResult
+handle_compress(Client &client, Request request, Response &response);
+#endif
+
+CommandResult
+handle_protocol(Client &client, Request request, Response &response);
+
 #endif
@@ -21,7 +21,6 @@
 #define MPD_COMMAND_LIST_BUILDER_HXX
 
 #include <cassert>
-#include <list>
 #include <string>
 
 class CommandListBuilder {
@@ -46,14 +45,10 @@ class CommandListBuilder {
 	} mode = Mode::DISABLED;
 
 	/**
-	 * for when in list mode
+	 * for when in list mode: all commands in one buffer, each one
+	 * terminated with a null byte
 	 */
-	std::list<std::string> list;
-
-	/**
-	 * Memory consumed by the list.
-	 */
-	size_t size;
+	std::string list;
 
 public:
 	/**
@@ -85,7 +80,6 @@ public:
 		assert(mode == Mode::DISABLED);
 
 		mode = (Mode)ok;
-		size = 0;
 	}
 
 	/**
@@ -94,9 +88,11 @@ public:
 	bool Add(const char *cmd);
 
 	/**
-	 * Finishes the list and returns it.
+	 * Finishes the list and returns it.  The returned buffer
+	 * contains all commands, each one terminated with a null
+	 * byte.
 	 */
-	std::list<std::string> Commit() {
+	std::string Commit() {
 		assert(IsActive());
 
 		return std::move(list);
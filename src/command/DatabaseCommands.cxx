@@ -215,10 +215,7 @@ handle_listall(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   false, false);
-	return CommandResult::OK;
+	return db_stream_print(client, r, uri, false);
 }
 
 static CommandResult
@@ -325,8 +322,5 @@ handle_listallinfo(Client &client, Request args, Response &r)
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	db_selection_print(r, client.GetPartition(),
-			   DatabaseSelection(uri, true),
-			   true, false);
-	return CommandResult::OK;
+	return db_stream_print(client, r, uri, true);
 }
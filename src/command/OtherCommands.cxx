@@ -32,6 +32,7 @@
 #include "tag/Handler.hxx"
 #include "TimePrint.hxx"
 #include "decoder/DecoderPrint.hxx"
+#include "input/BufferPrint.hxx"
 #include "ls.hxx"
 #include "mixer/Volume.hxx"
 #include "time/ChronoUtil.hxx"
@@ -85,6 +86,15 @@ handle_decoders([[maybe_unused]] Client &client, [[maybe_unused]] Request args,
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_inputbuffers([[maybe_unused]] Client &client,
+		    [[maybe_unused]] Request args,
+		    Response &r)
+{
+	input_buffer_print(r);
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_kill([[maybe_unused]] Client &client, [[maybe_unused]] Request request,
 	    [[maybe_unused]] Response &r)
@@ -32,6 +32,9 @@ handle_urlhandlers(Client &client, Request request, Response &response);
 CommandResult
 handle_decoders(Client &client, Request request, Response &response);
 
+CommandResult
+handle_inputbuffers(Client &client, Request request, Response &response);
+
 CommandResult
 handle_kill(Client &client, Request request, Response &response);
 
@@ -33,6 +33,8 @@ enum class ConfigOption {
 	PLAYLIST_DIR,
 	FOLLOW_INSIDE_SYMLINKS,
 	FOLLOW_OUTSIDE_SYMLINKS,
+	SKIP_UNCHANGED_DIRECTORIES,
+	LOUDNESS_ANALYSIS,
 	DB_FILE,
 	STICKER_FILE,
 	LOG_FILE,
@@ -59,6 +61,8 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	INPUT_BUFFER_BUDGET,
+	INPUT_MMAP,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
@@ -69,6 +73,8 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	IDLE_MIXER_INTERVAL,
+	CLIENT_OUTPUT_THREADS,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -29,6 +29,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "playlist_directory" },
 	{ "follow_inside_symlinks" },
 	{ "follow_outside_symlinks" },
+	{ "skip_unchanged_directories" },
+	{ "loudness_analysis" },
 	{ "db_file" },
 	{ "sticker_file" },
 	{ "log_file" },
@@ -55,6 +57,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "input_buffer_budget" },
+	{ "input_mmap" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -65,6 +69,8 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "idle_mixer_interval" },
+	{ "client_output_threads" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
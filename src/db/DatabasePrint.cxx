@@ -21,7 +21,14 @@
 #include "Selection.hxx"
 #include "SongPrint.hxx"
 #include "TimePrint.hxx"
+#include "DatabaseError.hxx"
+#include "plugins/simple/SimpleDatabasePlugin.hxx"
+#include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/BackgroundCommand.hxx"
+#include "command/CommandError.hxx"
+#include "protocol/Result.hxx"
+#include "event/DeferEvent.hxx"
 #include "Partition.hxx"
 #include "song/LightSong.hxx"
 #include "tag/Tag.hxx"
@@ -31,8 +38,15 @@
 #include "fs/Traits.hxx"
 #include "time/ChronoUtil.hxx"
 #include "util/RecursiveMap.hxx"
+#include "util/StringAPI.hxx"
 
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <string.h>
 
 gcc_pure
 static const char *
@@ -47,8 +61,7 @@ static void
 PrintDirectoryURI(Response &r, bool base,
 		  const LightDirectory &directory) noexcept
 {
-	r.Format("directory: %s\n",
-		 ApplyBaseFlag(directory.GetPath(), base));
+	r.WriteField("directory", ApplyBaseFlag(directory.GetPath(), base));
 }
 
 static void
@@ -77,8 +90,7 @@ print_playlist_in_directory(Response &r, bool base,
 			    const char *name_utf8) noexcept
 {
 	if (base || directory == nullptr)
-		r.Format("playlist: %s\n",
-			 ApplyBaseFlag(name_utf8, base));
+		r.WriteField("playlist", ApplyBaseFlag(name_utf8, base));
 	else
 		r.Format("playlist: %s/%s\n",
 			 directory, name_utf8);
@@ -90,7 +102,7 @@ print_playlist_in_directory(Response &r, bool base,
 			    const char *name_utf8) noexcept
 {
 	if (base || directory == nullptr || directory->IsRoot())
-		r.Format("playlist: %s\n", name_utf8);
+		r.WriteField("playlist", name_utf8);
 	else
 		r.Format("playlist: %s/%s\n",
 			 directory->GetPath(), name_utf8);
@@ -168,6 +180,270 @@ db_selection_print(Response &r, Partition &partition,
 	db.Visit(selection, d, s, p);
 }
 
+/**
+ * A directory whose line has been printed by its parent's listing,
+ * but whose contents have not been printed yet.
+ */
+struct StreamDirectory {
+	std::string uri;
+
+	std::chrono::system_clock::time_point mtime;
+
+	explicit StreamDirectory(const LightDirectory &directory) noexcept
+		:uri(directory.GetPath()), mtime(directory.mtime) {}
+
+	LightDirectory Export() const noexcept {
+		return LightDirectory(uri.c_str(), mtime);
+	}
+};
+
+static void
+PrintDirectoryLine(Response &r, bool full,
+		   const LightDirectory &directory) noexcept
+{
+	if (full)
+		PrintDirectoryFull(r, false, directory);
+	else
+		PrintDirectoryBrief(r, false, directory);
+}
+
+/**
+ * Print the songs and playlists of one directory (non-recursively)
+ * and collect its child directories.
+ */
+static void
+PrintDirectoryContents(Response &r, const Database &db, bool full,
+		       const char *uri,
+		       std::vector<StreamDirectory> &children)
+{
+	const DatabaseSelection selection(uri, false);
+
+	const auto d = [&children](const auto &dir)
+		{ children.emplace_back(dir); };
+
+	VisitSong s = [&r,full](const auto &song)
+		{ return full ?
+			PrintSongFull(r, false, song) :
+			PrintSongBrief(r, false, song); };
+
+	const auto p = [&r,full](const auto &playlist, const auto &dir)
+		{ return full ?
+			PrintPlaylistFull(r, false, playlist, dir) :
+			PrintPlaylistBrief(r, false, playlist, dir); };
+
+	db.Visit(selection, d, s, p);
+}
+
+/**
+ * Generates the response of db_stream_print().  The cursor is a
+ * stack of directories which are yet to be printed; printing one
+ * directory pushes its children in reverse order, which reproduces
+ * the depth-first order of Directory::Walk().
+ */
+class DatabaseStreamPrint final : public BackgroundCommand {
+	/**
+	 * Stop generating output as soon as this many bytes are
+	 * waiting in the output buffer, and continue when all of it
+	 * has been sent.
+	 */
+	static constexpr size_t OUTPUT_THRESHOLD = 16384;
+
+	/**
+	 * The maximum number of directories per iteration; this
+	 * limits the time the #EventLoop is blocked while printing
+	 * many directories which are empty.
+	 */
+	static constexpr unsigned MAX_DIRECTORIES = 64;
+
+	Client &client;
+
+	DeferEvent defer_fill;
+
+	const bool full;
+
+	/**
+	 * Directories to be printed; the next one is at the back.
+	 */
+	std::vector<StreamDirectory> stack;
+
+public:
+	DatabaseStreamPrint(Client &_client, bool _full) noexcept
+		:client(_client),
+		 defer_fill(_client.GetEventLoop(),
+			    BIND_THIS_METHOD(OnDeferredFill)),
+		 full(_full) {}
+
+	/**
+	 * Print the base directory.
+	 *
+	 * Throws on error.
+	 */
+	void Start(const Database &db, Response &r, const char *uri);
+
+	/**
+	 * Print more directories until the output buffer is full
+	 * enough.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if the response is complete or if the client
+	 * has expired (which may have deleted this object already)
+	 */
+	bool Fill(Response &r);
+
+	void ScheduleFill() noexcept {
+		if (client.GetOutputSize() == 0)
+			defer_fill.Schedule();
+		/* else wait for OnOutputDrained() */
+	}
+
+	/* virtual methods from class BackgroundCommand */
+	void Cancel() noexcept override {
+		defer_fill.Cancel();
+	}
+
+	void OnOutputDrained() noexcept override {
+		defer_fill.Schedule();
+	}
+
+private:
+	void Push(std::vector<StreamDirectory> &&children) noexcept {
+		stack.insert(stack.end(),
+			     std::make_move_iterator(children.rbegin()),
+			     std::make_move_iterator(children.rend()));
+	}
+
+	/* callback for #defer_fill */
+	void OnDeferredFill() noexcept;
+};
+
+void
+DatabaseStreamPrint::Start(const Database &db, Response &r, const char *uri)
+{
+	/* a recursive visit begins with the base directory itself,
+	   but its modification time is only known to the parent's
+	   listing */
+	if (*uri != 0) {
+		const char *slash = strrchr(uri, '/');
+		const std::string parent = slash != nullptr
+			? std::string(uri, slash)
+			: std::string();
+
+		const auto d = [&r, uri, this](const LightDirectory &dir){
+			if (StringIsEqual(dir.GetPath(), uri))
+				PrintDirectoryLine(r, full, dir);
+		};
+
+		db.Visit(DatabaseSelection(parent.c_str(), false),
+			 d, VisitSong());
+	}
+
+	std::vector<StreamDirectory> children;
+	PrintDirectoryContents(r, db, full, uri, children);
+	Push(std::move(children));
+}
+
+bool
+DatabaseStreamPrint::Fill(Response &r)
+{
+	/* copy the attributes to local variables, because this
+	   object gets deleted by Client::SetExpired() if the output
+	   buffer overflows */
+	Client &c = client;
+	const bool _full = full;
+
+	const Database &db = c.GetDatabaseOrThrow();
+
+	for (unsigned i = 0; i < MAX_DIRECTORIES; ++i) {
+		if (stack.empty())
+			return true;
+
+		if (c.GetOutputSize() >= OUTPUT_THRESHOLD)
+			return false;
+
+		const auto directory = std::move(stack.back());
+		stack.pop_back();
+
+		std::vector<StreamDirectory> children;
+
+		PrintDirectoryLine(r, _full, directory.Export());
+		if (c.IsExpired())
+			return true;
+
+		try {
+			PrintDirectoryContents(r, db, _full,
+					       directory.uri.c_str(),
+					       children);
+		} catch (const DatabaseError &e) {
+			/* the directory has been deleted by a
+			   database update meanwhile */
+			if (e.GetCode() != DatabaseErrorCode::NOT_FOUND)
+				throw;
+		}
+
+		if (c.IsExpired())
+			return true;
+
+		Push(std::move(children));
+	}
+
+	return stack.empty();
+}
+
+void
+DatabaseStreamPrint::OnDeferredFill() noexcept
+{
+	/* see Fill() */
+	Client &c = client;
+
+	Response r(c, 0);
+
+	try {
+		if (!Fill(r)) {
+			ScheduleFill();
+			return;
+		}
+
+		command_success(c);
+	} catch (...) {
+		PrintError(r, std::current_exception());
+	}
+
+	if (!c.IsExpired())
+		/* this deletes this object */
+		c.OnBackgroundCommandFinished();
+}
+
+CommandResult
+db_stream_print(Client &client, Response &r, const char *uri, bool full)
+{
+	const Database &db = client.GetDatabaseOrThrow();
+
+	if (client.IsInCommandList() ||
+	    dynamic_cast<const SimpleDatabase *>(&db) == nullptr) {
+		/* generate all of it right now: the following
+		   commands in the list must not be executed before
+		   this response is complete, and streaming visits
+		   each directory separately, which would be one
+		   network round trip per directory with the proxy
+		   and UPnP plugins */
+		db_selection_print(r, client.GetPartition(),
+				   DatabaseSelection(uri, true),
+				   full, false);
+		return CommandResult::OK;
+	}
+
+	auto command = std::make_unique<DatabaseStreamPrint>(client, full);
+	command->Start(db, r, uri);
+
+	if (command->Fill(r) || client.IsExpired())
+		return CommandResult::OK;
+
+	command->ScheduleFill();
+	client.SetBackgroundCommand(std::move(command));
+	return CommandResult::BACKGROUND;
+}
+
 static void
 PrintSongURIVisitor(Response &r, const LightSong &song) noexcept
 {
@@ -196,7 +472,7 @@ PrintUniqueTags(Response &r, ConstBuffer<TagType> tag_types,
 	tag_types.pop_front();
 
 	for (const auto &i : map) {
-		r.Format("%s: %s\n", name, i.first.c_str());
+		r.WriteField(name, i.first.c_str());
 
 		if (!tag_types.empty())
 			PrintUniqueTags(r, tag_types, i.second);
@@ -20,6 +20,8 @@
 #ifndef MPD_DB_PRINT_H
 #define MPD_DB_PRINT_H
 
+#include "command/CommandResult.hxx"
+
 #include <cstdint>
 
 template<typename T> struct ConstBuffer;
@@ -27,6 +29,7 @@ enum TagType : uint8_t;
 class SongFilter;
 struct DatabaseSelection;
 struct Partition;
+class Client;
 class Response;
 
 /**
@@ -38,6 +41,22 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base);
 
+/**
+ * Print all songs, playlists and directories below the given URI,
+ * just like db_selection_print() with a recursive unfiltered
+ * selection.  The response is generated one directory at a time,
+ * and more of it is generated only after the client has received
+ * what was already generated.  This allows huge responses without
+ * hitting the output buffer limit.
+ *
+ * @param full print attributes/tags
+ * @return CommandResult::OK if the response is complete, or
+ * CommandResult::BACKGROUND if the rest will be generated by a
+ * #BackgroundCommand
+ */
+CommandResult
+db_stream_print(Client &client, Response &r, const char *uri, bool full);
+
 void
 PrintSongUris(Response &r, Partition &partition,
 	      const SongFilter *filter);
@@ -39,7 +39,10 @@
 #define DIRECTORY_FS_CHARSET "fs_charset: "
 #define DB_TAG_PREFIX "tag: "
 
-static constexpr unsigned DB_FORMAT = 2;
+/**
+ * Format 3 added the "AnalyzedGain" song line.
+ */
+static constexpr unsigned DB_FORMAT = 3;
 
 /**
  * The oldest database format understood by this MPD version.
@@ -30,6 +30,8 @@ Song::Song(DetachedSong &&other, Directory &_parent) noexcept
 	 mtime(other.GetLastModified()),
 	 start_time(other.GetStartTime()),
 	 end_time(other.GetEndTime()),
+	 audio_format(other.GetAudioFormat()),
+	 analyzed_gain(other.GetAnalyzedGain()),
 	 filename(other.GetURI())
 {
 }
@@ -57,5 +59,6 @@ Song::Export() const noexcept
 	dest.start_time = start_time;
 	dest.end_time = end_time;
 	dest.audio_format = audio_format;
+	dest.analyzed_gain = analyzed_gain;
 	return dest;
 }
@@ -24,6 +24,7 @@
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
@@ -88,6 +89,14 @@ struct Song {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * The track gain and true peak calculated by the loudness
+	 * analysis (see #LoudnessAnalyzer), relative to the
+	 * ReplayGain 2.0 reference level of -18 LUFS.  Undefined if
+	 * the song has not been analyzed yet.
+	 */
+	ReplayGainTuple analyzed_gain = ReplayGainTuple::Undefined();
+
 	/**
 	 * The file name.
 	 */
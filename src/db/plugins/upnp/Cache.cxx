@@ -0,0 +1,227 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "Cache.hxx"
+
+#include <cassert>
+
+std::string
+UpnpContentCache::MakeBrowseKey(std::string_view object_id) noexcept
+{
+	std::string key("b:");
+	key.append(object_id);
+	return key;
+}
+
+std::string
+UpnpContentCache::MakeMetadataKey(std::string_view object_id) noexcept
+{
+	std::string key("m:");
+	key.append(object_id);
+	return key;
+}
+
+std::string
+UpnpContentCache::MakeSearchKey(std::string_view object_id,
+				std::string_view criteria) noexcept
+{
+	std::string key("s:");
+	key.append(object_id);
+	key.push_back('\n');
+	key.append(criteria);
+	return key;
+}
+
+inline std::string
+UpnpContentCache::MakeMapKey(std::string_view server,
+			     std::string_view key) noexcept
+{
+	std::string result;
+	result.reserve(server.size() + 1 + key.size());
+	result.append(server);
+	result.push_back('\0');
+	result.append(key);
+	return result;
+}
+
+inline void
+UpnpContentCache::Remove(List::iterator i) noexcept
+{
+	map.erase(MakeMapKey(i->server, i->key));
+	lru.erase(i);
+}
+
+UpnpContentCache::ContentPtr
+UpnpContentCache::Get(std::string_view server, std::string_view key,
+		      Clock::time_point now) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = map.find(MakeMapKey(server, key));
+	if (i == map.end())
+		return nullptr;
+
+	auto entry = i->second;
+	if (now >= entry->expires) {
+		Remove(entry);
+		return nullptr;
+	}
+
+	/* move to the front of the LRU list */
+	lru.splice(lru.begin(), lru, entry);
+	return entry->content;
+}
+
+void
+UpnpContentCache::Put(std::string_view server, std::string_view key,
+		      ContentPtr content, Clock::time_point now) noexcept
+{
+	assert(content);
+
+	if (!IsEnabled())
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto map_key = MakeMapKey(server, key);
+	auto i = map.find(map_key);
+	if (i != map.end()) {
+		auto entry = i->second;
+		entry->content = std::move(content);
+		entry->expires = now + ttl;
+		lru.splice(lru.begin(), lru, entry);
+		return;
+	}
+
+	while (!lru.empty() && lru.size() >= max_entries)
+		Remove(std::prev(lru.end()));
+
+	lru.emplace_front(server, key, std::move(content), now + ttl);
+	map.emplace(std::move(map_key), lru.begin());
+}
+
+bool
+UpnpContentCache::NeedUpdateIdCheck(std::string_view server,
+				    Clock::duration interval,
+				    Clock::time_point now) const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = servers.find(server);
+	if (i == servers.end())
+		return true;
+
+	const auto &state = i->second;
+	return !state.update_id_unsupported &&
+		(!state.has_update_id || now >= state.checked + interval);
+}
+
+bool
+UpnpContentCache::SetUpdateId(std::string_view server, unsigned update_id,
+			      Clock::time_point now) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = servers.find(server);
+	if (i == servers.end())
+		i = servers.emplace(server, ServerState()).first;
+
+	auto &state = i->second;
+	state.checked = now;
+
+	if (state.has_update_id && state.update_id == update_id)
+		return false;
+
+	/* on the first contact with this server, entries which
+	   were added before cannot be validated */
+	state.update_id = update_id;
+	state.has_update_id = true;
+	FlushLocked(server);
+	return true;
+}
+
+void
+UpnpContentCache::SetUpdateIdUnsupported(std::string_view server) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = servers.find(server);
+	if (i == servers.end())
+		i = servers.emplace(server, ServerState()).first;
+
+	i->second.update_id_unsupported = true;
+}
+
+UpnpContentCache::SearchCapsPtr
+UpnpContentCache::GetSearchCapabilities(std::string_view server) const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = servers.find(server);
+	return i != servers.end() ? i->second.search_caps : nullptr;
+}
+
+void
+UpnpContentCache::PutSearchCapabilities(std::string_view server,
+					SearchCapsPtr caps) noexcept
+{
+	if (!IsEnabled())
+		return;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = servers.find(server);
+	if (i == servers.end())
+		i = servers.emplace(server, ServerState()).first;
+
+	i->second.search_caps = std::move(caps);
+}
+
+void
+UpnpContentCache::FlushLocked(std::string_view server) noexcept
+{
+	for (auto i = lru.begin(); i != lru.end();) {
+		auto next = std::next(i);
+		if (i->server == server)
+			Remove(i);
+		i = next;
+	}
+}
+
+void
+UpnpContentCache::Flush(std::string_view server) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	FlushLocked(server);
+}
+
+void
+UpnpContentCache::Clear() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	map.clear();
+	lru.clear();
+	servers.clear();
+}
+
+std::size_t
+UpnpContentCache::GetSize() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return lru.size();
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_UPNP_CACHE_HXX
+#define MPD_UPNP_CACHE_HXX
+
+#include "Directory.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <forward_list>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * A cache for the responses of UPnP MediaServers ("Browse" and
+ * "Search" results), shared by all clients.  Entries expire after a
+ * configurable time, and all entries of a server are discarded as
+ * soon as its "SystemUpdateID" changes.
+ *
+ * This class is thread-safe.
+ */
+class UpnpContentCache {
+public:
+	using Clock = std::chrono::steady_clock;
+	using ContentPtr = std::shared_ptr<const UPnPDirContent>;
+	using SearchCaps = std::forward_list<std::string>;
+	using SearchCapsPtr = std::shared_ptr<const SearchCaps>;
+
+private:
+	struct Entry {
+		/**
+		 * The server URI, see ContentDirectoryService::GetURI().
+		 */
+		std::string server;
+
+		/**
+		 * The key within the server, see MakeBrowseKey() and
+		 * friends.
+		 */
+		std::string key;
+
+		ContentPtr content;
+
+		Clock::time_point expires;
+
+		template<typename S, typename K>
+		Entry(S &&_server, K &&_key, ContentPtr &&_content,
+		      Clock::time_point _expires) noexcept
+			:server(std::forward<S>(_server)),
+			 key(std::forward<K>(_key)),
+			 content(std::move(_content)), expires(_expires) {}
+	};
+
+	using List = std::list<Entry>;
+
+	struct ServerState {
+		/**
+		 * The last "SystemUpdateID" reported by the server.
+		 */
+		unsigned update_id = 0;
+
+		/**
+		 * When was #update_id last checked?
+		 */
+		Clock::time_point checked;
+
+		/**
+		 * Has #update_id been set?
+		 */
+		bool has_update_id = false;
+
+		/**
+		 * Has the server failed to report its
+		 * "SystemUpdateID"?  Then it will not be asked again,
+		 * and its entries expire only by their age.
+		 */
+		bool update_id_unsupported = false;
+
+		/**
+		 * The server's search capabilities; nullptr if they
+		 * have not been requested yet.
+		 */
+		SearchCapsPtr search_caps;
+	};
+
+	const Clock::duration ttl;
+
+	const std::size_t max_entries;
+
+	mutable Mutex mutex;
+
+	/**
+	 * All entries, the most recently used one first.
+	 */
+	List lru;
+
+	/**
+	 * Maps server URI and key (separated by a null byte) to the
+	 * #lru item.
+	 */
+	std::unordered_map<std::string, List::iterator> map;
+
+	std::map<std::string, ServerState, std::less<>> servers;
+
+public:
+	/**
+	 * @param _ttl the maximum age of an entry; zero disables
+	 * the cache
+	 */
+	UpnpContentCache(Clock::duration _ttl,
+			 std::size_t _max_entries) noexcept
+		:ttl(_ttl), max_entries(_max_entries) {}
+
+	UpnpContentCache(const UpnpContentCache &) = delete;
+	UpnpContentCache &operator=(const UpnpContentCache &) = delete;
+
+	bool IsEnabled() const noexcept {
+		return ttl > Clock::duration::zero();
+	}
+
+	Clock::duration GetTTL() const noexcept {
+		return ttl;
+	}
+
+	static std::string MakeBrowseKey(std::string_view object_id) noexcept;
+	static std::string MakeMetadataKey(std::string_view object_id) noexcept;
+	static std::string MakeSearchKey(std::string_view object_id,
+					 std::string_view criteria) noexcept;
+
+	/**
+	 * Look up an entry which has not yet expired.
+	 *
+	 * @return the entry or nullptr if there is none
+	 */
+	ContentPtr Get(std::string_view server, std::string_view key,
+		       Clock::time_point now=Clock::now()) noexcept;
+
+	/**
+	 * Add (or replace) an entry.
+	 */
+	void Put(std::string_view server, std::string_view key,
+		 ContentPtr content,
+		 Clock::time_point now=Clock::now()) noexcept;
+
+	/**
+	 * Is it time to ask the server for its "SystemUpdateID"
+	 * again?
+	 */
+	gcc_pure
+	bool NeedUpdateIdCheck(std::string_view server,
+			       Clock::duration interval,
+			       Clock::time_point now=Clock::now()) const noexcept;
+
+	/**
+	 * Submit a "SystemUpdateID" reported by the server.  If it
+	 * differs from the previous one, all entries of this server
+	 * are discarded.
+	 *
+	 * @return true if the server's content has changed
+	 */
+	bool SetUpdateId(std::string_view server, unsigned update_id,
+			 Clock::time_point now=Clock::now()) noexcept;
+
+	/**
+	 * The server has failed to report its "SystemUpdateID";
+	 * NeedUpdateIdCheck() will return false from now on.
+	 */
+	void SetUpdateIdUnsupported(std::string_view server) noexcept;
+
+	/**
+	 * Look up the server's search capabilities which were
+	 * passed to PutSearchCapabilities() earlier.
+	 *
+	 * @return the capabilities or nullptr if they are not known
+	 */
+	SearchCapsPtr GetSearchCapabilities(std::string_view server) const noexcept;
+
+	void PutSearchCapabilities(std::string_view server,
+				   SearchCapsPtr caps) noexcept;
+
+	/**
+	 * Discard all entries of the given server.
+	 */
+	void Flush(std::string_view server) noexcept;
+
+	void Clear() noexcept;
+
+	gcc_pure
+	std::size_t GetSize() const noexcept;
+
+	/**
+	 * Look up the key in the cache; if it is missing, invoke the
+	 * given function to obtain the value and add it to the
+	 * cache.
+	 *
+	 * Exceptions thrown by the function are passed to the
+	 * caller.
+	 */
+	template<typename F>
+	ContentPtr GetOrFetch(std::string_view server, std::string_view key,
+			      F &&fetch) {
+		if (!IsEnabled())
+			return std::make_shared<const UPnPDirContent>(fetch());
+
+		auto content = Get(server, key);
+		if (content)
+			return content;
+
+		/* the (slow) request to the server is done
+		   without holding the mutex; concurrent misses
+		   on the same key may both fetch it */
+		content = std::make_shared<const UPnPDirContent>(fetch());
+		Put(server, key, content);
+		return content;
+	}
+
+	/**
+	 * Like GetOrFetch(), but for the server's search
+	 * capabilities, which do not expire.
+	 */
+	template<typename F>
+	SearchCapsPtr GetOrFetchSearchCapabilities(std::string_view server,
+						   F &&fetch) {
+		if (!IsEnabled())
+			return std::make_shared<const SearchCaps>(fetch());
+
+		auto caps = GetSearchCapabilities(server);
+		if (caps)
+			return caps;
+
+		caps = std::make_shared<const SearchCaps>(fetch());
+		PutSearchCapabilities(server, caps);
+		return caps;
+	}
+
+private:
+	static std::string MakeMapKey(std::string_view server,
+				      std::string_view key) noexcept;
+
+	void Remove(List::iterator i) noexcept;
+
+	void FlushLocked(std::string_view server) noexcept;
+};
+
+#endif
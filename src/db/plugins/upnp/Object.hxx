@@ -76,6 +76,11 @@ public:
 	UPnPDirObject() = default;
 	UPnPDirObject(UPnPDirObject &&) = default;
 
+	/**
+	 * Copy an object, e.g. from the #UpnpContentCache.
+	 */
+	UPnPDirObject(const UPnPDirObject &) = default;
+
 	~UPnPDirObject() noexcept;
 
 	UPnPDirObject &operator=(UPnPDirObject &&) = default;
@@ -19,6 +19,7 @@
 
 #include "UpnpDatabasePlugin.hxx"
 #include "Directory.hxx"
+#include "Cache.hxx"
 #include "Tags.hxx"
 #include "lib/upnp/ClientInit.hxx"
 #include "lib/upnp/Discovery.hxx"
@@ -35,10 +36,16 @@
 #include "song/TagSongFilter.hxx"
 #include "db/Stats.hxx"
 #include "tag/Table.hxx"
+#include "config/Block.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Name.hxx"
+#include "thread/Thread.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/RecursiveMap.hxx"
 #include "util/SplitString.hxx"
+#include "Log.hxx"
 
 #include <cassert>
 #include <string>
@@ -48,6 +55,12 @@
 
 static const char *const rootid = "0";
 
+/**
+ * Ask each server for its "SystemUpdateID" at most this often, to
+ * find out whether cached responses are still valid.
+ */
+static constexpr auto UPDATE_ID_CHECK_INTERVAL = std::chrono::seconds(5);
+
 class UpnpSongData {
 protected:
 	std::string uri;
@@ -76,10 +89,30 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * Responses of all servers, shared by all clients.
+	 */
+	mutable UpnpContentCache cache;
+
+	/**
+	 * Refresh the top levels of all servers in the background?
+	 */
+	const bool cache_warm;
+
+	Mutex warm_mutex;
+	Cond warm_cond;
+	bool warm_quit;
+
+	Thread warm_thread{BIND_THIS_METHOD(RunWarmThread)};
+
 public:
-	explicit UpnpDatabase(EventLoop &_event_loop) noexcept
+	UpnpDatabase(EventLoop &_event_loop, const ConfigBlock &block) noexcept
 		:Database(upnp_db_plugin),
-		 event_loop(_event_loop) {}
+		 event_loop(_event_loop),
+		 cache(std::chrono::seconds(block.GetBlockValue("cache_ttl",
+								 60U)),
+		       block.GetPositiveValue("cache_size", 1024U)),
+		 cache_warm(block.GetBlockValue("cache_warm", false)) {}
 
 	static DatabasePtr Create(EventLoop &main_event_loop,
 				  EventLoop &io_event_loop,
@@ -106,6 +139,40 @@ public:
 	}
 
 private:
+	/**
+	 * Discard cached responses of this server if its
+	 * "SystemUpdateID" has changed.
+	 */
+	void CheckUpdateId(const ContentDirectoryService &server,
+			   const std::string &server_uri) const noexcept;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::readDir().
+	 */
+	UpnpContentCache::ContentPtr ReadDir(const ContentDirectoryService &server,
+					     const char *objid) const;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::getMetadata().
+	 */
+	UpnpContentCache::ContentPtr GetMetadata(const ContentDirectoryService &server,
+						 const char *objid) const;
+
+	/**
+	 * Cached wrapper for ContentDirectoryService::search().
+	 */
+	UpnpContentCache::ContentPtr Search(const ContentDirectoryService &server,
+					    const char *objid,
+					    const char *criteria) const;
+
+	/**
+	 * Fetch the top levels of all servers and store them in the
+	 * cache.
+	 */
+	void WarmCache() noexcept;
+
+	void RunWarmThread() noexcept;
+
 	void VisitServer(const ContentDirectoryService &server,
 			 std::forward_list<std::string_view> &&vpath,
 			 const DatabaseSelection &selection,
@@ -122,9 +189,13 @@ private:
 			 const DatabaseSelection &selection,
 			 const VisitSong& visit_song) const;
 
-	UPnPDirContent SearchSongs(const ContentDirectoryService &server,
-				   const char *objid,
-				   const DatabaseSelection &selection) const;
+	/**
+	 * @return the search results or nullptr if this selection
+	 * cannot be searched
+	 */
+	UpnpContentCache::ContentPtr SearchSongs(const ContentDirectoryService &server,
+						 const char *objid,
+						 const DatabaseSelection &selection) const;
 
 	UPnPDirObject Namei(const ContentDirectoryService &server,
 			    std::forward_list<std::string_view> &&vpath) const;
@@ -147,9 +218,9 @@ private:
 DatabasePtr
 UpnpDatabase::Create(EventLoop &, EventLoop &io_event_loop,
 		     [[maybe_unused]] DatabaseListener &listener,
-		     const ConfigBlock &) noexcept
+		     const ConfigBlock &block) noexcept
 {
-	return std::make_unique<UpnpDatabase>(io_event_loop);
+	return std::make_unique<UpnpDatabase>(io_event_loop, block);
 }
 
 void
@@ -165,13 +236,141 @@ UpnpDatabase::Open()
 		UpnpClientGlobalFinish();
 		throw;
 	}
+
+	if (cache_warm && cache.IsEnabled()) {
+		warm_quit = false;
+
+		try {
+			warm_thread.Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start UPnP cache thread");
+		}
+	}
 }
 
 void
 UpnpDatabase::Close() noexcept
 {
+	if (warm_thread.IsDefined()) {
+		{
+			const std::lock_guard<Mutex> protect(warm_mutex);
+			warm_quit = true;
+			warm_cond.notify_one();
+		}
+
+		warm_thread.Join();
+	}
+
 	delete discovery;
 	UpnpClientGlobalFinish();
+
+	cache.Clear();
+}
+
+void
+UpnpDatabase::CheckUpdateId(const ContentDirectoryService &server,
+			    const std::string &server_uri) const noexcept
+{
+	if (!cache.IsEnabled() ||
+	    !cache.NeedUpdateIdCheck(server_uri, UPDATE_ID_CHECK_INTERVAL))
+		return;
+
+	try {
+		cache.SetUpdateId(server_uri,
+				  server.getSystemUpdateID(handle));
+	} catch (...) {
+		/* the server does not support this action; rely on
+		   the TTL only, and don't ask again */
+		cache.SetUpdateIdUnsupported(server_uri);
+	}
+}
+
+UpnpContentCache::ContentPtr
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid) const
+{
+	const auto server_uri = server.GetURI();
+	CheckUpdateId(server, server_uri);
+
+	return cache.GetOrFetch(server_uri,
+				UpnpContentCache::MakeBrowseKey(objid),
+				[&]{ return server.readDir(handle, objid); });
+}
+
+UpnpContentCache::ContentPtr
+UpnpDatabase::GetMetadata(const ContentDirectoryService &server,
+			  const char *objid) const
+{
+	const auto server_uri = server.GetURI();
+	CheckUpdateId(server, server_uri);
+
+	return cache.GetOrFetch(server_uri,
+				UpnpContentCache::MakeMetadataKey(objid),
+				[&]{ return server.getMetadata(handle, objid); });
+}
+
+UpnpContentCache::ContentPtr
+UpnpDatabase::Search(const ContentDirectoryService &server,
+		     const char *objid, const char *criteria) const
+{
+	const auto server_uri = server.GetURI();
+	CheckUpdateId(server, server_uri);
+
+	return cache.GetOrFetch(server_uri,
+				UpnpContentCache::MakeSearchKey(objid, criteria),
+				[&]{ return server.search(handle, objid, criteria); });
+}
+
+void
+UpnpDatabase::WarmCache() noexcept
+{
+	for (const auto &server : discovery->GetDirectories()) {
+		const auto server_uri = server.GetURI();
+
+		try {
+			CheckUpdateId(server, server_uri);
+
+			/* always fetch, to replace entries before
+			   they expire */
+			auto root = std::make_shared<const UPnPDirContent>(server.readDir(handle, rootid));
+			cache.Put(server_uri,
+				  UpnpContentCache::MakeBrowseKey(rootid),
+				  root);
+
+			for (const auto &object : root->objects) {
+				if (object.type != UPnPDirObject::Type::CONTAINER)
+					continue;
+
+				cache.Put(server_uri,
+					  UpnpContentCache::MakeBrowseKey(object.id),
+					  std::make_shared<const UPnPDirContent>(server.readDir(handle, object.id.c_str())));
+			}
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+}
+
+void
+UpnpDatabase::RunWarmThread() noexcept
+{
+	SetThreadName("upnp_cache");
+
+	/* the first round runs soon after startup, when discovery
+	   has found the servers */
+	std::chrono::steady_clock::duration delay = std::chrono::seconds(5);
+
+	std::unique_lock<Mutex> lock(warm_mutex);
+	while (!warm_cond.wait_for(lock, delay, [this]{ return warm_quit; })) {
+		{
+			const ScopeUnlock unlock(warm_mutex);
+			WarmCache();
+		}
+
+		delay = std::max<std::chrono::steady_clock::duration>(cache.GetTTL() / 2,
+								      std::chrono::seconds(1));
+	}
 }
 
 void
@@ -239,18 +438,22 @@ dquote(std::string &out, const char *in) noexcept
 
 // Run an UPnP search, according to MPD parameters. Return results as
 // UPnP items
-UPnPDirContent
+UpnpContentCache::ContentPtr
 UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 			  const char *objid,
 			  const DatabaseSelection &selection) const
 {
 	const SongFilter *filter = selection.filter;
 	if (selection.filter == nullptr)
-		return UPnPDirContent();
+		return nullptr;
 
-	const auto searchcaps = server.getSearchCapabilities(handle);
+	const auto searchcaps_ptr =
+		cache.GetOrFetchSearchCapabilities(server.GetURI(), [&]{
+			return server.getSearchCapabilities(handle);
+		});
+	const auto &searchcaps = *searchcaps_ptr;
 	if (searchcaps.empty())
-		return UPnPDirContent();
+		return nullptr;
 
 	std::string cond;
 	for (const auto &item : filter->GetItems()) {
@@ -307,7 +510,7 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 		// TODO: support other ISongFilter implementations
 	}
 
-	return server.search(handle, objid, cond.c_str());
+	return Search(server, objid, cond.c_str());
 }
 
 static void
@@ -346,7 +549,11 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	if (!visit_song)
 		return;
 
-	for (auto &dirent : SearchSongs(server, objid, selection).objects) {
+	const auto content = SearchSongs(server, objid, selection);
+	if (!content)
+		return;
+
+	for (const auto &dirent : content->objects) {
 		if (dirent.type != UPnPDirObject::Type::ITEM ||
 		    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
 			continue;
@@ -378,11 +585,11 @@ UPnPDirObject
 UpnpDatabase::ReadNode(const ContentDirectoryService &server,
 		       const char *objid) const
 {
-	auto dirbuf = server.getMetadata(handle, objid);
-	if (dirbuf.objects.size() != 1)
+	const auto dirbuf = GetMetadata(server, objid);
+	if (dirbuf->objects.size() != 1)
 		throw std::runtime_error("Bad resource");
 
-	return std::move(dirbuf.objects.front());
+	return dirbuf->objects.front();
 }
 
 std::string
@@ -418,23 +625,23 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	while (true) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		const auto dirbuf = ReadDir(server, objid.c_str());
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(vpath.front());
+		const UPnPDirObject *child = dirbuf->FindObject(vpath.front());
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		vpath.pop_front();
 		if (vpath.empty())
-			return std::move(*child);
+			return *child;
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -564,7 +771,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	for (const auto &dirent : server.readDir(handle, tdirent.id.c_str()).objects) {
+	const auto content = ReadDir(server, tdirent.id.c_str());
+	for (const auto &dirent : content->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		VisitObject(dirent, uri.c_str(),
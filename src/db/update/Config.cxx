@@ -31,7 +31,12 @@ UpdateConfig::UpdateConfig(const ConfigData &config)
 	follow_outside_symlinks =
 		config.GetBool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 			       DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
-#else
-	(void)config;
 #endif
+
+	skip_unchanged_directories =
+		config.GetBool(ConfigOption::SKIP_UNCHANGED_DIRECTORIES,
+			       false);
+
+	loudness_analysis =
+		config.GetBool(ConfigOption::LOUDNESS_ANALYSIS, false);
 }
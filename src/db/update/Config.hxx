@@ -31,6 +31,19 @@ struct UpdateConfig {
 	bool follow_outside_symlinks = DEFAULT_FOLLOW_OUTSIDE_SYMLINKS;
 #endif
 
+	/**
+	 * Don't read the listing of directories whose modification
+	 * time and inode number have not changed since the last
+	 * update; only descend into their known subdirectories.
+	 */
+	bool skip_unchanged_directories = false;
+
+	/**
+	 * Decode all songs in the background to determine their
+	 * loudness (see #LoudnessAnalyzer).
+	 */
+	bool loudness_analysis = false;
+
 	explicit UpdateConfig(const ConfigData &config);
 };
 
@@ -24,6 +24,9 @@
 #include "protocol/Ack.hxx" // for class ProtocolError
 #include "util/StringCompare.hxx"
 
+#include <algorithm>
+#include <vector>
+
 /**
  * Wait this long after the last change before calling
  * UpdateService::Enqueue().  This increases the probability that
@@ -32,11 +35,122 @@
 static constexpr std::chrono::steady_clock::duration INOTIFY_UPDATE_DELAY =
 	std::chrono::seconds(5);
 
+/**
+ * If more files than this are changed within one
+ * #INOTIFY_UPDATE_DELAY, it is cheaper to rescan their directories.
+ */
+static constexpr std::size_t MAX_FILE_OPERATIONS = 1024;
+
+gcc_pure
+static bool
+path_in(const char *path, const char *possible_parent) noexcept
+{
+	if (StringIsEmpty(path))
+		return true;
+
+	auto rest = StringAfterPrefix(path, possible_parent);
+	return rest != nullptr &&
+		(StringIsEmpty(rest) || rest[0] == '/');
+}
+
+static std::string
+GetParentUri(std::string_view uri) noexcept
+{
+	const auto slash = uri.rfind('/');
+	if (slash == uri.npos)
+		return {};
+
+	return std::string(uri.substr(0, slash));
+}
+
+void
+InotifyQueue::ClearFiles() noexcept
+{
+	files.clear();
+	file_index.clear();
+	pending_moves.clear();
+	files_overflow = false;
+}
+
+void
+InotifyQueue::PruneFiles() noexcept
+{
+	if (queue.empty() || files.empty())
+		return;
+
+	auto is_covered = [this](const std::string &uri){
+		return std::any_of(queue.begin(), queue.end(),
+				   [&uri](const std::string &directory){
+					   return directory.empty() ||
+						   path_in(uri.c_str(),
+							   directory.c_str());
+				   });
+	};
+
+	/* the new index of each operation which is kept unchanged,
+	   to update #file_index and #pending_moves; they must remain
+	   valid, because OnDelay() may postpone the flush */
+	static constexpr std::size_t PRUNED = std::size_t(-1);
+	std::vector<std::size_t> new_index(files.size(), PRUNED);
+
+	UpdateFileOperationList result;
+
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		auto &op = files[i];
+		const bool covered = is_covered(op.uri);
+
+		if (op.type != UpdateFileOperation::Type::MOVE) {
+			if (!covered) {
+				new_index[i] = result.size();
+				result.push_back(std::move(op));
+			}
+
+			continue;
+		}
+
+		const bool from_covered = is_covered(op.from_uri);
+		if (!covered && !from_covered) {
+			new_index[i] = result.size();
+			result.push_back(std::move(op));
+			continue;
+		}
+
+		/* one side of the move is covered by a directory
+		   rescan; handle the other side separately */
+
+		if (!from_covered)
+			result.emplace_back(UpdateFileOperation::Type::REMOVE,
+					    std::move(op.from_uri));
+
+		if (!covered)
+			result.emplace_back(UpdateFileOperation::Type::UPDATE,
+					    std::move(op.uri));
+	}
+
+	auto reindex = [&new_index](auto &map){
+		for (auto i = map.begin(); i != map.end();) {
+			const std::size_t n = new_index[i->second];
+			if (n == PRUNED) {
+				i = map.erase(i);
+			} else {
+				i->second = n;
+				++i;
+			}
+		}
+	};
+
+	reindex(file_index);
+	reindex(pending_moves);
+	files = std::move(result);
+}
+
 void
 InotifyQueue::OnDelay() noexcept
 {
 	unsigned id;
 
+	PruneFiles();
+
 	while (!queue.empty()) {
 		const char *uri_utf8 = queue.front().c_str();
 
@@ -64,18 +178,35 @@ InotifyQueue::OnDelay() noexcept
 
 		queue.pop_front();
 	}
-}
 
-gcc_pure
-static bool
-path_in(const char *path, const char *possible_parent) noexcept
-{
-	if (StringIsEmpty(path))
-		return true;
+	if (files.empty())
+		return;
 
-	auto rest = StringAfterPrefix(path, possible_parent);
-	return rest != nullptr &&
-		(StringIsEmpty(rest) || rest[0] == '/');
+	const std::size_t n_files = files.size();
+
+	try {
+		try {
+			id = update.Enqueue(std::move(files));
+		} catch (const ProtocolError &e) {
+			if (e.GetCode() == ACK_ERROR_UPDATE_ALREADY) {
+				/* retry later */
+				delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+				return;
+			}
+
+			throw;
+		}
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to enqueue %zu files", n_files);
+		ClearFiles();
+		return;
+	}
+
+	FormatDebug(inotify_domain, "updating %zu files job=%u",
+		    n_files, id);
+
+	ClearFiles();
 }
 
 void
@@ -101,3 +232,117 @@ InotifyQueue::Enqueue(const char *uri_utf8) noexcept
 
 	queue.emplace_back(uri_utf8);
 }
+
+void
+InotifyQueue::FilesToDirectories() noexcept
+{
+	FormatDebug(inotify_domain,
+		    "too many changed files, rescanning their directories");
+
+	for (const auto &op : files) {
+		Enqueue(GetParentUri(op.uri).c_str());
+		if (op.type == UpdateFileOperation::Type::MOVE)
+			Enqueue(GetParentUri(op.from_uri).c_str());
+	}
+
+	ClearFiles();
+	files_overflow = true;
+}
+
+void
+InotifyQueue::EnqueueFile(UpdateFileOperation::Type type,
+			  std::string &&uri_utf8) noexcept
+{
+	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+
+	if (!files_overflow) {
+		auto i = file_index.find(uri_utf8);
+		if (i != file_index.end()) {
+			/* merge with the previous event; the file
+			   will be checked again anyway, so only the
+			   last event matters */
+			files[i->second].type = type;
+			return;
+		}
+
+		if (files.size() >= MAX_FILE_OPERATIONS)
+			FilesToDirectories();
+	}
+
+	if (files_overflow) {
+		Enqueue(GetParentUri(uri_utf8).c_str());
+		return;
+	}
+
+	file_index.emplace(uri_utf8, files.size());
+	files.emplace_back(type, std::move(uri_utf8));
+}
+
+void
+InotifyQueue::EnqueueUpdateFile(std::string &&uri_utf8) noexcept
+{
+	EnqueueFile(UpdateFileOperation::Type::UPDATE, std::move(uri_utf8));
+}
+
+void
+InotifyQueue::EnqueueRemoveFile(std::string &&uri_utf8) noexcept
+{
+	EnqueueFile(UpdateFileOperation::Type::REMOVE, std::move(uri_utf8));
+}
+
+void
+InotifyQueue::EnqueueMoveFrom(uint32_t cookie,
+			      std::string &&uri_utf8) noexcept
+{
+	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+
+	if (!files_overflow && files.size() >= MAX_FILE_OPERATIONS)
+		FilesToDirectories();
+
+	if (files_overflow) {
+		Enqueue(GetParentUri(uri_utf8).c_str());
+		return;
+	}
+
+	/* this is a removal unless the matching IN_MOVED_TO
+	   arrives; it must not be merged with other events, because
+	   it may be converted to a move later */
+	file_index.erase(uri_utf8);
+	pending_moves[cookie] = files.size();
+	files.emplace_back(UpdateFileOperation::Type::REMOVE,
+			   std::move(uri_utf8));
+}
+
+void
+InotifyQueue::EnqueueMoveTo(uint32_t cookie, std::string &&uri_utf8) noexcept
+{
+	auto i = files_overflow
+		? pending_moves.end()
+		: pending_moves.find(cookie);
+	if (i == pending_moves.end()) {
+		/* moved here from outside the music directory */
+		EnqueueUpdateFile(std::move(uri_utf8));
+		return;
+	}
+
+	delay_event.Schedule(INOTIFY_UPDATE_DELAY);
+
+	auto &op = files[i->second];
+	pending_moves.erase(i);
+
+	file_index.erase(uri_utf8);
+	op.type = UpdateFileOperation::Type::MOVE;
+	op.from_uri = std::move(op.uri);
+	op.uri = std::move(uri_utf8);
+}
+
+void
+InotifyQueue::Overflow() noexcept
+{
+	LogWarning(inotify_domain,
+		   "inotify queue overflow, rescanning the music directory");
+
+	ClearFiles();
+	queue.clear();
+	Enqueue("");
+}
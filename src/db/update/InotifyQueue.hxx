@@ -20,18 +20,52 @@
 #ifndef MPD_INOTIFY_QUEUE_HXX
 #define MPD_INOTIFY_QUEUE_HXX
 
+#include "Queue.hxx"
 #include "event/TimerEvent.hxx"
 
+#include <cstdint>
 #include <list>
+#include <map>
 #include <string>
+#include <unordered_map>
 
 class UpdateService;
 
 class InotifyQueue final {
 	UpdateService &update;
 
+	/**
+	 * Directories which shall be rescanned completely.
+	 */
 	std::list<std::string> queue;
 
+	/**
+	 * Changes of single files, in the order they were reported.
+	 */
+	UpdateFileOperationList files;
+
+	/**
+	 * Maps URIs to the index of the last #UpdateFileOperation in
+	 * #files which refers to it, to allow merging repeated
+	 * events for the same file.
+	 */
+	std::unordered_map<std::string, std::size_t> file_index;
+
+	/**
+	 * Maps inotify cookies of IN_MOVED_FROM events to the index
+	 * of the #UpdateFileOperation::Type::REMOVE item in #files
+	 * which will be converted to a #UpdateFileOperation::Type::MOVE
+	 * as soon as the matching IN_MOVED_TO event arrives.
+	 */
+	std::map<uint32_t, std::size_t> pending_moves;
+
+	/**
+	 * Set when there were too many file changes; until the next
+	 * flush, all file changes are converted to rescans of their
+	 * parent directories.
+	 */
+	bool files_overflow = false;
+
 	TimerEvent delay_event;
 
 public:
@@ -39,9 +73,57 @@ public:
 		:update(_update),
 		 delay_event(_loop, BIND_THIS_METHOD(OnDelay)) {}
 
+	/**
+	 * Rescan the given directory.
+	 */
 	void Enqueue(const char *uri_utf8) noexcept;
 
+	/**
+	 * A file was created or modified.
+	 */
+	void EnqueueUpdateFile(std::string &&uri_utf8) noexcept;
+
+	/**
+	 * A file (or directory) was deleted.
+	 */
+	void EnqueueRemoveFile(std::string &&uri_utf8) noexcept;
+
+	/**
+	 * A file was renamed away from the given URI (IN_MOVED_FROM).
+	 */
+	void EnqueueMoveFrom(uint32_t cookie, std::string &&uri_utf8) noexcept;
+
+	/**
+	 * A file was renamed to the given URI (IN_MOVED_TO).
+	 */
+	void EnqueueMoveTo(uint32_t cookie, std::string &&uri_utf8) noexcept;
+
+	/**
+	 * The kernel has dropped events (IN_Q_OVERFLOW); rescan
+	 * everything.
+	 */
+	void Overflow() noexcept;
+
 private:
+	void EnqueueFile(UpdateFileOperation::Type type,
+			 std::string &&uri_utf8) noexcept;
+
+	/**
+	 * Convert all pending file changes to rescans of their
+	 * parent directories.
+	 */
+	void FilesToDirectories() noexcept;
+
+	void ClearFiles() noexcept;
+
+	/**
+	 * Remove all file changes which are covered by a directory
+	 * rescan.  #file_index and #pending_moves are updated, so
+	 * the remaining ones can still be merged and paired if the
+	 * flush gets postponed.
+	 */
+	void PruneFiles() noexcept;
+
 	void OnDelay() noexcept;
 };
 
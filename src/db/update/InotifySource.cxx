@@ -60,7 +60,8 @@ InotifySource::OnSocketReady([[maybe_unused]] unsigned flags) noexcept
 		else
 			name = nullptr;
 
-		callback(event->wd, event->mask, name, callback_ctx);
+		callback(event->wd, event->mask, event->cookie, name,
+			 callback_ctx);
 		p += sizeof(*event) + event->len;
 	}
 
@@ -22,7 +22,12 @@
 
 #include "event/SocketMonitor.hxx"
 
+/**
+ * @param cookie the inotify cookie which connects IN_MOVED_FROM
+ * and IN_MOVED_TO events
+ */
 typedef void (*mpd_inotify_callback_t)(int wd, unsigned mask,
+				       unsigned cookie,
 				       const char *name, void *ctx);
 
 class InotifySource final : private SocketMonitor {
@@ -62,6 +67,19 @@ public:
 	 */
 	void Remove(unsigned wd) noexcept;
 
+	/**
+	 * Stop reading events; the kernel queues them until
+	 * Resume() is called (or until its queue overflows, see
+	 * IN_Q_OVERFLOW).
+	 */
+	void Pause() noexcept {
+		CancelRead();
+	}
+
+	void Resume() noexcept {
+		ScheduleRead();
+	}
+
 private:
 	bool OnSocketReady(unsigned flags) noexcept override;
 };
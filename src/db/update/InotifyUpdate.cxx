@@ -21,16 +21,33 @@
 #include "InotifySource.hxx"
 #include "InotifyQueue.hxx"
 #include "InotifyDomain.hxx"
+#include "Service.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
 #include "storage/StorageInterface.hxx"
+#include "event/DeferEvent.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/BindMethod.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <forward_list>
-#include <map>
+#include <list>
 #include <string>
+#include <string_view>
+#include <thread> // for std::thread::hardware_concurrency()
+#include <unordered_map>
+#include <vector>
 
 #include <sys/inotify.h>
 #include <string.h>
@@ -73,7 +90,7 @@ static InotifyQueue *inotify_queue;
 
 static unsigned inotify_max_depth;
 static WatchDirectory *inotify_root;
-static std::map<int, WatchDirectory *> inotify_directories;
+static std::unordered_map<int, WatchDirectory *> inotify_directories;
 
 static void
 tree_add_watch_directory(WatchDirectory *directory)
@@ -235,13 +252,19 @@ WatchDirectory::GetDepth() const noexcept
 }
 
 static void
-mpd_inotify_callback(int wd, unsigned mask,
-		     [[maybe_unused]] const char *name, [[maybe_unused]] void *ctx)
+mpd_inotify_callback(int wd, unsigned mask, unsigned cookie,
+		     const char *name, [[maybe_unused]] void *ctx)
 {
 	WatchDirectory *directory;
 
 	/*FormatDebug(inotify_domain, "wd=%d mask=0x%x name='%s'", wd, mask, name);*/
 
+	if ((mask & IN_Q_OVERFLOW) != 0) {
+		/* events were lost */
+		inotify_queue->Overflow();
+		return;
+	}
+
 	directory = tree_find_watch_directory(wd);
 	if (directory == nullptr)
 		return;
@@ -267,22 +290,421 @@ mpd_inotify_callback(int wd, unsigned mask,
 					       directory->GetDepth());
 	}
 
-	if ((mask & (IN_CLOSE_WRITE|IN_MOVE|IN_DELETE)) != 0 ||
-	    /* at the maximum depth, we watch out for newly created
-	       directories */
-	    (directory->GetDepth() == inotify_max_depth &&
-	     (mask & (IN_CREATE|IN_ISDIR)) == (IN_CREATE|IN_ISDIR))) {
-		/* a file was changed, or a directory was
-		   moved/deleted: queue a database update */
-
-		if (!uri_fs.IsNull()) {
-			const std::string uri_utf8 = uri_fs.ToUTF8();
-			if (!uri_utf8.empty())
-				inotify_queue->Enqueue(uri_utf8.c_str());
+	if (name == nullptr || skip_path(name))
+		return;
+
+	const auto child_uri_fs = uri_fs.IsNull()
+		? AllocatedPath::FromFS(name)
+		: AllocatedPath::Build(uri_fs, name);
+	std::string uri_utf8 = child_uri_fs.ToUTF8();
+	if (uri_utf8.empty())
+		return;
+
+	if ((mask & IN_ISDIR) != 0) {
+		if ((mask & (IN_DELETE|IN_MOVED_FROM)) != 0)
+			inotify_queue->EnqueueRemoveFile(std::move(uri_utf8));
+		else if ((mask & (IN_CREATE|IN_MOVED_TO)) != 0)
+			/* a new directory: scan it completely,
+			   because files may have been created in it
+			   before it was being watched */
+			inotify_queue->Enqueue(uri_utf8.c_str());
+
+		return;
+	}
+
+	/* a file was changed: update only this file */
+
+	if ((mask & IN_MOVED_FROM) != 0)
+		inotify_queue->EnqueueMoveFrom(cookie, std::move(uri_utf8));
+	else if ((mask & IN_MOVED_TO) != 0)
+		inotify_queue->EnqueueMoveTo(cookie, std::move(uri_utf8));
+	else if ((mask & IN_DELETE) != 0)
+		inotify_queue->EnqueueRemoveFile(std::move(uri_utf8));
+	else if ((mask & (IN_CREATE|IN_CLOSE_WRITE)) != 0)
+		inotify_queue->EnqueueUpdateFile(std::move(uri_utf8));
+}
+
+/**
+ * A copy of the directory tree of the database, used to register
+ * inotify watches without walking the file system.
+ */
+struct DirectorySnapshot {
+	AllocatedPath name;
+
+	std::chrono::system_clock::time_point mtime;
+
+	std::forward_list<DirectorySnapshot> children;
+
+	DirectorySnapshot(AllocatedPath &&_name,
+			  std::chrono::system_clock::time_point _mtime) noexcept
+		:name(std::move(_name)), mtime(_mtime) {}
+};
+
+/**
+ * Copy the real (i.e. not virtual, not mounted) sub directories of
+ * the given database #Directory.
+ *
+ * The caller must lock the database.
+ *
+ * @return the number of directories copied
+ */
+static std::size_t
+SnapshotDirectories(DirectorySnapshot &dest, const Directory &src,
+		    unsigned depth) noexcept
+{
+	if (depth >= inotify_max_depth)
+		return 0;
+
+	std::size_t n = 0;
+
+	for (const Directory &child : src.children) {
+		if (child.IsMount() || child.IsReallyAFile())
+			continue;
+
+		auto name_fs = AllocatedPath::FromUTF8(child.GetName());
+		if (name_fs.IsNull())
+			continue;
+
+		auto &c = dest.children.emplace_front(std::move(name_fs),
+						      child.mtime);
+		n += 1 + SnapshotDirectories(c, child, depth + 1);
+	}
+
+	return n;
+}
+
+/**
+ * Registers inotify watches for the whole music directory in
+ * several worker threads.  The directory tree is taken from the
+ * database; only directories which were modified since the database
+ * was updated are read from the file system.
+ *
+ * Until this is finished, the #InotifySource is paused, so the
+ * #WatchDirectory tree is accessed only by the worker threads.
+ */
+class InotifyWatchSetup final {
+	/**
+	 * The maximum number of worker threads.  The kernel
+	 * serializes inotify_add_watch() calls, but stat() and
+	 * directory reads can run in parallel.
+	 */
+	static constexpr unsigned MAX_THREADS = 4;
+
+	struct Item {
+		WatchDirectory &parent;
+
+		AllocatedPath path_fs;
+
+		AllocatedPath name_fs;
+
+		/**
+		 * The database's view of this directory, or
+		 * nullptr if it is not in the database.
+		 */
+		const DirectorySnapshot *snapshot;
+
+		unsigned depth;
+	};
+
+	DirectorySnapshot snapshot;
+
+	DeferEvent done_event;
+
+	/**
+	 * Invoked in the #EventLoop thread when all watches have been
+	 * registered.  The owner may delete this object.
+	 */
+	const BoundMethod<void() noexcept> done_callback;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Directories which shall be watched.  Protected by
+	 * #mutex.
+	 */
+	std::vector<Item> queue;
+
+	/**
+	 * The number of worker threads which are currently processing
+	 * an #Item.  Protected by #mutex.
+	 */
+	unsigned busy = 0;
+
+	std::atomic_bool cancel{false};
+
+	std::atomic_size_t n_watched{0}, n_listed{0};
+
+	std::list<Thread> threads;
+
+	const std::chrono::steady_clock::time_point start_time =
+		std::chrono::steady_clock::now();
+
+public:
+	InotifyWatchSetup(EventLoop &loop, SimpleDatabase &db,
+			  BoundMethod<void() noexcept> _done_callback) noexcept
+		:snapshot(nullptr, std::chrono::system_clock::time_point::min()),
+		 done_event(loop, BIND_THIS_METHOD(OnDone)),
+		 done_callback(_done_callback)
+	{
+		const ScopeDatabaseLock protect;
+		const auto &root = db.GetRoot();
+		snapshot.mtime = root.mtime;
+		inotify_directories.reserve(SnapshotDirectories(snapshot,
+								root, 0) + 1);
+	}
+
+	~InotifyWatchSetup() noexcept {
+		Stop();
+	}
+
+	void Start(WatchDirectory &root) noexcept;
+
+private:
+	void Stop() noexcept;
+
+	void ProcessChildren(WatchDirectory &directory,
+			     const AllocatedPath &path_fs,
+			     const DirectorySnapshot *dir_snapshot,
+			     unsigned depth,
+			     std::vector<Item> &children) noexcept;
+
+	void Process(Item &item, std::vector<Item> &children) noexcept;
+
+	void RunThread() noexcept;
+
+	/* DeferEvent callback */
+	void OnDone() noexcept;
+};
+
+static InotifyWatchSetup *inotify_setup;
+
+/**
+ * Was the given directory modified since the database was updated?
+ */
+static bool
+IsModifiedSince(Path path_fs,
+		std::chrono::system_clock::time_point mtime) noexcept
+try {
+	return FileInfo(path_fs).GetModificationTime() != mtime;
+} catch (...) {
+	return true;
+}
+
+inline void
+InotifyWatchSetup::ProcessChildren(WatchDirectory &directory,
+				   const AllocatedPath &path_fs,
+				   const DirectorySnapshot *dir_snapshot,
+				   unsigned depth,
+				   std::vector<Item> &children) noexcept
+{
+	if (dir_snapshot != nullptr &&
+	    !IsModifiedSince(path_fs, dir_snapshot->mtime)) {
+		/* the database is up to date: no need to read the
+		   directory */
+		for (const auto &child : dir_snapshot->children)
+			children.push_back({directory,
+					    path_fs / child.name,
+					    child.name, &child,
+					    depth});
+		return;
+	}
+
+	++n_listed;
+
+	std::unordered_map<std::string_view, const DirectorySnapshot *> known;
+	if (dir_snapshot != nullptr)
+		for (const auto &child : dir_snapshot->children)
+			known.emplace(child.name.c_str(), &child);
+
+	DIR *dir = opendir(path_fs.c_str());
+	if (dir == nullptr) {
+		FormatErrno(inotify_domain,
+			    "Failed to open directory %s", path_fs.c_str());
+		return;
+	}
+
+	while (const auto *ent = readdir(dir)) {
+		if (skip_path(ent->d_name))
+			continue;
+
+		auto child_path_fs = path_fs / Path::FromFS(ent->d_name);
+
+#ifdef DT_DIR
+		if (ent->d_type != DT_DIR && ent->d_type != DT_UNKNOWN &&
+		    ent->d_type != DT_LNK)
+			continue;
+#endif
+
+		try {
+			if (!FileInfo(child_path_fs).IsDirectory())
+				continue;
+		} catch (...) {
+			LogError(std::current_exception());
+			continue;
+		}
+
+		auto i = known.find(ent->d_name);
+		children.push_back({directory,
+				    std::move(child_path_fs),
+				    AllocatedPath::FromFS(ent->d_name),
+				    i != known.end() ? i->second : nullptr,
+				    depth});
+	}
+
+	closedir(dir);
+}
+
+inline void
+InotifyWatchSetup::Process(Item &item, std::vector<Item> &children) noexcept
+{
+	int wd;
+	try {
+		wd = inotify_source->Add(item.path_fs.c_str(), IN_MASK);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "Failed to register %s", item.path_fs.c_str());
+		return;
+	}
+
+	WatchDirectory *directory;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		if (tree_find_watch_directory(wd) != nullptr)
+			/* already being watched */
+			return;
+
+		item.parent.children.emplace_front(&item.parent,
+						   std::move(item.name_fs),
+						   wd);
+		directory = &item.parent.children.front();
+		tree_add_watch_directory(directory);
+	}
+
+	++n_watched;
+
+	if (item.depth < inotify_max_depth)
+		ProcessChildren(*directory, item.path_fs, item.snapshot,
+				item.depth + 1, children);
+}
+
+void
+InotifyWatchSetup::RunThread() noexcept
+{
+	SetThreadName("inotify");
+
+	std::vector<Item> children;
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	while (!cancel) {
+		if (queue.empty()) {
+			if (busy == 0) {
+				/* all done */
+				cond.notify_all();
+				break;
+			}
+
+			cond.wait(lock);
+			continue;
+		}
+
+		/* LIFO order keeps the queue short */
+		Item item = std::move(queue.back());
+		queue.pop_back();
+		++busy;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			Process(item, children);
+		}
+
+		--busy;
+
+		if (!children.empty()) {
+			std::move(children.begin(), children.end(),
+				  std::back_inserter(queue));
+			children.clear();
+			cond.notify_all();
+		} else if (busy == 0 && queue.empty())
+			cond.notify_all();
+	}
+
+	if (busy == 0 && !cancel)
+		done_event.Schedule();
+}
+
+void
+InotifyWatchSetup::Start(WatchDirectory &root) noexcept
+{
+	/* the root directory itself has already been registered by
+	   the caller */
+	ProcessChildren(root, root.name, &snapshot, 1, queue);
+
+	const unsigned n_threads =
+		std::clamp(std::thread::hardware_concurrency(),
+			   1U, MAX_THREADS);
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		auto &thread = threads.emplace_back(BIND_THIS_METHOD(RunThread));
+
+		try {
+			thread.Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start inotify thread");
+			threads.pop_back();
+			break;
 		}
-		else
-			inotify_queue->Enqueue("");
 	}
+
+	if (threads.empty())
+		/* no thread: do it synchronously */
+		RunThread();
+}
+
+void
+InotifyWatchSetup::Stop() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		cancel = true;
+		cond.notify_all();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+	threads.clear();
+
+	done_event.Cancel();
+}
+
+void
+InotifyWatchSetup::OnDone() noexcept
+{
+	Stop();
+
+	const auto duration = std::chrono::steady_clock::now() - start_time;
+	FormatDebug(inotify_domain,
+		    "watching music directory: %zu directories, %zu read, %u ms",
+		    n_watched.load() + 1, n_listed.load(),
+		    unsigned(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count()));
+
+	/* the owner deletes this object */
+	done_callback();
+}
+
+static void
+OnInotifySetupDone() noexcept
+{
+	/* now that the #WatchDirectory tree is complete, events can
+	   be handled */
+	inotify_source->Resume();
+
+	delete inotify_setup;
+	inotify_setup = nullptr;
 }
 
 void
@@ -322,11 +744,14 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 
 	tree_add_watch_directory(inotify_root);
 
-	recursive_watch_subdirectories(inotify_root, path, 0);
-
 	inotify_queue = new InotifyQueue(loop, update);
 
-	LogDebug(inotify_domain, "watching music directory");
+	/* register the sub directories in the background; events
+	   are handled after that has finished */
+	inotify_source->Pause();
+	inotify_setup = new InotifyWatchSetup(loop, update.GetDatabase(),
+					      BIND_FUNCTION(OnInotifySetupDone));
+	inotify_setup->Start(*inotify_root);
 }
 
 void
@@ -335,6 +760,7 @@ mpd_inotify_finish() noexcept
 	if (inotify_source == nullptr)
 		return;
 
+	delete inotify_setup;
 	delete inotify_queue;
 	delete inotify_source;
 	delete inotify_root;
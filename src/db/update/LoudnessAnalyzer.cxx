@@ -0,0 +1,521 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "LoudnessAnalyzer.hxx"
+#include "UpdateDomain.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "storage/StorageInterface.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "decoder/DecoderList.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "pcm/LoudnessMeter.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/UriExtract.hxx"
+#include "ReplayGainInfo.hxx"
+#include "Log.hxx"
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * The ReplayGain 2.0 reference level [LUFS].
+ */
+static constexpr double REFERENCE_LOUDNESS = -18;
+
+/**
+ * After being busy for this duration, the thread sleeps for the
+ * same duration.
+ */
+static constexpr std::chrono::steady_clock::duration THROTTLE_INTERVAL =
+	std::chrono::milliseconds(50);
+
+/**
+ * Exit the thread after this number of songs have been analyzed, to
+ * let the #UpdateService save the database.
+ */
+static constexpr unsigned SAVE_INTERVAL = 100;
+
+/**
+ * A #DecoderClient which feeds the decoded samples into a
+ * #LoudnessMeter.
+ */
+class LoudnessDecoderClient final : public DecoderClient {
+	LoudnessAnalyzer &analyzer;
+
+	const SongTime start_time, end_time;
+
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	PcmFormatConverter converter;
+
+	/**
+	 * The number of frames which remain until #end_time; zero
+	 * means "until the end of the file".
+	 */
+	uint64_t remaining_frames = 0;
+
+	std::chrono::steady_clock::time_point busy_since;
+
+	bool ready = false;
+
+	/**
+	 * Shall the decoder seek to #start_time?
+	 */
+	bool seeking = false;
+
+	/**
+	 * Shall the decoder stop?  This is set after #end_time has
+	 * been reached or if the song cannot be analyzed.
+	 */
+	bool stop = false;
+
+	bool error = false;
+
+public:
+	Mutex mutex;
+
+	LoudnessMeter meter;
+
+	LoudnessDecoderClient(LoudnessAnalyzer &_analyzer,
+			      SongTime _start_time, SongTime _end_time) noexcept
+		:analyzer(_analyzer),
+		 start_time(_start_time), end_time(_end_time),
+		 busy_since(std::chrono::steady_clock::now()) {}
+
+	/**
+	 * Has the decoder plugin recognized the file and have all
+	 * samples been analyzed?
+	 */
+	bool IsSuccessful() const noexcept {
+		return ready && !error;
+	}
+
+	bool IsReady() const noexcept {
+		return ready;
+	}
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   bool seekable, SignedSongTime duration) noexcept override;
+	DecoderCommand GetCommand() noexcept override;
+	void CommandFinished() noexcept override;
+	SongTime GetSeekTime() noexcept override;
+	uint64_t GetSeekFrame() noexcept override;
+	void SeekError() noexcept override;
+	InputStreamPtr OpenUri(const char *uri) override;
+	size_t Read(InputStream &is,
+		    void *buffer, size_t length) noexcept override;
+	void SubmitTimestamp(FloatDuration t) noexcept override;
+	DecoderCommand SubmitData(InputStream *is,
+				  const void *data, size_t length,
+				  uint16_t kbit_rate) noexcept override;
+	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) noexcept override;
+	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) noexcept override;
+	void SubmitMixRamp(MixRampInfo &&mix_ramp) noexcept override;
+};
+
+void
+LoudnessDecoderClient::Ready(AudioFormat _audio_format, bool seekable,
+			     [[maybe_unused]] SignedSongTime duration) noexcept
+{
+	assert(!ready);
+	assert(_audio_format.IsValid());
+
+	ready = true;
+	audio_format = _audio_format;
+
+	try {
+		if (audio_format.format == SampleFormat::DSD)
+			throw std::runtime_error("DSD not supported");
+
+		converter.Open(audio_format.format, SampleFormat::FLOAT);
+		meter.Open(audio_format.sample_rate, audio_format.channels);
+	} catch (...) {
+		error = stop = true;
+		return;
+	}
+
+	if (start_time.IsPositive()) {
+		if (!seekable) {
+			error = stop = true;
+			return;
+		}
+
+		seeking = true;
+	}
+
+	if (end_time > start_time)
+		remaining_frames =
+			end_time.ToScale<uint64_t>(audio_format.sample_rate) -
+			start_time.ToScale<uint64_t>(audio_format.sample_rate);
+}
+
+DecoderCommand
+LoudnessDecoderClient::GetCommand() noexcept
+{
+	if (stop || analyzer.IsCancelled())
+		return DecoderCommand::STOP;
+
+	if (seeking)
+		return DecoderCommand::SEEK;
+
+	return DecoderCommand::NONE;
+}
+
+void
+LoudnessDecoderClient::CommandFinished() noexcept
+{
+	seeking = false;
+}
+
+SongTime
+LoudnessDecoderClient::GetSeekTime() noexcept
+{
+	return start_time;
+}
+
+uint64_t
+LoudnessDecoderClient::GetSeekFrame() noexcept
+{
+	return start_time.ToScale<uint64_t>(audio_format.sample_rate);
+}
+
+void
+LoudnessDecoderClient::SeekError() noexcept
+{
+	seeking = false;
+	error = stop = true;
+}
+
+InputStreamPtr
+LoudnessDecoderClient::OpenUri(const char *uri)
+{
+	return InputStream::OpenReady(uri, mutex);
+}
+
+size_t
+LoudnessDecoderClient::Read(InputStream &is, void *buffer,
+			    size_t length) noexcept
+{
+	try {
+		return is.LockRead(buffer, length);
+	} catch (...) {
+		error = true;
+		return 0;
+	}
+}
+
+void
+LoudnessDecoderClient::SubmitTimestamp([[maybe_unused]] FloatDuration t) noexcept
+{
+}
+
+DecoderCommand
+LoudnessDecoderClient::SubmitData([[maybe_unused]] InputStream *is,
+				  const void *data, size_t length,
+				  [[maybe_unused]] uint16_t kbit_rate) noexcept
+{
+	assert(ready);
+
+	if (seeking || stop)
+		return GetCommand();
+
+	const auto src = ConstBuffer<float>::FromVoid(converter.Convert({data, length}));
+	size_t n_frames = src.size / audio_format.channels;
+
+	if (remaining_frames > 0) {
+		if (n_frames >= remaining_frames) {
+			n_frames = remaining_frames;
+			stop = true;
+		}
+
+		remaining_frames -= n_frames;
+	}
+
+	meter.Feed(src.data, n_frames);
+
+	const auto now = std::chrono::steady_clock::now();
+	const auto busy = now - busy_since;
+	if (busy >= THROTTLE_INTERVAL) {
+		analyzer.Sleep(busy);
+		busy_since = std::chrono::steady_clock::now();
+	}
+
+	return GetCommand();
+}
+
+DecoderCommand
+LoudnessDecoderClient::SubmitTag([[maybe_unused]] InputStream *is,
+				 [[maybe_unused]] Tag &&tag) noexcept
+{
+	return GetCommand();
+}
+
+void
+LoudnessDecoderClient::SubmitReplayGain([[maybe_unused]] const ReplayGainInfo *replay_gain_info) noexcept
+{
+}
+
+void
+LoudnessDecoderClient::SubmitMixRamp([[maybe_unused]] MixRampInfo &&mix_ramp) noexcept
+{
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer(EventLoop &_loop, SimpleDatabase &_db,
+				   Storage &_storage,
+				   Callback _callback) noexcept
+	:db(_db), storage(_storage),
+	 thread(BIND_THIS_METHOD(Run)),
+	 defer_finished(_loop, BIND_THIS_METHOD(OnFinished)),
+	 finished_callback(_callback)
+{
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer() noexcept
+{
+	if (thread.IsDefined()) {
+		Stop();
+		thread.Join();
+	}
+}
+
+void
+LoudnessAnalyzer::Start()
+{
+	if (thread.IsDefined()) {
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			if (running)
+				return;
+		}
+
+		/* the thread has exited, but OnFinished() has not
+		   been called yet */
+		defer_finished.Cancel();
+		thread.Join();
+	}
+
+	cancel = false;
+	running = true;
+	modified = false;
+	thread.Start();
+}
+
+void
+LoudnessAnalyzer::Stop() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	cancel = true;
+	cond.notify_one();
+}
+
+void
+LoudnessAnalyzer::OnFinished() noexcept
+{
+	if (!thread.IsDefined())
+		return;
+
+	/* the thread has already exited, this does not block */
+	thread.Join();
+
+	finished_callback();
+}
+
+void
+LoudnessAnalyzer::Sleep(std::chrono::steady_clock::duration d) noexcept
+{
+	std::unique_lock<Mutex> lock(mutex);
+	cond.wait_for(lock, d, [this]{ return cancel; });
+}
+
+void
+LoudnessAnalyzer::CollectPending(const Directory &directory,
+				 std::vector<PendingSong> &pending) const noexcept
+{
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			CollectPending(child, pending);
+
+	for (const auto &song : directory.songs) {
+		if (song.analyzed_gain.IsDefined() || !song.target.empty())
+			continue;
+
+		auto uri = song.GetURI();
+		if (failed.find(uri) != failed.end())
+			continue;
+
+		pending.push_back({std::move(uri), song.mtime,
+				   song.start_time, song.end_time});
+	}
+}
+
+bool
+LoudnessAnalyzer::Analyze(const PendingSong &song, ReplayGainTuple &result)
+{
+	const auto path_fs = storage.MapFS(song.uri);
+	if (path_fs.IsNull())
+		/* not a local file */
+		return false;
+
+	const char *suffix = uri_get_suffix(song.uri.c_str());
+	if (suffix == nullptr)
+		return false;
+
+	LoudnessDecoderClient client(*this, song.start_time, song.end_time);
+
+	InputStreamPtr is;
+	try {
+		is = OpenLocalInputStream(path_fs, client.mutex);
+	} catch (...) {
+		/* this may be a song inside a container file, which
+		   can only be decoded by a file_decode() plugin */
+	}
+
+	decoder_plugins_try([&](const DecoderPlugin &plugin){
+		if (!plugin.SupportsSuffix(suffix))
+			return false;
+
+		if (plugin.file_decode != nullptr) {
+			plugin.FileDecode(client, path_fs);
+		} else if (plugin.stream_decode != nullptr && is) {
+			/* rewind the stream, so each plugin gets a
+			   fresh start */
+			try {
+				is->LockRewind();
+			} catch (...) {
+			}
+
+			plugin.StreamDecode(client, *is);
+		} else
+			return false;
+
+		return client.IsReady() || IsCancelled();
+	});
+
+	if (!client.IsSuccessful() || IsCancelled())
+		return false;
+
+	const double loudness = client.meter.GetIntegratedLoudness();
+	if (std::isfinite(loudness)) {
+		result.gain = REFERENCE_LOUDNESS - loudness;
+		result.peak = client.meter.GetTruePeak();
+	} else {
+		/* silence; don't change it */
+		result.gain = 0;
+		result.peak = 0;
+	}
+
+	return true;
+}
+
+bool
+LoudnessAnalyzer::Store(const PendingSong &pending,
+			const ReplayGainTuple &result) noexcept
+{
+	const ScopeDatabaseLock protect;
+
+	const auto lr = db.GetRoot().LookupDirectory(pending.uri);
+	if (lr.directory->IsMount() || lr.rest.data() == nullptr ||
+	    lr.rest.find('/') != lr.rest.npos)
+		return false;
+
+	Song *song = lr.directory->FindSong(lr.rest);
+	if (song == nullptr || song->mtime != pending.mtime ||
+	    song->start_time != pending.start_time ||
+	    song->end_time != pending.end_time)
+		/* the song has been deleted or modified meanwhile */
+		return false;
+
+	song->analyzed_gain = result;
+	return true;
+}
+
+void
+LoudnessAnalyzer::Run() noexcept
+{
+	SetThreadName("loudness");
+	SetThreadIdlePriority();
+
+	std::vector<PendingSong> pending;
+
+	{
+		const ScopeDatabaseLock protect;
+		CollectPending(db.GetRoot(), pending);
+	}
+
+	if (!pending.empty())
+		FormatDebug(update_domain, "analyzing loudness of %zu songs",
+			    pending.size());
+
+	unsigned n_analyzed = 0;
+
+	for (const auto &i : pending) {
+		if (IsCancelled())
+			break;
+
+		ReplayGainTuple result;
+
+		try {
+			if (!Analyze(i, result)) {
+				if (!IsCancelled())
+					failed.emplace(i.uri);
+				continue;
+			}
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "Failed to analyze loudness of %s",
+				    i.uri.c_str());
+			failed.emplace(i.uri);
+			continue;
+		}
+
+		FormatDebug(update_domain, "loudness of %s: gain=%.2f peak=%.3f",
+			    i.uri.c_str(), (double)result.gain,
+			    (double)result.peak);
+
+		if (Store(i, result) && ++n_analyzed >= SAVE_INTERVAL)
+			/* exit to let the UpdateService save the
+			   database; it will start this thread
+			   again */
+			break;
+	}
+
+	if (n_analyzed > 0)
+		FormatDebug(update_domain, "analyzed loudness of %u songs",
+			    n_analyzed);
+
+	modified = n_analyzed > 0;
+
+	{
+		const std::lock_guard<Mutex> lock(mutex);
+		running = false;
+	}
+
+	defer_finished.Schedule();
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_UPDATE_LOUDNESS_ANALYZER_HXX
+#define MPD_UPDATE_LOUDNESS_ANALYZER_HXX
+
+#include "event/DeferEvent.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/BindMethod.hxx"
+#include "Chrono.hxx"
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Directory;
+struct ReplayGainTuple;
+class SimpleDatabase;
+class Storage;
+
+/**
+ * Decodes all songs in the database which have not been analyzed
+ * yet in a background thread, measures their integrated loudness
+ * and true peak (ITU-R BS.1770) and stores the result in
+ * Song::analyzed_gain.  It is used for playback if the song has no
+ * ReplayGain tags.
+ *
+ * The thread runs with idle priority and sleeps as long as it has
+ * been busy, to leave the CPU to the player.  It does not save the
+ * database; it exits after a batch of results, and the owner
+ * (#UpdateService) saves the database and starts it again.  After a
+ * restart, only the songs which have not been analyzed yet are
+ * processed.
+ *
+ * Only the "root" database is analyzed; songs in mounted databases
+ * and songs which are not plain local files are ignored.
+ */
+class LoudnessAnalyzer final {
+public:
+	using Callback = BoundMethod<void() noexcept>;
+
+private:
+	SimpleDatabase &db;
+	Storage &storage;
+
+	Thread thread;
+
+	/**
+	 * Scheduled by the thread before it exits; invokes
+	 * #finished_callback in the #EventLoop thread.
+	 */
+	DeferEvent defer_finished;
+
+	const Callback finished_callback;
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Shall the thread stop?  Protected by #mutex.
+	 */
+	bool cancel;
+
+	/**
+	 * Is the thread still working?  Protected by #mutex.
+	 */
+	bool running = false;
+
+	/**
+	 * Has the thread stored results in the database?  Written by
+	 * the thread, read by the #EventLoop thread after it has
+	 * exited.
+	 */
+	bool modified = false;
+
+	/**
+	 * The URIs of songs which could not be analyzed; they will
+	 * not be tried again until MPD is restarted.  Only accessed
+	 * by the thread.
+	 */
+	std::set<std::string> failed;
+
+	struct PendingSong {
+		std::string uri;
+		std::chrono::system_clock::time_point mtime;
+		SongTime start_time, end_time;
+	};
+
+public:
+	/**
+	 * @param _callback invoked in the #EventLoop thread after the
+	 * thread has exited
+	 */
+	LoudnessAnalyzer(EventLoop &_loop, SimpleDatabase &_db,
+			 Storage &_storage, Callback _callback) noexcept;
+
+	/**
+	 * Stops the thread and waits for it to exit.
+	 */
+	~LoudnessAnalyzer() noexcept;
+
+	LoudnessAnalyzer(const LoudnessAnalyzer &) = delete;
+	LoudnessAnalyzer &operator=(const LoudnessAnalyzer &) = delete;
+
+	/**
+	 * Has the thread been started and the callback not been
+	 * invoked yet?
+	 */
+	bool IsBusy() const noexcept {
+		return thread.IsDefined();
+	}
+
+	/**
+	 * Did the last run store results in the database, which need
+	 * to be saved?  Only valid while not busy.
+	 */
+	bool IsModified() const noexcept {
+		return modified;
+	}
+
+	/**
+	 * Start the thread unless it is already running.  It exits
+	 * after all songs (or a batch of them) have been analyzed.
+	 */
+	void Start();
+
+	/**
+	 * Ask the thread to stop.  This does not wait; the callback
+	 * is invoked after it has exited.
+	 */
+	void Stop() noexcept;
+
+	/**
+	 * Has Stop() been called?  This is thread-safe.
+	 */
+	bool IsCancelled() noexcept {
+		const std::lock_guard<Mutex> lock(mutex);
+		return cancel;
+	}
+
+	/**
+	 * Sleep for the given duration or until Stop() is called.
+	 * Called by the thread to throttle itself.
+	 */
+	void Sleep(std::chrono::steady_clock::duration d) noexcept;
+
+private:
+	void CollectPending(const Directory &directory,
+			    std::vector<PendingSong> &pending) const noexcept;
+
+	/**
+	 * Decode the song and measure its loudness.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true on success, false if the song could not be
+	 * decoded (or if the thread was cancelled)
+	 */
+	bool Analyze(const PendingSong &song, ReplayGainTuple &result);
+
+	/**
+	 * Store the result in the #Song object, unless it has been
+	 * deleted or modified meanwhile.
+	 */
+	bool Store(const PendingSong &song,
+		   const ReplayGainTuple &result) noexcept;
+
+	/* the thread */
+	void Run() noexcept;
+
+	/* DeferEvent callback */
+	void OnFinished() noexcept;
+};
+
+#endif
@@ -30,6 +30,17 @@ UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
 	return true;
 }
 
+bool
+UpdateQueue::Push(SimpleDatabase &db, Storage &storage,
+		  UpdateFileOperationList &&files, unsigned id) noexcept
+{
+	if (update_queue.size() >= MAX_UPDATE_QUEUE_SIZE)
+		return false;
+
+	update_queue.emplace_back(db, storage, std::move(files), id);
+	return true;
+}
+
 UpdateQueueItem
 UpdateQueue::Pop() noexcept
 {
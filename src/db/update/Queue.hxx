@@ -22,18 +22,71 @@
 
 #include "util/Compiler.h"
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <list>
+#include <vector>
 
 class SimpleDatabase;
 class Storage;
 
+/**
+ * A change of a single file (or directory) which was reported by
+ * inotify.  It allows updating just this file instead of rescanning
+ * the whole directory.
+ */
+struct UpdateFileOperation {
+	enum class Type : uint8_t {
+		/**
+		 * The file was created or modified.
+		 */
+		UPDATE,
+
+		/**
+		 * The file was deleted.
+		 */
+		REMOVE,
+
+		/**
+		 * The file was renamed from #from_uri to #uri.
+		 */
+		MOVE,
+	};
+
+	Type type;
+
+	std::string uri;
+
+	/**
+	 * The old URI; only used by #Type::MOVE.
+	 */
+	std::string from_uri;
+
+	template<typename U>
+	UpdateFileOperation(Type _type, U &&_uri)
+		:type(_type), uri(std::forward<U>(_uri)) {}
+
+	template<typename U, typename F>
+	UpdateFileOperation(U &&_uri, F &&_from_uri)
+		:type(Type::MOVE), uri(std::forward<U>(_uri)),
+		 from_uri(std::forward<F>(_from_uri)) {}
+};
+
+using UpdateFileOperationList = std::vector<UpdateFileOperation>;
+
 struct UpdateQueueItem {
 	SimpleDatabase *db;
 	Storage *storage;
 
 	std::string path_utf8;
+
+	/**
+	 * If not empty, then only these files are updated, and
+	 * #path_utf8 and #discard are ignored.
+	 */
+	UpdateFileOperationList files;
+
 	unsigned id;
 	bool discard;
 
@@ -46,6 +99,13 @@ struct UpdateQueueItem {
 		:db(&_db), storage(&_storage), path_utf8(_path),
 		 id(_id), discard(_discard) {}
 
+	UpdateQueueItem(SimpleDatabase &_db,
+			Storage &_storage,
+			UpdateFileOperationList &&_files,
+			unsigned _id) noexcept
+		:db(&_db), storage(&_storage), files(std::move(_files)),
+		 id(_id), discard(false) {}
+
 	bool IsDefined() const noexcept {
 		return id != 0;
 	}
@@ -65,6 +125,13 @@ public:
 	bool Push(SimpleDatabase &db, Storage &storage,
 		  std::string_view path, bool discard, unsigned id) noexcept;
 
+	/**
+	 * Enqueue a list of file operations.  The list is moved only
+	 * on success.
+	 */
+	bool Push(SimpleDatabase &db, Storage &storage,
+		  UpdateFileOperationList &&files, unsigned id) noexcept;
+
 	UpdateQueueItem Pop() noexcept;
 
 	void Clear() noexcept {
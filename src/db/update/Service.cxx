@@ -19,6 +19,7 @@
 
 #include "Service.hxx"
 #include "Walk.hxx"
+#include "LoudnessAnalyzer.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseListener.hxx"
 #include "db/DatabaseLock.hxx"
@@ -48,16 +49,45 @@ UpdateService::UpdateService(const ConfigData &_config,
 	 listener(_listener),
 	 update_thread(BIND_THIS_METHOD(Task))
 {
+	if (config.loudness_analysis)
+		loudness = std::make_unique<LoudnessAnalyzer>(_loop, db, storage,
+							      BIND_THIS_METHOD(OnLoudnessFinished));
 }
 
 UpdateService::~UpdateService() noexcept
 {
 	CancelAllAsync();
 
+	loudness.reset();
+
 	if (update_thread.IsDefined())
 		update_thread.Join();
 }
 
+void
+UpdateService::StartLoudnessAnalysis() noexcept
+{
+	assert(GetEventLoop().IsInside());
+
+	if (!loudness || IsBusy())
+		/* RunDeferred() will start it */
+		return;
+
+	try {
+		loudness->Start();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start loudness analysis");
+	}
+}
+
+void
+UpdateService::StopLoudnessAnalysis() noexcept
+{
+	/* the destructor waits for the thread */
+	loudness.reset();
+}
+
 void
 UpdateService::CancelAllAsync() noexcept
 {
@@ -67,6 +97,9 @@ UpdateService::CancelAllAsync() noexcept
 
 	if (walk != nullptr)
 		walk->Cancel();
+
+	if (loudness)
+		loudness->Stop();
 }
 
 void
@@ -102,17 +135,45 @@ UpdateService::CancelMount(const char *uri) noexcept
 
 		if (update_thread.IsDefined())
 			update_thread.Join();
+		else {
+			/* the thread was waiting for the loudness
+			   analysis to stop; don't start it */
+			walk.reset();
+			next.Clear();
+		}
+	}
+}
+
+static void
+SaveDatabase(SimpleDatabase &db) noexcept
+{
+	try {
+		db.Save();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to save database");
 	}
 }
 
 inline void
 UpdateService::Task() noexcept
 {
-	assert(walk != nullptr);
-
 	SetThreadName("update");
 
-	if (!next.path_utf8.empty())
+	if (saving) {
+		LogDebug(update_domain, "saving loudness analysis results");
+		SetThreadIdlePriority();
+		SaveDatabase(db);
+		defer.Schedule();
+		return;
+	}
+
+	assert(walk != nullptr);
+
+	if (!next.files.empty())
+		FormatDebug(update_domain, "starting: %zu files",
+			    next.files.size());
+	else if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "starting: %s",
 			    next.path_utf8.c_str());
 	else
@@ -120,17 +181,19 @@ UpdateService::Task() noexcept
 
 	SetThreadIdlePriority();
 
-	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
-			      next.discard);
+	if (!next.files.empty())
+		modified = walk->WalkFiles(next.db->GetRoot(), next.files);
+	else
+		modified = walk->Walk(next.db->GetRoot(),
+				      next.path_utf8.c_str(),
+				      next.discard);
 
-	if (modified || !next.db->FileExists()) {
-		try {
-			next.db->Save();
-		} catch (...) {
-			LogError(std::current_exception(),
-				 "Failed to save database");
-		}
-	}
+	if (modified || !next.db->FileExists() ||
+	    (loudness_modified && next.db == &db))
+		SaveDatabase(*next.db);
+
+	if (loudness_modified && next.db != &db)
+		SaveDatabase(db);
 
 	if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "finished: %s",
@@ -145,7 +208,7 @@ void
 UpdateService::StartThread(UpdateQueueItem &&i)
 {
 	assert(GetEventLoop().IsInside());
-	assert(walk == nullptr);
+	assert(!IsBusy());
 
 	modified = false;
 
@@ -153,6 +216,17 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	walk = std::make_unique<UpdateWalk>(config, GetEventLoop(), listener,
 					    *next.storage);
 
+	if (loudness && loudness->IsBusy()) {
+		/* the loudness analysis must not modify the database
+		   while it is being updated; OnLoudnessFinished()
+		   will start the thread after it has stopped */
+		loudness->Stop();
+		FormatDebug(update_domain,
+			    "update job id %i waits for loudness analysis",
+			    next.id);
+		return;
+	}
+
 	update_thread.Start();
 
 	FormatDebug(update_domain,
@@ -212,7 +286,7 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 		   happen */
 		throw std::runtime_error("No storage at this path");
 
-	if (walk != nullptr) {
+	if (IsBusy()) {
 		const unsigned id = GenerateId();
 		if (!queue.Push(*db2, *storage2, path, discard, id))
 			throw ProtocolError(ACK_ERROR_UPDATE_ALREADY,
@@ -230,33 +304,104 @@ UpdateService::Enqueue(std::string_view path, bool discard)
 	return id;
 }
 
+unsigned
+UpdateService::Enqueue(UpdateFileOperationList &&files)
+{
+	assert(GetEventLoop().IsInside());
+	assert(!files.empty());
+
+	Storage *storage2 = storage.GetMount("");
+	if (storage2 == nullptr)
+		throw std::runtime_error("No storage at this path");
+
+	if (IsBusy()) {
+		const unsigned id = GenerateId();
+		if (!queue.Push(db, *storage2, std::move(files), id))
+			throw ProtocolError(ACK_ERROR_UPDATE_ALREADY,
+					    "Update queue is full");
+
+		update_task_id = id;
+		return id;
+	}
+
+	const unsigned id = update_task_id = GenerateId();
+	StartThread(UpdateQueueItem(db, *storage2, std::move(files), id));
+
+	idle_add(IDLE_UPDATE);
+
+	return id;
+}
+
 /**
  * Called in the main thread after the database update is finished.
  */
 void
 UpdateService::RunDeferred() noexcept
 {
-	assert(next.IsDefined());
-	assert(walk != nullptr);
-
 	/* wait for thread to finish only if it wasn't cancelled by
 	   CancelMount() */
 	if (update_thread.IsDefined())
 		update_thread.Join();
 
-	walk.reset();
+	/* the results have been saved by the thread */
+	loudness_modified = false;
 
-	next.Clear();
+	if (saving) {
+		saving = false;
+	} else {
+		assert(next.IsDefined());
+		assert(walk != nullptr);
 
-	idle_add(IDLE_UPDATE);
+		walk.reset();
+
+		next.Clear();
+
+		idle_add(IDLE_UPDATE);
 
-	if (modified)
-		/* send "idle" events */
-		listener.OnDatabaseModified();
+		if (modified)
+			/* send "idle" events */
+			listener.OnDatabaseModified();
+	}
 
 	auto i = queue.Pop();
 	if (i.IsDefined()) {
 		/* schedule the next path */
 		StartThread(std::move(i));
+	} else if (loudness) {
+		/* analyze the new songs */
+		try {
+			loudness->Start();
+		} catch (...) {
+			LogError(std::current_exception(),
+				 "Failed to start loudness analysis");
+		}
+	}
+}
+
+/**
+ * Called in the main thread after the loudness analysis thread has
+ * exited.
+ */
+void
+UpdateService::OnLoudnessFinished() noexcept
+{
+	if (loudness->IsModified())
+		loudness_modified = true;
+
+	if (walk != nullptr) {
+		/* an update was waiting for the analysis to stop */
+		update_thread.Start();
+
+		FormatDebug(update_domain,
+			    "spawned thread for update job id %i", next.id);
+	} else if (loudness_modified) {
+		/* save the results in the update thread; after that,
+		   RunDeferred() resumes the analysis */
+		saving = true;
+		update_thread.Start();
+	} else if (auto i = queue.Pop(); i.IsDefined()) {
+		/* an update was cancelled by CancelMount() while
+		   waiting for the analysis */
+		StartThread(std::move(i));
 	}
 }
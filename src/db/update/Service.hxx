@@ -32,6 +32,7 @@
 class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
+class LoudnessAnalyzer;
 class CompositeStorage;
 
 /**
@@ -49,6 +50,19 @@ class UpdateService final {
 
 	bool modified;
 
+	/**
+	 * Is the update thread saving the database on behalf of the
+	 * #LoudnessAnalyzer instead of running an #UpdateWalk?
+	 */
+	bool saving = false;
+
+	/**
+	 * Has the #LoudnessAnalyzer stored results in the "root"
+	 * database which have not been saved yet?  They will be
+	 * saved by the update thread.
+	 */
+	bool loudness_modified = false;
+
 	Thread update_thread;
 
 	static constexpr unsigned update_task_id_max = 1 << 15;
@@ -61,6 +75,12 @@ class UpdateService final {
 
 	std::unique_ptr<UpdateWalk> walk;
 
+	/**
+	 * Analyzes the loudness of new songs while no update is
+	 * running.  Only set if enabled in the configuration.
+	 */
+	std::unique_ptr<LoudnessAnalyzer> loudness;
+
 public:
 	UpdateService(const ConfigData &_config,
 		      EventLoop &_loop, SimpleDatabase &_db,
@@ -73,6 +93,10 @@ public:
 		return defer.GetEventLoop();
 	}
 
+	SimpleDatabase &GetDatabase() const noexcept {
+		return db;
+	}
+
 	/**
 	 * Returns a non-zero job id when we are currently updating
 	 * the database.
@@ -94,8 +118,33 @@ public:
 	unsigned Enqueue(std::string_view path, bool discard);
 
 	/**
-	 * Clear the queue and cancel the current update.  Does not
-	 * wait for the thread to exit.
+	 * Add a list of file operations (see #UpdateFileOperation)
+	 * within the "root" storage to the database update queue.
+	 * The list is moved only on success.
+	 *
+	 * Throws on error
+	 *
+	 * @return the job id
+	 */
+	unsigned Enqueue(UpdateFileOperationList &&files);
+
+	/**
+	 * Start the loudness analysis (if enabled) unless an update
+	 * is running.  Call this after the decoder and input plugins
+	 * have been initialized.
+	 */
+	void StartLoudnessAnalysis() noexcept;
+
+	/**
+	 * Stop the loudness analysis and wait for its thread to
+	 * exit.  It will not be started again.  Call this before the
+	 * decoder and input plugins are deinitialized.
+	 */
+	void StopLoudnessAnalysis() noexcept;
+
+	/**
+	 * Clear the queue, cancel the current update and the
+	 * loudness analysis.  Does not wait for the threads to exit.
 	 */
 	void CancelAllAsync() noexcept;
 
@@ -107,9 +156,19 @@ public:
 	void CancelMount(const char *uri) noexcept;
 
 private:
+	/**
+	 * Is the update thread running (or about to be started)?
+	 */
+	bool IsBusy() const noexcept {
+		return walk != nullptr || saving;
+	}
+
 	/* DeferEvent callback */
 	void RunDeferred() noexcept;
 
+	/* LoudnessAnalyzer callback */
+	void OnLoudnessFinished() noexcept;
+
 	/* the update thread */
 	void Task() noexcept;
 
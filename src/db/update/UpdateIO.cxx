@@ -21,7 +21,6 @@
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/FileInfo.hxx"
 #include "storage/StorageInterface.hxx"
-#include "fs/Traits.hxx"
 #include "fs/FileSystem.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Log.hxx"
@@ -38,51 +37,6 @@ try {
 	return false;
 }
 
-bool
-GetInfo(StorageDirectoryReader &reader, StorageFileInfo &info) noexcept
-try {
-	info = reader.GetInfo(true);
-	return true;
-} catch (...) {
-	LogError(std::current_exception());
-	return false;
-}
-
-bool
-DirectoryExists(Storage &storage, const Directory &directory) noexcept
-{
-	StorageFileInfo info;
-
-	try {
-		info = storage.GetInfo(directory.GetPath(), true);
-	} catch (...) {
-		return false;
-	}
-
-	return directory.IsReallyAFile()
-		? info.IsRegular()
-		: info.IsDirectory();
-}
-
-static StorageFileInfo
-GetDirectoryChildInfo(Storage &storage, const Directory &directory,
-		      std::string_view name_utf8)
-{
-	const auto uri_utf8 = PathTraitsUTF8::Build(directory.GetPath(),
-						    name_utf8);
-	return storage.GetInfo(uri_utf8.c_str(), true);
-}
-
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   std::string_view name_utf8) noexcept
-try {
-	return GetDirectoryChildInfo(storage, directory, name_utf8)
-		.IsRegular();
-} catch (...) {
-	return false;
-}
-
 bool
 directory_child_access(Storage &storage, const Directory &directory,
 		       std::string_view name, int mode) noexcept
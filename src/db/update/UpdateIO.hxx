@@ -27,7 +27,6 @@
 struct Directory;
 struct StorageFileInfo;
 class Storage;
-class StorageDirectoryReader;
 
 /**
  * Wrapper for Storage::GetInfo() that logs errors instead of
@@ -36,22 +35,6 @@ class StorageDirectoryReader;
 bool
 GetInfo(Storage &storage, const char *uri_utf8, StorageFileInfo &info) noexcept;
 
-/**
- * Wrapper for LocalDirectoryReader::GetInfo() that logs errors
- * instead of returning them.
- */
-bool
-GetInfo(StorageDirectoryReader &reader, StorageFileInfo &info) noexcept;
-
-gcc_pure
-bool
-DirectoryExists(Storage &storage, const Directory &directory) noexcept;
-
-gcc_pure
-bool
-directory_child_is_regular(Storage &storage, const Directory &directory,
-			   std::string_view name_utf8) noexcept;
-
 /**
  * Checks if the given permissions on the mapped file are given.
  */
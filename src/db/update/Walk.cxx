@@ -33,11 +33,13 @@
 #include "storage/FileInfo.hxx"
 #include "input/InputStream.hxx"
 #include "input/Error.hxx"
+#include "time/ChronoUtil.hxx"
 #include "util/Alloc.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriExtract.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <exception>
@@ -89,11 +91,51 @@ UpdateWalk::RemoveExcludedFromDirectory(Directory &directory,
 		});
 }
 
+/**
+ * Look up a name in a directory listing sorted by name.
+ *
+ * @return the entry or nullptr if there is no such entry or if its
+ * attributes could not be obtained
+ */
+gcc_pure
+static const StorageFileInfo *
+FindListingEntry(const DirectoryListing &listing,
+		 std::string_view name) noexcept
+{
+	auto i = std::lower_bound(listing.begin(), listing.end(), name,
+				  [](const StorageDirectoryReader::Entry &a,
+				     std::string_view b){
+					  return a.name < b;
+				  });
+	if (i == listing.end() || i->name != name || i->error)
+		return nullptr;
+
+	return &i->info;
+}
+
+gcc_pure
+static bool
+ListingHasRegular(const DirectoryListing &listing,
+		  std::string_view name) noexcept
+{
+	const auto *info = FindListingEntry(listing, name);
+	return info != nullptr && info->IsRegular();
+}
+
 inline void
-UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
+UpdateWalk::PurgeDeletedFromDirectory(Directory &directory,
+				      const DirectoryListing &listing) noexcept
 {
 	directory.ForEachChildSafe([&](Directory &child){
-			if (child.IsMount() || DirectoryExists(storage, child))
+			if (child.IsMount())
+				return;
+
+			const auto *info = FindListingEntry(listing,
+							    child.GetName());
+			if (info != nullptr &&
+			    (child.IsReallyAFile()
+			     ? info->IsRegular()
+			     : info->IsDirectory()))
 				return;
 
 			editor.LockDeleteDirectory(&child);
@@ -102,8 +144,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 		});
 
 	directory.ForEachSongSafe([&](Song &song){
-			if (!directory_child_is_regular(storage, directory,
-							song.filename)) {
+			if (!ListingHasRegular(listing, song.filename)) {
 				editor.LockDeleteSong(directory, &song);
 
 				modified = true;
@@ -113,7 +154,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory) noexcept
 	for (auto i = directory.playlists.begin(),
 		     end = directory.playlists.end();
 	     i != end;) {
-		if (!directory_child_is_regular(storage, directory, i->name)) {
+		if (!ListingHasRegular(listing, i->name)) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
 		} else
@@ -300,6 +341,87 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 #endif
 }
 
+/**
+ * Read all entries of a directory including their attributes,
+ * sorted by name.
+ */
+static DirectoryListing
+ReadListing(StorageDirectoryReader &reader)
+{
+	static constexpr std::size_t BATCH_SIZE = 256;
+
+	DirectoryListing listing;
+	while (reader.ReadBatch(listing, BATCH_SIZE, true) > 0) {}
+
+	std::sort(listing.begin(), listing.end(),
+		  [](const StorageDirectoryReader::Entry &a,
+		     const StorageDirectoryReader::Entry &b){
+			  return a.name < b.name;
+		  });
+
+	return listing;
+}
+
+/**
+ * Has the directory not been modified since its listing was stored
+ * in the database?
+ */
+gcc_pure
+static bool
+IsUnchanged(const Directory &directory, const StorageFileInfo &info) noexcept
+{
+	return !IsNegative(info.mtime) && directory.mtime == info.mtime &&
+		/* the inode number is not stored in the database
+		   file; after a restart, only the mtime is known */
+		(directory.inode == 0 ||
+		 (directory.inode == info.inode &&
+		  directory.device == info.device));
+}
+
+void
+UpdateWalk::LoadExcludeList(const Directory &directory,
+			    ExcludeList &exclude_list) noexcept
+{
+	try {
+		Mutex mutex;
+		auto is = InputStream::OpenReady(PathTraitsUTF8::Build(storage.MapUTF8(directory.GetPath()),
+								       ".mpdignore").c_str(),
+						 mutex);
+		exclude_list.Load(std::move(is));
+	} catch (...) {
+		if (!IsFileNotFound(std::current_exception()))
+			LogError(std::current_exception());
+	}
+}
+
+inline void
+UpdateWalk::UpdateUnchangedDirectory(Directory &directory,
+				     const ExcludeList &exclude_list) noexcept
+{
+	FormatDebug(update_domain, "skipping unchanged directory %s",
+		    directory.GetPath());
+
+	directory.ForEachChildSafe([&](Directory &child){
+			if (cancel || child.IsMount() || child.IsReallyAFile())
+				return;
+
+			/* apply the same checks as to the entries of
+			   a directory listing */
+			const char *name = child.GetName();
+			StorageFileInfo info;
+			if (SkipSymlink(&directory, name) ||
+			    !GetInfo(storage, child.GetPath(), info) ||
+			    !info.IsDirectory()) {
+				editor.LockDeleteDirectory(&child);
+				modified = true;
+				return;
+			}
+
+			UpdateDirectoryChild(directory, exclude_list,
+					     name, info);
+		});
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
@@ -307,37 +429,47 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 {
 	assert(info.IsDirectory());
 
+	const bool unchanged = config.skip_unchanged_directories &&
+		!walk_discard && IsUnchanged(directory, info);
+
 	directory_set_stat(directory, info);
 
-	std::unique_ptr<StorageDirectoryReader> reader;
+	if (unchanged) {
+		/* the listing is still valid, but subdirectories may
+		   have been modified */
+		ExcludeList child_exclude_list(exclude_list);
+		LoadExcludeList(directory, child_exclude_list);
+		if (!child_exclude_list.IsEmpty())
+			RemoveExcludedFromDirectory(directory,
+						    child_exclude_list);
+
+		UpdateUnchangedDirectory(directory, child_exclude_list);
+		return true;
+	}
+
+	DirectoryListing listing;
 
 	try {
-		reader = storage.OpenDirectory(directory.GetPath());
+		listing = ReadListing(*storage.OpenDirectory(directory.GetPath()));
 	} catch (...) {
 		LogError(std::current_exception());
 		return false;
 	}
 
 	ExcludeList child_exclude_list(exclude_list);
-
-	try {
-		Mutex mutex;
-		auto is = InputStream::OpenReady(PathTraitsUTF8::Build(storage.MapUTF8(directory.GetPath()),
-								       ".mpdignore").c_str(),
-						 mutex);
-		child_exclude_list.Load(std::move(is));
-	} catch (...) {
-		if (!IsFileNotFound(std::current_exception()))
-			LogError(std::current_exception());
-	}
+	LoadExcludeList(directory, child_exclude_list);
 
 	if (!child_exclude_list.IsEmpty())
 		RemoveExcludedFromDirectory(directory, child_exclude_list);
 
-	PurgeDeletedFromDirectory(directory);
+	PurgeDeletedFromDirectory(directory, listing);
+
+	for (const auto &entry : listing) {
+		if (cancel)
+			break;
+
+		const char *name_utf8 = entry.name.c_str();
 
-	const char *name_utf8;
-	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
@@ -352,16 +484,26 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 			continue;
 		}
 
-		StorageFileInfo info2;
-		if (!GetInfo(*reader, info2)) {
+		if (entry.error) {
+			LogError(entry.error);
 			modified |= editor.DeleteNameIn(directory, name_utf8);
 			continue;
 		}
 
-		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
+		UpdateDirectoryChild(directory, child_exclude_list, name_utf8,
+				     entry.info);
 	}
 
-	directory.mtime = info.mtime;
+	if (!config.skip_unchanged_directories ||
+	    info.mtime + std::chrono::seconds(1) < walk_start)
+		directory.mtime = info.mtime;
+	else
+		/* the directory may be modified again within the
+		   mtime granularity, which would go unnoticed by
+		   the next update; leave the old mtime so it will be
+		   listed again */
+		FormatDebug(update_domain, "directory %s was just modified",
+			    directory.GetPath());
 
 	return true;
 }
@@ -462,10 +604,226 @@ try {
 	LogError(std::current_exception());
 }
 
+/**
+ * Split a URI into the parent directory URI and the base name.
+ */
+static std::pair<std::string_view, std::string_view>
+SplitParentUri(std::string_view uri) noexcept
+{
+	const auto slash = uri.rfind(PathTraitsUTF8::SEPARATOR);
+	if (slash == uri.npos)
+		return {std::string_view{}, uri};
+
+	return {uri.substr(0, slash), uri.substr(slash + 1)};
+}
+
+/**
+ * Look up an existing directory (which is neither a mount point nor
+ * a virtual directory) by its URI.
+ *
+ * The caller must lock the database.
+ */
+gcc_pure
+static Directory *
+LookupRealDirectory(Directory &root, std::string_view uri) noexcept
+{
+	const auto lr = root.LookupDirectory(uri);
+	if (lr.rest.data() != nullptr)
+		return nullptr;
+
+	for (const Directory *d = lr.directory; d != nullptr; d = d->parent)
+		if (d->IsMount() || d->IsReallyAFile())
+			return nullptr;
+
+	return lr.directory;
+}
+
+/**
+ * Does the given URI exist in the storage?  Unlike GetInfo(), this
+ * does not log errors.
+ */
+static bool
+StorageExists(Storage &storage, const char *uri_utf8) noexcept
+try {
+	storage.GetInfo(uri_utf8, true);
+	return true;
+} catch (...) {
+	return false;
+}
+
+void
+UpdateWalk::RemoveUri(Directory &root, const char *uri) noexcept
+try {
+	const auto [parent_uri, name] = SplitParentUri(uri);
+
+	Directory *parent;
+	{
+		const ScopeDatabaseLock protect;
+		parent = LookupRealDirectory(root, parent_uri);
+	}
+
+	if (parent == nullptr)
+		/* the parent directory is not in the database, so
+		   neither is this file */
+		return;
+
+	if (!SkipSymlink(parent, name) && StorageExists(storage, uri)) {
+		/* the file was created again meanwhile */
+		UpdateUri(root, uri);
+		return;
+	}
+
+	modified |= editor.DeleteNameIn(*parent, name);
+} catch (...) {
+	LogError(std::current_exception());
+}
+
+bool
+UpdateWalk::MoveSong(Directory &root, std::string_view from_uri,
+		     const char *to_uri) noexcept
+try {
+	const auto [from_parent_uri, from_name] = SplitParentUri(from_uri);
+	const auto [to_parent_uri, to_name] = SplitParentUri(to_uri);
+
+	/* renaming a file does not change its suffix (i.e. the
+	   decoder plugin) or its modification time; if either
+	   differs, it is safer to scan the file again */
+
+	UriSuffixBuffer to_suffix_buffer;
+	const char *to_suffix = uri_get_suffix(to_uri, to_suffix_buffer);
+	if (to_suffix == nullptr)
+		return false;
+
+	const auto info = storage.GetInfo(to_uri, true);
+	if (!info.IsRegular())
+		return false;
+
+	/* validate everything before modifying the database; if
+	   the move is rejected, the caller falls back to
+	   RemoveUri() and UpdateUri() */
+
+	Directory *to_dir;
+	std::unique_ptr<Song> new_song;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		/* the destination directory must exist already; a
+		   file moved into a new directory is scanned by
+		   UpdateUri(), which creates the directory */
+		to_dir = LookupRealDirectory(root, to_parent_uri);
+		if (to_dir == nullptr)
+			return false;
+
+		const Directory *from_dir =
+			LookupRealDirectory(root, from_parent_uri);
+		if (from_dir == nullptr)
+			return false;
+
+		const Song *song = from_dir->FindSong(from_name);
+		if (song == nullptr)
+			return false;
+
+		UriSuffixBuffer from_suffix_buffer;
+		const char *from_suffix =
+			uri_get_suffix(song->filename.c_str(),
+				       from_suffix_buffer);
+		if (from_suffix == nullptr ||
+		    !StringIsEqualIgnoreCase(from_suffix, to_suffix) ||
+		    info.mtime != song->mtime)
+			return false;
+
+		/* copy the attributes while the database is locked;
+		   the "remove" service may delete the old song as
+		   soon as the lock is released */
+		new_song = std::make_unique<Song>(to_name, *to_dir);
+		new_song->tag = Tag(song->tag);
+		new_song->mtime = song->mtime;
+		new_song->start_time = song->start_time;
+		new_song->end_time = song->end_time;
+		new_song->audio_format = song->audio_format;
+		new_song->analyzed_gain = song->analyzed_gain;
+		new_song->target = song->target;
+	}
+
+	if (SkipSymlink(to_dir, to_name))
+		return false;
+
+	/* the target name may have been occupied by another song
+	   which was replaced */
+	modified |= editor.DeleteNameIn(*to_dir, to_name);
+
+	FormatDebug(update_domain, "moved %.*s to %s",
+		    int(from_uri.size()), from_uri.data(), to_uri);
+
+	{
+		const ScopeDatabaseLock protect;
+
+		/* look it up again, the "remove" service may have
+		   deleted it meanwhile */
+		Directory *from_dir = LookupRealDirectory(root,
+							  from_parent_uri);
+		Song *old_song = from_dir != nullptr
+			? from_dir->FindSong(from_name)
+			: nullptr;
+		if (old_song != nullptr)
+			editor.DeleteSong(*from_dir, old_song);
+
+		to_dir->AddSong(std::move(new_song));
+	}
+
+	modified = true;
+	return true;
+} catch (...) {
+	return false;
+}
+
+void
+UpdateWalk::ApplyFileOperation(Directory &root,
+			       const UpdateFileOperation &op) noexcept
+{
+	switch (op.type) {
+	case UpdateFileOperation::Type::UPDATE:
+		UpdateUri(root, op.uri.c_str());
+		break;
+
+	case UpdateFileOperation::Type::REMOVE:
+		RemoveUri(root, op.uri.c_str());
+		break;
+
+	case UpdateFileOperation::Type::MOVE:
+		if (!MoveSong(root, op.from_uri, op.uri.c_str())) {
+			RemoveUri(root, op.from_uri.c_str());
+			UpdateUri(root, op.uri.c_str());
+		}
+
+		break;
+	}
+}
+
+bool
+UpdateWalk::WalkFiles(Directory &root,
+		      const UpdateFileOperationList &files) noexcept
+{
+	walk_discard = false;
+	walk_start = std::chrono::system_clock::now();
+	modified = false;
+
+	for (const auto &op : files) {
+		if (cancel)
+			break;
+
+		ApplyFileOperation(root, op);
+	}
+
+	return modified;
+}
+
 bool
 UpdateWalk::Walk(Directory &root, const char *path, bool discard) noexcept
 {
 	walk_discard = discard;
+	walk_start = std::chrono::system_clock::now();
 	modified = false;
 
 	if (path != nullptr && !isRootDirectory(path)) {
@@ -22,11 +22,15 @@
 
 #include "Config.hxx"
 #include "Editor.hxx"
+#include "Queue.hxx"
+#include "storage/StorageInterface.hxx"
 #include "util/Compiler.h"
 #include "config.h"
 
 #include <atomic>
+#include <chrono>
 #include <string_view>
+#include <vector>
 
 struct StorageFileInfo;
 struct Directory;
@@ -36,6 +40,11 @@ class ArchiveFile;
 class Storage;
 class ExcludeList;
 
+/**
+ * The entries of a directory sorted by name.
+ */
+using DirectoryListing = std::vector<StorageDirectoryReader::Entry>;
+
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
 	friend class UpdateArchiveVisitor;
@@ -46,6 +55,11 @@ class UpdateWalk final {
 	bool walk_discard;
 	bool modified;
 
+	/**
+	 * The time the current Walk() was started.
+	 */
+	std::chrono::system_clock::time_point walk_start;
+
 	/**
 	 * Set to true by the main thread when the update thread shall
 	 * cancel as quickly as possible.  Access to this flag is
@@ -75,6 +89,15 @@ public:
 	 */
 	bool Walk(Directory &root, const char *path, bool discard) noexcept;
 
+	/**
+	 * Apply the given file operations (usually reported by
+	 * inotify) without rescanning whole directories.
+	 *
+	 * Returns true if the database was modified.
+	 */
+	bool WalkFiles(Directory &root,
+		       const UpdateFileOperationList &files) noexcept;
+
 private:
 	gcc_pure
 	bool SkipSymlink(const Directory *directory,
@@ -83,7 +106,14 @@ private:
 	void RemoveExcludedFromDirectory(Directory &directory,
 					 const ExcludeList &exclude_list) noexcept;
 
-	void PurgeDeletedFromDirectory(Directory &directory) noexcept;
+	void PurgeDeletedFromDirectory(Directory &directory,
+				       const DirectoryListing &listing) noexcept;
+
+	/**
+	 * Load the ".mpdignore" file of the given directory.
+	 */
+	void LoadExcludeList(const Directory &directory,
+			     ExcludeList &exclude_list) noexcept;
 
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
@@ -136,6 +166,9 @@ private:
 				  const char *name,
 				  const StorageFileInfo &info) noexcept;
 
+	void UpdateUnchangedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list) noexcept;
+
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
 			     const StorageFileInfo &info) noexcept;
@@ -169,6 +202,26 @@ private:
 						 std::string_view uri) noexcept;
 
 	void UpdateUri(Directory &root, const char *uri) noexcept;
+
+	/**
+	 * Remove the given URI from the database if it does not
+	 * exist anymore.  Unlike UpdateUri(), this does not create
+	 * missing parent directories.
+	 */
+	void RemoveUri(Directory &root, const char *uri) noexcept;
+
+	/**
+	 * Move an existing #Song object to a new name without
+	 * scanning its tags again.
+	 *
+	 * @return false if the song could not be moved; the caller
+	 * should then update both URIs
+	 */
+	bool MoveSong(Directory &root, std::string_view from_uri,
+		      const char *to_uri) noexcept;
+
+	void ApplyFileOperation(Directory &root,
+				const UpdateFileOperation &op) noexcept;
 };
 
 #endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Sniff.hxx"
+#include "DecoderPlugin.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <cstdint>
+#include <string.h>
+
+bool
+SniffedFormat::Match(const DecoderPlugin &plugin) const noexcept
+{
+	return (suffix != nullptr && plugin.SupportsSuffix(suffix)) ||
+		(mime_type != nullptr && plugin.SupportsMimeType(mime_type));
+}
+
+static constexpr SniffedFormat
+BySuffix(const char *suffix) noexcept
+{
+	return {suffix, nullptr};
+}
+
+static constexpr SniffedFormat
+ByMimeType(const char *mime_type) noexcept
+{
+	return {nullptr, mime_type};
+}
+
+gcc_pure
+static bool
+StartsWith(ConstBuffer<uint8_t> b, size_t offset,
+	   const char *magic) noexcept
+{
+	const size_t length = strlen(magic);
+	return b.size >= offset + length &&
+		memcmp(b.data + offset, magic, length) == 0;
+}
+
+/**
+ * Determine the total size of the ID3v2 tag at the beginning of the
+ * buffer.
+ *
+ * @return the size in bytes or 0 if there is no ID3v2 tag
+ */
+gcc_pure
+static size_t
+GetId3v2Size(ConstBuffer<uint8_t> b) noexcept
+{
+	if (b.size < 10 || !StartsWith(b, 0, "ID3") ||
+	    ((b[6] | b[7] | b[8] | b[9]) & 0x80) != 0)
+		return 0;
+
+	/* the size is a "synchsafe" integer, excluding the 10 byte
+	   header and the optional footer */
+	size_t size = (size_t(b[6]) << 21) | (size_t(b[7]) << 14) |
+		(size_t(b[8]) << 7) | size_t(b[9]);
+	size += 10;
+	if (b[5] & 0x10)
+		size += 10;
+
+	return size;
+}
+
+/**
+ * Detect the codec in the first page of an Ogg stream.
+ */
+gcc_pure
+static SniffedFormat
+SniffOgg(ConstBuffer<uint8_t> b) noexcept
+{
+	/* the first page contains only the identification header
+	   packet, which begins right after the segment table */
+	if (b.size < 27)
+		return {};
+
+	const size_t packet = 27 + b[26];
+
+	if (StartsWith(b, packet, "OpusHead"))
+		return BySuffix("opus");
+
+	if (StartsWith(b, packet, "\x7f" "FLAC"))
+		return ByMimeType("audio/x-flac+ogg");
+
+	if (StartsWith(b, packet, "\x01vorbis"))
+		return ByMimeType("audio/x-vorbis+ogg");
+
+	return {};
+}
+
+/**
+ * Detect a MPEG audio frame header or an ADTS (AAC) header.
+ */
+gcc_pure
+static SniffedFormat
+SniffMpegSync(ConstBuffer<uint8_t> b) noexcept
+{
+	if (b.size < 4 || b[0] != 0xff)
+		return {};
+
+	if ((b[1] & 0xf6) == 0xf0)
+		/* ADTS: layer 0 */
+		return BySuffix("aac");
+
+	if ((b[1] & 0xe0) == 0xe0 &&
+	    /* layer must not be "reserved" */
+	    (b[1] & 0x06) != 0 &&
+	    /* bit rate index must not be "bad" */
+	    (b[2] & 0xf0) != 0xf0 &&
+	    /* sample rate index must not be "reserved" */
+	    (b[2] & 0x0c) != 0x0c)
+		return BySuffix("mp3");
+
+	return {};
+}
+
+SniffedFormat
+SniffAudioFormat(ConstBuffer<void> _header) noexcept
+{
+	auto b = ConstBuffer<uint8_t>::FromVoid(_header);
+
+	const size_t id3_size = GetId3v2Size(b);
+	if (id3_size > 0) {
+		if (id3_size >= b.size)
+			/* we can't see what's behind the ID3 tag */
+			return {};
+
+		b.skip_front(id3_size);
+	}
+
+	if (StartsWith(b, 0, "fLaC"))
+		return BySuffix("flac");
+
+	if (StartsWith(b, 0, "OggS"))
+		return SniffOgg(b);
+
+	if ((StartsWith(b, 0, "RIFF") || StartsWith(b, 0, "RF64")) &&
+	    StartsWith(b, 8, "WAVE"))
+		return BySuffix("wav");
+
+	if (StartsWith(b, 0, "FORM") &&
+	    (StartsWith(b, 8, "AIFF") || StartsWith(b, 8, "AIFC")))
+		return BySuffix("aiff");
+
+	if (StartsWith(b, 0, "DSD "))
+		return BySuffix("dsf");
+
+	if (StartsWith(b, 0, "FRM8") && StartsWith(b, 12, "DSD "))
+		return BySuffix("dff");
+
+	if (StartsWith(b, 0, "wvpk"))
+		return BySuffix("wv");
+
+	if (StartsWith(b, 0, "MPCK") || StartsWith(b, 0, "MP+"))
+		return BySuffix("mpc");
+
+	if (StartsWith(b, 0, "MAC "))
+		return BySuffix("ape");
+
+	if (StartsWith(b, 4, "ftyp"))
+		return BySuffix("m4a");
+
+	if (StartsWith(b, 0, "ADIF"))
+		return BySuffix("aac");
+
+	if (StartsWith(b, 0, "MThd"))
+		return BySuffix("mid");
+
+	return SniffMpegSync(b);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_SNIFF_HXX
+#define MPD_DECODER_SNIFF_HXX
+
+#include "util/Compiler.h"
+
+template<typename T> struct ConstBuffer;
+struct DecoderPlugin;
+
+/**
+ * The result of SniffAudioFormat().  Exactly one of the two
+ * attributes is set; it was chosen to match only the plugins which
+ * are able to handle the detected format, e.g. a MIME type for Ogg
+ * Vorbis, because the suffix "ogg" is claimed by several plugins.
+ */
+struct SniffedFormat {
+	const char *suffix = nullptr;
+	const char *mime_type = nullptr;
+
+	constexpr bool IsDefined() const noexcept {
+		return suffix != nullptr || mime_type != nullptr;
+	}
+
+	/**
+	 * Is the #DecoderPlugin expected to handle this format?
+	 */
+	gcc_pure
+	bool Match(const DecoderPlugin &plugin) const noexcept;
+};
+
+/**
+ * Detect the audio format by looking at the first bytes of a file
+ * ("magic bytes").  A leading ID3v2 tag is skipped.
+ *
+ * @param header the first bytes of the file
+ * @return the format or an undefined #SniffedFormat if the format
+ * was not recognized
+ */
+gcc_pure
+SniffedFormat
+SniffAudioFormat(ConstBuffer<void> header) noexcept;
+
+#endif
@@ -430,6 +430,15 @@ decoder_run_song(DecoderControl &dc,
 				played it*/
 			     !SongHasVolatileTags(song) ? std::make_unique<Tag>(song.GetTag()) : nullptr);
 
+	if (song.GetAnalyzedGain().IsDefined()) {
+		/* use the result of the loudness analysis unless the
+		   decoder plugin finds ReplayGain tags, which will
+		   override this */
+		auto replay_gain_info = ReplayGainInfo::Undefined();
+		replay_gain_info.track = song.GetAnalyzedGain();
+		bridge.SubmitReplayGain(&replay_gain_info);
+	}
+
 	dc.state = DecoderState::START;
 	dc.CommandFinishedLocked();
 
@@ -34,6 +34,7 @@
 #include "pcm/CheckAudioFormat.hxx"
 #include "util/BitReverse.hxx"
 #include "util/ByteOrder.hxx"
+#include "util/ConstBuffer.hxx"
 #include "DsdLib.hxx"
 #include "tag/Handler.hxx"
 
@@ -246,6 +247,37 @@ FrameToBlock(uint64_t frame)
 	return frame / DSF_BLOCK_SIZE;
 }
 
+/**
+ * Interleave the next block directly from the #InputStream's buffer
+ * (see InputStream::Peek()), without copying it into a temporary
+ * buffer first.
+ *
+ * @return false if the stream does not support InputStream::Peek()
+ * or if less than one block is available; the caller shall then
+ * fall back to reading the block
+ */
+static bool
+InterleaveFromPeek(InputStream &is, uint8_t *dest,
+		   size_t block_size, unsigned channels)
+{
+	std::unique_lock<Mutex> lock(is.mutex);
+
+	const auto src = ConstBuffer<uint8_t>::FromVoid(is.Peek(lock));
+	if (src.size < block_size)
+		return false;
+
+	{
+		/* the buffer remains valid until the next call on
+		   the stream, and page faults in a mapped file may
+		   block on disk I/O */
+		const ScopeUnlock unlock(is.mutex);
+		InterleaveDsfBlock(dest, src.data, channels);
+	}
+
+	is.Skip(lock, block_size);
+	return true;
+}
+
 /**
  * Decode one complete DSF 'data' chunk i.e. a complete song
  */
@@ -278,16 +310,23 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 				client.SeekError();
 		}
 
-		/* worst-case buffer size */
-		uint8_t buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		if (!decoder_read_full(&client, is, buffer, block_size))
-			return false;
+		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
 
-		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+		if (!InterleaveFromPeek(is, interleaved_buffer,
+					block_size, channels)) {
+			/* worst-case buffer size */
+			uint8_t buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
+			if (!decoder_read_full(&client, is, buffer, block_size))
+				return false;
 
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
+			InterleaveDsfBlock(interleaved_buffer, buffer, channels);
+		}
+
+		/* bit reversal works on single bytes, so it can be
+		   applied after interleaving */
+		if (bitreverse)
+			bit_reverse_buffer(interleaved_buffer,
+					   interleaved_buffer + block_size);
 
 		cmd = client.SubmitData(is,
 					interleaved_buffer, block_size,
@@ -25,10 +25,95 @@
 
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/**
+ * The size of the #RemoteSocketWriter buffer.  Output beyond that
+ * stays in the #PeakBuffer until the writer thread has caught up.
+ */
+static constexpr size_t REMOTE_BUFFER_SIZE = 16384;
+
+FullyBufferedSocket::FullyBufferedSocket(SocketDescriptor _fd,
+					 EventLoop &_loop,
+					 size_t normal_size, size_t peak_size,
+					 EventLoop *writer_loop) noexcept
+	:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
+	 output(normal_size, peak_size)
+{
+	if (writer_loop != nullptr) {
+		RemoteSocketWriterHandler &handler = *this;
+		remote = std::make_unique<RemoteSocketWriter>(_fd, _loop,
+							      *writer_loop,
+							      REMOTE_BUFFER_SIZE,
+							      handler);
+	}
+}
+
+FullyBufferedSocket::~FullyBufferedSocket() noexcept = default;
+
+size_t
+FullyBufferedSocket::GetOutputSize() const noexcept
+{
+	size_t size = output.GetSize();
+	if (remote)
+		size += remote->GetSize();
+	return size;
+}
+
+SocketWriteStats
+FullyBufferedSocket::GetWriteStats() const noexcept
+{
+	SocketWriteStats stats = write_stats;
+	if (remote)
+		stats += remote->GetWriteStats();
+	return stats;
+}
+
+void
+FullyBufferedSocket::Close() noexcept
+{
+	IdleMonitor::Cancel();
+
+	/* the writer thread must let go of the socket before it gets
+	   closed */
+	if (remote)
+		remote->Stop();
+
+	BufferedSocket::Close();
+}
+
 FullyBufferedSocket::ssize_t
-FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
+FullyBufferedSocket::DirectWrite(const WritableBuffer<void> *v,
+				 unsigned n) noexcept
 {
-	const auto nbytes = GetSocket().Write((const char *)data, length);
+	assert(n > 0);
+
+#ifdef _WIN32
+	(void)n;
+	const auto nbytes = GetSocket().Write((const char *)v[0].data,
+					      v[0].size);
+#else
+	ssize_t nbytes;
+	if (n == 1) {
+		nbytes = GetSocket().Write((const char *)v[0].data,
+					   v[0].size);
+	} else {
+		/* gather both chunks of the PeakBuffer into one
+		   system call */
+		struct iovec iov[2];
+		for (unsigned i = 0; i < n; ++i) {
+			iov[i].iov_base = v[i].data;
+			iov[i].iov_len = v[i].size;
+		}
+
+		nbytes = GetSocket().Write(iov, n);
+	}
+#endif
+
+	++write_stats.n_calls;
+
 	if (gcc_unlikely(nbytes < 0)) {
 		const auto code = GetSocketError();
 		if (IsSocketErrorAgain(code))
@@ -41,24 +126,60 @@ FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
 			OnSocketClosed();
 		else
 			OnSocketError(std::make_exception_ptr(MakeSocketError(code, "Failed to send to socket")));
+		return nbytes;
 	}
 
+	write_stats.n_bytes += nbytes;
 	return nbytes;
 }
 
+void
+FullyBufferedSocket::RemoteFlush() noexcept
+{
+	bool consumed = false;
+
+	while (true) {
+		const auto data = output.Read();
+		if (data.empty())
+			break;
+
+		const size_t nbytes = remote->Append(data.data, data.size);
+		if (nbytes == 0) {
+			/* the writer's buffer is full; wait for
+			   OnRemoteSocketWritten() */
+			IdleMonitor::Cancel();
+			return;
+		}
+
+		output.Consume(nbytes);
+		consumed = true;
+	}
+
+	IdleMonitor::Cancel();
+
+	if (consumed)
+		OnOutputDrained();
+}
+
 bool
 FullyBufferedSocket::Flush() noexcept
 {
 	assert(IsDefined());
 
-	const auto data = output.Read();
-	if (data.empty()) {
+	if (remote) {
+		RemoteFlush();
+		return true;
+	}
+
+	WritableBuffer<void> v[2];
+	const unsigned n = output.ReadAll(v);
+	if (n == 0) {
 		IdleMonitor::Cancel();
 		CancelWrite();
 		return true;
 	}
 
-	auto nbytes = DirectWrite(data.data, data.size);
+	auto nbytes = DirectWrite(v, n);
 	if (gcc_unlikely(nbytes <= 0))
 		return nbytes == 0;
 
@@ -67,6 +188,7 @@ FullyBufferedSocket::Flush() noexcept
 	if (output.empty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
+		OnOutputDrained();
 	}
 
 	return true;
@@ -92,6 +214,19 @@ FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 	return true;
 }
 
+void
+FullyBufferedSocket::CommitWrite(size_t length) noexcept
+{
+	assert(IsDefined());
+
+	const bool was_empty = output.empty();
+
+	output.Append(length);
+
+	if (was_empty && length > 0)
+		IdleMonitor::Schedule();
+}
+
 bool
 FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 {
@@ -109,6 +244,33 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 void
 FullyBufferedSocket::OnIdle() noexcept
 {
-	if (Flush() && !output.empty())
+	if (Flush() && !output.empty() && !remote)
 		ScheduleWrite();
 }
+
+void
+FullyBufferedSocket::OnRemoteSocketWritten() noexcept
+{
+	if (!IsDefined())
+		return;
+
+	if (!output.empty())
+		RemoteFlush();
+	else
+		/* the writer thread has made progress with data
+		   which was handed over earlier; this may be what a
+		   background command is waiting for */
+		OnOutputDrained();
+}
+
+void
+FullyBufferedSocket::OnRemoteSocketError(socket_error_t code) noexcept
+{
+	IdleMonitor::Cancel();
+	BufferedSocket::Cancel();
+
+	if (IsSocketErrorClosed(code))
+		OnSocketClosed();
+	else
+		OnSocketError(std::make_exception_ptr(MakeSocketError(code, "Failed to send to socket")));
+}
@@ -22,36 +22,77 @@
 
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
+#include "RemoteSocketWriter.hxx"
+#include "SocketWriteStats.hxx"
 #include "util/PeakBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <memory>
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
-class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
+class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor,
+			    RemoteSocketWriterHandler {
 	PeakBuffer output;
 
+	/**
+	 * If set, then data from the output buffer is handed over to
+	 * this object, which sends it to the socket in another
+	 * #EventLoop.
+	 */
+	std::unique_ptr<RemoteSocketWriter> remote;
+
+	SocketWriteStats write_stats;
+
 public:
+	/**
+	 * @param writer_loop if not nullptr, then the send() calls are
+	 * done in this #EventLoop instead of #_loop
+	 */
 	FullyBufferedSocket(SocketDescriptor _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0) noexcept
-		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
-		 output(normal_size, peak_size) {
-	}
+			    size_t normal_size, size_t peak_size=0,
+			    EventLoop *writer_loop=nullptr) noexcept;
+
+	~FullyBufferedSocket() noexcept;
 
 	using BufferedSocket::GetEventLoop;
 	using BufferedSocket::IsDefined;
 
-	void Close() noexcept {
-		IdleMonitor::Cancel();
-		BufferedSocket::Close();
-	}
+	/**
+	 * Returns the number of bytes in the output buffer.
+	 */
+	gcc_pure
+	size_t GetOutputSize() const noexcept;
+
+	/**
+	 * Returns counters for the send() system calls on this
+	 * socket, including those done by the #RemoteSocketWriter.
+	 */
+	gcc_pure
+	SocketWriteStats GetWriteStats() const noexcept;
+
+	void Close() noexcept;
 
 private:
 	/**
+	 * Send the given chunks to the socket with one system call.
+	 *
+	 * @param v an array of #n chunks
+	 * @param n the number of chunks (1 or 2)
 	 * @return the number of bytes written to the socket, 0 if the
 	 * socket isn't ready for writing, -1 on error (the socket has
 	 * been closed and probably destructed)
 	 */
-	ssize_t DirectWrite(const void *data, size_t length) noexcept;
+	ssize_t DirectWrite(const WritableBuffer<void> *v,
+			    unsigned n) noexcept;
+
+	/**
+	 * The Flush() implementation for #remote: hand over as much
+	 * as possible from the output buffer.
+	 */
+	void RemoteFlush() noexcept;
 
 protected:
 	/**
@@ -66,10 +107,39 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+	/**
+	 * Prepare writing at least #min_length bytes directly into
+	 * the output buffer.  After writing, call CommitWrite().
+	 *
+	 * @return a writable buffer of at least #min_length bytes, or
+	 * nullptr if there is not enough contiguous space (fall back
+	 * to Write() then)
+	 */
+	WritableBuffer<void> BeginWrite(size_t min_length) noexcept {
+		return output.Write(min_length);
+	}
+
+	/**
+	 * Commit data written to the buffer returned by
+	 * BeginWrite().  A length of 0 cancels the operation.
+	 */
+	void CommitWrite(size_t length) noexcept;
+
+	/**
+	 * The output buffer has become empty after all of it has been
+	 * sent to the socket.  This method must not call Write().
+	 */
+	virtual void OnOutputDrained() noexcept {}
+
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
 	void OnIdle() noexcept override;
+
+private:
+	/* virtual methods from class RemoteSocketWriterHandler */
+	void OnRemoteSocketWritten() noexcept override;
+	void OnRemoteSocketError(socket_error_t code) noexcept override;
 };
 
 #endif
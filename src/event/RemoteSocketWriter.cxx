@@ -0,0 +1,180 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "RemoteSocketWriter.hxx"
+#include "Call.hxx"
+
+#include <algorithm>
+
+RemoteSocketWriter::RemoteSocketWriter(SocketDescriptor _fd,
+				       EventLoop &owner_loop,
+				       EventLoop &writer_loop,
+				       size_t buffer_size,
+				       RemoteSocketWriterHandler &_handler) noexcept
+	:SocketMonitor(_fd, writer_loop),
+	 handler(_handler),
+	 notify(owner_loop, BIND_THIS_METHOD(OnNotify)),
+	 defer_send(writer_loop, BIND_THIS_METHOD(OnDeferredSend)),
+	 buffer(buffer_size)
+{
+}
+
+RemoteSocketWriter::~RemoteSocketWriter() noexcept
+{
+	if (SocketMonitor::IsDefined())
+		Stop();
+}
+
+size_t
+RemoteSocketWriter::GetSize() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return buffer.GetAvailable();
+}
+
+SocketWriteStats
+RemoteSocketWriter::GetWriteStats() const noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+	return write_stats;
+}
+
+size_t
+RemoteSocketWriter::Append(const void *data, size_t length) noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (stopped || error != 0)
+		return 0;
+
+	const bool was_empty = buffer.empty();
+
+	const auto w = buffer.Write();
+	const size_t nbytes = std::min(w.size, length);
+	if (nbytes == 0)
+		return 0;
+
+	std::copy_n((const uint8_t *)data, nbytes, w.data);
+	buffer.Append(nbytes);
+
+	if (was_empty)
+		defer_send.Schedule();
+
+	return nbytes;
+}
+
+void
+RemoteSocketWriter::Stop() noexcept
+{
+	BlockingCall(SocketMonitor::GetEventLoop(), [this](){
+		defer_send.Cancel();
+
+		const std::lock_guard<Mutex> lock(mutex);
+		stopped = true;
+
+		if (error == 0) {
+			/* last attempt to send pending data, just
+			   like FullyBufferedSocket::Flush() before
+			   closing the socket */
+			const auto r = buffer.Read();
+			if (!r.empty()) {
+				const auto nbytes =
+					GetSocket().Write(r.data, r.size);
+				++write_stats.n_calls;
+				if (nbytes > 0)
+					write_stats.n_bytes += nbytes;
+			}
+		}
+
+		buffer.Clear();
+
+		/* unregister the socket, but don't close it; it
+		   belongs to the owner */
+		if (SocketMonitor::IsDefined())
+			Steal();
+	});
+
+	notify.Cancel();
+}
+
+void
+RemoteSocketWriter::TrySend() noexcept
+{
+	const std::lock_guard<Mutex> lock(mutex);
+
+	if (stopped || error != 0)
+		return;
+
+	const auto r = buffer.Read();
+	if (r.empty()) {
+		SocketMonitor::Cancel();
+		return;
+	}
+
+	const auto nbytes = GetSocket().Write(r.data, r.size);
+	++write_stats.n_calls;
+	if (gcc_unlikely(nbytes < 0)) {
+		const auto code = GetSocketError();
+		if (IsSocketErrorAgain(code)) {
+			ScheduleWrite();
+			return;
+		}
+
+		error = code;
+		SocketMonitor::Cancel();
+		notify.OrMask(NOTIFY_ERROR);
+		return;
+	}
+
+	buffer.Consume(nbytes);
+	write_stats.n_bytes += nbytes;
+
+	if (buffer.empty())
+		SocketMonitor::Cancel();
+	else
+		ScheduleWrite();
+
+	notify.OrMask(NOTIFY_WRITTEN);
+}
+
+void
+RemoteSocketWriter::OnNotify(unsigned mask) noexcept
+{
+	if (mask & NOTIFY_ERROR) {
+		socket_error_t code;
+
+		{
+			const std::lock_guard<Mutex> lock(mutex);
+			code = error;
+		}
+
+		handler.OnRemoteSocketError(code);
+		return;
+	}
+
+	if (mask & NOTIFY_WRITTEN)
+		handler.OnRemoteSocketWritten();
+}
+
+bool
+RemoteSocketWriter::OnSocketReady(unsigned) noexcept
+{
+	TrySend();
+	return true;
+}
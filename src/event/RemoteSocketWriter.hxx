@@ -0,0 +1,149 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_REMOTE_SOCKET_WRITER_HXX
+#define MPD_REMOTE_SOCKET_WRITER_HXX
+
+#include "SocketMonitor.hxx"
+#include "MaskMonitor.hxx"
+#include "DeferEvent.hxx"
+#include "SocketWriteStats.hxx"
+#include "thread/Mutex.hxx"
+#include "net/SocketError.hxx"
+#include "util/DynamicFifoBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <cstdint>
+
+class RemoteSocketWriterHandler {
+public:
+	/**
+	 * Data has been sent to the socket, and there is room for
+	 * more.
+	 */
+	virtual void OnRemoteSocketWritten() noexcept = 0;
+
+	/**
+	 * Sending to the socket has failed.  No more data will be
+	 * sent.
+	 */
+	virtual void OnRemoteSocketError(socket_error_t code) noexcept = 0;
+};
+
+/**
+ * Sends data to a socket from another thread, i.e. on another
+ * #EventLoop.  The owner hands over data with Append() and gets
+ * notified in its own #EventLoop about progress and errors.  This
+ * moves the send() system calls out of the owner's thread.
+ *
+ * All public methods must be called in the owner's thread.
+ */
+class RemoteSocketWriter final : SocketMonitor {
+	RemoteSocketWriterHandler &handler;
+
+	/**
+	 * Notifies the owner's #EventLoop; see #NOTIFY_WRITTEN and
+	 * #NOTIFY_ERROR.
+	 */
+	MaskMonitor notify;
+
+	static constexpr unsigned NOTIFY_WRITTEN = 0x1;
+	static constexpr unsigned NOTIFY_ERROR = 0x2;
+
+	/**
+	 * Triggers TrySend() in the writer's #EventLoop after data has
+	 * been appended.
+	 */
+	DeferEvent defer_send;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Data which has been handed over, but has not yet been sent.
+	 * Protected by #mutex.
+	 */
+	DynamicFifoBuffer<uint8_t> buffer;
+
+	/**
+	 * The error which has occurred while sending, or 0.
+	 * Protected by #mutex.
+	 */
+	socket_error_t error = 0;
+
+	/**
+	 * Has Stop() been called?  Protected by #mutex.
+	 */
+	bool stopped = false;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	SocketWriteStats write_stats;
+
+public:
+	RemoteSocketWriter(SocketDescriptor _fd,
+			   EventLoop &owner_loop, EventLoop &writer_loop,
+			   size_t buffer_size,
+			   RemoteSocketWriterHandler &_handler) noexcept;
+
+	~RemoteSocketWriter() noexcept;
+
+	/**
+	 * Returns the number of bytes which have been handed over, but
+	 * have not yet been sent.
+	 */
+	gcc_pure
+	size_t GetSize() const noexcept;
+
+	gcc_pure
+	SocketWriteStats GetWriteStats() const noexcept;
+
+	/**
+	 * Hand over data to be sent.
+	 *
+	 * @return the number of bytes which were accepted; 0 if the
+	 * buffer is full (wait for OnRemoteSocketWritten()) or after an
+	 * error
+	 */
+	size_t Append(const void *data, size_t length) noexcept;
+
+	/**
+	 * Stop using the socket.  This makes one last attempt to send
+	 * pending data.  Must be called before the socket gets closed.
+	 */
+	void Stop() noexcept;
+
+private:
+	/**
+	 * Send data from the buffer.  Runs in the writer's
+	 * #EventLoop.
+	 */
+	void TrySend() noexcept;
+
+	void OnDeferredSend() noexcept {
+		TrySend();
+	}
+
+	void OnNotify(unsigned mask) noexcept;
+
+	/* virtual methods from class SocketMonitor */
+	bool OnSocketReady(unsigned flags) noexcept override;
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_SOCKET_WRITE_STATS_HXX
+#define MPD_SOCKET_WRITE_STATS_HXX
+
+#include <cstdint>
+
+/**
+ * Counters for the send() system calls on a socket.
+ */
+struct SocketWriteStats {
+	/**
+	 * The number of send() system calls, including those which
+	 * have failed.
+	 */
+	uint64_t n_calls = 0;
+
+	/**
+	 * The number of bytes which have been sent.
+	 */
+	uint64_t n_bytes = 0;
+
+	SocketWriteStats &operator+=(const SocketWriteStats &other) noexcept {
+		n_calls += other.n_calls;
+		n_bytes += other.n_bytes;
+		return *this;
+	}
+};
+
+#endif
@@ -21,59 +21,98 @@
 #include "filter/FilterPlugin.hxx"
 #include "filter/Filter.hxx"
 #include "filter/Prepared.hxx"
-#include "pcm/Buffer.hxx"
+#include "pcm/Normalizer.hxx"
 #include "pcm/AudioFormat.hxx"
-#include "AudioCompress/compress.h"
+#include "config/Block.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
 
-#include <string.h>
+#include <stdexcept>
 
-class NormalizeFilter final : public Filter {
-	Compressor *const compressor;
+#include <stdlib.h>
 
-	PcmBuffer buffer;
+class NormalizeFilter final : public Filter {
+	PcmNormalizer normalizer;
 
 public:
-	explicit NormalizeFilter(const AudioFormat &audio_format)
-		:Filter(audio_format), compressor(Compressor_new(0)) {
+	NormalizeFilter(const AudioFormat &audio_format,
+			const PcmNormalizer::Config &config)
+		:Filter(audio_format) {
+		normalizer.Open(audio_format, config);
 	}
 
-	~NormalizeFilter() override {
-		Compressor_delete(compressor);
+	/* virtual methods from class Filter */
+	void Reset() noexcept override {
+		normalizer.Reset();
 	}
 
-	/* virtual methods from class Filter */
-	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override;
+	ConstBuffer<void> FilterPCM(ConstBuffer<void> src) override {
+		return normalizer.Process(src);
+	}
+
+	ConstBuffer<void> Flush() override {
+		return normalizer.Flush();
+	}
 };
 
 class PreparedNormalizeFilter final : public PreparedFilter {
+	const PcmNormalizer::Config config;
+
 public:
+	explicit PreparedNormalizeFilter(const PcmNormalizer::Config &_config) noexcept
+		:config(_config) {}
+
 	/* virtual methods from class PreparedFilter */
 	std::unique_ptr<Filter> Open(AudioFormat &af) override;
 };
 
-static std::unique_ptr<PreparedFilter>
-normalize_filter_init([[maybe_unused]] const ConfigBlock &block)
+static double
+ParseDecibel(const char *s, double min, double max)
 {
-	return std::make_unique<PreparedNormalizeFilter>();
+	char *endptr;
+	const double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0)
+		throw std::invalid_argument("Not a numeric value");
+
+	if (value < min || value > max)
+		throw FormatInvalidArgument("Number must be between %g and %g",
+					    min, max);
+
+	return value;
 }
 
-std::unique_ptr<Filter>
-PreparedNormalizeFilter::Open(AudioFormat &audio_format)
+static std::unique_ptr<PreparedFilter>
+normalize_filter_init(const ConfigBlock &block)
 {
-	audio_format.format = SampleFormat::S16;
+	PcmNormalizer::Config config;
 
-	return std::make_unique<NormalizeFilter>(audio_format);
+	if (const auto *p = block.GetBlockParam("target"))
+		config.target = p->With([](const char *s){
+			return ParseDecibel(s, -70, 0);
+		});
+
+	if (const auto *p = block.GetBlockParam("max_gain"))
+		config.max_gain = p->With([](const char *s){
+			return ParseDecibel(s, 0, 60);
+		});
+
+	config.lookahead_ms = block.GetPositiveValue("lookahead",
+						     config.lookahead_ms);
+	if (config.lookahead_ms > 1000)
+		throw std::invalid_argument("\"lookahead\" is too large");
+
+	return std::make_unique<PreparedNormalizeFilter>(config);
 }
 
-ConstBuffer<void>
-NormalizeFilter::FilterPCM(ConstBuffer<void> src)
+std::unique_ptr<Filter>
+PreparedNormalizeFilter::Open(AudioFormat &audio_format)
 {
-	auto *dest = (int16_t *)buffer.Get(src.size);
-	memcpy(dest, src.data, src.size);
+	/* S16, S24_P32, S32 and FLOAT are processed natively; other
+	   formats are converted by the filter chain */
+	audio_format.format =
+		PcmNormalizer::GetSupportedFormat(audio_format.format);
 
-	Compressor_Process_int16(compressor, dest, src.size / 2);
-	return { (const void *)dest, src.size };
+	return std::make_unique<NormalizeFilter>(audio_format, config);
 }
 
 const FilterPlugin normalize_filter_plugin = {
@@ -84,5 +123,5 @@ const FilterPlugin normalize_filter_plugin = {
 std::unique_ptr<PreparedFilter>
 normalize_filter_prepare() noexcept
 {
-	return std::make_unique<PreparedNormalizeFilter>();
+	return std::make_unique<PreparedNormalizeFilter>(PcmNormalizer::Config());
 }
@@ -146,6 +146,14 @@ public:
 		assert(HasEntry());
 		return Path::FromFS(ent->d_name);
 	}
+
+	/**
+	 * Returns the file descriptor of the directory, to be used
+	 * with the "*at()" system calls.
+	 */
+	int GetFD() const {
+		return dirfd(dirp);
+	}
 };
 
 #endif
@@ -27,6 +27,7 @@
 #include "time/FileTime.hxx"
 #else
 #include <sys/stat.h>
+#include <fcntl.h>
 #endif
 
 #include <chrono>
@@ -35,6 +36,10 @@
 class FileInfo {
 	friend bool GetFileInfo(Path path, FileInfo &info,
 				bool follow_symlinks);
+#ifndef _WIN32
+	friend bool GetFileInfoAt(int directory_fd, Path name,
+				  FileInfo &info, bool follow_symlinks);
+#endif
 	friend class FileReader;
 
 #ifdef _WIN32
@@ -125,4 +130,21 @@ GetFileInfo(Path path, FileInfo &info, bool follow_symlinks=true)
 #endif
 }
 
+#ifndef _WIN32
+
+/**
+ * Like GetFileInfo(), but look up the name relative to a directory
+ * file descriptor, which saves the kernel from resolving the whole
+ * path again.
+ */
+inline bool
+GetFileInfoAt(int directory_fd, Path name, FileInfo &info,
+	      bool follow_symlinks=true)
+{
+	return fstatat(directory_fd, name.c_str(), &info.st,
+		       follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+#endif
+
 #endif
@@ -77,6 +77,56 @@ GzipOutputStream::Flush()
 	}
 }
 
+void
+GzipOutputStream::SyncFlush()
+{
+	/* no more input */
+	z.next_in = nullptr;
+	z.avail_in = 0;
+
+	do {
+		Bytef output[16384];
+		z.next_out = output;
+		z.avail_out = sizeof(output);
+
+		int result = deflate(&z, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR)
+			throw ZlibError(result);
+
+		if (z.next_out > output)
+			next.Write(output, z.next_out - output);
+
+		/* if zlib has filled the whole output buffer, there
+		   may be more */
+	} while (z.avail_out == 0);
+}
+
+void
+GzipOutputStream::SetLevel(int level)
+{
+	/* no more input */
+	z.next_in = nullptr;
+	z.avail_in = 0;
+
+	while (true) {
+		Bytef output[16384];
+		z.next_out = output;
+		z.avail_out = sizeof(output);
+
+		/* this flushes pending data with Z_BLOCK, which may
+		   need more output space than is available */
+		int result = deflateParams(&z, level, Z_DEFAULT_STRATEGY);
+
+		if (z.next_out > output)
+			next.Write(output, z.next_out - output);
+
+		if (result == Z_OK)
+			break;
+		else if (result != Z_BUF_ERROR)
+			throw ZlibError(result);
+	}
+}
+
 void
 GzipOutputStream::Write(const void *_data, size_t size)
 {
@@ -58,6 +58,21 @@ public:
 	 */
 	void Flush();
 
+	/**
+	 * Write all data remaining in zlib's output buffer, aligned
+	 * to a byte boundary, so the receiver can decompress
+	 * everything written so far (#Z_SYNC_FLUSH).  The stream
+	 * remains open.
+	 */
+	void SyncFlush();
+
+	/**
+	 * Change the compression level for data written after this
+	 * call.  Data written before is compressed with the old
+	 * level.
+	 */
+	void SetLevel(int level);
+
 	/* virtual methods from class OutputStream */
 	void Write(const void *data, size_t size) override;
 };
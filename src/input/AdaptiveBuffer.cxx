@@ -0,0 +1,227 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "AdaptiveBuffer.hxx"
+#include "thread/Mutex.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+/**
+ * The default value for SetInputBufferBudget().
+ */
+static constexpr std::size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+/**
+ * Measure the consumption rate over intervals of this duration.
+ */
+static constexpr auto MEASURE_INTERVAL = std::chrono::seconds(2);
+
+/**
+ * Buffer at least this many seconds of data.
+ */
+static constexpr unsigned MIN_MARGIN = 4;
+
+/**
+ * Buffer at most this many seconds of data, even after many
+ * underruns.
+ */
+static constexpr unsigned MAX_MARGIN = 64;
+
+/**
+ * After this many measurement intervals without an underrun, the
+ * margin is reduced.
+ */
+static constexpr unsigned SMOOTH_INTERVALS = 16;
+
+/**
+ * Buffer sizes are multiples of this granularity.
+ */
+static constexpr std::size_t GRANULARITY = 16 * 1024;
+
+static Mutex budget_mutex;
+static std::size_t budget = DEFAULT_BUDGET, budget_used;
+
+static boost::intrusive::list<AdaptiveBufferSize,
+			      boost::intrusive::constant_time_size<false>> buffers;
+
+/**
+ * Charge (up to) the given number of bytes to the budget.
+ *
+ * Caller must lock #budget_mutex.
+ *
+ * @return the number of bytes which were granted
+ */
+static std::size_t
+Acquire(std::size_t nbytes) noexcept
+{
+	const std::size_t available = budget_used < budget
+		? budget - budget_used
+		: 0;
+	nbytes = std::min(nbytes, available) / GRANULARITY * GRANULARITY;
+	budget_used += nbytes;
+	return nbytes;
+}
+
+static void
+Release(std::size_t nbytes) noexcept
+{
+	assert(budget_used >= nbytes);
+
+	budget_used -= nbytes;
+}
+
+void
+SetInputBufferBudget(std::size_t _budget) noexcept
+{
+	const std::lock_guard<Mutex> lock(budget_mutex);
+	budget = _budget;
+}
+
+std::size_t
+GetInputBufferUsage() noexcept
+{
+	const std::lock_guard<Mutex> lock(budget_mutex);
+	return budget_used;
+}
+
+std::vector<InputBufferInfo>
+GetInputBufferInfo()
+{
+	std::vector<InputBufferInfo> result;
+
+	const std::lock_guard<Mutex> lock(budget_mutex);
+	for (const auto &i : buffers)
+		result.push_back({
+				i.uri,
+				i.stat_size, i.stat_fill,
+				i.stat_rate, i.stat_underruns,
+			});
+
+	return result;
+}
+
+AdaptiveBufferSize::AdaptiveBufferSize(const char *_uri,
+				       std::size_t _min_size,
+				       std::size_t initial_size,
+				       std::size_t _max_size) noexcept
+	:uri(_uri), min_size(_min_size), max_size(_max_size),
+	 size(_min_size), margin(MIN_MARGIN), stat_size(_min_size)
+{
+	assert(min_size > 0);
+	assert(min_size <= initial_size);
+	assert(initial_size <= max_size);
+
+	const std::lock_guard<Mutex> lock(budget_mutex);
+
+	/* the minimum size is always granted */
+	budget_used += min_size;
+
+	if (initial_size > min_size)
+		size += Acquire(initial_size - min_size);
+
+	stat_size = size;
+	buffers.push_back(*this);
+}
+
+AdaptiveBufferSize::~AdaptiveBufferSize() noexcept
+{
+	const std::lock_guard<Mutex> lock(budget_mutex);
+	Release(size);
+	buffers.erase(buffers.iterator_to(*this));
+}
+
+std::size_t
+AdaptiveBufferSize::OnConsumed(std::size_t nbytes, std::size_t fill,
+			       Clock::time_point now) noexcept
+{
+	stat_fill = fill;
+
+	if (interval_bytes == 0 && nbytes > 0 &&
+	    interval_start == Clock::time_point())
+		/* first call: start measuring */
+		interval_start = now;
+
+	interval_bytes += nbytes;
+
+	const auto duration = now - interval_start;
+	if (duration < MEASURE_INTERVAL)
+		return size;
+
+	const double seconds =
+		std::chrono::duration_cast<std::chrono::duration<double>>(duration).count();
+	const double sample = interval_bytes / seconds;
+
+	/* exponential moving average */
+	rate = rate > 0
+		? (rate * 3 + sample) / 4
+		: sample;
+	stat_rate = uint64_t(rate);
+
+	interval_start = now;
+	interval_bytes = 0;
+
+	if (++smooth_intervals >= SMOOTH_INTERVALS && margin > MIN_MARGIN) {
+		/* no underrun for a while: the connection seems to
+		   be stable, reduce the margin */
+		margin = std::max(margin - margin / 4, MIN_MARGIN);
+		smooth_intervals = 0;
+	}
+
+	return Update();
+}
+
+std::size_t
+AdaptiveBufferSize::OnUnderrun() noexcept
+{
+	++stat_underruns;
+
+	margin = std::min(margin * 2, MAX_MARGIN);
+	smooth_intervals = 0;
+
+	if (rate <= 0)
+		/* rate not yet known: grow by 50% */
+		rate = double(size + size / 2) / margin;
+
+	return Update();
+}
+
+std::size_t
+AdaptiveBufferSize::Update() noexcept
+{
+	std::size_t target = std::size_t(rate * margin);
+	target = (target + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+	target = std::clamp(target, min_size, max_size);
+
+	if (target > size) {
+		const std::lock_guard<Mutex> lock(budget_mutex);
+		size += Acquire(target - size);
+	} else if (target < size / 2) {
+		/* shrink only if the buffer is much too large, to
+		   avoid resizing back and forth */
+		const std::lock_guard<Mutex> lock(budget_mutex);
+		Release(size - target);
+		size = target;
+	}
+
+	return size;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_ADAPTIVE_BUFFER_HXX
+#define MPD_INPUT_ADAPTIVE_BUFFER_HXX
+
+#include <boost/intrusive/list_hook.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Decides how large the buffer of an #InputStream should be.  The
+ * size follows the rate at which the client consumes data (the
+ * bitrate, after the decoder's initial burst), multiplied by a
+ * number of seconds which grows after each buffer underrun (network
+ * jitter) and shrinks slowly again when the stream runs smoothly.
+ *
+ * All instances share one global memory budget (see
+ * SetInputBufferBudget()); a buffer may not grow beyond its minimum
+ * size if that would exceed the budget.
+ *
+ * This class is not thread-safe; it is protected by the mutex of
+ * the #InputStream which owns it.  Only the statistics (see
+ * GetInputBufferInfo()) may be read by other threads.
+ */
+class AdaptiveBufferSize final
+	: public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+private:
+	const std::string uri;
+
+	const std::size_t min_size, max_size;
+
+	/**
+	 * The current buffer size.  This amount has been charged to
+	 * the global budget.
+	 */
+	std::size_t size;
+
+	/**
+	 * The beginning of the current measurement interval.
+	 */
+	Clock::time_point interval_start;
+
+	/**
+	 * The number of bytes consumed during the current
+	 * measurement interval.
+	 */
+	std::size_t interval_bytes = 0;
+
+	/**
+	 * The consumption rate [bytes per second]; 0 if not yet
+	 * known.
+	 */
+	double rate = 0;
+
+	/**
+	 * How many seconds of data shall be buffered?
+	 */
+	unsigned margin;
+
+	/**
+	 * The number of measurement intervals since the last
+	 * underrun.
+	 */
+	unsigned smooth_intervals = 0;
+
+	/* statistics for GetInputBufferInfo() */
+	std::atomic_size_t stat_size, stat_fill{0};
+	std::atomic<uint64_t> stat_rate{0};
+	std::atomic_uint stat_underruns{0};
+
+public:
+	/**
+	 * @param _uri the URI of the stream (for the statistics)
+	 * @param _min_size the minimum buffer size, which is always
+	 * granted, even if the budget is exhausted
+	 * @param initial_size the buffer size until the consumption
+	 * rate is known
+	 * @param _max_size the maximum buffer size (i.e. the size of
+	 * the allocation)
+	 */
+	AdaptiveBufferSize(const char *_uri, std::size_t _min_size,
+			   std::size_t initial_size,
+			   std::size_t _max_size) noexcept;
+
+	~AdaptiveBufferSize() noexcept;
+
+	AdaptiveBufferSize(const AdaptiveBufferSize &) = delete;
+	AdaptiveBufferSize &operator=(const AdaptiveBufferSize &) = delete;
+
+	std::size_t GetSize() const noexcept {
+		return size;
+	}
+
+	/**
+	 * The client has consumed data from the buffer.
+	 *
+	 * @param fill the number of bytes remaining in the buffer
+	 * @return the new buffer size
+	 */
+	std::size_t OnConsumed(std::size_t nbytes, std::size_t fill,
+			       Clock::time_point now=Clock::now()) noexcept;
+
+	/**
+	 * The client had to wait for data, because the buffer ran
+	 * empty.
+	 *
+	 * @return the new buffer size
+	 */
+	std::size_t OnUnderrun() noexcept;
+
+	/**
+	 * Update the statistics after the stream has resized its
+	 * buffer.  The stream may not be able to apply a new size
+	 * immediately.
+	 */
+	void SetActualSize(std::size_t actual_size) noexcept {
+		stat_size = actual_size;
+	}
+
+private:
+	std::size_t Update() noexcept;
+
+	friend std::vector<struct InputBufferInfo> GetInputBufferInfo();
+};
+
+/**
+ * Statistics about one input stream buffer.
+ */
+struct InputBufferInfo {
+	std::string uri;
+
+	/**
+	 * The buffer size in bytes.
+	 */
+	std::size_t size;
+
+	/**
+	 * The number of bytes in the buffer (as of the most recent
+	 * read).
+	 */
+	std::size_t fill;
+
+	/**
+	 * The measured consumption rate in bytes per second; 0 if not
+	 * yet known.
+	 */
+	uint64_t rate;
+
+	/**
+	 * The number of buffer underruns.
+	 */
+	unsigned underruns;
+};
+
+/**
+ * Set the total number of bytes which may be used by all adaptive
+ * input stream buffers.
+ */
+void
+SetInputBufferBudget(std::size_t budget) noexcept;
+
+/**
+ * Return the total number of bytes currently used by all adaptive
+ * input stream buffers.
+ */
+std::size_t
+GetInputBufferUsage() noexcept;
+
+/**
+ * Obtain statistics about all open adaptive input stream buffers.
+ */
+std::vector<InputBufferInfo>
+GetInputBufferInfo();
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "AsyncInputStream.hxx"
+#include "AdaptiveBuffer.hxx"
 #include "CondHandler.hxx"
 #include "tag/Tag.hxx"
 #include "thread/Cond.hxx"
@@ -31,13 +32,15 @@
 AsyncInputStream::AsyncInputStream(EventLoop &event_loop, const char *_url,
 				   Mutex &_mutex,
 				   size_t _buffer_size,
-				   size_t _resume_at) noexcept
+				   size_t _resume_at,
+				   size_t _cache_size) noexcept
 	:InputStream(_url, _mutex),
 	 deferred_resume(event_loop, BIND_THIS_METHOD(DeferredResume)),
 	 deferred_seek(event_loop, BIND_THIS_METHOD(DeferredSeek)),
 	 allocation(_buffer_size),
 	 buffer(&allocation.front(), allocation.size()),
-	 resume_at(_resume_at)
+	 resume_at(_resume_at),
+	 cache(_cache_size)
 {
 	allocation.ForkCow(false);
 }
@@ -59,6 +62,43 @@ AsyncInputStream::ClearTag() noexcept
 	tag.reset();
 }
 
+void
+AsyncInputStream::EnableAdaptiveBuffer(size_t min_size,
+				       size_t initial_size) noexcept
+{
+	assert(buffer.empty());
+
+	adaptive = std::make_unique<AdaptiveBufferSize>(GetURI(),
+							min_size,
+							initial_size,
+							allocation.size());
+	ResizeBuffer(adaptive->GetSize());
+}
+
+void
+AsyncInputStream::ResizeBuffer(size_t new_capacity) noexcept
+{
+	const size_t old_capacity = buffer.GetCapacity();
+	if (new_capacity == old_capacity || !buffer.Resize(new_capacity))
+		/* try again after the next Read() */
+		return;
+
+	if (new_capacity < old_capacity)
+		/* give the unused memory back to the kernel */
+		allocation.DiscardFrom(new_capacity);
+
+	adaptive->SetActualSize(new_capacity);
+}
+
+void
+AsyncInputStream::MaybeScheduleResume() noexcept
+{
+	/* the threshold scales with the current capacity */
+	if (paused &&
+	    buffer.GetSize() < uint64_t(resume_at) * buffer.GetCapacity() / allocation.size())
+		deferred_resume.Schedule();
+}
+
 void
 AsyncInputStream::Pause() noexcept
 {
@@ -91,7 +131,7 @@ bool
 AsyncInputStream::IsEOF() const noexcept
 {
 	return (KnownSize() && offset >= size) ||
-		(!open && buffer.empty());
+		(!reading_cache && !open && buffer.empty());
 }
 
 void
@@ -108,24 +148,26 @@ AsyncInputStream::Seek(std::unique_lock<Mutex> &lock,
 	if (!IsSeekable())
 		throw std::runtime_error("Not seekable");
 
-	/* check if we can fast-forward the buffer */
+	if (reading_cache)
+		LeaveCache();
 
-	while (new_offset > offset) {
-		auto r = buffer.Read();
-		if (r.empty())
-			break;
-
-		const size_t nbytes =
-			new_offset - offset < (offset_type)r.size
-					       ? new_offset - offset
-					       : r.size;
+	/* check if we can fast-forward the buffer */
 
-		buffer.Consume(nbytes);
-		offset += nbytes;
+	if (SkipBuffered(new_offset)) {
+		MaybeScheduleResume();
+		return;
 	}
 
-	if (new_offset == offset)
+	/* check if we have read this part of the stream recently;
+	   the buffer remains untouched, and Read() will switch back
+	   to it when it reaches the buffer's offset */
+
+	if (cache.Contains(new_offset)) {
+		buffer_offset = offset;
+		offset = new_offset;
+		reading_cache = true;
 		return;
+	}
 
 	/* no: ask the implementation to seek */
 
@@ -142,6 +184,28 @@ AsyncInputStream::Seek(std::unique_lock<Mutex> &lock,
 	Check();
 }
 
+bool
+AsyncInputStream::SkipBuffered(offset_type new_offset) noexcept
+{
+	while (new_offset > offset) {
+		auto r = buffer.Read();
+		if (r.empty())
+			break;
+
+		const size_t nbytes =
+			new_offset - offset < (offset_type)r.size
+					       ? new_offset - offset
+					       : r.size;
+
+		if (IsSeekable())
+			cache.Put(offset, r.data, nbytes);
+		buffer.Consume(nbytes);
+		offset += nbytes;
+	}
+
+	return new_offset == offset;
+}
+
 void
 AsyncInputStream::SeekDone() noexcept
 {
@@ -166,9 +230,34 @@ AsyncInputStream::ReadTag() noexcept
 bool
 AsyncInputStream::IsAvailable() const noexcept
 {
-	return postponed_exception ||
-		IsEOF() ||
-		!buffer.empty();
+	if (postponed_exception)
+		return true;
+
+	if (reading_cache && offset != buffer_offset)
+		return cache.Contains(offset);
+
+	return IsEOF() || !buffer.empty();
+}
+
+size_t
+AsyncInputStream::ReadCache(void *ptr, size_t read_size) noexcept
+{
+	assert(reading_cache);
+
+	auto r = cache.Read(offset);
+	if (r.empty())
+		return 0;
+
+	/* switch back to the buffer as soon as possible */
+	if (offset < buffer_offset && r.size > buffer_offset - offset)
+		r.size = buffer_offset - offset;
+
+	const size_t nbytes = std::min(read_size, r.size);
+	memcpy(ptr, r.data, nbytes);
+	cache.Consume(nbytes);
+
+	offset += (offset_type)nbytes;
+	return nbytes;
 }
 
 size_t
@@ -177,10 +266,27 @@ AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
 {
 	assert(!GetEventLoop().IsInside());
 
+	if (reading_cache) {
+		if (offset != buffer_offset) {
+			size_t nbytes = ReadCache(ptr, read_size);
+			if (nbytes > 0)
+				return nbytes;
+
+			/* the cache has no more data; let the
+			   implementation seek to the current
+			   offset */
+			const offset_type new_offset = offset;
+			LeaveCache();
+			Seek(lock, new_offset);
+		} else
+			LeaveCache();
+	}
+
 	CondInputStreamHandler cond_handler;
 
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
+	bool underrun = false;
 	while (true) {
 		Check();
 
@@ -188,18 +294,30 @@ AsyncInputStream::Read(std::unique_lock<Mutex> &lock,
 		if (!r.empty() || IsEOF())
 			break;
 
+		if (adaptive && !underrun && offset > 0) {
+			/* the buffer has run empty: maybe it
+			   needs to be larger */
+			underrun = true;
+			ResizeBuffer(adaptive->OnUnderrun());
+		}
+
 		const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
 		cond_handler.cond.wait(lock);
 	}
 
 	const size_t nbytes = std::min(read_size, r.size);
 	memcpy(ptr, r.data, nbytes);
+	if (IsSeekable())
+		cache.Put(offset, r.data, nbytes);
 	buffer.Consume(nbytes);
 
 	offset += (offset_type)nbytes;
 
-	if (paused && buffer.GetSize() < resume_at)
-		deferred_resume.Schedule();
+	if (adaptive)
+		ResizeBuffer(adaptive->OnConsumed(nbytes,
+						  buffer.GetSize()));
+
+	MaybeScheduleResume();
 
 	return nbytes;
 }
@@ -264,6 +382,17 @@ AsyncInputStream::DeferredSeek() noexcept
 	try {
 		Resume();
 
+		/* more data may have arrived since Seek() was called
+		   (or while resuming); maybe the new offset is in the
+		   buffer now */
+		if (SkipBuffered(seek_offset)) {
+			MaybeScheduleResume();
+
+			seek_state = SeekState::NONE;
+			InvokeOnAvailable();
+			return;
+		}
+
 		seek_state = SeekState::PENDING;
 		buffer.Clear();
 		paused = false;
@@ -21,11 +21,16 @@
 #define MPD_ASYNC_INPUT_STREAM_HXX
 
 #include "InputStream.hxx"
+#include "SegmentCache.hxx"
 #include "event/DeferEvent.hxx"
 #include "util/HugeAllocator.hxx"
 #include "util/CircularBuffer.hxx"
 
+#include <cassert>
 #include <exception>
+#include <memory>
+
+class AdaptiveBufferSize;
 
 /**
  * Helper class for moving asynchronous (non-blocking) InputStream
@@ -46,6 +51,32 @@ class AsyncInputStream : public InputStream {
 	CircularBuffer<uint8_t> buffer;
 	const size_t resume_at;
 
+	/**
+	 * If set, then the buffer capacity is adjusted dynamically;
+	 * see EnableAdaptiveBuffer().
+	 */
+	std::unique_ptr<AdaptiveBufferSize> adaptive;
+
+	/**
+	 * Recently read data; backward seeks may be served from
+	 * here.
+	 */
+	InputSegmentCache cache;
+
+	/**
+	 * The offset of the first byte in #buffer.  This differs
+	 * from InputStream::offset only while #reading_cache is
+	 * set.
+	 */
+	offset_type buffer_offset;
+
+	/**
+	 * Is Read() currently serving data from the #cache?  This
+	 * happens after a seek to an offset which was found in the
+	 * #cache; #buffer is kept unmodified meanwhile.
+	 */
+	bool reading_cache = false;
+
 	bool open = true;
 
 	/**
@@ -72,7 +103,8 @@ public:
 	AsyncInputStream(EventLoop &event_loop, const char *_url,
 			 Mutex &_mutex,
 			 size_t _buffer_size,
-			 size_t _resume_at) noexcept;
+			 size_t _resume_at,
+			 size_t _cache_size=0) noexcept;
 
 	~AsyncInputStream() noexcept override;
 
@@ -80,6 +112,22 @@ public:
 		return deferred_resume.GetEventLoop();
 	}
 
+	/**
+	 * Statistics: how many bytes were served from the seek
+	 * cache?
+	 */
+	offset_type GetCacheServedBytes() const noexcept {
+		return cache.GetServedBytes();
+	}
+
+	/**
+	 * Statistics: how many bytes were received more than once
+	 * because they were not in the seek cache?
+	 */
+	offset_type GetCacheRefetchedBytes() const noexcept {
+		return cache.GetRefetchedBytes();
+	}
+
 	/* virtual methods from InputStream */
 	void Check() final;
 	bool IsEOF() const noexcept final;
@@ -97,6 +145,19 @@ protected:
 	void SetTag(std::unique_ptr<Tag> _tag) noexcept;
 	void ClearTag() noexcept;
 
+	/**
+	 * Let the buffer capacity follow the consumption rate,
+	 * between the given minimum and the allocation size passed
+	 * to the constructor.  The implementation must not keep
+	 * pointers into the buffer (from PrepareWriteBuffer()) while
+	 * the mutex is unlocked, because Read() may resize the
+	 * buffer.
+	 *
+	 * This must be called before data is added to the buffer.
+	 */
+	void EnableAdaptiveBuffer(size_t min_size,
+				  size_t initial_size) noexcept;
+
 	void Pause() noexcept;
 
 	bool IsPaused() const noexcept {
@@ -166,6 +227,44 @@ protected:
 private:
 	void Resume();
 
+	/**
+	 * Stop serving data from the #cache and continue with the
+	 * #buffer.
+	 */
+	void LeaveCache() noexcept {
+		assert(reading_cache);
+
+		reading_cache = false;
+		offset = buffer_offset;
+	}
+
+	/**
+	 * Copy data from the #cache (while #reading_cache is set).
+	 *
+	 * @return the number of bytes copied; 0 if the #cache has no
+	 * data at the current offset
+	 */
+	size_t ReadCache(void *ptr, size_t read_size) noexcept;
+
+	/**
+	 * Attempt to seek forward by discarding data from the
+	 * buffer.
+	 *
+	 * @return true if the new offset has been reached
+	 */
+	bool SkipBuffered(offset_type new_offset) noexcept;
+
+	/**
+	 * Resume the stream if it is paused and the buffer has been
+	 * drained below the threshold.
+	 */
+	void MaybeScheduleResume() noexcept;
+
+	/**
+	 * Apply the buffer capacity chosen by #adaptive.
+	 */
+	void ResizeBuffer(size_t new_capacity) noexcept;
+
 	/* for DeferEvent */
 	void DeferredResume() noexcept;
 	void DeferredSeek() noexcept;
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "BufferPrint.hxx"
+#include "AdaptiveBuffer.hxx"
+#include "client/Response.hxx"
+
+#include <cinttypes>
+
+void
+input_buffer_print(Response &r)
+{
+	for (const auto &i : GetInputBufferInfo())
+		r.Format("uri: %s\n"
+			 "size: %zu\n"
+			 "fill: %zu\n"
+			 "rate: %" PRIu64 "\n"
+			 "underruns: %u\n",
+			 i.uri.c_str(), i.size, i.fill,
+			 i.rate, i.underruns);
+
+	r.Format("total_size: %zu\n", GetInputBufferUsage());
+}
@@ -169,6 +169,11 @@ BufferingInputStream::RunThreadLocked(std::unique_lock<Mutex> &lock)
 
 			client_cond.notify_all();
 			OnBufferAvailable();
+
+			const auto delay = GetThrottleDelay(nbytes);
+			if (delay > delay.zero() &&
+			    want_offset == INVALID_OFFSET)
+				wake_cond.wait_for(lock, delay);
 		} else
 			wake_cond.wait(lock);
 	}
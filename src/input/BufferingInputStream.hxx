@@ -26,7 +26,9 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "util/SparseBuffer.hxx"
+#include "util/Compiler.h"
 
+#include <chrono>
 #include <exception>
 
 /**
@@ -100,6 +102,17 @@ public:
 	 */
 	void Check();
 
+	/**
+	 * Has the whole file been copied into the buffer, or has
+	 * reading failed?
+	 *
+	 * Caller must lock the mutex.
+	 */
+	gcc_pure
+	bool IsComplete() const noexcept {
+		return error || FindFirstHole() == INVALID_OFFSET;
+	}
+
 	/**
 	 * Check whether data is available in the buffer at the given
 	 * offset..
@@ -122,7 +135,22 @@ protected:
 	 */
 	virtual void OnBufferAvailable() noexcept {}
 
+	/**
+	 * This virtual method gets called after each chunk has been
+	 * added to the buffer, and allows the subclass to slow down
+	 * the transfer.  During this method call, the mutex is
+	 * locked.
+	 *
+	 * @param nbytes the number of bytes which were just read
+	 * @return the duration the thread shall pause before reading
+	 * the next chunk (zero for no pause)
+	 */
+	virtual std::chrono::steady_clock::duration GetThrottleDelay(size_t) noexcept {
+		return std::chrono::steady_clock::duration::zero();
+	}
+
 private:
+	gcc_pure
 	size_t FindFirstHole() const noexcept;
 
 	void RunThreadLocked(std::unique_lock<Mutex> &lock);
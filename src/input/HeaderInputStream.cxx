@@ -0,0 +1,125 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "HeaderInputStream.hxx"
+
+#include <algorithm>
+#include <cassert>
+
+#include <string.h>
+
+void
+HeaderInputStream::Fill(std::unique_lock<Mutex> &lock)
+{
+	assert(fill == 0);
+	assert(input->IsReady());
+	assert(input->GetOffset() == 0);
+
+	while (fill < buffer.size() && !input->IsEOF()) {
+		size_t nbytes = input->Read(lock, &buffer[fill],
+					    buffer.size() - fill);
+		if (nbytes == 0)
+			break;
+
+		fill += nbytes;
+	}
+
+	CopyAttributes();
+
+	/* CopyAttributes() has copied the offset of the underlying
+	   stream, but we're still at the beginning of the window */
+	offset = 0;
+}
+
+void
+HeaderInputStream::Update() noexcept
+{
+	if (ReadingFromBuffer())
+		return;
+
+	if (offset == offset_type(fill) && input->GetOffset() != offset) {
+		/* at the end of the window after seeking back into
+		   it; the underlying stream will be repositioned by
+		   Read(), so don't let CopyAttributes() overwrite our
+		   offset with its offset */
+		input->Update();
+		return;
+	}
+
+	ProxyInputStream::Update();
+}
+
+bool
+HeaderInputStream::IsEOF() const noexcept
+{
+	if (ReadingFromBuffer())
+		return false;
+
+	if (KnownSize())
+		return offset >= size;
+
+	return input->GetOffset() == offset && input->IsEOF();
+}
+
+size_t
+HeaderInputStream::Read(std::unique_lock<Mutex> &lock,
+			void *ptr, size_t read_size)
+{
+	if (ReadingFromBuffer()) {
+		read_size = std::min(read_size, fill - size_t(offset));
+		memcpy(ptr, &buffer[offset], read_size);
+		offset += read_size;
+		return read_size;
+	}
+
+	if (input->GetOffset() != offset)
+		/* the underlying stream is somewhere else after we
+		   have seeked back into the window */
+		input->Seek(lock, offset);
+
+	size_t nbytes = input->Read(lock, ptr, read_size);
+	CopyAttributes();
+	return nbytes;
+}
+
+void
+HeaderInputStream::Seek(std::unique_lock<Mutex> &lock,
+			offset_type new_offset)
+{
+	if (new_offset <= offset_type(fill)) {
+		/* no I/O for seeks within the window; the underlying
+		   stream will be repositioned lazily by Read() */
+		offset = new_offset;
+		return;
+	}
+
+	ProxyInputStream::Seek(lock, new_offset);
+}
+
+ConstBuffer<void>
+HeaderInputStream::Peek(std::unique_lock<Mutex> &lock) noexcept
+{
+	if (ReadingFromBuffer())
+		return {&buffer[offset], fill - size_t(offset)};
+
+	if (input->GetOffset() != offset)
+		return nullptr;
+
+	return input->Peek(lock);
+}
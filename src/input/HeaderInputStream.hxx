@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_HEADER_INPUT_STREAM_HXX
+#define MPD_HEADER_INPUT_STREAM_HXX
+
+#include "ProxyInputStream.hxx"
+#include "util/AllocatedArray.hxx"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A wrapper for a (usually seekable) #InputStream which keeps the
+ * first bytes of the stream in memory.  Reads and seeks within this
+ * "header window" do not touch the underlying stream, which makes
+ * probing by several decoder plugins and tag scanners cheap, and
+ * Peek() exposes the window for detecting the format.
+ *
+ * Call Fill() before using it.
+ */
+class HeaderInputStream final : public ProxyInputStream {
+	AllocatedArray<uint8_t> buffer;
+
+	/**
+	 * The number of valid bytes in #buffer.
+	 */
+	size_t fill = 0;
+
+public:
+	HeaderInputStream(InputStreamPtr _input, size_t _size) noexcept
+		:ProxyInputStream(std::move(_input)), buffer(_size) {}
+
+	/**
+	 * Read the header window from the underlying stream.  The
+	 * underlying stream must be ready and at offset 0.
+	 *
+	 * Throws on error.
+	 */
+	void Fill(std::unique_lock<Mutex> &lock);
+
+	/* virtual methods from InputStream */
+	void Update() noexcept override;
+	bool IsEOF() const noexcept override;
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    void *ptr, size_t size) override;
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type new_offset) override;
+	ConstBuffer<void> Peek(std::unique_lock<Mutex> &lock) noexcept override;
+
+private:
+	bool ReadingFromBuffer() const noexcept {
+		return offset < offset_type(fill);
+	}
+};
+
+#endif
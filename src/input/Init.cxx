@@ -20,9 +20,12 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "AdaptiveBuffer.hxx"
+#include "plugins/FileInputPlugin.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
+#include "config/Parser.hxx"
 #include "Log.hxx"
 #include "PluginUnavailable.hxx"
 #include "util/RuntimeError.hxx"
@@ -42,6 +45,13 @@ input_stream_global_init(const ConfigData &config, EventLoop &event_loop)
 	InitUringInputPlugin(event_loop);
 #endif
 
+	config.With(ConfigOption::INPUT_BUFFER_BUDGET, [](const char *s){
+		if (s != nullptr)
+			SetInputBufferBudget(ParseSize(s, 1024));
+	});
+
+	SetFileInputMmap(config.GetBool(ConfigOption::INPUT_MMAP, false));
+
 	const ConfigBlock empty;
 
 	for (unsigned i = 0; input_plugins[i] != nullptr; ++i) {
@@ -108,6 +108,12 @@ InputStream::IsAvailable() const noexcept
 	return true;
 }
 
+ConstBuffer<void>
+InputStream::Peek(std::unique_lock<Mutex> &) noexcept
+{
+	return nullptr;
+}
+
 size_t
 InputStream::LockRead(void *ptr, size_t _size)
 {
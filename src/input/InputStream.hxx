@@ -23,6 +23,7 @@
 #include "Offset.hxx"
 #include "Ptr.hxx"
 #include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <cassert>
@@ -373,6 +374,21 @@ public:
 	gcc_nonnull_all
 	size_t LockRead(void *ptr, size_t size);
 
+	/**
+	 * Obtain a pointer to the data at the current offset without
+	 * copying it.  This is an optional feature; the default
+	 * implementation returns an empty buffer, and the caller must
+	 * fall back to Read().  An empty buffer is also returned at
+	 * end-of-file.
+	 *
+	 * The returned buffer remains valid until the next call on
+	 * this object.  After using the data, the caller advances
+	 * the offset with Skip().
+	 *
+	 * The caller must lock the mutex.
+	 */
+	virtual ConstBuffer<void> Peek(std::unique_lock<Mutex> &lock) noexcept;
+
 	/**
 	 * Reads the whole data from the stream into the caller-supplied buffer.
 	 *
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "SegmentCache.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <new>
+
+#include <string.h>
+
+InputSegmentCache::SegmentMap::const_iterator
+InputSegmentCache::FindSegment(offset_type offset) const noexcept
+{
+	auto i = segments.upper_bound(offset);
+	if (i == segments.begin())
+		return segments.end();
+
+	--i;
+	if (offset >= i->first + i->second.fill)
+		return segments.end();
+
+	return i;
+}
+
+ConstBuffer<uint8_t>
+InputSegmentCache::Read(offset_type offset) noexcept
+{
+	auto i = FindSegment(offset);
+	if (i == segments.end())
+		return nullptr;
+
+	const auto &segment = i->second;
+	segment.last_use = ++use_counter;
+
+	const std::size_t position = offset - i->first;
+	return {segment.data.get() + position, segment.fill - position};
+}
+
+bool
+InputSegmentCache::Contains(offset_type offset) const noexcept
+{
+	return FindSegment(offset) != segments.end();
+}
+
+void
+InputSegmentCache::EvictLeastRecentlyUsed() noexcept
+{
+	assert(!segments.empty());
+
+	auto lru = std::min_element(segments.begin(), segments.end(),
+				    [](const auto &a, const auto &b){
+					    return a.second.last_use < b.second.last_use;
+				    });
+	segments.erase(lru);
+}
+
+void
+InputSegmentCache::MarkFetched(offset_type start, offset_type end)
+{
+	/* find the first range which overlaps or touches the new
+	   one */
+	auto i = fetched.upper_bound(start);
+	if (i != fetched.begin() && std::prev(i)->second >= start)
+		--i;
+
+	/* merge all of them into one */
+	offset_type new_start = start, new_end = end;
+	while (i != fetched.end() && i->first <= end) {
+		const offset_type overlap_start = std::max(i->first, start);
+		const offset_type overlap_end = std::min(i->second, end);
+		if (overlap_end > overlap_start)
+			refetched_bytes += overlap_end - overlap_start;
+
+		new_start = std::min(new_start, i->first);
+		new_end = std::max(new_end, i->second);
+		i = fetched.erase(i);
+	}
+
+	fetched.emplace(new_start, new_end);
+
+	while (fetched.size() > max_fetched)
+		CoalesceFetched();
+}
+
+void
+InputSegmentCache::CoalesceFetched() noexcept
+{
+	assert(fetched.size() >= 2);
+
+	auto best = fetched.begin();
+	offset_type best_gap = std::numeric_limits<offset_type>::max();
+
+	for (auto i = fetched.begin(), next = std::next(i);
+	     next != fetched.end(); i = next++) {
+		const offset_type gap = next->first - i->second;
+		if (gap < best_gap) {
+			best = i;
+			best_gap = gap;
+		}
+	}
+
+	auto next = std::next(best);
+	best->second = next->second;
+	fetched.erase(next);
+}
+
+void
+InputSegmentCache::Put(offset_type offset, const void *data,
+		       std::size_t size) noexcept
+try {
+	if (!IsEnabled() || size == 0)
+		return;
+
+	MarkFetched(offset, offset + size);
+
+	const auto *p = (const uint8_t *)data;
+
+	while (size > 0) {
+		auto i = segments.upper_bound(offset);
+		const offset_type next_start = i != segments.end()
+			? i->first
+			: std::numeric_limits<offset_type>::max();
+
+		std::size_t nbytes;
+
+		if (i != segments.begin()) {
+			auto &[start, segment] = *std::prev(i);
+			const offset_type end = start + segment.fill;
+
+			if (offset < end) {
+				/* this range is already cached */
+				nbytes = std::min<offset_type>(size,
+							       end - offset);
+				offset += nbytes;
+				p += nbytes;
+				size -= nbytes;
+				continue;
+			}
+
+			if (offset == end && segment.fill < SEGMENT_SIZE) {
+				/* append to the previous segment */
+				nbytes = std::min<offset_type>({size,
+							       SEGMENT_SIZE - segment.fill,
+							       next_start - offset});
+				memcpy(segment.data.get() + segment.fill,
+				       p, nbytes);
+				segment.fill += nbytes;
+				segment.last_use = ++use_counter;
+
+				offset += nbytes;
+				p += nbytes;
+				size -= nbytes;
+				continue;
+			}
+		}
+
+		if (segments.size() >= max_segments) {
+			/* make room and look up the neighbours
+			   again */
+			EvictLeastRecentlyUsed();
+			continue;
+		}
+
+		/* start a new segment */
+		auto &s = segments.emplace_hint(i, std::piecewise_construct,
+						std::forward_as_tuple(offset),
+						std::forward_as_tuple(++use_counter))->second;
+		nbytes = std::min<offset_type>({size, SEGMENT_SIZE,
+					       next_start - offset});
+		memcpy(s.data.get(), p, nbytes);
+		s.fill = nbytes;
+
+		offset += nbytes;
+		p += nbytes;
+		size -= nbytes;
+	}
+} catch (const std::bad_alloc &) {
+	/* out of memory: this is only a cache, so just don't
+	   cache the rest */
+}
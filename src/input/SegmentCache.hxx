@@ -0,0 +1,178 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_SEGMENT_CACHE_HXX
+#define MPD_INPUT_SEGMENT_CACHE_HXX
+
+#include "Offset.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+
+/**
+ * A bounded cache for data which was read from a (remote)
+ * #InputStream.  It remembers recently read segments of the file,
+ * indexed by their offset, so a backward seek can be served from
+ * memory instead of downloading the same data again.  When the cache
+ * is full, the least recently used segment is discarded.
+ *
+ * This class is not thread-safe.
+ */
+class InputSegmentCache {
+	static constexpr std::size_t SEGMENT_SIZE = 64 * 1024;
+
+	struct Segment {
+		std::unique_ptr<uint8_t[]> data;
+
+		/**
+		 * The number of bytes in #data which are valid.
+		 */
+		std::size_t fill = 0;
+
+		/**
+		 * The value of InputSegmentCache::use_counter when
+		 * this segment was last used.
+		 */
+		mutable unsigned long last_use;
+
+		explicit Segment(unsigned long _last_use)
+			:data(new uint8_t[SEGMENT_SIZE]),
+			 last_use(_last_use) {}
+	};
+
+	/**
+	 * Key is the start offset of the segment.  Segments never
+	 * overlap.
+	 */
+	using SegmentMap = std::map<offset_type, Segment>;
+	SegmentMap segments;
+
+	/**
+	 * All ranges which have ever been passed to Put(), even if
+	 * they have been evicted meanwhile.  Key is the start offset,
+	 * value is the end offset.
+	 *
+	 * This is only used for the statistics.  It is bounded by
+	 * #max_fetched; when it grows larger, neighbouring ranges are
+	 * coalesced, and the gap between them is then considered
+	 * "fetched".
+	 */
+	std::map<offset_type, offset_type> fetched;
+
+	const std::size_t max_segments;
+
+	/**
+	 * The maximum number of items in #fetched.
+	 */
+	const std::size_t max_fetched;
+
+	mutable unsigned long use_counter = 0;
+
+	offset_type served_bytes = 0, refetched_bytes = 0;
+
+public:
+	/**
+	 * @param max_size the maximum number of bytes to be cached;
+	 * zero disables the cache
+	 */
+	explicit InputSegmentCache(std::size_t max_size) noexcept
+		:max_segments(max_size / SEGMENT_SIZE),
+		 max_fetched(2 * max_segments) {}
+
+	bool IsEnabled() const noexcept {
+		return max_segments > 0;
+	}
+
+	/**
+	 * Return the cached data at the given offset (or an empty
+	 * buffer if there is none).  The returned buffer may be
+	 * shorter than the cached range; call this method again with
+	 * the new offset to get more.
+	 */
+	ConstBuffer<uint8_t> Read(offset_type offset) noexcept;
+
+	/**
+	 * Has the given offset been cached?
+	 */
+	gcc_pure
+	bool Contains(offset_type offset) const noexcept;
+
+	/**
+	 * Declare that the given number of bytes returned by Read()
+	 * has been consumed.  This only updates the statistics.
+	 */
+	void Consume(std::size_t nbytes) noexcept {
+		served_bytes += nbytes;
+	}
+
+	/**
+	 * Add data which has been read from the stream.  If memory
+	 * cannot be allocated, the data is not cached (or only
+	 * partially).
+	 */
+	void Put(offset_type offset, const void *data,
+		 std::size_t size) noexcept;
+
+	/**
+	 * The number of bytes which were served from the cache.
+	 */
+	offset_type GetServedBytes() const noexcept {
+		return served_bytes;
+	}
+
+	/**
+	 * The number of bytes which were passed to Put() for a
+	 * second time, i.e. which had to be fetched again because
+	 * they were not in the cache (anymore).
+	 */
+	offset_type GetRefetchedBytes() const noexcept {
+		return refetched_bytes;
+	}
+
+	/**
+	 * The number of disjoint ranges which are remembered for
+	 * GetRefetchedBytes().
+	 */
+	std::size_t GetFetchedRangeCount() const noexcept {
+		return fetched.size();
+	}
+
+private:
+	gcc_pure
+	SegmentMap::const_iterator FindSegment(offset_type offset) const noexcept;
+
+	void EvictLeastRecentlyUsed() noexcept;
+
+	/**
+	 * Throws std::bad_alloc on out-of-memory.
+	 */
+	void MarkFetched(offset_type start, offset_type end);
+
+	/**
+	 * Merge the two neighbouring items of #fetched with the
+	 * smallest gap between them.
+	 */
+	void CoalesceFetched() noexcept;
+};
+
+#endif
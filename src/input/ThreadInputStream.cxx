@@ -18,6 +18,7 @@
  */
 
 #include "ThreadInputStream.hxx"
+#include "AdaptiveBuffer.hxx"
 #include "CondHandler.hxx"
 #include "thread/Name.hxx"
 
@@ -38,6 +39,44 @@ ThreadInputStream::ThreadInputStream(const char *_plugin,
 	allocation.ForkCow(false);
 }
 
+ThreadInputStream::~ThreadInputStream() noexcept
+{
+	/* Stop() must have been called already */
+	assert(!thread.IsDefined());
+}
+
+void
+ThreadInputStream::EnableAdaptiveBuffer(size_t min_size,
+					size_t initial_size) noexcept
+{
+	assert(!thread.IsDefined());
+	assert(buffer.empty());
+
+	adaptive = std::make_unique<AdaptiveBufferSize>(GetURI(),
+							min_size,
+							initial_size,
+							allocation.size());
+	ResizeBuffer();
+}
+
+void
+ThreadInputStream::ResizeBuffer() noexcept
+{
+	assert(adaptive);
+
+	const size_t old_capacity = buffer.GetCapacity();
+	const size_t new_capacity = adaptive->GetSize();
+	if (new_capacity == old_capacity || !buffer.Resize(new_capacity))
+		/* try again later */
+		return;
+
+	if (new_capacity < old_capacity)
+		/* give the unused memory back to the kernel */
+		allocation.DiscardFrom(new_capacity);
+
+	adaptive->SetActualSize(new_capacity);
+}
+
 void
 ThreadInputStream::Stop() noexcept
 {
@@ -84,6 +123,9 @@ ThreadInputStream::ThreadFunc() noexcept
 	while (!close) {
 		assert(!postponed_exception);
 
+		if (adaptive)
+			ResizeBuffer();
+
 		auto w = buffer.Write();
 		if (w.empty()) {
 			wake_cond.wait(lock);
@@ -137,6 +179,7 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 	assert(!thread.IsInside());
 
 	CondInputStreamHandler cond_handler;
+	bool underrun = false;
 
 	while (true) {
 		if (postponed_exception)
@@ -147,6 +190,8 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
 			buffer.Consume(nbytes);
+			if (adaptive)
+				adaptive->OnConsumed(nbytes, buffer.GetSize());
 			wake_cond.notify_all();
 			offset += nbytes;
 			return nbytes;
@@ -155,6 +200,13 @@ ThreadInputStream::Read(std::unique_lock<Mutex> &lock,
 		if (eof)
 			return 0;
 
+		if (adaptive && !underrun && offset > 0) {
+			/* the buffer has run empty: maybe it
+			   needs to be larger */
+			underrun = true;
+			adaptive->OnUnderrun();
+		}
+
 		const ScopeExchangeInputStreamHandler h(*this, &cond_handler);
 		cond_handler.cond.wait(lock);
 	}
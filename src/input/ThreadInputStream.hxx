@@ -29,6 +29,9 @@
 #include <cassert>
 #include <cstdint>
 #include <exception>
+#include <memory>
+
+class AdaptiveBufferSize;
 
 /**
  * Helper class for moving InputStream implementations with blocking
@@ -62,6 +65,14 @@ class ThreadInputStream : public InputStream {
 
 	CircularBuffer<uint8_t> buffer;
 
+	/**
+	 * If set, then the buffer capacity is adjusted dynamically;
+	 * see EnableAdaptiveBuffer().  The new capacity is chosen by
+	 * Read(), but applied by the thread, because only the thread
+	 * knows when it is safe to do so.
+	 */
+	std::unique_ptr<AdaptiveBufferSize> adaptive;
+
 	/**
 	 * Shall the stream be closed?
 	 */
@@ -77,12 +88,7 @@ public:
 			  const char *_uri, Mutex &_mutex,
 			  size_t _buffer_size) noexcept;
 
-#ifndef NDEBUG
-	~ThreadInputStream() override {
-		/* Stop() must have been called already */
-		assert(!thread.IsDefined());
-	}
-#endif
+	~ThreadInputStream() noexcept override;
 
 	/**
 	 * Initialize the object and start the thread.
@@ -103,6 +109,14 @@ protected:
 	 */
 	void Stop() noexcept;
 
+	/**
+	 * Let the buffer capacity follow the consumption rate,
+	 * between the given minimum and the buffer size passed to
+	 * the constructor.  This must be called before Start().
+	 */
+	void EnableAdaptiveBuffer(size_t min_size,
+				  size_t initial_size) noexcept;
+
 	void SetMimeType(const char *_mime) noexcept {
 		assert(thread.IsInside());
 
@@ -151,6 +165,12 @@ protected:
 	virtual void Cancel() noexcept {}
 
 private:
+	/**
+	 * Apply the buffer capacity chosen by #adaptive.  Must be
+	 * called from the thread.
+	 */
+	void ResizeBuffer() noexcept;
+
 	void ThreadFunc() noexcept;
 };
 
@@ -32,4 +32,15 @@ InputCacheConfig::InputCacheConfig(const ConfigBlock &block)
 		size = size_param->With([](const char *s){
 			return ParseSize(s);
 		});
+
+	prefetch_songs = block.GetPositiveValue("prefetch_songs", 1U);
+	prefetch_time = block.GetBlockValue("prefetch_time", 0U);
+	prefetch_threads = block.GetPositiveValue("prefetch_threads", 1U);
+
+	prefetch_rate = 0;
+	const auto *rate_param = block.GetBlockParam("prefetch_rate");
+	if (rate_param != nullptr)
+		prefetch_rate = rate_param->With([](const char *s){
+			return ParseSize(s);
+		});
 }
@@ -27,6 +27,29 @@ struct ConfigBlock;
 struct InputCacheConfig {
 	size_t size;
 
+	/**
+	 * The maximum number of upcoming songs to be prefetched.
+	 */
+	unsigned prefetch_songs;
+
+	/**
+	 * Stop prefetching when the upcoming songs add up to this
+	 * duration (in seconds).  0 means no limit.
+	 */
+	unsigned prefetch_time;
+
+	/**
+	 * The number of worker threads which prefetch songs
+	 * concurrently.
+	 */
+	unsigned prefetch_threads;
+
+	/**
+	 * The maximum transfer rate (bytes per second) of a prefetch
+	 * which is not being played yet.  0 means no limit.
+	 */
+	size_t prefetch_rate;
+
 	explicit InputCacheConfig(const ConfigBlock &block);
 };
 
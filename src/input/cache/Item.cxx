@@ -23,9 +23,11 @@
 
 #include <cassert>
 
-InputCacheItem::InputCacheItem(InputStreamPtr _input) noexcept
+InputCacheItem::InputCacheItem(InputStreamPtr _input,
+			       size_t _prefetch_rate) noexcept
 	:BufferingInputStream(std::move(_input)),
-	 uri(GetInput().GetURI())
+	 uri(GetInput().GetURI()),
+	 prefetch_rate(_prefetch_rate)
 {
 }
 
@@ -60,4 +62,17 @@ InputCacheItem::OnBufferAvailable() noexcept
 		next_lease = std::next(i);
 		i->OnInputCacheAvailable();
 	}
+
+	if (prefetching)
+		prefetch_cond.notify_all();
+}
+
+std::chrono::steady_clock::duration
+InputCacheItem::GetThrottleDelay(size_t nbytes) noexcept
+{
+	if (prefetch_rate == 0 || !IsOnlyPrefetching())
+		return std::chrono::steady_clock::duration::zero();
+
+	const std::chrono::duration<double> delay(double(nbytes) / prefetch_rate);
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay);
 }
@@ -22,6 +22,7 @@
 
 #include "input/BufferingInputStream.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 
 #include <boost/intrusive/list.hpp>
 #include <boost/intrusive/set_hook.hpp>
@@ -52,8 +53,27 @@ class InputCacheItem final
 	LeaseList leases;
 	LeaseList::iterator next_lease = leases.end();
 
+	/**
+	 * The maximum transfer rate (bytes per second) while this
+	 * item is only being prefetched.  0 means no limit.
+	 */
+	const size_t prefetch_rate;
+
+	/**
+	 * Is a prefetch worker holding a lease on this item,
+	 * waiting for it to be filled?  Protected by the mutex.
+	 */
+	bool prefetching = false;
+
+	/**
+	 * Wakes up the prefetch worker when new data arrives or when
+	 * the prefetch gets cancelled.
+	 */
+	Cond prefetch_cond;
+
 public:
-	explicit InputCacheItem(InputStreamPtr _input) noexcept;
+	explicit InputCacheItem(InputStreamPtr _input,
+				size_t _prefetch_rate=0) noexcept;
 	~InputCacheItem() noexcept;
 
 	const char *GetUri() const noexcept {
@@ -70,9 +90,44 @@ public:
 	void AddLease(InputCacheLease &lease) noexcept;
 	void RemoveLease(InputCacheLease &lease) noexcept;
 
+	/**
+	 * Caller locks the mutex.
+	 */
+	void SetPrefetching(bool _prefetching) noexcept {
+		prefetching = _prefetching;
+	}
+
+	/**
+	 * Wait until new data has been added or until
+	 * WakePrefetch() is called.  Caller locks the mutex.
+	 */
+	void WaitPrefetch(std::unique_lock<Mutex> &lock) noexcept {
+		prefetch_cond.wait(lock);
+	}
+
+	/**
+	 * Wake up the prefetch worker waiting in WaitPrefetch(),
+	 * e.g. because the prefetch has been cancelled.
+	 */
+	void WakePrefetch() noexcept {
+		const std::lock_guard<Mutex> lock(mutex);
+		prefetch_cond.notify_all();
+	}
+
 private:
+	/**
+	 * Is this item being read only by the prefetch worker?
+	 * Caller locks the mutex.
+	 */
+	gcc_pure
+	bool IsOnlyPrefetching() const noexcept {
+		return prefetching && !leases.empty() &&
+			std::next(leases.begin()) == leases.end();
+	}
+
 	/* virtual methods from class BufferingInputStream */
 	void OnBufferAvailable() noexcept override;
+	std::chrono::steady_clock::duration GetThrottleDelay(size_t nbytes) noexcept override;
 };
 
 #endif
@@ -23,10 +23,17 @@
 #include "Lease.hxx"
 #include "input/InputStream.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Name.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <string.h>
 
+static constexpr Domain cache_domain("cache");
+
 inline bool
 InputCacheManager::ItemCompare::operator()(const InputCacheItem &a,
 					   const char *b) const noexcept
@@ -49,18 +56,26 @@ InputCacheManager::ItemCompare::operator()(const InputCacheItem &a,
 }
 
 InputCacheManager::InputCacheManager(const InputCacheConfig &config) noexcept
-	:max_total_size(config.size)
+	:max_total_size(config.size),
+	 prefetch_songs(config.prefetch_songs),
+	 prefetch_time(config.prefetch_time),
+	 max_prefetch_threads(config.prefetch_threads),
+	 prefetch_rate(config.prefetch_rate)
 {
 }
 
 InputCacheManager::~InputCacheManager() noexcept
 {
+	StopPrefetchThreads();
+
 	items_by_time.clear_and_dispose(DeleteDisposer());
 }
 
 void
 InputCacheManager::Flush() noexcept
 {
+	const std::lock_guard<Mutex> lock(items_mutex);
+
 	items_by_time.remove_and_dispose_if([](const InputCacheItem &item){
 		return !item.IsInUse();
 	}, [this](InputCacheItem *item){
@@ -91,51 +106,305 @@ InputCacheManager::Contains(const char *uri) noexcept
 }
 
 InputCacheLease
-InputCacheManager::Get(const char *uri, bool create)
+InputCacheManager::Get(const char *uri, bool create, bool prefetch)
 {
 	// TODO: allow caching remote files
 	if (!PathTraitsUTF8::IsAbsolute(uri))
 		return {};
 
-	auto iter = items_by_uri.find(uri, items_by_uri.key_comp());
-	if (iter != items_by_uri.end()) {
-		auto &item = *iter;
+	{
+		const std::lock_guard<Mutex> lock(items_mutex);
+
+		auto iter = items_by_uri.find(uri, items_by_uri.key_comp());
+		if (iter != items_by_uri.end()) {
+			auto &item = *iter;
 
-		/* refresh */
-		items_by_time.erase(items_by_time.iterator_to(item));
-		items_by_time.push_back(item);
+			/* refresh */
+			items_by_time.erase(items_by_time.iterator_to(item));
+			items_by_time.push_back(item);
 
-		// TODO revalidate the cache item using the file's mtime?
-		// TODO if cache item contains error, retry now?
+			// TODO revalidate the cache item using the file's mtime?
+			// TODO if cache item contains error, retry now?
 
-		return InputCacheLease(item);
+			return InputCacheLease(item);
+		}
 	}
 
 	if (!create)
 		return {};
 
-	// TODO: wait for "ready" without blocking here
+	/* open the file without holding the lock, because this may
+	   block for a while (e.g. on network storage) */
 	auto is = InputStream::OpenReady(uri, mutex);
 
 	if (!IsEligible(*is))
 		return {};
 
+	/* copy the prefetch windows before locking items_mutex,
+	   because prefetch_mutex must not be held while item
+	   mutexes are locked */
+	const auto keep = GetPrefetchUris();
+
+	const std::lock_guard<Mutex> lock(items_mutex);
+
+	/* another thread may have added it meanwhile */
+	auto iter = items_by_uri.find(uri, items_by_uri.key_comp());
+	if (iter != items_by_uri.end())
+		return InputCacheLease(*iter);
+
 	const size_t size = is->GetSize();
 	total_size += size;
 
-	while (total_size > max_total_size && EvictOldestUnused()) {}
+	/* evict old items, but keep those which are going to be
+	   played soon */
+	while (total_size > max_total_size && EvictOldestUnused(&keep)) {}
+
+	if (total_size > max_total_size) {
+		if (prefetch) {
+			/* don't evict a song which will be played
+			   earlier than this one */
+			total_size -= size;
+			FormatDebug(cache_domain,
+				    "No room to prefetch '%s'", uri);
+			return {};
+		}
+
+		while (total_size > max_total_size &&
+		       EvictOldestUnused(nullptr)) {}
+	}
 
-	auto *item = new InputCacheItem(std::move(is));
+	auto *item = new InputCacheItem(std::move(is), prefetch_rate);
 	items_by_uri.insert(*item);
 	items_by_time.push_back(*item);
 
 	return InputCacheLease(*item);
 }
 
+bool
+InputCacheManager::IsInPrefetchWindow(const char *uri) const noexcept
+{
+	for (const auto &i : prefetch_windows)
+		if (std::find(i.second.begin(), i.second.end(),
+			      uri) != i.second.end())
+			return true;
+
+	return false;
+}
+
+bool
+InputCacheManager::IsPrefetchWanted(const char *uri) const noexcept
+{
+	const std::lock_guard<Mutex> lock(prefetch_mutex);
+	return !prefetch_stop && IsInPrefetchWindow(uri);
+}
+
+std::vector<std::string>
+InputCacheManager::GetPrefetchUris() const
+{
+	const std::lock_guard<Mutex> lock(prefetch_mutex);
+
+	std::vector<std::string> uris;
+	for (const auto &i : prefetch_windows)
+		uris.insert(uris.end(), i.second.begin(), i.second.end());
+	return uris;
+}
+
+void
+InputCacheManager::SetPrefetchWindow(const std::string &owner,
+				     std::vector<std::string> &&uris)
+{
+	if (uris.empty()) {
+		RemovePrefetchWindow(owner);
+		return;
+	}
+
+	/* this must be done before locking prefetch_mutex, because
+	   Contains() locks the item mutex */
+	std::deque<std::string> missing;
+	for (const auto &uri : uris)
+		if (!Contains(uri.c_str()))
+			missing.emplace_back(uri);
+
+	{
+		const std::lock_guard<Mutex> lock(prefetch_mutex);
+
+		prefetch_windows[owner] = std::move(uris);
+
+		/* enqueue the new window in playback order, followed
+		   by pending prefetches of the other windows; cancel
+		   the ones which are no longer wanted */
+		for (auto &uri : prefetch_queue)
+			if (std::find(missing.begin(), missing.end(),
+				      uri) == missing.end() &&
+			    IsInPrefetchWindow(uri.c_str()))
+				missing.emplace_back(std::move(uri));
+
+		prefetch_queue = std::move(missing);
+
+		if (!prefetch_queue.empty()) {
+			if (prefetch_threads.size() < max_prefetch_threads &&
+			    prefetch_queue.size() > prefetch_threads.size())
+				StartPrefetchThread();
+
+			prefetch_cond.notify_all();
+		}
+	}
+
+	/* wake up workers waiting for an item which may have
+	   dropped out of the window */
+	const std::lock_guard<Mutex> lock(items_mutex);
+	for (auto &item : items_by_time)
+		item.WakePrefetch();
+}
+
+void
+InputCacheManager::RemovePrefetchWindow(const std::string &owner) noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(prefetch_mutex);
+
+		auto i = prefetch_windows.find(owner);
+		if (i == prefetch_windows.end())
+			return;
+
+		prefetch_windows.erase(i);
+
+		/* std::remove_if() doesn't allocate memory */
+		prefetch_queue.erase(std::remove_if(prefetch_queue.begin(),
+						    prefetch_queue.end(),
+						    [this](const std::string &uri){
+							    return !IsInPrefetchWindow(uri.c_str());
+						    }),
+				     prefetch_queue.end());
+	}
+
+	const std::lock_guard<Mutex> lock(items_mutex);
+	for (auto &item : items_by_time)
+		item.WakePrefetch();
+}
+
+void
+InputCacheManager::StartPrefetchThread() noexcept
+{
+	auto &thread = prefetch_threads.emplace_back(BIND_THIS_METHOD(RunPrefetchThread));
+
+	try {
+		thread.Start();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start prefetch thread");
+		prefetch_threads.pop_back();
+	}
+}
+
+void
+InputCacheManager::StopPrefetchThreads() noexcept
+{
+	{
+		const std::lock_guard<Mutex> lock(prefetch_mutex);
+		prefetch_stop = true;
+		prefetch_windows.clear();
+		prefetch_queue.clear();
+		prefetch_cond.notify_all();
+	}
+
+	{
+		const std::lock_guard<Mutex> lock(items_mutex);
+		for (auto &item : items_by_time)
+			item.WakePrefetch();
+	}
+
+	for (auto &thread : prefetch_threads)
+		thread.Join();
+	prefetch_threads.clear();
+}
+
 void
 InputCacheManager::Prefetch(const char *uri)
 {
-	Get(uri, true);
+	FormatDebug(cache_domain, "Prefetch '%s'", uri);
+
+	bool cancelled = false;
+
+	{
+		auto lease = Get(uri, true, true);
+		if (!lease)
+			return;
+
+		std::unique_lock<Mutex> lock(mutex);
+		lease->SetPrefetching(true);
+
+		while (!lease->IsComplete()) {
+			if (!IsPrefetchWanted(uri)) {
+				cancelled = true;
+				break;
+			}
+
+			lease->WaitPrefetch(lock);
+		}
+
+		lease->SetPrefetching(false);
+
+		if (!cancelled)
+			lease->Check();
+	}
+
+	if (cancelled) {
+		/* our lease has been released; the item can be
+		   discarded now unless somebody else uses it */
+		FormatDebug(cache_domain, "Prefetch '%s' cancelled", uri);
+		DiscardIncomplete(uri);
+	}
+}
+
+void
+InputCacheManager::RunPrefetchThread() noexcept
+{
+	SetThreadName("prefetch");
+
+	std::unique_lock<Mutex> lock(prefetch_mutex);
+
+	while (!prefetch_stop) {
+		if (prefetch_queue.empty()) {
+			prefetch_cond.wait(lock);
+			continue;
+		}
+
+		const std::string uri = std::move(prefetch_queue.front());
+		prefetch_queue.pop_front();
+
+		lock.unlock();
+
+		try {
+			Prefetch(uri.c_str());
+		} catch (...) {
+			FormatError(std::current_exception(),
+				    "Prefetch '%s' failed", uri.c_str());
+		}
+
+		lock.lock();
+	}
+}
+
+void
+InputCacheManager::DiscardIncomplete(const char *uri) noexcept
+{
+	const std::lock_guard<Mutex> lock(items_mutex);
+
+	auto iter = items_by_uri.find(uri, items_by_uri.key_comp());
+	if (iter == items_by_uri.end())
+		return;
+
+	auto &item = *iter;
+
+	{
+		const std::lock_guard<Mutex> item_lock(mutex);
+		if (item.IsComplete())
+			return;
+	}
+
+	if (!item.IsInUse())
+		Delete(&item);
 }
 
 void
@@ -156,19 +425,22 @@ InputCacheManager::Delete(InputCacheItem *item) noexcept
 }
 
 InputCacheItem *
-InputCacheManager::FindOldestUnused() noexcept
+InputCacheManager::FindOldestUnused(const std::vector<std::string> *keep) noexcept
 {
 	for (auto &i : items_by_time)
-		if (!i.IsInUse())
+		if (!i.IsInUse() &&
+		    (keep == nullptr ||
+		     std::find(keep->begin(), keep->end(),
+			       i.GetUri()) == keep->end()))
 			return &i;
 
 	return nullptr;
 }
 
 bool
-InputCacheManager::EvictOldestUnused() noexcept
+InputCacheManager::EvictOldestUnused(const std::vector<std::string> *keep) noexcept
 {
-	auto *item = FindOldestUnused();
+	auto *item = FindOldestUnused(keep);
 	if (item == nullptr)
 		return false;
 
@@ -21,11 +21,19 @@
 #define MPD_INPUT_CACHE_MANAGER_HXX
 
 #include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
 #include "util/Compiler.h"
 
 #include <boost/intrusive/set.hpp>
 #include <boost/intrusive/list.hpp>
 
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
 class InputStream;
 class InputCacheItem;
 class InputCacheLease;
@@ -38,8 +46,23 @@ struct InputCacheConfig;
 class InputCacheManager {
 	const size_t max_total_size;
 
+	const unsigned prefetch_songs, prefetch_time;
+	const unsigned max_prefetch_threads;
+	const size_t prefetch_rate;
+
+	/**
+	 * The mutex shared by all #InputCacheItem instances (and
+	 * their #InputStream).
+	 */
 	mutable Mutex mutex;
 
+	/**
+	 * Protects #items_by_time, #items_by_uri and #total_size.
+	 * This may be locked before #mutex, but not the other way
+	 * around.
+	 */
+	mutable Mutex items_mutex;
+
 	size_t total_size = 0;
 
 	struct ItemCompare {
@@ -68,6 +91,40 @@ class InputCacheManager {
 
 	UriMap items_by_uri;
 
+	/**
+	 * Protects #prefetch_windows, #prefetch_queue and
+	 * #prefetch_stop.  This may be locked while holding #mutex,
+	 * but neither #mutex nor #items_mutex may be locked while
+	 * holding this one.
+	 */
+	mutable Mutex prefetch_mutex;
+
+	/**
+	 * Wakes up idle prefetch worker threads.
+	 */
+	Cond prefetch_cond;
+
+	/**
+	 * The URIs which shall be in the cache, as submitted by the
+	 * last SetPrefetchWindow() call of each owner (i.e. each
+	 * partition).
+	 */
+	std::map<std::string, std::vector<std::string>> prefetch_windows;
+
+	/**
+	 * URIs from #prefetch_windows which have not yet been picked
+	 * up by a worker thread.
+	 */
+	std::deque<std::string> prefetch_queue;
+
+	/**
+	 * The worker threads; they are launched on demand, up to
+	 * #max_prefetch_threads.
+	 */
+	std::list<Thread> prefetch_threads;
+
+	bool prefetch_stop = false;
+
 public:
 	explicit InputCacheManager(const InputCacheConfig &config) noexcept;
 	~InputCacheManager() noexcept;
@@ -82,18 +139,80 @@ public:
 	 *
 	 * @param create if true, then the cache item will be created
 	 * if it did not exist
+	 * @param prefetch if true, then items in a prefetch window
+	 * are never evicted to make room for the new item; if there
+	 * is not enough room without that, no item is created
 	 * @return a lease of the new item or nullptr if the file is
 	 * not eligible for caching
 	 */
-	InputCacheLease Get(const char *uri, bool create);
+	InputCacheLease Get(const char *uri, bool create,
+			    bool prefetch=false);
+
+	unsigned GetPrefetchSongs() const noexcept {
+		return prefetch_songs;
+	}
 
 	/**
-	 * Shortcut for "Get(uri,true)", discarding the returned
-	 * lease.
+	 * @return the maximum total duration of songs to be
+	 * prefetched in seconds (0 means no limit)
 	 */
-	void Prefetch(const char *uri);
+	unsigned GetPrefetchTime() const noexcept {
+		return prefetch_time;
+	}
+
+	/**
+	 * Replace the list of URIs which shall be prefetched for the
+	 * given owner (e.g. a partition name), in the order they are
+	 * going to be played.  They will be loaded asynchronously by
+	 * worker threads.  Pending and running prefetches which are
+	 * no longer in any owner's list are cancelled.  An empty
+	 * list removes the owner's window.
+	 *
+	 * Throws on error (e.g. std::bad_alloc).
+	 */
+	void SetPrefetchWindow(const std::string &owner,
+			       std::vector<std::string> &&uris);
+
+	/**
+	 * Remove the given owner's prefetch window, cancelling its
+	 * pending and running prefetches.
+	 */
+	void RemovePrefetchWindow(const std::string &owner) noexcept;
 
 private:
+	/**
+	 * Is the given URI in one of the #prefetch_windows?  Caller
+	 * must lock #prefetch_mutex.
+	 */
+	gcc_pure
+	bool IsInPrefetchWindow(const char *uri) const noexcept;
+
+	gcc_pure
+	bool IsPrefetchWanted(const char *uri) const noexcept;
+
+	/**
+	 * Returns a copy of all URIs in the #prefetch_windows.
+	 * Caller must not lock #prefetch_mutex.
+	 */
+	std::vector<std::string> GetPrefetchUris() const;
+
+	void StartPrefetchThread() noexcept;
+	void StopPrefetchThreads() noexcept;
+
+	/**
+	 * Load the given URI into the cache and wait until it has
+	 * been read completely or until it is no longer wanted.
+	 */
+	void Prefetch(const char *uri);
+
+	void RunPrefetchThread() noexcept;
+
+	/**
+	 * Delete the given item if it is not in use and has not
+	 * been read completely, to stop a cancelled prefetch.
+	 */
+	void DiscardIncomplete(const char *uri) noexcept;
+
 	/**
 	 * Check whether the given #InputStream can be stored in this
 	 * cache.
@@ -103,13 +222,20 @@ private:
 	void Remove(InputCacheItem &item) noexcept;
 	void Delete(InputCacheItem *item) noexcept;
 
-	InputCacheItem *FindOldestUnused() noexcept;
+	/**
+	 * Caller must lock #items_mutex.
+	 *
+	 * @param keep if not nullptr, then items whose URI is in
+	 * this list (a copy of the prefetch windows obtained with
+	 * GetPrefetchUris()) are skipped
+	 */
+	InputCacheItem *FindOldestUnused(const std::vector<std::string> *keep) noexcept;
 
 	/**
 	 * @return true if one item has been evicted, false if no
 	 * unused item was found
 	 */
-	bool EvictOldestUnused() noexcept;
+	bool EvictOldestUnused(const std::vector<std::string> *keep) noexcept;
 };
 
 #endif
@@ -58,16 +58,44 @@
 #include <curl/curl.h>
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
+ * Do not buffer more than this number of bytes.  The buffer grows
+ * up to this size only for high bitrates and unreliable connections;
+ * see #AdaptiveBufferSize.
+ */
+static const size_t CURL_MAX_BUFFERED = 8 * 1024 * 1024;
+
+/**
+ * Resume the stream at this number of bytes after it has been paused
+ * (for a buffer of #CURL_MAX_BUFFERED bytes; this is scaled to the
+ * current buffer size).
+ */
+static const size_t CURL_RESUME_AT = 6 * 1024 * 1024;
+
+/**
+ * The initial buffer size, until the bitrate is known.  It should be
+ * a reasonable limit that doesn't make low-end machines suffer too
  * much, but doesn't cause stuttering on high-latency lines.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+static const size_t CURL_INITIAL_BUFFERED = 512 * 1024;
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * The buffer never shrinks below this size.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+static const size_t CURL_MIN_BUFFERED = 64 * 1024;
+
+/**
+ * Keep up to this number of bytes which were already read, to be
+ * able to serve backward seeks without downloading them again.
+ */
+static const size_t CURL_SEEK_CACHE_SIZE = 2 * 1024 * 1024;
+
+/**
+ * Forward seeks by up to this number of bytes beyond the buffer are
+ * implemented by discarding data from the running response instead
+ * of sending a new request (which may need a new connection and
+ * costs at least one round trip).
+ */
+static constexpr offset_type CURL_MAX_SEEK_SKIP = 1024 * 1024;
 
 class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 	/* some buffers which were passed to libcurl, which we have
@@ -76,6 +104,23 @@ class CurlInputStream final : public AsyncInputStream, CurlResponseHandler {
 
 	CurlRequest *request = nullptr;
 
+	/**
+	 * The file offset of the next byte which will be received
+	 * from the current #request.
+	 */
+	offset_type request_offset = 0;
+
+	/**
+	 * The number of bytes to be discarded from the current
+	 * response to complete a forward seek.
+	 */
+	offset_type skip = 0;
+
+	/**
+	 * Has the current #request finished (successfully or not)?
+	 */
+	bool request_finished = false;
+
 	/** parser for icy-metadata */
 	std::shared_ptr<IcyMetaDataParser> icy;
 
@@ -304,22 +349,48 @@ CurlInputStream::OnData(ConstBuffer<void> data)
 
 	const std::lock_guard<Mutex> protect(mutex);
 
+	auto src = ConstBuffer<uint8_t>::FromVoid(data);
+
+	if (skip >= src.size) {
+		/* discard data to complete a coalesced forward
+		   seek */
+		skip -= src.size;
+		request_offset += src.size;
+		return;
+	}
+
+	const size_t skip_now = skip;
+
 	if (IsSeekPending())
 		SeekDone();
 
-	if (data.size > GetBufferSpace()) {
+	if (src.size - skip_now > GetBufferSpace()) {
+		/* libcurl will deliver this chunk again after
+		   resuming, therefore we don't consume the skipped
+		   part yet */
 		AsyncInputStream::Pause();
 		throw CurlRequest::Pause();
 	}
 
-	AppendToBuffer(data.data, data.size);
+	skip = 0;
+	request_offset += src.size;
+	src.skip_front(skip_now);
+
+	AppendToBuffer(src.data, src.size);
 }
 
 void
 CurlInputStream::OnEnd()
 {
 	const std::lock_guard<Mutex> protect(mutex);
-	InvokeOnAvailable();
+	request_finished = true;
+
+	if (IsSeekPending())
+		/* the response ended before a coalesced forward seek
+		   was completed */
+		SeekDone();
+	else
+		InvokeOnAvailable();
 
 	AsyncInputStream::SetClosed();
 }
@@ -328,6 +399,7 @@ void
 CurlInputStream::OnError(std::exception_ptr e) noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
+	request_finished = true;
 	postponed_exception = std::move(e);
 
 	if (IsSeekPending())
@@ -390,9 +462,12 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, const char *_url,
 				 Mutex &_mutex)
 	:AsyncInputStream(event_loop, _url, _mutex,
 			  CURL_MAX_BUFFERED,
-			  CURL_RESUME_AT),
+			  CURL_RESUME_AT,
+			  CURL_SEEK_CACHE_SIZE),
 	 icy(std::forward<I>(_icy))
 {
+	EnableAdaptiveBuffer(CURL_MIN_BUFFERED, CURL_INITIAL_BUFFERED);
+
 	request_headers.Append("Icy-Metadata: 1");
 
 	for (const auto &i : headers)
@@ -402,12 +477,22 @@ CurlInputStream::CurlInputStream(EventLoop &event_loop, const char *_url,
 CurlInputStream::~CurlInputStream() noexcept
 {
 	FreeEasyIndirect();
+
+	const auto served = GetCacheServedBytes();
+	const auto refetched = GetCacheRefetchedBytes();
+	if (served > 0 || refetched > 0)
+		FormatDebug(curl_domain,
+			    "seek cache served %" PRIoffset " bytes, "
+			    "%" PRIoffset " bytes were fetched again",
+			    served, refetched);
 }
 
 void
 CurlInputStream::InitEasy()
 {
 	request = new CurlRequest(**curl_init, GetURI(), *this);
+	request_finished = false;
+	skip = 0;
 
 	request->SetOption(CURLOPT_HTTP200ALIASES, http_200_aliases);
 	request->SetOption(CURLOPT_FOLLOWLOCATION, 1L);
@@ -439,7 +524,26 @@ CurlInputStream::StartRequest()
 void
 CurlInputStream::SeekInternal(offset_type new_offset)
 {
-	/* close the old connection and open a new one */
+	if (request != nullptr && !request_finished &&
+	    (!KnownSize() || new_offset < size) &&
+	    new_offset >= request_offset &&
+	    new_offset - request_offset <= CURL_MAX_SEEK_SKIP) {
+		/* a short forward seek: keep the running response
+		   and discard everything up to the new offset */
+		offset = new_offset;
+		skip = new_offset - request_offset;
+		if (skip == 0)
+			SeekDone();
+
+		/* AsyncInputStream::DeferredSeek() has cleared the
+		   "paused" flag, so make sure libcurl continues to
+		   deliver data */
+		request->Resume();
+		return;
+	}
+
+	/* abort the old request and send a new one; libcurl will
+	   reuse the connection if possible */
 
 	FreeEasy();
 
@@ -453,6 +557,7 @@ CurlInputStream::SeekInternal(offset_type new_offset)
 	}
 
 	InitEasy();
+	request_offset = offset;
 
 	/* send the "Range" header */
 
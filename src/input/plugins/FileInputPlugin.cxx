@@ -25,8 +25,24 @@
 #include "io/FileDescriptor.hxx"
 #include "util/RuntimeError.hxx"
 
+#include <algorithm>
+#include <cstdint>
+
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+
+static bool file_input_mmap = false;
 
 class FileInputStream final : public InputStream {
 	FileReader reader;
@@ -53,6 +69,243 @@ public:
 		  offset_type offset) override;
 };
 
+#ifndef _WIN32
+
+/**
+ * Ask the kernel to read this number of bytes ahead of the current
+ * offset.
+ */
+static constexpr offset_type MMAP_READ_AHEAD = 4 * 1024 * 1024;
+
+/**
+ * Keep this number of bytes behind the current offset mapped, for
+ * short backward seeks.  Everything before that is unmapped with
+ * MADV_DONTNEED (the data stays in the page cache).
+ */
+static constexpr offset_type MMAP_KEEP_BEHIND = 1024 * 1024;
+
+/**
+ * Update the madvise() hints each time the offset has moved by this
+ * number of bytes.
+ */
+static constexpr offset_type MMAP_ADVISE_STEP = 1024 * 1024;
+
+/**
+ * An #InputStream implementation which maps the whole file into
+ * memory.  Read() is a plain memcpy() from the page cache, and
+ * Peek() gives the caller direct access to the mapping.
+ */
+class MmapFileInputStream final : public InputStream {
+	const uint8_t *const data;
+
+	/**
+	 * The offset at which UpdateAdvice() was last called.
+	 */
+	offset_type advised_offset = 0;
+
+	/**
+	 * Everything before this (page-aligned) offset has been
+	 * discarded with MADV_DONTNEED.
+	 */
+	offset_type discarded = 0;
+
+public:
+	MmapFileInputStream(const char *path, const void *_data,
+			    size_t _size, Mutex &_mutex) noexcept
+		:InputStream(path, _mutex),
+		 data((const uint8_t *)_data) {
+		size = _size;
+		seekable = true;
+		SetReady();
+
+#ifdef MADV_SEQUENTIAL
+		madvise(const_cast<uint8_t *>(data), size, MADV_SEQUENTIAL);
+#endif
+		UpdateAdvice();
+	}
+
+	~MmapFileInputStream() noexcept override {
+		munmap(const_cast<uint8_t *>(data), size);
+	}
+
+	/* virtual methods from InputStream */
+
+	[[nodiscard]] bool IsEOF() const noexcept override {
+		return GetOffset() >= GetSize();
+	}
+
+	size_t Read(std::unique_lock<Mutex> &lock,
+		    void *ptr, size_t size) override;
+	void Seek(std::unique_lock<Mutex> &lock,
+		  offset_type offset) override;
+	ConstBuffer<void> Peek(std::unique_lock<Mutex> &lock) noexcept override;
+
+private:
+	/**
+	 * Give the kernel hints about which pages will be needed
+	 * soon and which are not needed anymore.
+	 */
+	void UpdateAdvice() noexcept;
+
+	void MaybeUpdateAdvice() noexcept {
+		if (offset < advised_offset ||
+		    offset >= advised_offset + MMAP_ADVISE_STEP)
+			UpdateAdvice();
+	}
+};
+
+gcc_pure
+static offset_type
+PageFloor(offset_type offset) noexcept
+{
+	static const long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		return offset;
+
+	return offset / page_size * page_size;
+}
+
+void
+MmapFileInputStream::UpdateAdvice() noexcept
+{
+	advised_offset = offset;
+
+	if (offset >= size)
+		return;
+
+	const offset_type start = PageFloor(offset);
+
+#ifdef MADV_WILLNEED
+	const offset_type end = std::min(offset + MMAP_READ_AHEAD, size);
+	madvise(const_cast<uint8_t *>(data + start), end - start,
+		MADV_WILLNEED);
+#endif
+
+	if (start < discarded)
+		/* after a backward seek: these pages will be faulted
+		   in again */
+		discarded = start;
+
+#ifdef MADV_DONTNEED
+	if (offset > MMAP_KEEP_BEHIND) {
+		const offset_type behind = PageFloor(offset - MMAP_KEEP_BEHIND);
+		if (behind > discarded) {
+			madvise(const_cast<uint8_t *>(data + discarded),
+				behind - discarded, MADV_DONTNEED);
+			discarded = behind;
+		}
+	}
+#endif
+}
+
+void
+MmapFileInputStream::Seek(std::unique_lock<Mutex> &,
+			  offset_type new_offset)
+{
+	offset = new_offset;
+	MaybeUpdateAdvice();
+}
+
+size_t
+MmapFileInputStream::Read(std::unique_lock<Mutex> &,
+			  void *ptr, size_t read_size)
+{
+	if (offset >= size)
+		return 0;
+
+	const size_t nbytes = std::min<offset_type>(read_size, size - offset);
+
+	{
+		/* copying may block on disk I/O (page faults) */
+		const ScopeUnlock unlock(mutex);
+		memcpy(ptr, data + offset, nbytes);
+	}
+
+	offset += nbytes;
+	MaybeUpdateAdvice();
+	return nbytes;
+}
+
+ConstBuffer<void>
+MmapFileInputStream::Peek(std::unique_lock<Mutex> &) noexcept
+{
+	if (offset >= size)
+		return nullptr;
+
+	return {data + offset, size_t(size - offset)};
+}
+
+/**
+ * Is it impossible that the file gets truncated while it is mapped?
+ * Accessing a page beyond the end of a truncated file raises
+ * SIGBUS, which would kill MPD.
+ */
+static bool
+CannotShrink(FileDescriptor fd) noexcept
+{
+#ifdef F_GET_SEALS
+	const int seals = fcntl(fd.Get(), F_GET_SEALS);
+	if (seals >= 0 && (seals & F_SEAL_SHRINK) != 0)
+		return true;
+#endif
+
+	struct statvfs vfs;
+	if (fstatvfs(fd.Get(), &vfs) < 0 || (vfs.f_flag & ST_RDONLY) == 0)
+		return false;
+
+#ifdef __linux__
+	/* a read-only mount of a network or FUSE filesystem doesn't
+	   prevent the server from truncating the file */
+	struct statfs fs;
+	if (fstatfs(fd.Get(), &fs) < 0)
+		return false;
+
+	switch ((unsigned long)fs.f_type) {
+	case 0x6969: /* NFS_SUPER_MAGIC */
+	case 0x517b: /* SMB_SUPER_MAGIC */
+	case 0xff534d42: /* CIFS_SUPER_MAGIC */
+	case 0xfe534d42: /* SMB2_SUPER_MAGIC */
+	case 0x65735546: /* FUSE_SUPER_MAGIC */
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+/**
+ * Attempt to map the file into memory.
+ *
+ * @return nullptr if that is not possible (the caller shall fall
+ * back to #FileInputStream)
+ */
+static InputStreamPtr
+OpenMmapFileInputStream(const char *path, FileDescriptor fd,
+			offset_type size, Mutex &mutex) noexcept
+{
+	if (size == 0 || size > SIZE_MAX / 2)
+		/* empty files cannot be mapped, and very large files
+		   may not fit into the address space */
+		return nullptr;
+
+	if (!CannotShrink(fd))
+		return nullptr;
+
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.Get(), 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+	return std::make_unique<MmapFileInputStream>(path, p, size, mutex);
+}
+
+#endif
+
+void
+SetFileInputMmap(bool enable) noexcept
+{
+	file_input_mmap = enable;
+}
+
 InputStreamPtr
 OpenFileInputStream(Path path, Mutex &mutex)
 {
@@ -69,6 +322,18 @@ OpenFileInputStream(Path path, Mutex &mutex)
 		      POSIX_FADV_SEQUENTIAL);
 #endif
 
+#ifndef _WIN32
+	if (file_input_mmap) {
+		/* the mapping remains valid after the file descriptor
+		   has been closed */
+		auto is = OpenMmapFileInputStream(path.ToUTF8Throw().c_str(),
+						  reader.GetFD(),
+						  info.GetSize(), mutex);
+		if (is)
+			return is;
+	}
+#endif
+
 	return std::make_unique<FileInputStream>(path.ToUTF8Throw().c_str(),
 						 std::move(reader), info.GetSize(),
 						 mutex);
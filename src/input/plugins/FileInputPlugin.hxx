@@ -25,6 +25,13 @@
 
 class Path;
 
+/**
+ * Shall local files be mapped into memory instead of being read
+ * with read()?
+ */
+void
+SetFileInputMmap(bool enable) noexcept;
+
 InputStreamPtr
 OpenFileInputStream(Path path, Mutex &mutex);
 
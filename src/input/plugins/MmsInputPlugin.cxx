@@ -26,7 +26,9 @@
 
 #include <stdexcept>
 
-static constexpr size_t MMS_BUFFER_SIZE = 256 * 1024;
+static constexpr size_t MMS_BUFFER_SIZE = 2 * 1024 * 1024;
+static constexpr size_t MMS_INITIAL_BUFFER_SIZE = 256 * 1024;
+static constexpr size_t MMS_MIN_BUFFER_SIZE = 64 * 1024;
 
 class MmsInputStream final : public ThreadInputStream {
 	mmsx_t *mms;
@@ -35,6 +37,8 @@ public:
 	MmsInputStream(const char *_uri, Mutex &_mutex)
 		:ThreadInputStream(input_plugin_mms.name, _uri, _mutex,
 				   MMS_BUFFER_SIZE) {
+		EnableAdaptiveBuffer(MMS_MIN_BUFFER_SIZE,
+				     MMS_INITIAL_BUFFER_SIZE);
 	}
 
 	~MmsInputStream() noexcept override {
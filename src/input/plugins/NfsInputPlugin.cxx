@@ -35,6 +35,12 @@ static const size_t NFS_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t NFS_RESUME_AT = 384 * 1024;
 
+/**
+ * Keep up to this number of bytes which were already read, to be
+ * able to serve backward seeks without reading them again.
+ */
+static const size_t NFS_SEEK_CACHE_SIZE = 1024 * 1024;
+
 class NfsInputStream final : NfsFileReader, public AsyncInputStream {
 	uint64_t next_offset;
 
@@ -45,7 +51,8 @@ public:
 		:AsyncInputStream(NfsFileReader::GetEventLoop(),
 				  _uri, _mutex,
 				  NFS_MAX_BUFFERED,
-				  NFS_RESUME_AT) {}
+				  NFS_RESUME_AT,
+				  NFS_SEEK_CACHE_SIZE) {}
 
 	~NfsInputStream() override {
 		DeferClose();
@@ -96,6 +96,17 @@ public:
 			throw std::runtime_error(curl_easy_strerror(code));
 	}
 
+	/**
+	 * Like SetOption(), but ignore errors, e.g. if the option is
+	 * not supported by this libcurl build.
+	 *
+	 * @return true on success
+	 */
+	template<typename T>
+	bool TrySetOption(CURLoption option, T value) noexcept {
+		return curl_easy_setopt(handle, option, value) == CURLE_OK;
+	}
+
 	void SetPrivate(void *pointer) {
 		SetOption(CURLOPT_PRIVATE, pointer);
 	}
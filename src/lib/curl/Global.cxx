@@ -105,6 +105,18 @@ CurlGlobal::CurlGlobal(EventLoop &_loop)
 
 	multi.SetOption(CURLMOPT_TIMERFUNCTION, TimerFunction);
 	multi.SetOption(CURLMOPT_TIMERDATA, this);
+
+#ifdef CURLPIPE_MULTIPLEX
+	/* multiplex requests to the same server over one HTTP/2
+	   connection; this way, seeking (which aborts one request
+	   and starts another one) doesn't need a new TCP/TLS
+	   handshake */
+	multi.SetOption(CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+	/* keep more idle connections around for reuse, e.g. for
+	   album playback from several servers at a time */
+	multi.SetOption(CURLMOPT_MAXCONNECTS, 16L);
 }
 
 int
@@ -65,6 +65,23 @@ CurlRequest::CurlRequest(CurlGlobal &_global,
 	easy.SetNoSignal();
 	easy.SetConnectTimeout(10);
 	easy.SetOption(CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	/* use HTTP/2 for https:// if the server supports it */
+	easy.TrySetOption(CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	/* prefer waiting for an existing connection (to be
+	   multiplexed) over opening a new one */
+	easy.TrySetOption(CURLOPT_PIPEWAIT, 1L);
+#endif
+
+	/* keep idle connections alive between two songs or between
+	   two seeks */
+	easy.TrySetOption(CURLOPT_TCP_KEEPALIVE, 1L);
+	easy.TrySetOption(CURLOPT_TCP_KEEPIDLE, 60L);
+	easy.TrySetOption(CURLOPT_TCP_KEEPINTVL, 30L);
 }
 
 CurlRequest::~CurlRequest() noexcept
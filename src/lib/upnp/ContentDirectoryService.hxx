@@ -112,6 +112,14 @@ public:
 	 */
 	std::forward_list<std::string> getSearchCapabilities(UpnpClient_Handle handle) const;
 
+	/**
+	 * Retrieve the "SystemUpdateID", which is incremented by
+	 * the server whenever its content changes.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	unsigned getSystemUpdateID(UpnpClient_Handle handle) const;
+
 	gcc_pure
 	std::string GetURI() const noexcept {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
@@ -19,6 +19,8 @@
 
 #include "ConfiguredResampler.hxx"
 #include "FallbackResampler.hxx"
+#include "PolyphaseResampler.hxx"
+#include "SplitResampler.hxx"
 #include "config/Data.hxx"
 #include "config/Option.hxx"
 #include "config/Block.hxx"
@@ -34,12 +36,15 @@
 #include "SoxrResampler.hxx"
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <thread>
 
 #include <string.h>
 
 enum class SelectedResampler {
 	FALLBACK,
+	POLYPHASE,
 
 #ifdef ENABLE_LIBSAMPLERATE
 	LIBSAMPLERATE,
@@ -52,6 +57,12 @@ enum class SelectedResampler {
 
 static SelectedResampler selected_resampler = SelectedResampler::FALLBACK;
 
+/**
+ * The number of threads for resampling, see #SplitPcmResampler.
+ * libsoxr implements multi-threading on its own.
+ */
+static unsigned resampler_threads = 1;
+
 static const ConfigBlock *
 MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
 {
@@ -62,7 +73,7 @@ MakeResamplerDefaultConfig(ConfigBlock &block) noexcept
 #elif defined(ENABLE_SOXR)
 	block.AddBlockParam("plugin", "soxr");
 #else
-	block.AddBlockParam("plugin", "internal");
+	block.AddBlockParam("plugin", "polyphase");
 #endif
 	return &block;
 }
@@ -142,6 +153,9 @@ pcm_resampler_global_init(const ConfigData &config)
 
 	if (strcmp(plugin_name, "internal") == 0) {
 		selected_resampler = SelectedResampler::FALLBACK;
+	} else if (strcmp(plugin_name, "polyphase") == 0) {
+		selected_resampler = SelectedResampler::POLYPHASE;
+		pcm_resample_polyphase_global_init(*block);
 #ifdef ENABLE_SOXR
 	} else if (strcmp(plugin_name, "soxr") == 0) {
 		selected_resampler = SelectedResampler::SOXR;
@@ -156,15 +170,28 @@ pcm_resampler_global_init(const ConfigData &config)
 		throw FormatRuntimeError("No such resampler plugin: %s",
 					 plugin_name);
 	}
+
+#ifdef ENABLE_SOXR
+	if (selected_resampler != SelectedResampler::SOXR)
+#endif
+	{
+		resampler_threads = block->GetBlockValue("threads", 1U);
+		if (resampler_threads == 0)
+			resampler_threads =
+				std::max(std::thread::hardware_concurrency(), 1U);
+	}
 }
 
-PcmResampler *
-pcm_resampler_create()
+static PcmResampler *
+CreatePluginResampler()
 {
 	switch (selected_resampler) {
 	case SelectedResampler::FALLBACK:
 		return new FallbackPcmResampler();
 
+	case SelectedResampler::POLYPHASE:
+		return new PolyphasePcmResampler();
+
 #ifdef ENABLE_LIBSAMPLERATE
 	case SelectedResampler::LIBSAMPLERATE:
 		return new LibsampleratePcmResampler();
@@ -178,3 +205,13 @@ pcm_resampler_create()
 
 	gcc_unreachable();
 }
+
+PcmResampler *
+pcm_resampler_create()
+{
+	if (resampler_threads > 1)
+		return new SplitPcmResampler(CreatePluginResampler,
+					     resampler_threads);
+
+	return CreatePluginResampler();
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PCM_DOT_PRODUCT_HXX
+#define MPD_PCM_DOT_PRODUCT_HXX
+
+#include "util/Compiler.h"
+
+#include <cstddef>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/**
+ * The number of elements processed by one iteration of
+ * PcmDotProduct(); the length must be a multiple of this.
+ */
+static constexpr std::size_t PCM_DOT_PRODUCT_BLOCK = 8;
+
+/**
+ * Calculate the dot product of two float vectors.  This is the inner
+ * loop of FIR filters.  It uses AVX, SSE or NEON if the compiler
+ * targets it, and a generic implementation (which compilers can
+ * vectorize because each lane is independent) otherwise.
+ *
+ * @param n the number of elements; must be a multiple of
+ * #PCM_DOT_PRODUCT_BLOCK
+ */
+gcc_pure
+static inline float
+PcmDotProduct(const float *a, const float *b, std::size_t n) noexcept
+{
+#if defined(__AVX__)
+	__m256 sum = _mm256_setzero_ps();
+	for (std::size_t i = 0; i < n; i += 8) {
+#ifdef __FMA__
+		sum = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),
+				      _mm256_loadu_ps(b + i), sum);
+#else
+		sum = _mm256_add_ps(sum,
+				    _mm256_mul_ps(_mm256_loadu_ps(a + i),
+						  _mm256_loadu_ps(b + i)));
+#endif
+	}
+
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(sum),
+			      _mm256_extractf128_ps(sum, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+#elif defined(__SSE__)
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	for (std::size_t i = 0; i < n; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i),
+						   _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+						   _mm_loadu_ps(b + i + 4)));
+	}
+
+	__m128 s = _mm_add_ps(sum0, sum1);
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+	for (std::size_t i = 0; i < n; i += 8) {
+		sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+		sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4),
+				 vld1q_f32(b + i + 4));
+	}
+
+	const float32x4_t s = vaddq_f32(sum0, sum1);
+	const float32x2_t s2 = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+	return vget_lane_f32(vpadd_f32(s2, s2), 0);
+#else
+	float sum[PCM_DOT_PRODUCT_BLOCK]{};
+	for (std::size_t i = 0; i < n; i += PCM_DOT_PRODUCT_BLOCK)
+		for (std::size_t j = 0; j < PCM_DOT_PRODUCT_BLOCK; ++j)
+			sum[j] += a[i + j] * b[i + j];
+
+	float result = 0;
+	for (const float j : sum)
+		result += j;
+	return result;
+#endif
+}
+
+#endif
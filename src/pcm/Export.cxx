@@ -19,12 +19,12 @@
 
 #include "Export.hxx"
 #include "Order.hxx"
-#include "Pack.hxx"
 #include "Silence.hxx"
 #include "util/ByteReverse.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/WritableBuffer.hxx"
 
+#include <algorithm>
 #include <cassert>
 
 #include <string.h>
@@ -93,6 +93,29 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 			reverse_endian = sample_size;
 	}
 
+	export_words = nullptr;
+	if (sample_format == SampleFormat::S24_P32 ||
+	    sample_format == SampleFormat::S32) {
+		const bool reverse = reverse_endian > 0;
+		PcmWordExport mode;
+
+		if (pack24)
+			mode = reverse
+				? PcmWordExport::PACK24_REVERSE
+				: PcmWordExport::PACK24;
+		else if (shift8)
+			mode = reverse
+				? PcmWordExport::SHIFT8_REVERSE
+				: PcmWordExport::SHIFT8;
+		else
+			mode = PcmWordExport::REVERSE;
+
+		if (pack24 || shift8 || reverse) {
+			export_words = PcmSelectWordExport(mode);
+			export_word_size = PcmWordExportSize(mode);
+		}
+	}
+
 	/* prepare a moment of silence for GetSilence() */
 	char buffer[sizeof(silence_buffer)];
 	const size_t buffer_size = GetInputBlockSize();
@@ -263,6 +286,52 @@ PcmExport::Params::CalcInputSampleRate(unsigned sample_rate) const noexcept
 	return sample_rate;
 }
 
+#ifdef ENABLE_DSD
+
+/**
+ * The number of DSD bytes converted at a time by
+ * PcmExport::ExportDsdWords().
+ */
+static constexpr size_t DSD_EXPORT_CHUNK = 4096;
+
+template<typename C>
+ConstBuffer<void>
+PcmExport::ExportDsdWords(C &converter, ConstBuffer<void> _src) noexcept
+{
+	assert(export_words != nullptr);
+
+	auto src = ConstBuffer<uint8_t>::FromVoid(_src);
+
+	const size_t input_block_size = converter.GetInputBlockSize();
+	const size_t output_block_size = converter.GetOutputBlockSize();
+
+	/* worst case: the rest buffer of the converter completes
+	   one more block */
+	const size_t max_words = (src.size / input_block_size + 1)
+		* output_block_size / sizeof(uint32_t);
+
+	auto *const dest0 = (uint8_t *)
+		pack_buffer.Get(max_words * export_word_size);
+	auto *dest = dest0;
+
+	const size_t chunk_size =
+		std::max<size_t>(DSD_EXPORT_CHUNK / input_block_size, 1)
+		* input_block_size;
+
+	while (!src.empty()) {
+		const size_t n = std::min(src.size, chunk_size);
+		const auto words = converter.Convert({src.data, n});
+		src.skip_front(n);
+
+		export_words(dest, words.data, words.size);
+		dest += words.size * export_word_size;
+	}
+
+	return {dest0, size_t(dest - dest0)};
+}
+
+#endif
+
 ConstBuffer<void>
 PcmExport::Export(ConstBuffer<void> data) noexcept
 {
@@ -281,36 +350,32 @@ PcmExport::Export(ConstBuffer<void> data) noexcept
 		break;
 
 	case DsdMode::U32:
+		if (export_words != nullptr)
+			return ExportDsdWords(dsd32_converter, data);
+
 		data = dsd32_converter.Convert(ConstBuffer<uint8_t>::FromVoid(data))
 			.ToVoid();
 		break;
 
 	case DsdMode::DOP:
+		if (export_words != nullptr)
+			return ExportDsdWords(dop_converter, data);
+
 		data = dop_converter.Convert(ConstBuffer<uint8_t>::FromVoid(data))
 			.ToVoid();
 		break;
 	}
 #endif
 
-	if (pack24) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-		const size_t num_samples = src.size;
-		const size_t dest_size = num_samples * 3;
+	if (export_words != nullptr) {
+		/* shift8, pack24 and reverse_endian in one pass */
+		const auto src = ConstBuffer<uint32_t>::FromVoid(data);
+		const size_t dest_size = src.size * export_word_size;
 		auto *dest = (uint8_t *)pack_buffer.Get(dest_size);
 		assert(dest != nullptr);
 
-		pcm_pack_24(dest, src.begin(), src.end());
-
-		data.data = dest;
-		data.size = dest_size;
-	} else if (shift8) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-
-		auto *dest = (uint32_t *)pack_buffer.Get(data.size);
-		data.data = dest;
-
-		for (auto i : src)
-			*dest++ = i << 8;
+		export_words(dest, src.data, src.size);
+		return {dest, dest_size};
 	}
 
 	if (reverse_endian > 0) {
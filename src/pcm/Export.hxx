@@ -22,6 +22,7 @@
 
 #include "SampleFormat.hxx"
 #include "Buffer.hxx"
+#include "ExportWords.hxx"
 #include "config.h"
 
 #ifdef ENABLE_DSD
@@ -65,7 +66,8 @@ class PcmExport {
 #endif
 
 	/**
-	 * The buffer is used to pack samples, removing padding.
+	 * The buffer is used to pack samples, removing padding, and
+	 * for the output of #export_words.
 	 *
 	 * @see #pack24
 	 */
@@ -143,6 +145,20 @@ private:
 	 */
 	uint8_t reverse_endian;
 
+	/**
+	 * The number of bytes written by #export_words for each
+	 * source word.
+	 */
+	uint8_t export_word_size;
+
+	/**
+	 * A single-pass kernel which applies #shift8, #pack24 and
+	 * #reverse_endian to 32 bit words (after the DSD
+	 * conversion), or nullptr if none of them is enabled or the
+	 * sample format is not 32 bit.
+	 */
+	PcmWordExportFunction export_words;
+
 public:
 	struct Params {
 		bool alsa_channel_order = false;
@@ -237,6 +253,18 @@ public:
 	 */
 	gcc_pure
 	size_t CalcInputSize(size_t dest_size) const noexcept;
+
+private:
+#ifdef ENABLE_DSD
+	/**
+	 * Convert DSD to 32 bit words with the given converter and
+	 * pass them to #export_words.  This is done in small chunks,
+	 * so the intermediate words stay in the CPU cache.
+	 */
+	template<typename C>
+	ConstBuffer<void> ExportDsdWords(C &converter,
+					 ConstBuffer<void> src) noexcept;
+#endif
 };
 
 #endif
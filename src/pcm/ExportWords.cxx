@@ -0,0 +1,192 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ExportWords.hxx"
+#include "util/ByteOrder.hxx"
+#include "util/Compiler.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SSSE3_DISPATCH
+#include <tmmintrin.h>
+#endif
+
+template<PcmWordExport mode>
+static inline uint8_t *
+StoreWord(uint8_t *dest, uint32_t x) noexcept
+{
+	if constexpr (mode == PcmWordExport::PACK24 ||
+		      mode == PcmWordExport::PACK24_REVERSE) {
+		constexpr bool big_endian = IsBigEndian() !=
+			(mode == PcmWordExport::PACK24_REVERSE);
+
+		if (big_endian) {
+			dest[0] = x >> 16;
+			dest[1] = x >> 8;
+			dest[2] = x;
+		} else {
+			dest[0] = x;
+			dest[1] = x >> 8;
+			dest[2] = x >> 16;
+		}
+
+		return dest + 3;
+	} else {
+		if constexpr (mode == PcmWordExport::SHIFT8 ||
+			      mode == PcmWordExport::SHIFT8_REVERSE)
+			x <<= 8;
+
+		if constexpr (mode == PcmWordExport::REVERSE ||
+			      mode == PcmWordExport::SHIFT8_REVERSE)
+			x = ByteSwap32(x);
+
+		memcpy(dest, &x, sizeof(x));
+		return dest + sizeof(x);
+	}
+}
+
+template<PcmWordExport mode>
+static void
+GenericWordExport(uint8_t *gcc_restrict dest,
+		  const uint32_t *gcc_restrict src, size_t n) noexcept
+{
+	for (size_t i = 0; i < n; ++i)
+		dest = StoreWord<mode>(dest, src[i]);
+}
+
+PcmWordExportFunction
+PcmGenericWordExport(PcmWordExport mode) noexcept
+{
+	switch (mode) {
+	case PcmWordExport::REVERSE:
+		return GenericWordExport<PcmWordExport::REVERSE>;
+
+	case PcmWordExport::SHIFT8:
+		return GenericWordExport<PcmWordExport::SHIFT8>;
+
+	case PcmWordExport::SHIFT8_REVERSE:
+		return GenericWordExport<PcmWordExport::SHIFT8_REVERSE>;
+
+	case PcmWordExport::PACK24:
+		return GenericWordExport<PcmWordExport::PACK24>;
+
+	case PcmWordExport::PACK24_REVERSE:
+		return GenericWordExport<PcmWordExport::PACK24_REVERSE>;
+	}
+
+	gcc_unreachable();
+}
+
+#ifdef HAVE_SSSE3_DISPATCH
+
+/**
+ * All modes are a byte shuffle of four little-endian source words
+ * (16 bytes); a negative index clears the destination byte.
+ */
+template<PcmWordExport mode>
+__attribute__((target("ssse3")))
+static inline __m128i
+Ssse3ShuffleMask() noexcept
+{
+	switch (mode) {
+	case PcmWordExport::REVERSE:
+		return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+				     11, 10, 9, 8, 15, 14, 13, 12);
+
+	case PcmWordExport::SHIFT8:
+		return _mm_setr_epi8(-1, 0, 1, 2, -1, 4, 5, 6,
+				     -1, 8, 9, 10, -1, 12, 13, 14);
+
+	case PcmWordExport::SHIFT8_REVERSE:
+		return _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1,
+				     10, 9, 8, -1, 14, 13, 12, -1);
+
+	case PcmWordExport::PACK24:
+		return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+				     10, 12, 13, 14, -1, -1, -1, -1);
+
+	case PcmWordExport::PACK24_REVERSE:
+		return _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+				     8, 14, 13, 12, -1, -1, -1, -1);
+	}
+
+	gcc_unreachable();
+}
+
+template<PcmWordExport mode>
+__attribute__((target("ssse3")))
+static void
+Ssse3WordExport(uint8_t *gcc_restrict dest,
+		const uint32_t *gcc_restrict src, size_t n) noexcept
+{
+	const __m128i mask = Ssse3ShuffleMask<mode>();
+
+	constexpr size_t stride = 4 * PcmWordExportSize(mode);
+
+	/* with PACK24, each 16 byte store writes 4 garbage bytes
+	   after the 12 bytes of this iteration; stop early enough
+	   to keep them inside the destination buffer (they get
+	   overwritten by the next iteration or by the generic
+	   loop) */
+	constexpr size_t min_words = stride < 16 ? 6 : 4;
+
+	for (; n >= min_words; n -= 4, src += 4, dest += stride) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)src);
+		_mm_storeu_si128((__m128i *)dest, _mm_shuffle_epi8(v, mask));
+	}
+
+	GenericWordExport<mode>(dest, src, n);
+}
+
+static PcmWordExportFunction
+Ssse3WordExport(PcmWordExport mode) noexcept
+{
+	switch (mode) {
+	case PcmWordExport::REVERSE:
+		return Ssse3WordExport<PcmWordExport::REVERSE>;
+
+	case PcmWordExport::SHIFT8:
+		return Ssse3WordExport<PcmWordExport::SHIFT8>;
+
+	case PcmWordExport::SHIFT8_REVERSE:
+		return Ssse3WordExport<PcmWordExport::SHIFT8_REVERSE>;
+
+	case PcmWordExport::PACK24:
+		return Ssse3WordExport<PcmWordExport::PACK24>;
+
+	case PcmWordExport::PACK24_REVERSE:
+		return Ssse3WordExport<PcmWordExport::PACK24_REVERSE>;
+	}
+
+	gcc_unreachable();
+}
+
+#endif
+
+PcmWordExportFunction
+PcmSelectWordExport(PcmWordExport mode) noexcept
+{
+#ifdef HAVE_SSSE3_DISPATCH
+	if (__builtin_cpu_supports("ssse3"))
+		return Ssse3WordExport(mode);
+#endif
+
+	return PcmGenericWordExport(mode);
+}
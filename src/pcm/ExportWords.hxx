@@ -0,0 +1,93 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_EXPORT_WORDS_HXX
+#define MPD_PCM_EXPORT_WORDS_HXX
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The binary representation of 32 bit words (S32, S24_P32, DSD_U32
+ * or DoP) written by PcmExport.  Each mode combines the
+ * transformations of #PcmExport::Params in one pass.
+ */
+enum class PcmWordExport : uint8_t {
+	/**
+	 * Reverse the byte order.
+	 */
+	REVERSE,
+
+	/**
+	 * Shift left by 8 bits (S24_P32 to S32).
+	 */
+	SHIFT8,
+
+	/**
+	 * Shift left by 8 bits and reverse the byte order.
+	 */
+	SHIFT8_REVERSE,
+
+	/**
+	 * Pack to 3 bytes (S24_P32 to S24_3), native byte order.
+	 */
+	PACK24,
+
+	/**
+	 * Pack to 3 bytes with reversed byte order.
+	 */
+	PACK24_REVERSE,
+};
+
+/**
+ * @param dest the destination buffer; it must have room for
+ * n * PcmWordExportSize() bytes
+ * @param src the source words (native byte order)
+ * @param n the number of words
+ */
+typedef void (*PcmWordExportFunction)(uint8_t *dest, const uint32_t *src,
+				      size_t n) noexcept;
+
+/**
+ * The number of bytes written for each source word.
+ */
+constexpr size_t
+PcmWordExportSize(PcmWordExport mode) noexcept
+{
+	return mode == PcmWordExport::PACK24 ||
+		mode == PcmWordExport::PACK24_REVERSE
+		? 3
+		: 4;
+}
+
+/**
+ * Choose the fastest implementation of the given mode for this
+ * CPU.  On x86, this checks for SSSE3 at runtime.
+ */
+PcmWordExportFunction
+PcmSelectWordExport(PcmWordExport mode) noexcept;
+
+/**
+ * The portable implementation of the given mode (for unit tests and
+ * benchmarks).
+ */
+PcmWordExportFunction
+PcmGenericWordExport(PcmWordExport mode) noexcept;
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "KWeighting.hxx"
+
+#include <cmath>
+
+void
+KWeightingFilter::Init(unsigned sample_rate) noexcept
+{
+	/* the filter coefficients for arbitrary sample rates, see
+	   ITU-R BS.1770 */
+	const double rate = sample_rate;
+
+	{
+		constexpr double f0 = 1681.974450955533;
+		constexpr double G = 3.999843853973347;
+		constexpr double Q = 0.7071752369554196;
+
+		const double K = std::tan(M_PI * f0 / rate);
+		const double Vh = std::pow(10.0, G / 20.0);
+		const double Vb = std::pow(Vh, 0.4996667741545416);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2.0 * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+		shelf.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	{
+		constexpr double f0 = 38.13547087602444;
+		constexpr double Q = 0.5003270373238773;
+
+		const double K = std::tan(M_PI * f0 / rate);
+		const double a0 = 1.0 + K / Q + K * K;
+
+		highpass.b0 = 1.0;
+		highpass.b1 = -2.0;
+		highpass.b2 = 1.0;
+		highpass.a1 = 2.0 * (K * K - 1.0) / a0;
+		highpass.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	Reset();
+}
+
+double
+KWeightingChannelWeight(unsigned channel, unsigned n_channels) noexcept
+{
+	if (n_channels >= 6) {
+		if (channel == 3)
+			/* LFE */
+			return 0;
+
+		return channel >= 4 ? 1.41 : 1.0;
+	}
+
+	if ((n_channels == 4 && channel >= 2) ||
+	    (n_channels == 5 && channel >= 3))
+		/* surround */
+		return 1.41;
+
+	return 1.0;
+}
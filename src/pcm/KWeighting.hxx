@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PCM_K_WEIGHTING_HXX
+#define MPD_PCM_K_WEIGHTING_HXX
+
+#include "util/Compiler.h"
+
+/**
+ * A biquad filter (direct form II transposed) for one channel.
+ */
+struct Biquad {
+	double b0, b1, b2, a1, a2;
+	double z1 = 0, z2 = 0;
+
+	void Reset() noexcept {
+		z1 = z2 = 0;
+	}
+
+	double Process(double x) noexcept {
+		const double y = b0 * x + z1;
+		z1 = b1 * x - a1 * y + z2;
+		z2 = b2 * x - a2 * y;
+		return y;
+	}
+};
+
+/**
+ * The "K" frequency weighting filter for one channel, as specified
+ * by ITU-R BS.1770: a high shelf followed by a high-pass filter.
+ */
+class KWeightingFilter {
+	Biquad shelf, highpass;
+
+public:
+	/**
+	 * Calculate the coefficients for the given sample rate and
+	 * clear the filter state.
+	 */
+	void Init(unsigned sample_rate) noexcept;
+
+	void Reset() noexcept {
+		shelf.Reset();
+		highpass.Reset();
+	}
+
+	double Process(double x) noexcept {
+		return highpass.Process(shelf.Process(x));
+	}
+};
+
+/**
+ * The weight of a channel in the loudness sum according to ITU-R
+ * BS.1770, assuming MPD's channel order.
+ */
+gcc_const
+double
+KWeightingChannelWeight(unsigned channel, unsigned n_channels) noexcept;
+
+#endif
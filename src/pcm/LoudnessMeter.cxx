@@ -0,0 +1,196 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "LoudnessMeter.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+/**
+ * The "absolute" gate according to EBU R128: blocks below -70 LUFS
+ * are ignored.
+ */
+static constexpr double ABSOLUTE_GATE = -70;
+
+/**
+ * The "relative" gate according to EBU R128: blocks 10 LU below
+ * the loudness of the non-silent blocks are ignored.
+ */
+static constexpr double RELATIVE_GATE = -10;
+
+gcc_const
+static double
+LoudnessToEnergy(double lufs) noexcept
+{
+	return std::pow(10.0, (lufs + 0.691) / 10.0);
+}
+
+gcc_const
+static double
+EnergyToLoudness(double energy) noexcept
+{
+	return -0.691 + 10 * std::log10(energy);
+}
+
+void
+LoudnessMeter::Open(unsigned sample_rate, unsigned _channels)
+{
+	assert(sample_rate > 0);
+	assert(_channels > 0);
+	assert(_channels <= MAX_CHANNELS);
+
+	channels = _channels;
+	step_frames = std::max(sample_rate / STEPS_PER_SECOND, 1U);
+	step_fill = 0;
+
+	for (unsigned i = 0; i < channels; ++i) {
+		auto &c = state[i];
+		c.filter.Init(sample_rate);
+		c.weight = KWeightingChannelWeight(i, channels);
+		c.sum = 0;
+		c.history.fill(0);
+	}
+
+	/* a Hann-windowed sinc low-pass filter with its cutoff at
+	   the original Nyquist frequency, split into one phase per
+	   interpolated sample; each phase is normalized to unity
+	   gain */
+	constexpr unsigned N = OVERSAMPLING * TAPS;
+	for (unsigned p = 0; p < OVERSAMPLING; ++p) {
+		double sum = 0;
+		for (unsigned k = 0; k < TAPS; ++k) {
+			const unsigned n = p + OVERSAMPLING * k;
+			const double t = (double(n) - (N - 1) / 2.0) / OVERSAMPLING;
+			const double sinc = t == 0
+				? 1.0
+				: std::sin(M_PI * t) / (M_PI * t);
+			const double window =
+				0.5 - 0.5 * std::cos(2 * M_PI * (n + 0.5) / N);
+			const double h = sinc * window;
+
+			/* reverse the order so it can be applied to
+			   the history (oldest first) */
+			coefficients[p][TAPS - 1 - k] = h;
+			sum += h;
+		}
+
+		for (auto &h : coefficients[p])
+			h /= sum;
+	}
+
+	history_position = 0;
+	n_steps = 0;
+	blocks.clear();
+	peak = 0;
+}
+
+inline void
+LoudnessMeter::FinishStep() noexcept
+{
+	double energy = 0;
+	for (unsigned i = 0; i < channels; ++i) {
+		auto &c = state[i];
+		energy += c.weight * c.sum;
+		c.sum = 0;
+	}
+
+	std::copy(steps.begin() + 1, steps.end(), steps.begin());
+	steps.back() = energy / step_frames;
+
+	if (++n_steps >= STEPS_PER_BLOCK) {
+		double sum = 0;
+		for (const double i : steps)
+			sum += i;
+
+		blocks.push_back(sum / STEPS_PER_BLOCK);
+	}
+
+	step_fill = 0;
+}
+
+void
+LoudnessMeter::Feed(const float *src, std::size_t n_frames) noexcept
+{
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		for (unsigned ch = 0; ch < channels; ++ch) {
+			auto &c = state[ch];
+			const float x = *src++;
+
+			const double y = c.filter.Process(x);
+			c.sum += y * y;
+
+			c.history[history_position] = x;
+			c.history[history_position + TAPS] = x;
+
+			const float *window =
+				&c.history[history_position + 1];
+			float p = std::fabs(x);
+			for (const auto &phase : coefficients) {
+				float v = 0;
+				for (unsigned k = 0; k < TAPS; ++k)
+					v += phase[k] * window[k];
+				p = std::max(p, std::fabs(v));
+			}
+
+			peak = std::max(peak, p);
+		}
+
+		if (++history_position == TAPS)
+			history_position = 0;
+
+		if (++step_fill == step_frames)
+			FinishStep();
+	}
+}
+
+double
+LoudnessMeter::GetIntegratedLoudness() const noexcept
+{
+	const double absolute = LoudnessToEnergy(ABSOLUTE_GATE);
+
+	double sum = 0;
+	std::size_t n = 0;
+	for (const double i : blocks) {
+		if (i > absolute) {
+			sum += i;
+			++n;
+		}
+	}
+
+	if (n == 0)
+		return -HUGE_VAL;
+
+	const double relative =
+		std::max(sum / n * std::pow(10.0, RELATIVE_GATE / 10),
+			 absolute);
+
+	sum = 0;
+	n = 0;
+	for (const double i : blocks) {
+		if (i > relative) {
+			sum += i;
+			++n;
+		}
+	}
+
+	if (n == 0)
+		return -HUGE_VAL;
+
+	return EnergyToLoudness(sum / n);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PCM_LOUDNESS_METER_HXX
+#define MPD_PCM_LOUDNESS_METER_HXX
+
+#include "ChannelDefs.hxx"
+#include "KWeighting.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Measures the integrated (gated) loudness and the true peak of a
+ * whole song according to ITU-R BS.1770-4 and EBU R128.  The input
+ * is interleaved floating point samples.
+ */
+class LoudnessMeter {
+	/**
+	 * The gating blocks (400 ms) overlap by 75%, i.e. a new one
+	 * starts every 100 ms.
+	 */
+	static constexpr unsigned STEPS_PER_SECOND = 10;
+	static constexpr unsigned STEPS_PER_BLOCK = 4;
+
+	/**
+	 * The oversampling factor for the true peak measurement.
+	 */
+	static constexpr unsigned OVERSAMPLING = 4;
+
+	/**
+	 * The number of taps of each phase of the interpolation
+	 * filter.
+	 */
+	static constexpr unsigned TAPS = 12;
+
+	unsigned channels;
+
+	std::size_t step_frames, step_fill;
+
+	struct ChannelState {
+		KWeightingFilter filter;
+		double weight;
+
+		/**
+		 * The sum of squares of the current step.
+		 */
+		double sum;
+
+		/**
+		 * The last #TAPS input samples, stored twice so a
+		 * contiguous window is always available.
+		 */
+		std::array<float, 2 * TAPS> history;
+	};
+
+	std::array<ChannelState, MAX_CHANNELS> state;
+
+	/**
+	 * The interpolation filter for the true peak measurement,
+	 * one row of #TAPS coefficients per phase.
+	 */
+	std::array<std::array<float, TAPS>, OVERSAMPLING> coefficients;
+
+	unsigned history_position;
+
+	/**
+	 * The mean square of the most recent steps.
+	 */
+	std::array<double, STEPS_PER_BLOCK> steps;
+	unsigned n_steps;
+
+	/**
+	 * The mean square of each gating block.
+	 */
+	std::vector<double> blocks;
+
+	float peak;
+
+public:
+	void Open(unsigned sample_rate, unsigned channels);
+
+	/**
+	 * Analyze a buffer of interleaved samples.
+	 */
+	void Feed(const float *src, std::size_t n_frames) noexcept;
+
+	/**
+	 * Returns the integrated loudness [LUFS] of all samples passed
+	 * to Feed(), or -HUGE_VAL if the signal was silent or too
+	 * short.
+	 */
+	gcc_pure
+	double GetIntegratedLoudness() const noexcept;
+
+	/**
+	 * Returns the (estimated) true peak, normalized to 1.0.
+	 */
+	float GetTruePeak() const noexcept {
+		return peak;
+	}
+
+private:
+	void FinishStep() noexcept;
+};
+
+#endif
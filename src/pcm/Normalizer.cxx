@@ -0,0 +1,470 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "Normalizer.hxx"
+#include "Traits.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/RuntimeError.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <string.h>
+
+/**
+ * The type used to apply the gain to samples of the given format;
+ * S32 needs double precision to preserve all bits.
+ */
+template<SampleFormat F>
+using NormalizeGainType =
+	std::conditional_t<F == SampleFormat::S32, double, float>;
+
+/**
+ * The factor which converts a sample to the range [-1..1].
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static constexpr double
+SampleScale() noexcept
+{
+	if constexpr (F == SampleFormat::FLOAT)
+		return 1.0;
+	else
+		return 1.0 / (double(Traits::MAX) + 1.0);
+}
+
+SampleFormat
+PcmNormalizer::GetSupportedFormat(SampleFormat format) noexcept
+{
+	switch (format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return format;
+
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::S8:
+	case SampleFormat::DSD:
+		break;
+	}
+
+	return SampleFormat::FLOAT;
+}
+
+void
+PcmNormalizer::InitFilters() noexcept
+{
+	for (unsigned i = 0; i < format.channels; ++i) {
+		auto &c = channels[i];
+		c.filter.Init(format.sample_rate);
+		c.weight = KWeightingChannelWeight(i, format.channels);
+	}
+}
+
+void
+PcmNormalizer::Open(const AudioFormat &audio_format, const Config &_config)
+{
+	assert(audio_format.IsValid());
+
+	if (GetSupportedFormat(audio_format.format) != audio_format.format)
+		throw FormatRuntimeError("Sample format not supported: %s",
+					 sample_format_to_string(audio_format.format));
+
+	format = audio_format;
+	config = _config;
+
+	block_frames = std::max(format.sample_rate / BLOCKS_PER_SECOND, 1U);
+	block_size = block_frames * format.GetFrameSize();
+
+	const unsigned lookahead_blocks =
+		std::max((config.lookahead_ms * BLOCKS_PER_SECOND + 999) / 1000,
+			 1U);
+	n_blocks = lookahead_blocks + 1;
+
+	delay.ResizeDiscard(n_blocks * block_size);
+	peaks.ResizeDiscard(n_blocks);
+	block_gains.ResizeDiscard(n_blocks);
+	evicted_energies.ResizeDiscard(n_blocks);
+	energies.ResizeDiscard(SHORT_TERM_BLOCKS);
+	std::fill(peaks.begin(), peaks.end(), 0.0f);
+
+	InitFilters();
+
+	energy_sum = 0;
+	energy_position = energy_count = 0;
+
+	delay_head = delay_count = 0;
+	fill = 0;
+
+	gain_db = 0;
+	applied_gain = 1;
+}
+
+void
+PcmNormalizer::Reset() noexcept
+{
+	InitFilters();
+
+	/* roll back the analysis of the discarded blocks, newest
+	   first, so they don't affect the gain of what follows */
+	for (unsigned i = delay_head, n = delay_count; n > 0; --n) {
+		i = (i + n_blocks - 1) % n_blocks;
+
+		energy_position = (energy_position + SHORT_TERM_BLOCKS - 1)
+			% SHORT_TERM_BLOCKS;
+		energy_sum -= energies[energy_position];
+
+		const double evicted = evicted_energies[i];
+		if (evicted >= 0) {
+			energies[energy_position] = evicted;
+			energy_sum += evicted;
+		} else
+			--energy_count;
+
+		gain_db = block_gains[i];
+	}
+
+	if (energy_count == 0 || energy_sum < 0)
+		energy_sum = 0;
+
+	delay_head = delay_count = 0;
+	fill = 0;
+	std::fill(peaks.begin(), peaks.end(), 0.0f);
+}
+
+double
+PcmNormalizer::GetLoudness() const noexcept
+{
+	if (energy_count == 0 || energy_sum <= 0)
+		return -HUGE_VAL;
+
+	return -0.691 + 10 * std::log10(energy_sum / energy_count);
+}
+
+template<SampleFormat F, typename C, class Traits=SampleTraits<F>>
+static float
+AnalyzeSamples(typename Traits::const_pointer src, std::size_t n_frames,
+	       unsigned n_channels, double *energy, C &channels) noexcept
+{
+	constexpr double scale = SampleScale<F>();
+
+	double peak = 0;
+	std::array<double, MAX_CHANNELS> sums{};
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		for (unsigned c = 0; c < n_channels; ++c) {
+			const double x = double(*src++) * scale;
+			peak = std::max(peak, std::fabs(x));
+
+			auto &cs = channels[c];
+			const double y = cs.filter.Process(x);
+			sums[c] += y * y;
+		}
+	}
+
+	double sum = 0;
+	for (unsigned c = 0; c < n_channels; ++c)
+		sum += channels[c].weight * sums[c];
+
+	*energy = sum / n_frames;
+	return peak;
+}
+
+void
+PcmNormalizer::AnalyzeBlock() noexcept
+{
+	const void *src = &delay[delay_head * block_size];
+	double energy;
+	float peak;
+
+	switch (format.format) {
+	case SampleFormat::S16:
+		peak = AnalyzeSamples<SampleFormat::S16>((const int16_t *)src,
+							 block_frames,
+							 format.channels,
+							 &energy, channels);
+		break;
+
+	case SampleFormat::S24_P32:
+		peak = AnalyzeSamples<SampleFormat::S24_P32>((const int32_t *)src,
+							     block_frames,
+							     format.channels,
+							     &energy, channels);
+		break;
+
+	case SampleFormat::S32:
+		peak = AnalyzeSamples<SampleFormat::S32>((const int32_t *)src,
+							 block_frames,
+							 format.channels,
+							 &energy, channels);
+		break;
+
+	case SampleFormat::FLOAT:
+		peak = AnalyzeSamples<SampleFormat::FLOAT>((const float *)src,
+							   block_frames,
+							   format.channels,
+							   &energy, channels);
+		break;
+
+	default:
+		gcc_unreachable();
+	}
+
+	peaks[delay_head] = peak;
+	block_gains[delay_head] = gain_db;
+
+	/* update the short-term window */
+	if (energy_count == SHORT_TERM_BLOCKS) {
+		evicted_energies[delay_head] = energies[energy_position];
+		energy_sum -= energies[energy_position];
+	} else {
+		evicted_energies[delay_head] = -1;
+		++energy_count;
+	}
+
+	energies[energy_position] = energy;
+	energy_sum += energy;
+
+	if (++energy_position == SHORT_TERM_BLOCKS) {
+		energy_position = 0;
+
+		/* avoid accumulating rounding errors */
+		energy_sum = 0;
+		for (unsigned i = 0; i < energy_count; ++i)
+			energy_sum += energies[i];
+	}
+}
+
+void
+PcmNormalizer::UpdateGain() noexcept
+{
+	/* time constants for lowering and raising the gain */
+	static const double attack =
+		1.0 - std::exp(-1.0 / (0.4 * BLOCKS_PER_SECOND));
+	static const double release =
+		1.0 - std::exp(-1.0 / (3.0 * BLOCKS_PER_SECOND));
+
+	const double loudness = GetLoudness();
+	if (loudness > -70) {
+		/* below -70 LUFS (the absolute gate of EBU R128),
+		   the signal is silence, and the gain is kept; the
+		   gain is never negative, because this filter only
+		   raises quiet material (peaks are limited by
+		   EmitBlock()) */
+		const double desired = std::clamp(config.target - loudness,
+						  0.0, config.max_gain);
+		gain_db += (desired - gain_db) *
+			(desired < gain_db ? attack : release);
+	}
+}
+
+/**
+ * Copy samples, applying a gain which changes linearly from #gain
+ * to #gain+n*#step.  This loop is simple enough to be vectorized by
+ * the compiler.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+ApplyGainRamp(typename Traits::pointer gcc_restrict dest,
+	      typename Traits::const_pointer gcc_restrict src,
+	      std::size_t n,
+	      NormalizeGainType<F> gain, NormalizeGainType<F> step) noexcept
+{
+	using G = NormalizeGainType<F>;
+
+	for (std::size_t i = 0; i < n; ++i) {
+		G x = G(src[i]) * (gain + G(i) * step);
+
+		if constexpr (F != SampleFormat::FLOAT) {
+			x = x < G(Traits::MIN) ? G(Traits::MIN) : x;
+			x = x > G(Traits::MAX) ? G(Traits::MAX) : x;
+		}
+
+		dest[i] = typename Traits::value_type(x);
+	}
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+ApplyGainRamp(void *dest, const void *src, std::size_t size,
+	      double from, double to) noexcept
+{
+	using G = NormalizeGainType<F>;
+
+	const std::size_t n = size / Traits::SAMPLE_SIZE;
+	ApplyGainRamp<F>((typename Traits::pointer)dest,
+			 (typename Traits::const_pointer)src, n,
+			 G(from), G((to - from) / n));
+}
+
+void
+PcmNormalizer::EmitBlock(void *dest, std::size_t size,
+			 const void *src, float peak_limit) noexcept
+{
+	/* don't let the peak within the look-ahead window exceed
+	   full scale */
+	double gain = std::pow(10.0, gain_db / 20.0);
+	if (peak_limit > 0)
+		gain = std::min(gain, 1.0 / peak_limit);
+
+	switch (format.format) {
+	case SampleFormat::S16:
+		ApplyGainRamp<SampleFormat::S16>(dest, src, size,
+						 applied_gain, gain);
+		break;
+
+	case SampleFormat::S24_P32:
+		ApplyGainRamp<SampleFormat::S24_P32>(dest, src, size,
+						     applied_gain, gain);
+		break;
+
+	case SampleFormat::S32:
+		ApplyGainRamp<SampleFormat::S32>(dest, src, size,
+						 applied_gain, gain);
+		break;
+
+	case SampleFormat::FLOAT:
+		ApplyGainRamp<SampleFormat::FLOAT>(dest, src, size,
+						   applied_gain, gain);
+		break;
+
+	default:
+		gcc_unreachable();
+	}
+
+	applied_gain = gain;
+}
+
+ConstBuffer<void>
+PcmNormalizer::Process(ConstBuffer<void> _src) noexcept
+{
+	auto src = ConstBuffer<uint8_t>::FromVoid(_src);
+
+	/* each complete input block emits at most one block */
+	auto *const dest0 = buffer.GetT<uint8_t>(src.size + block_size);
+	auto *dest = dest0;
+
+	while (!src.empty()) {
+		const std::size_t nbytes = std::min(block_size - fill,
+						    src.size);
+		memcpy(&delay[delay_head * block_size + fill], src.data,
+		       nbytes);
+		src.skip_front(nbytes);
+		fill += nbytes;
+
+		if (fill < block_size)
+			break;
+
+		AnalyzeBlock();
+		UpdateGain();
+
+		fill = 0;
+		if (++delay_head == n_blocks)
+			delay_head = 0;
+
+		if (++delay_count < n_blocks)
+			continue;
+
+		/* the look-ahead buffer is full: emit the oldest
+		   block, which is the one at the (new) head */
+
+		const float peak_limit =
+			*std::max_element(peaks.begin(), peaks.end());
+
+		EmitBlock(dest, block_size, &delay[delay_head * block_size],
+			  peak_limit);
+		dest += block_size;
+		--delay_count;
+	}
+
+	return { dest0, std::size_t(dest - dest0) };
+}
+
+ConstBuffer<void>
+PcmNormalizer::Flush() noexcept
+{
+	if (delay_count == 0 && fill == 0)
+		return nullptr;
+
+	auto *const dest0 = buffer.GetT<uint8_t>(n_blocks * block_size);
+	auto *dest = dest0;
+
+	/* the oldest complete block */
+	unsigned i = (delay_head + n_blocks - delay_count) % n_blocks;
+
+	for (; delay_count > 0; --delay_count) {
+		float peak_limit = 0;
+		for (unsigned j = 0, k = i; j < delay_count; ++j) {
+			peak_limit = std::max(peak_limit, peaks[k]);
+			if (++k == n_blocks)
+				k = 0;
+		}
+
+		EmitBlock(dest, block_size, &delay[i * block_size],
+			  peak_limit);
+		dest += block_size;
+
+		if (++i == n_blocks)
+			i = 0;
+	}
+
+	if (fill > 0) {
+		/* the partial block has not been analyzed; keep the
+		   current gain unless that would clip */
+		assert(i == delay_head);
+
+		memcpy(dest, &delay[delay_head * block_size], fill);
+		const std::size_t n_samples = fill / format.GetSampleSize();
+
+		float peak = 0;
+		for (std::size_t j = 0; j < n_samples; ++j) {
+			double x;
+			switch (format.format) {
+			case SampleFormat::S16:
+				x = ((const int16_t *)dest)[j] *
+					SampleScale<SampleFormat::S16>();
+				break;
+
+			case SampleFormat::S24_P32:
+				x = ((const int32_t *)dest)[j] *
+					SampleScale<SampleFormat::S24_P32>();
+				break;
+
+			case SampleFormat::S32:
+				x = ((const int32_t *)dest)[j] *
+					SampleScale<SampleFormat::S32>();
+				break;
+
+			default:
+				x = ((const float *)dest)[j];
+				break;
+			}
+
+			peak = std::max(peak, float(std::fabs(x)));
+		}
+
+		EmitBlock(dest, fill, dest, peak);
+		dest += fill;
+		fill = 0;
+	}
+
+	delay_head = 0;
+
+	return { dest0, std::size_t(dest - dest0) };
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PCM_NORMALIZER_HXX
+#define MPD_PCM_NORMALIZER_HXX
+
+#include "AudioFormat.hxx"
+#include "ChannelDefs.hxx"
+#include "KWeighting.hxx"
+#include "Buffer.hxx"
+#include "util/AllocatedArray.hxx"
+#include "util/Compiler.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Loudness normalization ("volume_normalization").  The loudness is
+ * measured similar to EBU R128 "short-term" loudness: the signal is
+ * K-weighted (ITU-R BS.1770), and its energy is averaged over three
+ * seconds.  The resulting gain is applied to the signal with a delay
+ * ("look-ahead"), which allows lowering the gain smoothly before a
+ * peak arrives, instead of clipping it.
+ *
+ * The samples are processed in their native format; supported are
+ * S16, S24_P32, S32 and FLOAT.
+ */
+class PcmNormalizer {
+public:
+	struct Config {
+		/**
+		 * The desired loudness [LUFS].
+		 */
+		double target = -16;
+
+		/**
+		 * The maximum amplification [dB].  The signal is
+		 * never attenuated below its original level; this
+		 * filter only raises quiet material, and loud
+		 * material is merely limited to avoid clipping.
+		 */
+		double max_gain = 30;
+
+		/**
+		 * The look-ahead (and therefore the latency) in
+		 * milliseconds.
+		 */
+		unsigned lookahead_ms = 100;
+	};
+
+private:
+	/**
+	 * The duration of one analysis block is 1/#BLOCKS_PER_SECOND
+	 * seconds.
+	 */
+	static constexpr unsigned BLOCKS_PER_SECOND = 100;
+
+	/**
+	 * The number of blocks in the short-term loudness window (3
+	 * seconds).
+	 */
+	static constexpr unsigned SHORT_TERM_BLOCKS = 3 * BLOCKS_PER_SECOND;
+
+	struct ChannelState {
+		KWeightingFilter filter;
+
+		/**
+		 * The channel weight according to ITU-R BS.1770.
+		 */
+		double weight;
+	};
+
+	Config config;
+
+	AudioFormat format = AudioFormat::Undefined();
+
+	std::size_t block_frames, block_size;
+
+	/**
+	 * The number of blocks in #delay (look-ahead plus one).
+	 */
+	unsigned n_blocks;
+
+	std::array<ChannelState, MAX_CHANNELS> channels;
+
+	/**
+	 * A ring buffer of blocks which were analyzed, but not yet
+	 * emitted; the block at #delay_head is being filled.
+	 */
+	AllocatedArray<uint8_t> delay;
+
+	/**
+	 * The peak (normalized to 1.0) of each block in #delay.
+	 */
+	AllocatedArray<float> peaks;
+
+	/**
+	 * The value of #gain_db before each block in #delay was
+	 * analyzed; used by Reset() to roll back the analysis of
+	 * discarded blocks.
+	 */
+	AllocatedArray<double> block_gains;
+
+	/**
+	 * The energy which each block in #delay has evicted from the
+	 * short-term window, or a negative value if the window was
+	 * not full yet.
+	 */
+	AllocatedArray<double> evicted_energies;
+
+	/**
+	 * The mean square of each block of the short-term loudness
+	 * window.
+	 */
+	AllocatedArray<double> energies;
+
+	double energy_sum;
+
+	unsigned energy_position, energy_count;
+
+	/**
+	 * The index of the block in #delay which is being filled.
+	 */
+	unsigned delay_head;
+
+	/**
+	 * The number of complete blocks in #delay.
+	 */
+	unsigned delay_count;
+
+	/**
+	 * The number of bytes in the block at #delay_head.
+	 */
+	std::size_t fill;
+
+	/**
+	 * The smoothed gain [dB], before peak limiting.
+	 */
+	double gain_db;
+
+	/**
+	 * The (linear) gain applied to the end of the last emitted
+	 * block.
+	 */
+	double applied_gain;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * Determine the #SampleFormat which will be processed.  Other
+	 * formats need to be converted by the caller.
+	 */
+	gcc_const
+	static SampleFormat GetSupportedFormat(SampleFormat format) noexcept;
+
+	/**
+	 * Throws on error.
+	 *
+	 * @param audio_format the input (and output) format; its
+	 * #SampleFormat must be one returned by GetSupportedFormat()
+	 */
+	void Open(const AudioFormat &audio_format, const Config &config);
+
+	/**
+	 * Discard all buffered samples (e.g. after seeking).  The
+	 * loudness measurement and the current gain are kept, except
+	 * for the contribution of the discarded samples.
+	 */
+	void Reset() noexcept;
+
+	/**
+	 * Process a block of samples.  Due to the look-ahead, the
+	 * returned buffer contains samples passed to an earlier call.
+	 */
+	ConstBuffer<void> Process(ConstBuffer<void> src) noexcept;
+
+	/**
+	 * Return the samples remaining in the look-ahead buffer.
+	 * Returns nullptr if nothing is left.
+	 */
+	ConstBuffer<void> Flush() noexcept;
+
+	/**
+	 * Returns the current short-term loudness [LUFS], or -HUGE_VAL
+	 * if the signal is silent.
+	 */
+	gcc_pure
+	double GetLoudness() const noexcept;
+
+private:
+	void InitFilters() noexcept;
+
+	/**
+	 * Analyze the complete block at #delay_head.
+	 */
+	void AnalyzeBlock() noexcept;
+
+	/**
+	 * Calculate the gain for the oldest block in #delay, copy it
+	 * to the given buffer with the gain applied.
+	 */
+	void EmitBlock(void *dest, std::size_t size,
+		       const void *src, float peak_limit) noexcept;
+
+	/**
+	 * Update #gain_db after a block has been analyzed.
+	 */
+	void UpdateGain() noexcept;
+};
+
+#endif
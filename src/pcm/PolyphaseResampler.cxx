@@ -0,0 +1,396 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "PolyphaseResampler.hxx"
+#include "DotProduct.hxx"
+#include "AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <tuple>
+
+#include <string.h>
+
+static constexpr Domain polyphase_domain("polyphase");
+
+/**
+ * If the reduced ratio has more than this number of phases, the
+ * coefficient table is limited to this size, and the coefficients
+ * between two phases are interpolated.
+ */
+static constexpr unsigned MAX_PHASES = 1024;
+
+struct PolyphaseQuality {
+	const char *name;
+
+	/**
+	 * The filter length in input samples (when upsampling).
+	 */
+	unsigned taps;
+
+	/**
+	 * The cutoff frequency relative to the Nyquist frequency.
+	 */
+	double bandwidth;
+
+	/**
+	 * The Kaiser window's beta parameter; larger values mean
+	 * more stopband attenuation and a wider transition band.
+	 */
+	double beta;
+};
+
+static constexpr PolyphaseQuality polyphase_quality_table[] = {
+	{ "very high", 128, 0.97, 12.0 },
+	{ "high", 64, 0.95, 10.0 },
+	{ "medium", 32, 0.91, 8.0 },
+	{ "low", 16, 0.85, 6.0 },
+};
+
+static const PolyphaseQuality *polyphase_quality =
+	&polyphase_quality_table[1];
+
+/**
+ * The coefficients of a polyphase filter: one row of #taps
+ * coefficients per phase, plus one more row for interpolating the
+ * last phase.  The coefficients of each row are in reverse order,
+ * so they can be applied to the input samples oldest first.
+ */
+struct PolyphaseFilter {
+	unsigned n_phases, taps;
+
+	std::vector<float> coefficients;
+
+	const float *GetPhase(unsigned i) const noexcept {
+		assert(i <= n_phases);
+
+		return &coefficients[i * taps];
+	}
+};
+
+/**
+ * The zeroth order modified Bessel function of the first kind, for
+ * the Kaiser window.
+ */
+gcc_const
+static double
+BesselI0(double x) noexcept
+{
+	double sum = 1, term = 1;
+	for (unsigned k = 1; k < 50; ++k) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+
+	return sum;
+}
+
+static std::shared_ptr<const PolyphaseFilter>
+CreatePolyphaseFilter(unsigned n_phases, unsigned taps,
+		      double cutoff, double beta)
+{
+	auto f = std::make_shared<PolyphaseFilter>();
+	f->n_phases = n_phases;
+	f->taps = taps;
+	f->coefficients.resize((n_phases + 1) * taps);
+
+	const double half = taps / 2.0;
+	const double i0_beta = BesselI0(beta);
+
+	for (unsigned p = 0; p <= n_phases; ++p) {
+		const double fraction = double(p) / n_phases;
+		float *row = &f->coefficients[p * taps];
+
+		double sum = 0;
+		for (unsigned m = 0; m < taps; ++m) {
+			/* the distance between the output sample and
+			   input sample "m" */
+			const double t = fraction + half - 1 - m;
+			if (std::fabs(t) >= half) {
+				row[m] = 0;
+				continue;
+			}
+
+			const double x = M_PI * cutoff * t;
+			const double sinc = x == 0 ? 1.0 : std::sin(x) / x;
+			const double r = t / half;
+			const double window =
+				BesselI0(beta * std::sqrt(1 - r * r)) / i0_beta;
+
+			const double h = cutoff * sinc * window;
+			row[m] = h;
+			sum += h;
+		}
+
+		/* normalize to unity gain at 0 Hz */
+		for (unsigned m = 0; m < taps; ++m)
+			row[m] /= sum;
+	}
+
+	return f;
+}
+
+/**
+ * Coefficient tables are expensive to calculate, therefore they are
+ * shared by all resampler instances.
+ */
+class PolyphaseFilterCache {
+	using Key = std::tuple<unsigned, unsigned, double, double>;
+
+	Mutex mutex;
+	std::map<Key, std::shared_ptr<const PolyphaseFilter>> map;
+
+public:
+	std::shared_ptr<const PolyphaseFilter> Get(unsigned n_phases,
+						   unsigned taps,
+						   double cutoff,
+						   double beta) {
+		const Key key{n_phases, taps, cutoff, beta};
+
+		const std::lock_guard<Mutex> lock(mutex);
+		auto i = map.find(key);
+		if (i == map.end())
+			i = map.emplace(key,
+					CreatePolyphaseFilter(n_phases, taps,
+							      cutoff, beta)).first;
+
+		return i->second;
+	}
+};
+
+static PolyphaseFilterCache polyphase_filter_cache;
+
+/**
+ * Determine the filter parameters for the given (reduced) ratio and
+ * obtain the coefficient table.
+ */
+static std::shared_ptr<const PolyphaseFilter>
+GetPolyphaseFilter(unsigned up, unsigned down)
+{
+	const auto &q = *polyphase_quality;
+
+	/* when downsampling, the cutoff frequency is relative to the
+	   output's Nyquist frequency, and the filter needs to be
+	   longer to keep the same transition band */
+	const double ratio = std::min(1.0, double(up) / double(down));
+	const double cutoff = ratio * q.bandwidth;
+
+	unsigned taps = std::ceil(q.taps / ratio);
+	taps = (taps + PCM_DOT_PRODUCT_BLOCK - 1) / PCM_DOT_PRODUCT_BLOCK
+		* PCM_DOT_PRODUCT_BLOCK;
+
+	return polyphase_filter_cache.Get(std::min(up, MAX_PHASES), taps,
+					  cutoff, q.beta);
+}
+
+void
+pcm_resample_polyphase_global_init(const ConfigBlock &block)
+{
+	const char *quality = block.GetBlockValue("quality", "high");
+
+	polyphase_quality = nullptr;
+	for (const auto &i : polyphase_quality_table)
+		if (strcmp(i.name, quality) == 0)
+			polyphase_quality = &i;
+
+	if (polyphase_quality == nullptr)
+		throw FormatRuntimeError("unknown quality setting '%s' in line %d",
+					 quality, block.line);
+
+	FormatDebug(polyphase_domain, "polyphase resampler quality '%s'",
+		    polyphase_quality->name);
+
+	/* precompute the tables for the most common conversions
+	   (44.1 kHz to 48 kHz and back) */
+	GetPolyphaseFilter(160, 147);
+	GetPolyphaseFilter(147, 160);
+}
+
+AudioFormat
+PolyphasePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+{
+	assert(af.IsValid());
+	assert(audio_valid_sample_rate(new_sample_rate));
+
+	const unsigned g = std::gcd(af.sample_rate, new_sample_rate);
+	up = new_sample_rate / g;
+	down = af.sample_rate / g;
+
+	filter = GetPolyphaseFilter(up, down);
+	channels = af.channels;
+
+	FormatDebug(polyphase_domain,
+		    "resampling %u:%u with %u phases, %u taps",
+		    up, down, filter->n_phases, filter->taps);
+
+	Reset();
+
+	/* this resampler works with floating point samples */
+	af.format = SampleFormat::FLOAT;
+
+	AudioFormat result = af;
+	result.sample_rate = new_sample_rate;
+	return result;
+}
+
+void
+PolyphasePcmResampler::Close() noexcept
+{
+	filter.reset();
+
+	for (auto &i : history) {
+		i.clear();
+		i.shrink_to_fit();
+	}
+}
+
+void
+PolyphasePcmResampler::InitHistory() noexcept
+{
+	/* zero padding, so the first output sample can be centered
+	   on the first input sample */
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].assign(filter->taps / 2 - 1, 0.0f);
+}
+
+void
+PolyphasePcmResampler::Reset() noexcept
+{
+	InitHistory();
+
+	phase = 0;
+	position = 0;
+	consumed = 0;
+	total_in = 0;
+	flushed = false;
+}
+
+inline ConstBuffer<void>
+PolyphasePcmResampler::Generate(bool flushing) noexcept
+{
+	const unsigned taps = filter->taps;
+	const unsigned n_phases = filter->n_phases;
+	const std::size_t length = history[0].size();
+
+	if (length < position + taps)
+		return {buffer.Get(0), 0};
+
+	const std::size_t available = length - taps + 1 - position;
+	const std::size_t max_frames =
+		std::size_t(uint64_t(available) * up / down) + 2;
+	float *const dest0 = buffer.GetT<float>(max_frames * channels);
+	float *dest = dest0;
+
+	while (position + taps <= length &&
+	       (!flushing || position + consumed < total_in)) {
+		assert(dest < dest0 + max_frames * channels);
+
+		if (n_phases == up) {
+			const float *coefficients = filter->GetPhase(phase);
+			for (unsigned c = 0; c < channels; ++c)
+				*dest++ = PcmDotProduct(coefficients,
+							&history[c][position],
+							taps);
+		} else {
+			/* interpolate between two phases */
+			const uint64_t x = uint64_t(phase) * n_phases;
+			const unsigned row = x / up;
+			const float fraction = float(x % up) / float(up);
+			const float *a = filter->GetPhase(row);
+			const float *b = filter->GetPhase(row + 1);
+
+			for (unsigned c = 0; c < channels; ++c) {
+				const float *src = &history[c][position];
+				const float ya = PcmDotProduct(a, src, taps);
+				const float yb = PcmDotProduct(b, src, taps);
+				*dest++ = ya + fraction * (yb - ya);
+			}
+		}
+
+		phase += down;
+		position += phase / up;
+		phase %= up;
+	}
+
+	/* discard input samples which are not needed anymore */
+	const std::size_t discard = std::min(position, length);
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].erase(history[c].begin(),
+				 history[c].begin() + discard);
+	position -= discard;
+	consumed += discard;
+
+	return {dest0, std::size_t(dest - dest0) * sizeof(float)};
+}
+
+ConstBuffer<void>
+PolyphasePcmResampler::Resample(ConstBuffer<void> _src)
+{
+	assert(!flushed);
+
+	const auto src = ConstBuffer<float>::FromVoid(_src);
+	assert(src.size % channels == 0);
+
+	const std::size_t n_frames = src.size / channels;
+
+	/* deinterleave */
+	for (unsigned c = 0; c < channels; ++c) {
+		auto &h = history[c];
+		const std::size_t old_size = h.size();
+		h.resize(old_size + n_frames);
+
+		float *dest = &h[old_size];
+		const float *s = src.data + c;
+		for (std::size_t i = 0; i < n_frames; ++i, s += channels)
+			dest[i] = *s;
+	}
+
+	total_in += n_frames;
+
+	return Generate(false);
+}
+
+ConstBuffer<void>
+PolyphasePcmResampler::Flush()
+{
+	if (flushed)
+		return nullptr;
+
+	flushed = true;
+
+	/* append zeroes so the filter window reaches beyond the end
+	   of the input */
+	for (unsigned c = 0; c < channels; ++c)
+		history[c].resize(history[c].size() + filter->taps / 2);
+
+	auto result = Generate(true);
+	if (result.empty())
+		return nullptr;
+
+	return result;
+}
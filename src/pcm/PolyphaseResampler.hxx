@@ -0,0 +1,108 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef MPD_PCM_POLYPHASE_RESAMPLER_HXX
+#define MPD_PCM_POLYPHASE_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "Buffer.hxx"
+#include "ChannelDefs.hxx"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ConfigBlock;
+struct PolyphaseFilter;
+
+/**
+ * A windowed-sinc polyphase resampler built into MPD.  The sample
+ * rate ratio is reduced to a fraction up/down; each output sample is
+ * calculated from one "phase" of a Kaiser-windowed sinc low-pass
+ * filter.  Coefficient tables are shared by all instances with the
+ * same ratio and quality.  If "up" is too large, the tables are
+ * limited and adjacent phases are interpolated linearly.
+ */
+class PolyphasePcmResampler final : public PcmResampler {
+	std::shared_ptr<const PolyphaseFilter> filter;
+
+	unsigned channels;
+
+	/**
+	 * The reduced sample rate ratio (output / input).
+	 */
+	unsigned up, down;
+
+	/**
+	 * The phase of the next output sample, in the range
+	 * [0, #up).
+	 */
+	unsigned phase;
+
+	/**
+	 * The index of the first input frame in #history used for the
+	 * next output frame.
+	 */
+	std::size_t position;
+
+	/**
+	 * The number of frames which have been removed from the
+	 * beginning of #history.
+	 */
+	uint64_t consumed;
+
+	/**
+	 * The number of frames passed to Resample().
+	 */
+	uint64_t total_in;
+
+	bool flushed;
+
+	/**
+	 * Deinterleaved input samples, preceded by the ones still
+	 * needed by the filter.
+	 */
+	std::array<std::vector<float>, MAX_CHANNELS> history;
+
+	PcmBuffer buffer;
+
+public:
+	/* virtual methods from class PcmResampler */
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	void Close() noexcept override;
+	void Reset() noexcept override;
+	ConstBuffer<void> Resample(ConstBuffer<void> src) override;
+	ConstBuffer<void> Flush() override;
+
+private:
+	void InitHistory() noexcept;
+
+	/**
+	 * Calculate as many output frames as possible from #history.
+	 *
+	 * @param flushing true if all input has been submitted; only
+	 * frames up to the end of the input are generated
+	 */
+	ConstBuffer<void> Generate(bool flushing) noexcept;
+};
+
+void
+pcm_resample_polyphase_global_init(const ConfigBlock &block);
+
+#endif
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SplitResampler.hxx"
+#include "AudioFormat.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <utility>
+
+#include <string.h>
+
+class SplitPcmResampler::Group {
+	std::unique_ptr<PcmResampler> resampler;
+
+public:
+	/**
+	 * The first channel of this group within the source frame.
+	 */
+	const unsigned first_channel;
+
+	const unsigned n_channels;
+
+private:
+	/**
+	 * The worker thread; it is only started for groups which do
+	 * not run on the calling thread.
+	 */
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by the caller when #state changes to PENDING or
+	 * QUIT.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled by the worker thread when #state changes to DONE.
+	 */
+	Cond done_cond;
+
+	enum class State {
+		IDLE,
+		PENDING,
+		DONE,
+		QUIT,
+	} state = State::IDLE;
+
+	bool open = false;
+
+	/**
+	 * Has Flush() returned nullptr?
+	 */
+	bool finished = false;
+
+	/**
+	 * The interleaved source buffer of the current job, or
+	 * nullptr to flush.
+	 */
+	ConstBuffer<void> src;
+	unsigned src_channels;
+	size_t src_sample_size;
+
+	PcmBuffer input_buffer;
+
+	std::exception_ptr error;
+
+public:
+	/**
+	 * Resampled data which has not been interleaved yet.
+	 */
+	std::vector<uint8_t> pending;
+
+	size_t frame_size;
+
+	Group(PcmResampler *_resampler,
+	      unsigned _first_channel, unsigned _n_channels) noexcept
+		:resampler(_resampler),
+		 first_channel(_first_channel), n_channels(_n_channels),
+		 thread(BIND_THIS_METHOD(Run)) {}
+
+	~Group() noexcept {
+		if (thread.IsDefined()) {
+			{
+				const std::lock_guard<Mutex> lock(mutex);
+				state = State::QUIT;
+				cond.notify_one();
+			}
+
+			thread.Join();
+		}
+
+		if (open)
+			resampler->Close();
+	}
+
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) {
+		AudioFormat result = resampler->Open(af, new_sample_rate);
+		open = true;
+		frame_size = result.GetFrameSize();
+		return result;
+	}
+
+	PcmResampler &GetResampler() noexcept {
+		return *resampler;
+	}
+
+	void StartThread() {
+		thread.Start();
+	}
+
+	void Reset() noexcept {
+		resampler->Reset();
+		pending.clear();
+		finished = false;
+	}
+
+	bool IsFinished() const noexcept {
+		return finished;
+	}
+
+	void Unfinish() noexcept {
+		finished = false;
+	}
+
+	size_t GetPendingFrames() const noexcept {
+		return pending.size() / frame_size;
+	}
+
+	void Set(ConstBuffer<void> _src, unsigned _src_channels,
+		 size_t _src_sample_size) noexcept {
+		src = _src;
+		src_channels = _src_channels;
+		src_sample_size = _src_sample_size;
+	}
+
+	/**
+	 * Run the job on the calling thread.
+	 */
+	void ProcessInline() {
+		Process();
+
+		if (error)
+			std::rethrow_exception(std::exchange(error, nullptr));
+	}
+
+	/**
+	 * Submit the job to the worker thread.
+	 */
+	void Submit() noexcept {
+		const std::lock_guard<Mutex> lock(mutex);
+		assert(state == State::IDLE);
+		state = State::PENDING;
+		cond.notify_one();
+	}
+
+	/**
+	 * Wait for completion of the job submitted with Submit().
+	 */
+	std::exception_ptr Wait() noexcept {
+		std::unique_lock<Mutex> lock(mutex);
+		done_cond.wait(lock, [this]{ return state == State::DONE; });
+		state = State::IDLE;
+		return std::exchange(error, nullptr);
+	}
+
+private:
+	/**
+	 * Copy this group's channels from the interleaved source
+	 * buffer.
+	 */
+	ConstBuffer<void> Deinterleave() noexcept {
+		if (n_channels == src_channels)
+			return src;
+
+		const size_t src_frame_size = src_channels * src_sample_size;
+		const size_t n_frames = src.size / src_frame_size;
+		const size_t size = n_channels * src_sample_size;
+
+		const auto *s = (const uint8_t *)src.data
+			+ first_channel * src_sample_size;
+		auto *const dest0 = (uint8_t *)input_buffer.Get(n_frames * size);
+		auto *dest = dest0;
+
+		for (size_t i = 0; i < n_frames; ++i) {
+			memcpy(dest, s, size);
+			dest += size;
+			s += src_frame_size;
+		}
+
+		return {dest0, n_frames * size};
+	}
+
+	void Process() noexcept
+	try {
+		ConstBuffer<void> result;
+
+		if (src.IsNull()) {
+			if (finished)
+				return;
+
+			result = resampler->Flush();
+			if (result.IsNull()) {
+				finished = true;
+				return;
+			}
+		} else
+			result = resampler->Resample(Deinterleave());
+
+		const auto *p = (const uint8_t *)result.data;
+		pending.insert(pending.end(), p, p + result.size);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	void Run() noexcept {
+		SetThreadName("resampler");
+
+		std::unique_lock<Mutex> lock(mutex);
+
+		while (true) {
+			cond.wait(lock, [this]{
+				return state == State::PENDING ||
+					state == State::QUIT;
+			});
+
+			if (state == State::QUIT)
+				break;
+
+			{
+				const ScopeUnlock unlock(mutex);
+				Process();
+			}
+
+			state = State::DONE;
+			done_cond.notify_one();
+		}
+	}
+};
+
+SplitPcmResampler::SplitPcmResampler(Factory _factory,
+				     unsigned _max_groups) noexcept
+	:factory(_factory), max_groups(std::max(_max_groups, 1U))
+{
+}
+
+SplitPcmResampler::~SplitPcmResampler() noexcept = default;
+
+AudioFormat
+SplitPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate)
+{
+	assert(groups.empty());
+
+	channels = af.channels;
+
+	const unsigned n_groups = std::min(max_groups, channels);
+	groups.reserve(n_groups);
+
+	AudioFormat result;
+
+	try {
+		unsigned first_channel = 0;
+		for (unsigned i = 0; i < n_groups; ++i) {
+			const unsigned n_channels = channels / n_groups +
+				(i < channels % n_groups);
+
+			groups.emplace_back(std::make_unique<Group>(factory(),
+								    first_channel,
+								    n_channels));
+			first_channel += n_channels;
+
+			AudioFormat group_format(af.sample_rate, af.format,
+						 n_channels);
+			AudioFormat group_result =
+				groups.back()->Open(group_format,
+						    new_sample_rate);
+
+			/* all groups use the same plugin, therefore
+			   they request the same formats */
+			if (i == 0) {
+				af.format = group_format.format;
+				result = group_result;
+			} else {
+				assert(group_format.format == af.format);
+				assert(group_result.format == result.format);
+			}
+
+			if (i > 0)
+				groups.back()->StartThread();
+		}
+	} catch (...) {
+		groups.clear();
+		throw;
+	}
+
+	src_sample_size = af.GetSampleSize();
+	dest_sample_size = result.GetSampleSize();
+
+	result.channels = channels;
+	return result;
+}
+
+void
+SplitPcmResampler::Close() noexcept
+{
+	groups.clear();
+}
+
+void
+SplitPcmResampler::Reset() noexcept
+{
+	for (auto &g : groups)
+		g->Reset();
+}
+
+void
+SplitPcmResampler::RunGroups(ConstBuffer<void> src)
+{
+	for (auto &g : groups)
+		g->Set(src, channels, src_sample_size);
+
+	for (std::size_t i = 1; i < groups.size(); ++i)
+		groups[i]->Submit();
+
+	std::exception_ptr error;
+
+	try {
+		groups.front()->ProcessInline();
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	/* always wait for all workers, even if the first group
+	   has failed, because they use the caller's buffer */
+	for (std::size_t i = 1; i < groups.size(); ++i) {
+		auto e = groups[i]->Wait();
+		if (e && !error)
+			error = std::move(e);
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+size_t
+SplitPcmResampler::GetPendingFrames() const noexcept
+{
+	size_t n = groups.front()->GetPendingFrames();
+	for (const auto &g : groups)
+		n = std::min(n, g->GetPendingFrames());
+	return n;
+}
+
+ConstBuffer<void>
+SplitPcmResampler::Interleave(size_t n_frames) noexcept
+{
+	const size_t dest_frame_size = channels * dest_sample_size;
+	auto *const dest0 = (uint8_t *)buffer.Get(n_frames * dest_frame_size);
+
+	for (auto &g : groups) {
+		const size_t size = g->n_channels * dest_sample_size;
+		const uint8_t *s = g->pending.data();
+		auto *dest = dest0 + g->first_channel * dest_sample_size;
+
+		for (size_t i = 0; i < n_frames; ++i) {
+			memcpy(dest, s, size);
+			s += size;
+			dest += dest_frame_size;
+		}
+
+		g->pending.erase(g->pending.begin(),
+				 g->pending.begin() + n_frames * size);
+	}
+
+	return {dest0, n_frames * dest_frame_size};
+}
+
+ConstBuffer<void>
+SplitPcmResampler::Resample(ConstBuffer<void> src)
+{
+	assert(!groups.empty());
+	assert(src.size % (channels * src_sample_size) == 0);
+
+	if (groups.size() == 1)
+		/* nothing to split (mono) */
+		return groups.front()->GetResampler().Resample(src);
+
+	RunGroups(src);
+	return Interleave(GetPendingFrames());
+}
+
+ConstBuffer<void>
+SplitPcmResampler::Flush()
+{
+	assert(!groups.empty());
+
+	if (groups.size() == 1)
+		return groups.front()->GetResampler().Flush();
+
+	while (true) {
+		RunGroups(nullptr);
+
+		const size_t n_frames = GetPendingFrames();
+		if (n_frames > 0)
+			return Interleave(n_frames);
+
+		if (std::all_of(groups.begin(), groups.end(),
+				[](const auto &g){ return g->IsFinished(); })) {
+			/* prepare for the next Flush() call sequence
+			   (after more data has been submitted) */
+			for (auto &g : groups) {
+				g->pending.clear();
+				g->Unfinish();
+			}
+
+			return nullptr;
+		}
+	}
+}
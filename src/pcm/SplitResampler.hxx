@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SPLIT_RESAMPLER_HXX
+#define MPD_PCM_SPLIT_RESAMPLER_HXX
+
+#include "Resampler.hxx"
+#include "Buffer.hxx"
+
+#include <memory>
+#include <vector>
+
+/**
+ * A #PcmResampler which partitions the channels into groups and
+ * resamples each group with its own #PcmResampler instance.  All
+ * groups but the first one run on a worker thread; the first one
+ * runs on the calling thread.  This allows using several CPU cores
+ * for streams with many channels or high sample rates.
+ */
+class SplitPcmResampler final : public PcmResampler {
+public:
+	typedef PcmResampler *(*Factory)();
+
+private:
+	class Group;
+
+	const Factory factory;
+
+	/**
+	 * The maximum number of channel groups, i.e. the number of
+	 * threads including the calling thread.
+	 */
+	const unsigned max_groups;
+
+	std::vector<std::unique_ptr<Group>> groups;
+
+	unsigned channels;
+
+	size_t src_sample_size, dest_sample_size;
+
+	PcmBuffer buffer;
+
+public:
+	/**
+	 * @param _factory creates a new #PcmResampler instance for
+	 * each channel group
+	 * @param _max_groups the maximum number of threads
+	 */
+	SplitPcmResampler(Factory _factory, unsigned _max_groups) noexcept;
+	~SplitPcmResampler() noexcept override;
+
+	/* virtual methods from class PcmResampler */
+	AudioFormat Open(AudioFormat &af, unsigned new_sample_rate) override;
+	void Close() noexcept override;
+	void Reset() noexcept override;
+	ConstBuffer<void> Resample(ConstBuffer<void> src) override;
+	ConstBuffer<void> Flush() override;
+
+private:
+	/**
+	 * Let all groups process the given input (or flush if
+	 * src.IsNull()) and wait for completion.  Rethrows the first
+	 * error of any group.
+	 */
+	void RunGroups(ConstBuffer<void> src);
+
+	/**
+	 * Returns the number of frames which are available in all
+	 * groups.
+	 */
+	gcc_pure
+	size_t GetPendingFrames() const noexcept;
+
+	/**
+	 * Interleave the first #n_frames pending frames of all groups
+	 * and remove them from the groups.
+	 */
+	ConstBuffer<void> Interleave(size_t n_frames) noexcept;
+};
+
+#endif
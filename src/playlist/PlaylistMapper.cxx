@@ -40,6 +40,8 @@ playlist_open_in_playlist_dir(const char *uri, Mutex &mutex)
 	if (path_fs.IsNull())
 		return nullptr;
 
+	spl_flush(uri);
+
 	return playlist_open_path(path_fs, mutex);
 }
 
@@ -24,17 +24,50 @@
 #include "PlaylistSong.hxx"
 #include "SongEnumerator.hxx"
 #include "SongPrint.hxx"
+#include "PlaylistFile.hxx"
 #include "song/DetachedSong.hxx"
 #include "fs/Traits.hxx"
 #include "thread/Mutex.hxx"
+#include "util/UriExtract.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 
+static void
+playlist_song_print(Response &r, const DetachedSong &song,
+		    bool found, bool detail) noexcept
+{
+	if (found && detail)
+		song_print_info(r, song);
+	else
+		/* fallback if no detail was requested or no detail
+		   was available */
+		song_print_uri(r, song);
+}
+
+/**
+ * Does the song (after playlist_check_translate_song()) look the
+ * same for all clients?  Local files outside of the music directory
+ * depend on the client's permissions.
+ */
+gcc_pure
+static bool
+IsClientIndependent(const DetachedSong &song) noexcept
+{
+	const char *uri = song.GetURI();
+	return uri_has_scheme(uri) || !PathTraitsUTF8::IsAbsolute(uri);
+}
+
+/**
+ * @param resolved if not nullptr, then all songs are added to this
+ * list; it is cleared if one of them cannot be shared with other
+ * clients
+ */
 static void
 playlist_provider_print(Response &r,
 			const SongLoader &loader,
 			const char *uri,
-			SongEnumerator &e, bool detail) noexcept
+			SongEnumerator &e, bool detail,
+			ResolvedPlaylist *resolved) noexcept
 {
 	const auto base_uri = uri != nullptr
 		? PathTraitsUTF8::GetParent(uri)
@@ -42,14 +75,25 @@ playlist_provider_print(Response &r,
 
 	std::unique_ptr<DetachedSong> song;
 	while ((song = e.NextSong()) != nullptr) {
-		if (playlist_check_translate_song(*song, base_uri,
-						  loader) &&
-		    detail)
-			song_print_info(r, *song);
-		else
-			/* fallback if no detail was requested or no
-			   detail was available */
-			song_print_uri(r, *song);
+		const bool found =
+			playlist_check_translate_song(*song, base_uri,
+						      loader);
+		playlist_song_print(r, *song, found, detail);
+
+		if (resolved == nullptr)
+			continue;
+
+		if (IsClientIndependent(*song)) {
+			try {
+				resolved->push_back({std::move(*song), found});
+				continue;
+			} catch (...) {
+			}
+		}
+
+		/* don't cache this playlist */
+		resolved->clear();
+		resolved = nullptr;
 	}
 }
 
@@ -58,6 +102,22 @@ playlist_file_print(Response &r, Partition &partition,
 		    const SongLoader &loader,
 		    const LocatedUri &uri, bool detail)
 {
+	/* stored playlists are opened from the playlist directory
+	   first (see playlist_mapper_open()); their resolved songs
+	   are cached */
+	const bool stored = detail &&
+		uri.type == LocatedUri::Type::RELATIVE &&
+		spl_valid_name(uri.canonical_uri);
+
+	if (stored) {
+		const auto *resolved = spl_get_resolved(uri.canonical_uri);
+		if (resolved != nullptr) {
+			for (const auto &i : *resolved)
+				playlist_song_print(r, i.song, i.found, detail);
+			return true;
+		}
+	}
+
 	Mutex mutex;
 
 #ifndef ENABLE_DATABASE
@@ -72,6 +132,14 @@ playlist_file_print(Response &r, Partition &partition,
 	if (playlist == nullptr)
 		return false;
 
-	playlist_provider_print(r, loader, uri.canonical_uri, *playlist, detail);
+	ResolvedPlaylist resolved;
+	playlist_provider_print(r, loader, uri.canonical_uri, *playlist, detail,
+				stored ? &resolved : nullptr);
+
+	if (!resolved.empty())
+		/* this does nothing if the playlist was not loaded
+		   from the playlist directory */
+		spl_put_resolved(uri.canonical_uri, std::move(resolved));
+
 	return true;
 }
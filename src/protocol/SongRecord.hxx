@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PROTOCOL_SONG_RECORD_HXX
+#define MPD_PROTOCOL_SONG_RECORD_HXX
+
+#include "tag/Type.h"
+
+#include <stdint.h>
+
+/**
+ * The field ids of a binary song record, which is sent instead of
+ * the "NAME: VALUE" lines describing a song if the client has
+ * enabled the "binary_songs" protocol feature.
+ *
+ * A record is announced by a "songrec: SIZE" line, followed by SIZE
+ * bytes and a newline.  It consists of fields; each one begins with
+ * the one-byte field id, followed by the length of the value
+ * (unsigned LEB128) and the value.  Integers are little-endian.
+ *
+ * Field ids below #TAG_NUM_OF_ITEM_TYPES are tag types, and their
+ * values are UTF-8 strings; "protocol tagids" lists them.
+ */
+enum class SongRecordField : uint8_t {
+	/**
+	 * The song URI (UTF-8).
+	 */
+	URI = 0xf0,
+
+	/**
+	 * The modification time: signed 64 bit, seconds since the
+	 * epoch.
+	 */
+	LAST_MODIFIED = 0xf1,
+
+	/**
+	 * The duration: unsigned 32 bit, milliseconds.
+	 */
+	DURATION = 0xf2,
+
+	/**
+	 * The range within the file: two unsigned 32 bit integers,
+	 * start and end in milliseconds; the end is zero if the song
+	 * plays until the end of the file.
+	 */
+	RANGE = 0xf3,
+
+	/**
+	 * The audio format, formatted like the "Format" line.
+	 */
+	FORMAT = 0xf4,
+};
+
+static_assert(TAG_NUM_OF_ITEM_TYPES < uint8_t(SongRecordField::URI),
+	      "Tag ids collide with field ids");
+
+#endif
@@ -38,12 +38,12 @@ queue_print_song_info(Response &r, const Queue &queue,
 		      unsigned position)
 {
 	song_print_info(r, queue.Get(position));
-	r.Format("Pos: %u\nId: %u\n",
-		 position, queue.PositionToId(position));
+	r.WriteField("Pos", position);
+	r.WriteField("Id", queue.PositionToId(position));
 
 	uint8_t priority = queue.GetPriorityAtPosition(position);
 	if (priority != 0)
-		r.Format("Prio: %u\n", priority);
+		r.WriteField("Prio", unsigned(priority));
 }
 
 void
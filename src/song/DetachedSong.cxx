@@ -28,7 +28,9 @@ DetachedSong::DetachedSong(const LightSong &other)
 	 tag(other.tag),
 	 mtime(other.mtime),
 	 start_time(other.start_time),
-	 end_time(other.end_time) {}
+	 end_time(other.end_time),
+	 audio_format(other.audio_format),
+	 analyzed_gain(other.analyzed_gain) {}
 
 DetachedSong::operator LightSong() const noexcept
 {
@@ -38,6 +40,8 @@ DetachedSong::operator LightSong() const noexcept
 	result.mtime = mtime;
 	result.start_time = start_time;
 	result.end_time = end_time;
+	result.audio_format = audio_format;
+	result.analyzed_gain = analyzed_gain;
 	return result;
 }
 
@@ -22,6 +22,8 @@
 
 #include "tag/Tag.hxx"
 #include "Chrono.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 
 #include <chrono>
@@ -79,6 +81,18 @@ class DetachedSong {
 	 */
 	SongTime end_time = SongTime::zero();
 
+	/**
+	 * The audio format of the song, if given by the decoder
+	 * plugin.  May be undefined if unknown.
+	 */
+	AudioFormat audio_format = AudioFormat::Undefined();
+
+	/**
+	 * The track gain calculated by the loudness analysis.  It is
+	 * used if the file does not have ReplayGain tags.
+	 */
+	ReplayGainTuple analyzed_gain = ReplayGainTuple::Undefined();
+
 public:
 	explicit DetachedSong(const char *_uri)
 		:uri(_uri) {}
@@ -228,6 +242,22 @@ public:
 		end_time = _value;
 	}
 
+	const AudioFormat &GetAudioFormat() const noexcept {
+		return audio_format;
+	}
+
+	void SetAudioFormat(const AudioFormat &src) noexcept {
+		audio_format = src;
+	}
+
+	const ReplayGainTuple &GetAnalyzedGain() const noexcept {
+		return analyzed_gain;
+	}
+
+	void SetAnalyzedGain(const ReplayGainTuple &_value) noexcept {
+		analyzed_gain = _value;
+	}
+
 	gcc_pure
 	SignedSongTime GetDuration() const noexcept;
 
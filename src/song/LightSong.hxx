@@ -22,6 +22,7 @@
 
 #include "Chrono.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "ReplayGainInfo.hxx"
 #include "util/Compiler.h"
 
 #include <string>
@@ -85,6 +86,12 @@ struct LightSong {
 	 */
 	AudioFormat audio_format = AudioFormat::Undefined();
 
+	/**
+	 * The track gain calculated by the loudness analysis.  May be
+	 * undefined if the song has not been analyzed.
+	 */
+	ReplayGainTuple analyzed_gain = ReplayGainTuple::Undefined();
+
 	LightSong(const char *_uri, const Tag &_tag) noexcept
 		:uri(_uri), tag(_tag) {}
 
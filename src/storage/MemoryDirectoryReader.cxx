@@ -43,3 +43,22 @@ MemoryStorageDirectoryReader::GetInfo([[maybe_unused]] bool follow)
 
 	return entries.front().info;
 }
+
+std::size_t
+MemoryStorageDirectoryReader::ReadBatch(std::vector<Entry> &dest,
+					std::size_t max_entries,
+					[[maybe_unused]] bool follow)
+{
+	/* don't mix with Read() */
+	assert(first);
+
+	/* the attributes are already known; just move them */
+
+	std::size_t n = 0;
+	for (; n < max_entries && !entries.empty(); ++n) {
+		dest.emplace_back(std::move(entries.front()));
+		entries.pop_front();
+	}
+
+	return n;
+}
@@ -32,15 +32,6 @@
  */
 class MemoryStorageDirectoryReader final : public StorageDirectoryReader {
 public:
-	struct Entry {
-		std::string name;
-
-		StorageFileInfo info;
-
-		template<typename N>
-		explicit Entry(N &&_name):name(std::forward<N>(_name)) {}
-	};
-
 	typedef std::forward_list<Entry> List;
 
 private:
@@ -61,6 +52,8 @@ public:
 	/* virtual methods from class StorageDirectoryReader */
 	const char *Read() noexcept override;
 	StorageFileInfo GetInfo(bool follow) override;
+	std::size_t ReadBatch(std::vector<Entry> &dest,
+			      std::size_t max_entries, bool follow) override;
 };
 
 #endif
@@ -21,6 +21,27 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 
+std::size_t
+StorageDirectoryReader::ReadBatch(std::vector<Entry> &dest,
+				  std::size_t max_entries, bool follow)
+{
+	std::size_t n = 0;
+
+	const char *name;
+	while (n < max_entries && (name = Read()) != nullptr) {
+		auto &entry = dest.emplace_back(name);
+		++n;
+
+		try {
+			entry.info = GetInfo(follow);
+		} catch (...) {
+			entry.error = std::current_exception();
+		}
+	}
+
+	return n;
+}
+
 AllocatedPath
 Storage::MapFS([[maybe_unused]] std::string_view uri_utf8) const noexcept
 {
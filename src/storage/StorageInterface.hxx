@@ -20,17 +20,39 @@
 #ifndef MPD_STORAGE_INTERFACE_HXX
 #define MPD_STORAGE_INTERFACE_HXX
 
+#include "FileInfo.hxx"
 #include "util/Compiler.h"
 
+#include <cstddef>
+#include <exception>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 
-struct StorageFileInfo;
 class AllocatedPath;
 
 class StorageDirectoryReader {
 public:
+	/**
+	 * A directory entry with its attributes, see ReadBatch().
+	 */
+	struct Entry {
+		std::string name;
+
+		StorageFileInfo info;
+
+		/**
+		 * If set, then the attributes could not be obtained
+		 * (e.g. a dangling symlink), and #info is undefined.
+		 */
+		std::exception_ptr error;
+
+		template<typename N>
+		explicit Entry(N &&_name)
+			:name(std::forward<N>(_name)) {}
+	};
+
 	StorageDirectoryReader() = default;
 	StorageDirectoryReader(const StorageDirectoryReader &) = delete;
 	virtual ~StorageDirectoryReader() noexcept {}
@@ -41,6 +63,22 @@ public:
 	 * Throws #std::runtime_error on error.
 	 */
 	virtual StorageFileInfo GetInfo(bool follow) = 0;
+
+	/**
+	 * Read up to the given number of entries together with their
+	 * attributes and append them to the given list.  This
+	 * replaces Read() and GetInfo(); don't mix both APIs.
+	 *
+	 * The default implementation calls Read() and GetInfo() for
+	 * each entry; storages which obtain the attributes together
+	 * with the listing (e.g. NFS READDIRPLUS) or more cheaply
+	 * should override it.
+	 *
+	 * @return the number of entries appended (0 at the end of
+	 * the directory)
+	 */
+	virtual std::size_t ReadBatch(std::vector<Entry> &dest,
+				      std::size_t max_entries, bool follow);
 };
 
 class Storage {
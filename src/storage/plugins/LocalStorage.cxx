@@ -42,6 +42,10 @@ public:
 	/* virtual methods from class StorageDirectoryReader */
 	const char *Read() noexcept override;
 	StorageFileInfo GetInfo(bool follow) override;
+#ifndef _WIN32
+	std::size_t ReadBatch(std::vector<Entry> &dest,
+			      std::size_t max_entries, bool follow) override;
+#endif
 };
 
 class LocalStorage final : public Storage {
@@ -71,9 +75,8 @@ private:
 };
 
 static StorageFileInfo
-Stat(Path path, bool follow)
+ToStorageFileInfo(const FileInfo &src) noexcept
 {
-	const FileInfo src(path, follow);
 	StorageFileInfo info;
 
 	if (src.IsRegular())
@@ -94,6 +97,12 @@ Stat(Path path, bool follow)
 	return info;
 }
 
+static StorageFileInfo
+Stat(Path path, bool follow)
+{
+	return ToStorageFileInfo(FileInfo(path, follow));
+}
+
 std::string
 LocalStorage::MapUTF8(std::string_view uri_utf8) const noexcept
 {
@@ -164,6 +173,36 @@ LocalDirectoryReader::GetInfo(bool follow)
 	return Stat(base_fs / reader.GetEntry(), follow);
 }
 
+#ifndef _WIN32
+
+std::size_t
+LocalDirectoryReader::ReadBatch(std::vector<Entry> &dest,
+				std::size_t max_entries, bool follow)
+{
+	const int fd = reader.GetFD();
+
+	std::size_t n = 0;
+
+	const char *name;
+	while (n < max_entries && (name = Read()) != nullptr) {
+		auto &entry = dest.emplace_back(name);
+		++n;
+
+		/* stat relative to the directory instead of building
+		   and resolving the full path */
+		FileInfo fi;
+		if (GetFileInfoAt(fd, reader.GetEntry(), fi, follow))
+			entry.info = ToStorageFileInfo(fi);
+		else
+			entry.error = std::make_exception_ptr(FormatErrno("Failed to access %s",
+									  (base_fs / reader.GetEntry()).ToUTF8().c_str()));
+	}
+
+	return n;
+}
+
+#endif
+
 std::unique_ptr<Storage>
 CreateLocalStorage(Path base_fs)
 {
@@ -65,7 +65,7 @@ protected:
 	 */
 	size_type tail;
 
-	const size_type capacity;
+	size_type capacity;
 	const pointer data;
 
 public:
@@ -90,6 +90,31 @@ public:
 		return capacity;
 	}
 
+	/**
+	 * Change the capacity of this buffer without moving the
+	 * contents.  The caller is responsible for making sure that
+	 * the underlying memory is large enough.
+	 *
+	 * This is only possible if the buffer is empty or if the
+	 * contents do not wrap around and fit into the new capacity.
+	 * Calling this method with a pending Write() range is not
+	 * allowed.
+	 *
+	 * @return true on success, false if the capacity was not
+	 * changed
+	 */
+	bool Resize(size_type new_capacity) {
+		assert(new_capacity > 1);
+
+		if (empty()) {
+			head = tail = 0;
+		} else if (head > tail || tail >= new_capacity)
+			return false;
+
+		capacity = new_capacity;
+		return true;
+	}
+
 	constexpr bool empty() const {
 		return head == tail;
 	}
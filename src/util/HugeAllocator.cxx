@@ -29,6 +29,7 @@
 
 #include "HugeAllocator.hxx"
 
+#include <cstdint>
 #include <new>
 
 #ifdef __linux__
@@ -99,6 +100,23 @@ HugeDiscard(void *p, size_t size) noexcept
 #endif
 }
 
+void
+HugeDiscardPartial(void *p, size_t size) noexcept
+{
+#ifdef MADV_DONTNEED
+	static const long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		return;
+
+	/* round the start up and the end down to page boundaries */
+	const uintptr_t ps(page_size);
+	const uintptr_t begin = ((uintptr_t)p + ps - 1) / ps * ps;
+	const uintptr_t end = ((uintptr_t)p + size) / ps * ps;
+	if (begin < end)
+		madvise((void *)begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
 #elif defined(_WIN32)
 
 WritableBuffer<void>
@@ -32,6 +32,7 @@
 
 #include "WritableBuffer.hxx"
 
+#include <cassert>
 #include <cstddef>
 #include <utility>
 
@@ -76,6 +77,14 @@ HugeForkCow(void *p, size_t size, bool enable) noexcept;
 void
 HugeDiscard(void *p, size_t size) noexcept;
 
+/**
+ * Like HugeDiscard(), but the range may be any part of an allocation.
+ * Only pages which lie completely inside the range are given back to
+ * the kernel; the contents of the rest of the range are preserved.
+ */
+void
+HugeDiscardPartial(void *p, size_t size) noexcept;
+
 #elif defined(_WIN32)
 #include <windows.h>
 
@@ -99,6 +108,11 @@ HugeDiscard(void *p, size_t size) noexcept
 	VirtualAlloc(p, size, MEM_RESET, PAGE_NOACCESS);
 }
 
+static inline void
+HugeDiscardPartial(void *, size_t) noexcept
+{
+}
+
 #else
 
 /* not Linux: fall back to standard C calls */
@@ -128,6 +142,11 @@ HugeDiscard(void *, size_t) noexcept
 {
 }
 
+static inline void
+HugeDiscardPartial(void *, size_t) noexcept
+{
+}
+
 #endif
 
 /**
@@ -177,6 +196,16 @@ public:
 		HugeDiscard(v.data, v.size);
 	}
 
+	/**
+	 * Discard all elements starting at the given index.
+	 */
+	void DiscardFrom(size_type start) noexcept {
+		assert(start <= buffer.size);
+
+		HugeDiscardPartial(buffer.data + start,
+				   (buffer.size - start) * sizeof(value_type));
+	}
+
 	constexpr bool operator==(std::nullptr_t) const noexcept {
 		return buffer == nullptr;
 	}
@@ -19,6 +19,7 @@
 
 #include "PeakBuffer.hxx"
 #include "DynamicFifoBuffer.hxx"
+#include "WritableBuffer.hxx"
 
 #include <algorithm>
 #include <cassert>
@@ -38,6 +39,17 @@ PeakBuffer::empty() const noexcept
 		(peak_buffer == nullptr || peak_buffer->empty());
 }
 
+size_t
+PeakBuffer::GetSize() const noexcept
+{
+	size_t size = 0;
+	if (normal_buffer != nullptr)
+		size += normal_buffer->GetAvailable();
+	if (peak_buffer != nullptr)
+		size += peak_buffer->GetAvailable();
+	return size;
+}
+
 WritableBuffer<void>
 PeakBuffer::Read() const noexcept
 {
@@ -56,12 +68,39 @@ PeakBuffer::Read() const noexcept
 	return nullptr;
 }
 
+unsigned
+PeakBuffer::ReadAll(WritableBuffer<void> *dest) const noexcept
+{
+	unsigned n = 0;
+
+	if (normal_buffer != nullptr) {
+		const auto p = normal_buffer->Read();
+		if (!p.empty())
+			dest[n++] = p.ToVoid();
+	}
+
+	if (peak_buffer != nullptr) {
+		const auto p = peak_buffer->Read();
+		if (!p.empty())
+			dest[n++] = p.ToVoid();
+	}
+
+	return n;
+}
+
 void
 PeakBuffer::Consume(size_t length) noexcept
 {
 	if (normal_buffer != nullptr && !normal_buffer->empty()) {
-		normal_buffer->Consume(length);
-		return;
+		const size_t available = normal_buffer->GetAvailable();
+		if (length <= available) {
+			normal_buffer->Consume(length);
+			return;
+		}
+
+		/* the rest is in the peak buffer */
+		normal_buffer->Consume(available);
+		length -= available;
 	}
 
 	if (peak_buffer != nullptr && !peak_buffer->empty()) {
@@ -133,3 +172,69 @@ PeakBuffer::Append(const void *data, size_t length)
 	nbytes = AppendTo(*peak_buffer, data, length);
 	return nbytes == length;
 }
+
+/**
+ * Can the given number of bytes be written without growing the
+ * buffer?
+ */
+gcc_pure
+static bool
+CanWrite(const DynamicFifoBuffer<uint8_t> &buffer, size_t length) noexcept
+{
+	return buffer.GetAvailable() + length <= buffer.GetCapacity();
+}
+
+static WritableBuffer<void>
+Reserve(DynamicFifoBuffer<uint8_t> &buffer, size_t length) noexcept
+{
+	assert(CanWrite(buffer, length));
+
+	/* this only shifts the buffer, because it is large
+	   enough */
+	buffer.WantWrite(length);
+	return buffer.Write().ToVoid();
+}
+
+WritableBuffer<void>
+PeakBuffer::Write(size_t min_length) noexcept
+{
+	assert(min_length > 0);
+	assert(reserved == nullptr);
+
+	/* like Append(const void *, size_t), use the normal buffer
+	   unless there is data in the peak buffer, to keep the
+	   order */
+	if (peak_buffer == nullptr || peak_buffer->empty()) {
+		if (normal_buffer == nullptr)
+			normal_buffer = new DynamicFifoBuffer<uint8_t>(normal_size);
+
+		if (CanWrite(*normal_buffer, min_length)) {
+			reserved = normal_buffer;
+			return Reserve(*normal_buffer, min_length);
+		}
+	}
+
+	if (peak_buffer == nullptr) {
+		if (peak_size == 0)
+			return nullptr;
+
+		peak_buffer = new DynamicFifoBuffer<uint8_t>(peak_size);
+	}
+
+	if (!CanWrite(*peak_buffer, min_length))
+		return nullptr;
+
+	reserved = peak_buffer;
+	return Reserve(*peak_buffer, min_length);
+}
+
+void
+PeakBuffer::Append(size_t length) noexcept
+{
+	assert(reserved != nullptr);
+
+	if (length > 0)
+		reserved->Append(length);
+
+	reserved = nullptr;
+}
@@ -38,6 +38,12 @@ class PeakBuffer {
 
 	DynamicFifoBuffer<uint8_t> *normal_buffer, *peak_buffer;
 
+	/**
+	 * The buffer returned by the last Write(size_t) call, to be
+	 * committed by Append(size_t).
+	 */
+	DynamicFifoBuffer<uint8_t> *reserved = nullptr;
+
 public:
 	PeakBuffer(size_t _normal_size, size_t _peak_size)
 		:normal_size(_normal_size), peak_size(_peak_size),
@@ -46,9 +52,11 @@ public:
 	PeakBuffer(PeakBuffer &&other)
 		:normal_size(other.normal_size), peak_size(other.peak_size),
 		 normal_buffer(other.normal_buffer),
-		 peak_buffer(other.peak_buffer) {
+		 peak_buffer(other.peak_buffer),
+		 reserved(other.reserved) {
 		other.normal_buffer = nullptr;
 		other.peak_buffer = nullptr;
+		other.reserved = nullptr;
 	}
 
 	~PeakBuffer();
@@ -59,12 +67,52 @@ public:
 	gcc_pure
 	bool empty() const noexcept;
 
+	/**
+	 * Returns the number of bytes which are currently buffered.
+	 */
+	gcc_pure
+	size_t GetSize() const noexcept;
+
 	gcc_pure
 	WritableBuffer<void> Read() const noexcept;
 
+	/**
+	 * Like Read(), but return all buffered data, which may be
+	 * split into two chunks (the normal and the peak buffer), so
+	 * it can be sent with one writev() call.
+	 *
+	 * @param dest an array of two buffers
+	 * @return the number of non-empty chunks stored in #dest (0,
+	 * 1 or 2)
+	 */
+	unsigned ReadAll(WritableBuffer<void> *dest) const noexcept;
+
+	/**
+	 * Remove data from the beginning of the buffer.  The length
+	 * may span both chunks returned by ReadAll().
+	 */
 	void Consume(size_t length) noexcept;
 
 	bool Append(const void *data, size_t length);
+
+	/**
+	 * Prepare writing at least #min_length contiguous bytes at the
+	 * end of the buffer.  The caller may write to the returned
+	 * buffer and then call Append(size_t).  No other method may
+	 * be called in between.
+	 *
+	 * @return a buffer of at least #min_length bytes, or nullptr
+	 * if there is not enough contiguous space (Append(const
+	 * void *, size_t) may still succeed, because it can split the
+	 * data)
+	 */
+	WritableBuffer<void> Write(size_t min_length) noexcept;
+
+	/**
+	 * Commit data which was written to the buffer returned by
+	 * Write(size_t).  A length of 0 cancels the operation.
+	 */
+	void Append(size_t length) noexcept;
 };
 
 #endif
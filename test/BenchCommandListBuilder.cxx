@@ -0,0 +1,154 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measure the speed of queueing a large command list in
+ * #CommandListBuilder and tokenizing its commands (as done for
+ * clients which add many songs at once), and count the heap
+ * allocations.  This covers only what Client::ProcessLine() and
+ * Client::ProcessCommandList() do before command_process(); the
+ * command lookup and the handlers are not measured.
+ */
+
+#include "command/CommandListBuilder.hxx"
+#include "client/Config.hxx"
+#include "util/Tokenizer.hxx"
+
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr unsigned N_COMMANDS = 10000;
+static constexpr unsigned N_ITERATIONS = 100;
+
+size_t client_max_command_list_size = 64 * 1024 * 1024;
+
+static size_t n_allocations;
+
+void *
+operator new(std::size_t size)
+{
+	++n_allocations;
+
+	void *p = malloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+	free(p);
+}
+
+static std::vector<std::string>
+MakeCommands()
+{
+	std::vector<std::string> commands;
+	commands.reserve(N_COMMANDS);
+
+	for (unsigned i = 0; i < N_COMMANDS; ++i) {
+		const unsigned album = i / 12, artist = album / 5;
+		commands.emplace_back("addid \"Artist " + std::to_string(artist) +
+				      "/Album " + std::to_string(album) +
+				      "/" + std::to_string(i % 12 + 1) +
+				      " - Title of Song Number " +
+				      std::to_string(i) + ".flac\"");
+	}
+
+	return commands;
+}
+
+/**
+ * @return the number of arguments
+ */
+static size_t
+Run(const std::vector<std::string> &commands)
+{
+	CommandListBuilder builder;
+	builder.Begin(false);
+
+	for (const auto &i : commands)
+		if (!builder.Add(i.c_str()))
+			abort();
+
+	auto list = builder.Commit();
+	builder.Reset();
+
+	size_t n_args = 0;
+
+	char *const end = list.data() + list.size();
+	for (char *cmd = list.data(), *next; cmd != end; cmd = next) {
+		next = cmd + strlen(cmd) + 1;
+
+		Tokenizer tokenizer(cmd);
+		if (tokenizer.NextWord() == nullptr)
+			abort();
+
+		while (tokenizer.NextParam() != nullptr)
+			++n_args;
+	}
+
+	return n_args;
+}
+
+int
+main(int, char **)
+try {
+	const auto commands = MakeCommands();
+
+	/* warm up */
+	Run(commands);
+
+	n_allocations = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	size_t n_args = 0;
+	for (unsigned i = 0; i < N_ITERATIONS; ++i)
+		n_args += Run(commands);
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%u commands, %zu arguments per iteration\n",
+	       N_COMMANDS, n_args / N_ITERATIONS);
+	printf("%.1f commands/ms\n",
+	       N_COMMANDS * N_ITERATIONS / duration.count() / 1e3);
+	printf("%zu allocations (%.2f per command)\n",
+	       n_allocations,
+	       double(n_allocations) / (N_COMMANDS * N_ITERATIONS));
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
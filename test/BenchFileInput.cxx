@@ -0,0 +1,157 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Compare the CPU cost of reading a local file with read() and with
+ * mmap() (copying and zero-copy).  The file is read repeatedly in
+ * small chunks (like a decoder does), and the result is printed as
+ * CPU seconds per hour of audio at the given byte rate.
+ */
+
+#include "input/InputStream.hxx"
+#include "input/plugins/FileInputPlugin.hxx"
+#include "fs/Path.hxx"
+#include "util/PrintException.hxx"
+
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr size_t CHUNK_SIZE = 8192;
+
+/**
+ * Read at least this number of bytes in each mode.
+ */
+static constexpr offset_type MIN_TOTAL = offset_type(1) << 30;
+
+enum class Mode {
+	READ,
+	MMAP,
+	PEEK,
+};
+
+static double
+GetCpuTime() noexcept
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static offset_type
+ReadOnce(Path path, Mode mode, uint8_t &checksum)
+{
+	SetFileInputMmap(mode != Mode::READ);
+
+	Mutex mutex;
+	auto is = OpenFileInputStream(path, mutex);
+	std::unique_lock<Mutex> lock(mutex);
+
+	offset_type total = 0;
+	uint8_t buffer[CHUNK_SIZE];
+
+	while (true) {
+		if (mode == Mode::PEEK) {
+			auto p = is->Peek(lock);
+			if (!p.empty()) {
+				const size_t nbytes = std::min(p.size,
+							       CHUNK_SIZE);
+				const auto *data = (const uint8_t *)p.data;
+				for (size_t i = 0; i < nbytes; i += 4096)
+					checksum ^= data[i];
+
+				is->Skip(lock, nbytes);
+				total += nbytes;
+				continue;
+			}
+
+			/* mmap not available for this file */
+		}
+
+		size_t nbytes = is->Read(lock, buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		for (size_t i = 0; i < nbytes; i += 4096)
+			checksum ^= buffer[i];
+
+		total += nbytes;
+	}
+
+	return total;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: BenchFileInput FILE [BYTES_PER_SECOND]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path path = Path::FromFS(argv[1]);
+
+	/* default: CD audio */
+	const double byte_rate = argc > 2 ? strtod(argv[2], nullptr) : 176400;
+	if (byte_rate <= 0) {
+		fprintf(stderr, "Invalid byte rate\n");
+		return EXIT_FAILURE;
+	}
+
+	static constexpr struct {
+		Mode mode;
+		const char *name;
+	} modes[] = {
+		{ Mode::READ, "read" },
+		{ Mode::MMAP, "mmap" },
+		{ Mode::PEEK, "mmap+peek" },
+	};
+
+	uint8_t checksum = 0;
+
+	/* warm up the page cache */
+	ReadOnce(path, Mode::READ, checksum);
+
+	for (const auto &m : modes) {
+		const double start = GetCpuTime();
+
+		offset_type total = 0;
+		do {
+			total += ReadOnce(path, m.mode, checksum);
+		} while (total > 0 && total < MIN_TOTAL);
+
+		const double cpu = GetCpuTime() - start;
+		const double hours = total / byte_rate / 3600;
+
+		printf("%-10s %8.3f CPU seconds for %.1f MiB; "
+		       "%.3f CPU seconds per decoded hour\n",
+		       m.name, cpu, total / (1024. * 1024.),
+		       hours > 0 ? cpu / hours : 0.);
+	}
+
+	/* print the checksum so the compiler doesn't optimize the
+	   loops away */
+	printf("checksum %02x\n", checksum);
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
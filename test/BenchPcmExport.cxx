@@ -0,0 +1,175 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measure the speed of PcmExport for the combinations commonly used
+ * with USB DACs, and compare the optimized word kernels with the
+ * portable ones.  The result is printed as multiples of real time.
+ */
+
+#include "config.h"
+#include "pcm/Export.hxx"
+#include "pcm/ExportWords.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <chrono>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The duration of the test signal in seconds.
+ */
+static constexpr unsigned SECONDS = 10;
+
+static constexpr unsigned CHANNELS = 2;
+
+/**
+ * The chunk size passed to PcmExport::Export(), similar to what
+ * the ALSA output plugin gets.
+ */
+static constexpr size_t CHUNK_SIZE = 16384;
+
+template<typename F>
+static double
+Measure(size_t size, F &&f)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < SECONDS; ++i)
+		for (size_t j = 0; j < size; j += CHUNK_SIZE)
+			f(j, std::min(CHUNK_SIZE, size - j));
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	return SECONDS / duration.count();
+}
+
+/**
+ * @param sample_rate the input sample rate (for DSD: the number of
+ * bytes per second and channel)
+ */
+static void
+RunExport(const char *name, SampleFormat format, unsigned sample_rate,
+	  PcmExport::Params params)
+{
+	const size_t size = size_t(sample_rate) * CHANNELS *
+		sample_format_size(format);
+	std::vector<uint8_t> src(size);
+	for (size_t i = 0; i < size; ++i)
+		src[i] = i * 7;
+
+	PcmExport e;
+	e.Open(format, CHANNELS, params);
+
+	size_t checksum = 0;
+	const double speed = Measure(size, [&](size_t offset, size_t n){
+		checksum += e.Export({&src[offset], n}).size;
+	});
+
+	if (checksum == 0)
+		abort();
+
+	printf("%-36s %8.1fx real time\n", name, speed);
+}
+
+static void
+RunWords(const char *name, PcmWordExport mode)
+{
+	/* S24_P32 at 384 kHz */
+	const size_t n_words = 384000 * CHANNELS;
+	std::vector<uint32_t> src(n_words);
+	for (size_t i = 0; i < n_words; ++i)
+		src[i] = i * 0x10101;
+
+	std::vector<uint8_t> dest(CHUNK_SIZE);
+
+	const auto generic = PcmGenericWordExport(mode);
+	const auto optimized = PcmSelectWordExport(mode);
+
+	const double generic_speed =
+		Measure(n_words * 4, [&](size_t offset, size_t n){
+			generic(dest.data(), &src[offset / 4], n / 4);
+		});
+
+	const double optimized_speed =
+		Measure(n_words * 4, [&](size_t offset, size_t n){
+			optimized(dest.data(), &src[offset / 4], n / 4);
+		});
+
+	printf("%-20s generic %8.1fx, optimized %8.1fx real time\n",
+	       name, generic_speed, optimized_speed);
+}
+
+int
+main(int, char **)
+{
+	PcmExport::Params params;
+	params.pack24 = true;
+	RunExport("S24_P32 192k -> S24_3LE", SampleFormat::S24_P32,
+		  192000, params);
+
+	params.reverse_endian = true;
+	RunExport("S24_P32 192k -> S24_3BE", SampleFormat::S24_P32,
+		  192000, params);
+
+	params = {};
+	params.reverse_endian = true;
+	RunExport("S32 384k -> S32 reverse", SampleFormat::S32,
+		  384000, params);
+
+	params = {};
+	params.shift8 = true;
+	params.reverse_endian = true;
+	RunExport("S24_P32 384k -> S32 reverse", SampleFormat::S24_P32,
+		  384000, params);
+
+#ifdef ENABLE_DSD
+	/* DSD256: 11.2896 MHz = 1411200 bytes per second and channel */
+	static constexpr unsigned DSD256 = 1411200;
+
+	params = {};
+	params.dsd_mode = PcmExport::DsdMode::DOP;
+	RunExport("DSD256 -> DoP", SampleFormat::DSD, DSD256, params);
+
+	params.pack24 = true;
+	RunExport("DSD256 -> DoP S24_3LE", SampleFormat::DSD, DSD256, params);
+
+	params = {};
+	params.dsd_mode = PcmExport::DsdMode::DOP;
+	params.shift8 = true;
+	RunExport("DSD256 -> DoP S32", SampleFormat::DSD, DSD256, params);
+
+	params = {};
+	params.dsd_mode = PcmExport::DsdMode::U32;
+	RunExport("DSD256 -> DSD_U32_LE", SampleFormat::DSD, DSD256, params);
+
+	params.reverse_endian = true;
+	RunExport("DSD256 -> DSD_U32_BE", SampleFormat::DSD, DSD256, params);
+#endif
+
+	RunWords("reverse", PcmWordExport::REVERSE);
+	RunWords("shift8", PcmWordExport::SHIFT8);
+	RunWords("shift8 reverse", PcmWordExport::SHIFT8_REVERSE);
+	RunWords("pack24", PcmWordExport::PACK24);
+	RunWords("pack24 reverse", PcmWordExport::PACK24_REVERSE);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measure the speed of the polyphase resampler for common sample
+ * rate conversions at each quality setting, and the speed of
+ * multi-channel high-rate conversions with several threads.  The
+ * result is printed as multiples of real time.
+ */
+
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/SplitResampler.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "util/PrintException.hxx"
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * The duration of the test signal in seconds.
+ */
+static constexpr unsigned SECONDS = 20;
+
+static constexpr const char *qualities[] = {
+	"low", "medium", "high", "very high",
+};
+
+static constexpr struct {
+	unsigned from, to;
+} conversions[] = {
+	{ 44100, 48000 },
+	{ 48000, 44100 },
+	{ 44100, 88200 },
+	{ 96000, 48000 },
+	{ 44100, 192000 },
+};
+
+static constexpr unsigned thread_counts[] = { 1, 2, 4, 8 };
+
+static PcmResampler *
+CreatePolyphaseResampler()
+{
+	return new PolyphasePcmResampler();
+}
+
+static double
+Run(PcmResampler &r, unsigned channels, unsigned from, unsigned to)
+{
+	std::vector<float> src(std::size_t(from) * channels);
+	for (std::size_t i = 0; i < src.size(); ++i)
+		src[i] = 0.5f * std::sin(i * 0.01);
+
+	AudioFormat af(from, SampleFormat::FLOAT, channels);
+	r.Open(af, to);
+
+	std::size_t checksum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < SECONDS; ++i) {
+		/* submit one second in chunks of 4096 frames */
+		for (std::size_t j = 0; j < src.size(); j += 4096 * channels) {
+			const std::size_t n = std::min<std::size_t>(4096 * channels,
+								    src.size() - j);
+			checksum += r.Resample(ConstBuffer<float>(&src[j], n).ToVoid()).size;
+		}
+	}
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	r.Close();
+
+	if (checksum == 0)
+		abort();
+
+	return SECONDS / duration.count();
+}
+
+int
+main(int, char **)
+try {
+	for (const char *quality : qualities) {
+		ConfigBlock block;
+		block.AddBlockParam("quality", quality);
+		pcm_resample_polyphase_global_init(block);
+
+		for (const auto &c : conversions) {
+			PolyphasePcmResampler r;
+			printf("%-10s %6u -> %6u: %8.1fx real time\n",
+			       quality, c.from, c.to,
+			       Run(r, 2, c.from, c.to));
+		}
+	}
+
+	/* 8 channels from a DSD128-to-PCM conversion down to 192 kHz */
+	pcm_resample_polyphase_global_init(ConfigBlock());
+
+	for (unsigned n_threads : thread_counts) {
+		SplitPcmResampler r(CreatePolyphaseResampler, n_threads);
+		printf("8 channels %u threads 352800 -> 192000: %8.1fx real time\n",
+		       n_threads, Run(r, 8, 352800, 192000));
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
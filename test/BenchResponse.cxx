@@ -0,0 +1,269 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measure the speed of serializing song information (as in
+ * "listallinfo") for a synthetic library, and count the heap
+ * allocations, both with the text protocol and with the
+ * "binary_songs" protocol feature.  The client's output buffer is
+ * replaced by an in-memory sink, so this measures only the response
+ * formatting code.
+ */
+
+#include "MakeTag.hxx"
+#include "SongPrint.hxx"
+#include "client/Client.hxx"
+#include "client/BackgroundCommand.hxx"
+#include "client/Response.hxx"
+#include "song/LightSong.hxx"
+#include "event/Loop.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/WritableBuffer.hxx"
+#include "config.h"
+
+#ifdef ENABLE_ZLIB
+#include "client/Deflate.hxx"
+#endif
+
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static constexpr unsigned N_SONGS = 100000;
+static constexpr unsigned N_ITERATIONS = 10;
+
+static size_t n_allocations;
+
+void *
+operator new(std::size_t size)
+{
+	++n_allocations;
+
+	void *p = malloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void
+operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+	free(p);
+}
+
+/**
+ * Replaces the client's output buffer; it is "drained" whenever it
+ * is full.
+ */
+static struct {
+	char data[1024 * 1024];
+	size_t fill;
+	size_t total;
+} sink;
+
+/* stubs for the Client class */
+
+Client::Client(EventLoop &_loop, Partition &_partition,
+	       UniqueSocketDescriptor _fd,
+	       int _uid, unsigned _permission,
+	       int _num) noexcept
+	:FullyBufferedSocket(_fd.Release(), _loop, 16384),
+	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+	 partition(&_partition),
+	 permission(_permission),
+	 uid(_uid),
+	 num(_num)
+{
+}
+
+Client::~Client() noexcept
+{
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+BufferedSocket::InputResult
+Client::OnSocketInput(void *, size_t) noexcept
+{
+	return InputResult::PAUSE;
+}
+
+void
+Client::OnSocketError(std::exception_ptr) noexcept
+{
+}
+
+void
+Client::OnSocketClosed() noexcept
+{
+}
+
+void
+Client::OnOutputDrained() noexcept
+{
+}
+
+void
+Client::OnIdle() noexcept
+{
+	FullyBufferedSocket::OnIdle();
+}
+
+void
+Client::OnTimeout() noexcept
+{
+}
+
+WritableBuffer<void>
+Client::BeginWrite(size_t min_length) noexcept
+{
+	if (sink.fill + min_length > sizeof(sink.data))
+		sink.fill = 0;
+
+	return {sink.data + sink.fill, sizeof(sink.data) - sink.fill};
+}
+
+void
+Client::CommitWrite(size_t length) noexcept
+{
+	sink.fill += length;
+	sink.total += length;
+}
+
+bool
+Client::Write(const void *data, size_t length) noexcept
+{
+	auto w = BeginWrite(length);
+	memcpy(w.data, data, length);
+	CommitWrite(length);
+	return true;
+}
+
+bool
+Client::Write(const char *data) noexcept
+{
+	return Write(data, strlen(data));
+}
+
+struct Library {
+	std::vector<Tag> tags;
+	std::vector<std::string> directories, uris;
+
+	Library() {
+		tags.reserve(N_SONGS);
+		directories.reserve(N_SONGS);
+		uris.reserve(N_SONGS);
+
+		for (unsigned i = 0; i < N_SONGS; ++i) {
+			const unsigned album = i / 12, artist = album / 5;
+			const auto artist_name = "Artist " + std::to_string(artist);
+			const auto album_name = "Album " + std::to_string(album);
+			const auto title = "Title of Song Number " + std::to_string(i);
+			const auto track = std::to_string(i % 12 + 1);
+
+			tags.emplace_back(MakeTag(TAG_ARTIST, artist_name.c_str(),
+						  TAG_ALBUM_ARTIST, artist_name.c_str(),
+						  TAG_ALBUM, album_name.c_str(),
+						  TAG_TITLE, title.c_str(),
+						  TAG_TRACK, track.c_str(),
+						  TAG_DATE, "1999",
+						  TAG_GENRE, "Rock"));
+			tags.back().duration = SignedSongTime::FromMS(180000 + i);
+
+			directories.emplace_back(artist_name + "/" + album_name);
+			uris.emplace_back(track + " - " + title + ".flac");
+		}
+	}
+};
+
+static void
+Print(Response &r, const Library &library)
+{
+	for (unsigned i = 0; i < N_SONGS; ++i) {
+		LightSong song(library.uris[i].c_str(), library.tags[i]);
+		song.directory = library.directories[i].c_str();
+		song.mtime = std::chrono::system_clock::from_time_t(1500000000 + i);
+		song.audio_format = AudioFormat(44100, SampleFormat::S16, 2);
+		song_print_info(r, song);
+	}
+}
+
+static void
+Run(Response &r, const Library &library, const char *label)
+{
+	/* warm up */
+	Print(r, library);
+
+	sink.total = 0;
+	n_allocations = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < N_ITERATIONS; ++i)
+		Print(r, library);
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%s: %u songs, %zu bytes per iteration\n",
+	       label, N_SONGS, sink.total / N_ITERATIONS);
+	printf("%.1f MB/s, %.1f songs/ms\n",
+	       sink.total / duration.count() / 1e6,
+	       N_SONGS * N_ITERATIONS / duration.count() / 1e3);
+	printf("%zu allocations (%.2f per song)\n",
+	       n_allocations, double(n_allocations) / (N_SONGS * N_ITERATIONS));
+}
+
+int
+main(int, char **)
+{
+	UniqueSocketDescriptor a, b;
+	if (!UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL, SOCK_STREAM,
+						      0, a, b)) {
+		perror("socketpair() failed");
+		return EXIT_FAILURE;
+	}
+
+	EventLoop loop;
+	alignas(std::max_align_t) static char partition[1];
+	Client client(loop, *(Partition *)(void *)partition, std::move(a),
+		      0, 0, 0);
+	Response r(client, 0);
+
+	const Library library;
+
+	Run(r, library, "text");
+
+	client.binary_songs = true;
+	Run(r, library, "binary_songs");
+
+	return EXIT_SUCCESS;
+}
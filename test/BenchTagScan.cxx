@@ -0,0 +1,361 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmark for the tag scanner which is used by the database
+ * update.  A synthetic directory tree with files of several formats
+ * is generated, and the time needed to scan all of them is compared
+ * between the old strategy (one open per plugin attempt and another
+ * one for the generic tag scanners) and ScanFileTagsWithGeneric().
+ */
+
+#include "TagFile.hxx"
+#include "config/Data.hxx"
+#include "event/Thread.hxx"
+#include "decoder/DecoderList.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "input/Init.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Generic.hxx"
+#include "tag/Handler.hxx"
+#include "fs/Path.hxx"
+#include "util/PrintException.hxx"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static constexpr unsigned DEFAULT_FILES_PER_FORMAT = 200;
+
+static void
+Append(std::string &s, const char *p, size_t n)
+{
+	s.append(p, n);
+}
+
+static void
+Append(std::string &s, const char *p)
+{
+	s.append(p);
+}
+
+static void
+AppendLE(std::string &s, uint64_t value, unsigned n_bytes)
+{
+	for (unsigned i = 0; i < n_bytes; ++i)
+		s.push_back(char(value >> (8 * i)));
+}
+
+static void
+AppendBE(std::string &s, uint64_t value, unsigned n_bytes)
+{
+	for (unsigned i = n_bytes; i-- > 0;)
+		s.push_back(char(value >> (8 * i)));
+}
+
+/**
+ * An ID3v2.3 tag with a title frame.
+ */
+static std::string
+MakeId3v2(const std::string &title)
+{
+	std::string frame;
+	Append(frame, "TIT2");
+	AppendBE(frame, title.size() + 1, 4);
+	AppendBE(frame, 0, 2);
+	frame.push_back(0); /* ISO-8859-1 */
+	frame += title;
+
+	std::string s;
+	Append(s, "ID3\x03\0\0", 6);
+	const size_t size = frame.size();
+	s.push_back(char((size >> 21) & 0x7f));
+	s.push_back(char((size >> 14) & 0x7f));
+	s.push_back(char((size >> 7) & 0x7f));
+	s.push_back(char(size & 0x7f));
+	return s + frame;
+}
+
+static std::string
+MakeDsf(const std::string &title)
+{
+	static constexpr unsigned channels = 2, block_size = 4096;
+	const std::string id3 = MakeId3v2(title);
+	const uint64_t data_size = channels * block_size;
+	const uint64_t id3_offset = 28 + 52 + 12 + data_size;
+
+	std::string s;
+	Append(s, "DSD ");
+	AppendLE(s, 28, 8);
+	AppendLE(s, id3_offset + id3.size(), 8);
+	AppendLE(s, id3_offset, 8);
+
+	Append(s, "fmt ");
+	AppendLE(s, 52, 8);
+	AppendLE(s, 1, 4); /* version */
+	AppendLE(s, 0, 4); /* DSD raw */
+	AppendLE(s, 2, 4); /* stereo */
+	AppendLE(s, channels, 4);
+	AppendLE(s, 2822400, 4);
+	AppendLE(s, 1, 4); /* bits per sample */
+	AppendLE(s, block_size * 8, 8);
+	AppendLE(s, block_size, 4);
+	AppendLE(s, 0, 4);
+
+	Append(s, "data");
+	AppendLE(s, 12 + data_size, 8);
+	s.append(data_size, char(0x69));
+
+	return s + id3;
+}
+
+static std::string
+MakeWav(const std::string &)
+{
+	static constexpr unsigned data_size = 44100 * 4 / 10;
+
+	std::string s;
+	Append(s, "RIFF");
+	AppendLE(s, 36 + data_size, 4);
+	Append(s, "WAVEfmt ");
+	AppendLE(s, 16, 4);
+	AppendLE(s, 1, 2); /* PCM */
+	AppendLE(s, 2, 2);
+	AppendLE(s, 44100, 4);
+	AppendLE(s, 44100 * 4, 4);
+	AppendLE(s, 4, 2);
+	AppendLE(s, 16, 2);
+	Append(s, "data");
+	AppendLE(s, data_size, 4);
+	s.append(data_size, 0);
+	return s;
+}
+
+static std::string
+MakeFlac(const std::string &title)
+{
+	std::string s;
+	Append(s, "fLaC");
+
+	/* STREAMINFO */
+	s.push_back(0);
+	AppendBE(s, 34, 3);
+	AppendBE(s, 4096, 2);
+	AppendBE(s, 4096, 2);
+	AppendBE(s, 0, 3);
+	AppendBE(s, 0, 3);
+	/* 44100 Hz, 2 channels, 16 bits, 44100 samples */
+	AppendBE(s, (uint64_t(44100) << 44) | (uint64_t(1) << 41) |
+		 (uint64_t(15) << 36) | 44100, 8);
+	s.append(16, 0); /* MD5 */
+
+	/* VORBIS_COMMENT, last metadata block */
+	const std::string comment = "TITLE=" + title;
+	std::string vc;
+	AppendLE(vc, 3, 4);
+	Append(vc, "mpd");
+	AppendLE(vc, 1, 4);
+	AppendLE(vc, comment.size(), 4);
+	vc += comment;
+
+	s.push_back(char(0x80 | 4));
+	AppendBE(s, vc.size(), 3);
+	return s + vc;
+}
+
+static std::string
+MakeMp3(const std::string &title)
+{
+	/* MPEG-1 layer III, 128 kbit/s, 44.1 kHz: 417 bytes per
+	   frame */
+	static constexpr size_t frame_size = 417;
+
+	std::string s = MakeId3v2(title);
+	for (unsigned i = 0; i < 40; ++i) {
+		Append(s, "\xff\xfb\x90\x64", 4);
+		s.append(frame_size - 4, 0);
+	}
+
+	return s;
+}
+
+struct Format {
+	const char *suffix;
+	std::string (*make)(const std::string &title);
+};
+
+static constexpr Format formats[] = {
+	{ "dsf", MakeDsf },
+	{ "wav", MakeWav },
+	{ "flac", MakeFlac },
+	{ "mp3", MakeMp3 },
+};
+
+static void
+WriteFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == nullptr ||
+	    fwrite(contents.data(), 1, contents.size(), file) != contents.size() ||
+	    fclose(file) != 0) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+static std::vector<std::string>
+MakeTree(const char *base, unsigned files_per_format)
+{
+	std::vector<std::string> files;
+
+	for (const auto &format : formats) {
+		const std::string dir = std::string(base) + "/" + format.suffix;
+		mkdir(dir.c_str(), 0777);
+
+		for (unsigned i = 0; i < files_per_format; ++i) {
+			const std::string title = "Song " + std::to_string(i);
+			std::string path = dir + "/" + std::to_string(i) +
+				"." + format.suffix;
+			WriteFile(path, format.make(title));
+			files.emplace_back(std::move(path));
+		}
+	}
+
+	return files;
+}
+
+/**
+ * The old strategy: try each plugin in turn, and reopen the file
+ * for the generic scanners.
+ */
+static bool
+LegacyScan(Path path, TagBuilder &builder)
+{
+	const auto suffix_utf8 = Path::FromFS(path.GetSuffix()).ToUTF8();
+
+	FullTagHandler h(builder);
+	Mutex mutex;
+	InputStreamPtr is;
+
+	bool found = decoder_plugins_try([&](const DecoderPlugin &plugin){
+			if (!plugin.SupportsSuffix(suffix_utf8.c_str()))
+				return false;
+
+			if (plugin.ScanFile(path, h))
+				return true;
+
+			if (plugin.scan_stream == nullptr)
+				return false;
+
+			if (is == nullptr)
+				is = OpenLocalInputStream(path, mutex);
+			else
+				is->LockRewind();
+
+			return plugin.ScanStream(*is, h);
+		});
+	if (!found)
+		return false;
+
+	if (builder.empty())
+		ScanGenericTags(path, h);
+
+	return true;
+}
+
+static bool
+SingleOpenScan(Path path, TagBuilder &builder)
+{
+	return ScanFileTagsWithGeneric(path, builder);
+}
+
+template<typename F>
+static void
+Run(const char *name, const std::vector<std::string> &files, F &&f)
+{
+	unsigned n_recognized = 0, n_tagged = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (const auto &i : files) {
+		TagBuilder builder;
+		try {
+			if (f(Path::FromFS(i.c_str()), builder))
+				++n_recognized;
+		} catch (...) {
+			PrintException(std::current_exception());
+		}
+
+		if (!builder.empty())
+			++n_tagged;
+	}
+
+	const std::chrono::duration<double, std::micro> duration =
+		std::chrono::steady_clock::now() - start;
+
+	printf("%-12s %6u files %6u recognized %6u tagged %8.1f us/file\n",
+	       name, unsigned(files.size()), n_recognized, n_tagged,
+	       duration.count() / files.size());
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr,
+			"Usage: BenchTagScan DIRECTORY [FILES_PER_FORMAT]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *base = argv[1];
+	const unsigned files_per_format = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: DEFAULT_FILES_PER_FORMAT;
+
+	EventThread io_thread;
+	io_thread.Start();
+
+	const ScopeInputPluginsInit input_plugins_init(ConfigData(),
+						       io_thread.GetEventLoop());
+
+	const ScopeDecoderPluginsInit decoder_plugins_init({});
+
+	const auto files = MakeTree(base, files_per_format);
+
+	/* warm up the page cache */
+	Run("warmup", files, LegacyScan);
+
+	for (unsigned i = 0; i < 3; ++i) {
+		Run("legacy", files, LegacyScan);
+		Run("single-open", files, SingleOpenScan);
+	}
+
+	return EXIT_SUCCESS;
+} catch (...) {
+	PrintException(std::current_exception());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "input/AdaptiveBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+using std::chrono::seconds;
+
+static constexpr std::size_t KB = 1024, MB = 1024 * KB;
+
+/**
+ * Feed the given rate [bytes per second] for the given number of
+ * seconds.
+ */
+static std::size_t
+Consume(AdaptiveBufferSize &b, AdaptiveBufferSize::Clock::time_point &now,
+	std::size_t rate, unsigned n_seconds)
+{
+	std::size_t size = b.GetSize();
+	for (unsigned i = 0; i < n_seconds; ++i) {
+		size = b.OnConsumed(rate, 0, now);
+		now += seconds(1);
+	}
+
+	return size;
+}
+
+TEST(AdaptiveBuffer, Rate)
+{
+	SetInputBufferBudget(64 * MB);
+
+	AdaptiveBufferSize::Clock::time_point now{};
+	now += seconds(1000);
+
+	AdaptiveBufferSize b("test://", 64 * KB, 512 * KB, 8 * MB);
+	EXPECT_EQ(512 * KB, b.GetSize());
+	EXPECT_EQ(512 * KB, GetInputBufferUsage());
+
+	/* a low bitrate stream shrinks the buffer to the minimum */
+	EXPECT_EQ(64 * KB, Consume(b, now, 8 * KB, 10));
+	EXPECT_EQ(64 * KB, GetInputBufferUsage());
+
+	/* high bitrate: grows */
+	std::size_t size = Consume(b, now, 700 * KB, 20);
+	EXPECT_GT(size, 2 * MB);
+	EXPECT_LE(size, 4 * MB);
+
+	/* an underrun makes it grow even more */
+	EXPECT_GT(b.OnUnderrun(), size);
+	EXPECT_EQ(b.GetSize(), GetInputBufferUsage());
+
+	const auto info = GetInputBufferInfo();
+	ASSERT_EQ(std::size_t(1), info.size());
+	EXPECT_EQ("test://", info.front().uri);
+	EXPECT_EQ(1u, info.front().underruns);
+	EXPECT_GT(info.front().rate, 600 * KB);
+}
+
+TEST(AdaptiveBuffer, Budget)
+{
+	SetInputBufferBudget(1 * MB);
+
+	AdaptiveBufferSize::Clock::time_point now{};
+	now += seconds(1000);
+
+	{
+		AdaptiveBufferSize a("a", 64 * KB, 512 * KB, 8 * MB);
+		AdaptiveBufferSize b("b", 64 * KB, 512 * KB, 8 * MB);
+		EXPECT_EQ(1 * MB, GetInputBufferUsage());
+
+		/* the budget is exhausted; the minimum size is
+		   always granted */
+		AdaptiveBufferSize c("c", 64 * KB, 512 * KB, 8 * MB);
+		EXPECT_EQ(64 * KB, c.GetSize());
+
+		/* cannot grow */
+		EXPECT_EQ(64 * KB, Consume(c, now, 700 * KB, 10));
+
+		/* after "a" has shrunk, "c" may grow */
+		Consume(a, now, 8 * KB, 10);
+		EXPECT_EQ(64 * KB, a.GetSize());
+		EXPECT_GT(Consume(c, now, 700 * KB, 10), 64 * KB);
+		EXPECT_LE(GetInputBufferUsage(), 1 * MB + 64 * KB);
+	}
+
+	EXPECT_EQ(std::size_t(0), GetInputBufferUsage());
+}
@@ -148,3 +148,56 @@ TEST(CircularBuffer, Basic)
 	EXPECT_EQ(&data[3], buffer.Write().data);
 	EXPECT_EQ(size_t(5), buffer.Write().size);
 }
+
+TEST(CircularBuffer, Resize)
+{
+	constexpr size_t N = 8;
+	int data[N];
+	CircularBuffer<int> buffer(data, 4);
+
+	EXPECT_EQ(size_t(4), buffer.GetCapacity());
+	EXPECT_EQ(size_t(3), buffer.GetSpace());
+
+	/* grow an empty buffer */
+	EXPECT_TRUE(buffer.Resize(N));
+	EXPECT_EQ(N, buffer.GetCapacity());
+	EXPECT_EQ(size_t(7), buffer.GetSpace());
+
+	/* [..OOO...] */
+	buffer.Append(5);
+	buffer.Consume(2);
+
+	/* shrink: the contents still fit */
+	EXPECT_TRUE(buffer.Resize(6));
+	EXPECT_EQ(size_t(3), buffer.GetSize());
+	EXPECT_EQ(size_t(2), buffer.GetSpace());
+	EXPECT_EQ(&data[2], buffer.Read().data);
+	EXPECT_EQ(size_t(3), buffer.Read().size);
+
+	/* too small for the contents */
+	EXPECT_FALSE(buffer.Resize(5));
+	EXPECT_EQ(size_t(6), buffer.GetCapacity());
+
+	/* wrap around: [O.XOOO] */
+	buffer.Append(1);
+	buffer.Append(1);
+	EXPECT_EQ(size_t(5), buffer.GetSize());
+
+	/* contents wrap around, cannot grow */
+	EXPECT_FALSE(buffer.Resize(N));
+	EXPECT_EQ(size_t(6), buffer.GetCapacity());
+
+	/* [O.....]; not wrapped anymore, growing is possible */
+	buffer.Consume(4);
+	EXPECT_EQ(size_t(1), buffer.GetSize());
+	EXPECT_TRUE(buffer.Resize(N));
+	EXPECT_EQ(size_t(1), buffer.GetSize());
+	EXPECT_EQ(&data[0], buffer.Read().data);
+	EXPECT_EQ(size_t(6), buffer.GetSpace());
+
+	/* an empty buffer is rewound */
+	buffer.Consume(1);
+	EXPECT_TRUE(buffer.Resize(4));
+	EXPECT_EQ(&data[0], buffer.Write().data);
+	EXPECT_EQ(size_t(3), buffer.Write().size);
+}
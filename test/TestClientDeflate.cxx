@@ -0,0 +1,361 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Send responses through #ClientDeflate and inflate what arrives at
+ * the peer socket.
+ */
+
+#include "client/Client.hxx"
+#include "client/BackgroundCommand.hxx"
+#include "client/Deflate.hxx"
+#include "event/Loop.hxx"
+#include "event/TimerEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <zlib.h>
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <string.h>
+#include <sys/socket.h>
+
+static bool socket_error;
+
+/**
+ * The #ClientDeflate flushed by Client::OnIdle(), which is
+ * Client::deflate in the real implementation.
+ */
+static ClientDeflate *client_deflate;
+
+/* stubs for the Client class */
+
+Client::Client(EventLoop &_loop, Partition &_partition,
+	       UniqueSocketDescriptor _fd,
+	       int _uid, unsigned _permission,
+	       int _num) noexcept
+	:FullyBufferedSocket(_fd.Release(), _loop, 16384),
+	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+	 partition(&_partition),
+	 permission(_permission),
+	 uid(_uid),
+	 num(_num)
+{
+}
+
+Client::~Client() noexcept
+{
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+BufferedSocket::InputResult
+Client::OnSocketInput(void *, size_t) noexcept
+{
+	return InputResult::PAUSE;
+}
+
+void
+Client::OnSocketError(std::exception_ptr) noexcept
+{
+	socket_error = true;
+}
+
+void
+Client::OnSocketClosed() noexcept
+{
+}
+
+void
+Client::OnOutputDrained() noexcept
+{
+}
+
+void
+Client::OnIdle() noexcept
+{
+	if (client_deflate == nullptr || client_deflate->Flush())
+		FullyBufferedSocket::OnIdle();
+}
+
+void
+Client::OnTimeout() noexcept
+{
+}
+
+/**
+ * Inflates the data which arrives at the peer socket.
+ */
+class Inflater {
+	z_stream z{};
+
+public:
+	Inflater() {
+		/* gzip format */
+		if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK)
+			throw std::runtime_error("inflateInit2() failed");
+	}
+
+	~Inflater() noexcept {
+		inflateEnd(&z);
+	}
+
+	Inflater(const Inflater &) = delete;
+	Inflater &operator=(const Inflater &) = delete;
+
+	/**
+	 * Inflate all of the given data.  Since the sender flushes
+	 * its compressor after each response, the result is complete.
+	 */
+	std::string Inflate(const std::string &input) {
+		std::string result;
+
+		z.next_in = (Bytef *)const_cast<char *>(input.data());
+		z.avail_in = input.size();
+
+		char buffer[4096];
+		do {
+			z.next_out = (Bytef *)buffer;
+			z.avail_out = sizeof(buffer);
+
+			int status = inflate(&z, Z_SYNC_FLUSH);
+			if (status != Z_OK && status != Z_BUF_ERROR)
+				throw std::runtime_error("inflate() failed");
+
+			result.append(buffer, sizeof(buffer) - z.avail_out);
+		} while (z.avail_in > 0 || z.avail_out == 0);
+
+		return result;
+	}
+};
+
+class ClientDeflateTest : public ::testing::Test {
+	EventLoop event_loop;
+
+	TimerEvent step_timer{event_loop, BIND_THIS_METHOD(OnStepTimer)};
+
+	UniqueSocketDescriptor peer;
+
+	alignas(std::max_align_t) char partition[1];
+
+	std::vector<std::function<void()>> steps;
+	size_t next_step;
+
+protected:
+	std::unique_ptr<Client> client;
+
+	std::unique_ptr<ClientDeflate> deflate;
+
+	Inflater inflater;
+
+	void SetUp() override {
+		UniqueSocketDescriptor a;
+		ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+								     SOCK_STREAM,
+								     0, a, peer));
+		peer.SetNonBlocking();
+
+		client = std::make_unique<Client>(event_loop,
+						  *(Partition *)(void *)partition,
+						  std::move(a), 0, 0, 0);
+		deflate = std::make_unique<ClientDeflate>(*client);
+		client_deflate = deflate.get();
+		socket_error = false;
+	}
+
+	void TearDown() override {
+		client_deflate = nullptr;
+		deflate.reset();
+		client.reset();
+	}
+
+	/**
+	 * Read everything the client has sent so far.
+	 */
+	std::string Receive() {
+		std::string result;
+		char buffer[65536];
+		ssize_t nbytes;
+		while ((nbytes = peer.Read(buffer, sizeof(buffer))) > 0)
+			result.append(buffer, nbytes);
+		return result;
+	}
+
+	/**
+	 * Run the #EventLoop, invoking each step in a separate event
+	 * loop iteration.  The steps are separated by a short delay,
+	 * which gives the client socket time to send the output of
+	 * the previous step.  This can be called only once per test.
+	 */
+	void RunSteps(std::vector<std::function<void()>> &&_steps) noexcept {
+		steps = std::move(_steps);
+		next_step = 0;
+		step_timer.Schedule(std::chrono::milliseconds(20));
+		event_loop.Run();
+	}
+
+private:
+	void OnStepTimer() noexcept {
+		if (next_step == steps.size()) {
+			event_loop.Break();
+			return;
+		}
+
+		steps[next_step++]();
+		step_timer.Schedule(std::chrono::milliseconds(20));
+	}
+};
+
+/**
+ * Generate a large, compressible response.
+ */
+static std::string
+MakeLargeResponse(unsigned n)
+{
+	std::string response;
+	for (unsigned i = 0; i < n; ++i)
+		response += "file: Artist/Album/" + std::to_string(i) +
+			" - Title.flac\nTitle: Title of Song " +
+			std::to_string(i) + "\n";
+	response += "OK\n";
+	return response;
+}
+
+TEST_F(ClientDeflateTest, StoredBlock)
+{
+	const std::string response = "volume: 42\nrepeat: 0\nOK\n";
+
+	RunSteps({
+		[&]{
+			ASSERT_TRUE(deflate->Append(response.data(),
+						    response.size()));
+		},
+		[&]{
+			/* the deferred flush has sent it */
+			const auto compressed = Receive();
+
+			/* a small response is not compressed; it
+			   appears verbatim in a stored block */
+			EXPECT_NE(compressed.find(response),
+				  std::string::npos);
+
+			EXPECT_EQ(inflater.Inflate(compressed), response);
+		},
+	});
+
+	EXPECT_FALSE(socket_error);
+}
+
+TEST_F(ClientDeflateTest, CommandBoundary)
+{
+	const std::string small1 = "OK\n", small2 = "state: play\nOK\n";
+	const std::string large = MakeLargeResponse(2000);
+	ASSERT_GT(large.size(), 16384u * 4);
+
+	RunSteps({
+		[&]{
+			ASSERT_TRUE(deflate->Append(small1.data(),
+						    small1.size()));
+		},
+		[&]{
+			/* each response can be inflated completely as
+			   soon as it arrives */
+			EXPECT_EQ(inflater.Inflate(Receive()), small1);
+
+			/* larger than ClientDeflate's buffer, which
+			   is compressed whenever it is full */
+			ASSERT_TRUE(deflate->Append(large.data(),
+						    large.size()));
+		},
+		[&]{
+			const auto compressed = Receive();
+			EXPECT_LT(compressed.size(), large.size() / 4);
+			EXPECT_EQ(inflater.Inflate(compressed), large);
+
+			/* the direct-write path used by Response */
+			auto w = deflate->BeginWrite(small2.size());
+			ASSERT_GE(w.size, small2.size());
+			memcpy(w.data, small2.data(), small2.size());
+			deflate->CommitWrite(small2.size());
+		},
+		[&]{
+			/* back to stored blocks after the large
+			   response */
+			const auto compressed = Receive();
+			EXPECT_NE(compressed.find(small2),
+				  std::string::npos);
+			EXPECT_EQ(inflater.Inflate(compressed), small2);
+		},
+	});
+
+	EXPECT_FALSE(socket_error);
+}
+
+TEST_F(ClientDeflateTest, ExplicitFlush)
+{
+	const std::string a = "a: 1\n", b = "b: 2\nOK\n";
+
+	RunSteps({
+		[&]{
+			/* two writes within one iteration are
+			   combined into one flush */
+			ASSERT_TRUE(deflate->Append(a.data(), a.size()));
+			ASSERT_TRUE(deflate->Append(b.data(), b.size()));
+			EXPECT_EQ(deflate->GetSize(), a.size() + b.size());
+
+			/* Flush() compresses immediately */
+			ASSERT_TRUE(deflate->Flush());
+			EXPECT_EQ(deflate->GetSize(), 0u);
+		},
+		[&]{
+			EXPECT_EQ(inflater.Inflate(Receive()), a + b);
+		},
+	});
+
+	EXPECT_FALSE(socket_error);
+}
+
+TEST_F(ClientDeflateTest, OneSend)
+{
+	const std::string large = MakeLargeResponse(1000);
+	ASSERT_GT(large.size(), 16384u);
+
+	RunSteps({
+		[&]{
+			/* the first 16 kB are compressed while
+			   appending, the rest by the final flush */
+			ASSERT_TRUE(deflate->Append(large.data(),
+						    large.size()));
+		},
+		[&]{
+			EXPECT_EQ(inflater.Inflate(Receive()), large);
+
+			/* both were sent with one send() call */
+			EXPECT_EQ(client->GetWriteStats().n_calls, 1u);
+		},
+	});
+
+	EXPECT_FALSE(socket_error);
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Verify that the CURL input plugin reuses HTTP connections across
+ * requests and seeks, and that backward seeks are served from the
+ * seek cache.  A minimal HTTP/1.1 server with keep-alive
+ * and "Range" support runs on the loopback interface and counts the
+ * connections and requests it receives.
+ */
+
+#include "input/plugins/CurlInputPlugin.hxx"
+#include "input/InputPlugin.hxx"
+#include "input/InputStream.hxx"
+#include "input/CondHandler.hxx"
+#include "config/Block.hxx"
+#include "event/Thread.hxx"
+#include "thread/Mutex.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <thread>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static constexpr uint8_t
+MakeByte(uint64_t offset) noexcept
+{
+	return uint8_t(offset % 251);
+}
+
+class TestHttpServer {
+	const uint64_t size;
+
+	int listen_fd;
+	unsigned port;
+
+	std::atomic_uint n_connections{0}, n_requests{0};
+
+	std::thread accept_thread;
+	std::list<std::pair<int, std::thread>> connections;
+
+public:
+	explicit TestHttpServer(uint64_t _size)
+		:size(_size)
+	{
+		listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (listen_fd < 0)
+			abort();
+
+		struct sockaddr_in sin{};
+		sin.sin_family = AF_INET;
+		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t sin_length = sizeof(sin);
+
+		if (bind(listen_fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ||
+		    listen(listen_fd, 16) < 0 ||
+		    getsockname(listen_fd, (struct sockaddr *)&sin,
+				&sin_length) < 0)
+			abort();
+
+		port = ntohs(sin.sin_port);
+
+		accept_thread = std::thread([this]{ RunAccept(); });
+	}
+
+	~TestHttpServer() noexcept {
+		shutdown(listen_fd, SHUT_RDWR);
+		accept_thread.join();
+		close(listen_fd);
+
+		for (auto &[fd, thread] : connections) {
+			shutdown(fd, SHUT_RDWR);
+			thread.join();
+			close(fd);
+		}
+	}
+
+	std::string GetUrl() const {
+		return "http://127.0.0.1:" + std::to_string(port) + "/test.bin";
+	}
+
+	unsigned GetConnections() const noexcept {
+		return n_connections;
+	}
+
+	unsigned GetRequests() const noexcept {
+		return n_requests;
+	}
+
+private:
+	void RunAccept() noexcept {
+		while (true) {
+			int fd = accept(listen_fd, nullptr, nullptr);
+			if (fd < 0)
+				break;
+
+			++n_connections;
+			connections.emplace_back(fd, std::thread([this, fd]{
+				RunConnection(fd);
+			}));
+		}
+	}
+
+	void RunConnection(int fd) noexcept {
+		std::string request;
+		char buffer[4096];
+
+		while (true) {
+			const auto end = request.find("\r\n\r\n");
+			if (end == request.npos) {
+				ssize_t nbytes = recv(fd, buffer,
+						      sizeof(buffer), 0);
+				if (nbytes <= 0)
+					return;
+
+				request.append(buffer, nbytes);
+				continue;
+			}
+
+			const auto header = request.substr(0, end);
+			request.erase(0, end + 4);
+
+			if (!SendResponse(fd, header))
+				return;
+		}
+	}
+
+	bool SendResponse(int fd, const std::string &header) noexcept {
+		++n_requests;
+
+		uint64_t start = 0;
+
+		const char *range = strcasestr(header.c_str(),
+					       "\r\nRange: bytes=");
+		if (range != nullptr)
+			start = strtoull(range + 15, nullptr, 10);
+
+		char head[256];
+		if (range != nullptr)
+			snprintf(head, sizeof(head),
+				 "HTTP/1.1 206 Partial Content\r\n"
+				 "Accept-Ranges: bytes\r\n"
+				 "Content-Range: bytes %llu-%llu/%llu\r\n"
+				 "Content-Length: %llu\r\n"
+				 "\r\n",
+				 (unsigned long long)start,
+				 (unsigned long long)(size - 1),
+				 (unsigned long long)size,
+				 (unsigned long long)(size - start));
+		else
+			snprintf(head, sizeof(head),
+				 "HTTP/1.1 200 OK\r\n"
+				 "Accept-Ranges: bytes\r\n"
+				 "Content-Length: %llu\r\n"
+				 "\r\n",
+				 (unsigned long long)size);
+
+		if (!SendAll(fd, head, strlen(head)))
+			return false;
+
+		uint8_t body[16384];
+		for (uint64_t offset = start; offset < size;) {
+			size_t n = std::min<uint64_t>(sizeof(body),
+						      size - offset);
+			for (size_t i = 0; i < n; ++i)
+				body[i] = MakeByte(offset + i);
+
+			if (!SendAll(fd, body, n))
+				return false;
+
+			offset += n;
+		}
+
+		return true;
+	}
+
+	static bool SendAll(int fd, const void *data, size_t length) noexcept {
+		const auto *p = (const uint8_t *)data;
+		while (length > 0) {
+			ssize_t nbytes = send(fd, p, length, MSG_NOSIGNAL);
+			if (nbytes <= 0)
+				return false;
+
+			p += nbytes;
+			length -= nbytes;
+		}
+
+		return true;
+	}
+};
+
+class CurlInputStreamTest : public ::testing::Test {
+protected:
+	EventThread io_thread;
+
+	void SetUp() override {
+		io_thread.Start();
+		input_plugin_curl.init(io_thread.GetEventLoop(), ConfigBlock());
+	}
+
+	void TearDown() override {
+		input_plugin_curl.finish();
+	}
+};
+
+static InputStreamPtr
+OpenReady(const std::string &url, Mutex &mutex)
+{
+	CondInputStreamHandler handler;
+
+	auto is = input_plugin_curl.open(url.c_str(), mutex);
+	is->SetHandler(&handler);
+
+	{
+		std::unique_lock<Mutex> lock(mutex);
+		handler.cond.wait(lock, [&is]{
+			is->Update();
+			return is->IsReady();
+		});
+
+		is->Check();
+	}
+
+	is->SetHandler(nullptr);
+	return is;
+}
+
+static void
+ExpectRead(InputStream &is, std::unique_lock<Mutex> &lock,
+	   uint64_t offset, size_t length)
+{
+	EXPECT_EQ(offset_type(offset), is.GetOffset());
+
+	uint8_t buffer[4096];
+	while (length > 0) {
+		size_t nbytes = is.Read(lock, buffer,
+					std::min(length, sizeof(buffer)));
+		ASSERT_GT(nbytes, size_t(0));
+
+		for (size_t i = 0; i < nbytes; ++i)
+			ASSERT_EQ(MakeByte(offset + i), buffer[i]);
+
+		offset += nbytes;
+		length -= nbytes;
+	}
+}
+
+TEST_F(CurlInputStreamTest, ReuseAfterEnd)
+{
+	static constexpr uint64_t size = 64 * 1024;
+	TestHttpServer server(size);
+	Mutex mutex;
+
+	for (unsigned i = 0; i < 3; ++i) {
+		auto is = OpenReady(server.GetUrl(), mutex);
+		std::unique_lock<Mutex> lock(mutex);
+		ExpectRead(*is, lock, 0, size);
+	}
+
+	EXPECT_EQ(1u, server.GetConnections());
+}
+
+TEST_F(CurlInputStreamTest, ShortForwardSeeks)
+{
+	static constexpr uint64_t size = 4 * 1024 * 1024;
+	TestHttpServer server(size);
+	Mutex mutex;
+
+	auto is = OpenReady(server.GetUrl(), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+	ExpectRead(*is, lock, 0, 1);
+
+	/* each seek stays within the range which the running
+	   response will deliver soon, so it must not need another
+	   connection */
+	for (uint64_t offset = 1024 * 1024; offset < size;
+	     offset += 1024 * 1024) {
+		is->Seek(lock, offset);
+		ExpectRead(*is, lock, offset, 1024);
+		EXPECT_EQ(1u, server.GetRequests());
+	}
+
+	/* seek back, this is served from the seek cache */
+	is->Seek(lock, 0);
+	ExpectRead(*is, lock, 0, 1);
+
+	EXPECT_EQ(1u, server.GetConnections());
+}
+
+TEST_F(CurlInputStreamTest, LongSeek)
+{
+	/* larger than BufferedInputStream::MAX_SIZE, so the stream
+	   is not copied to memory, and seeks go to the server */
+	static constexpr uint64_t size = 129 * 1024 * 1024;
+	TestHttpServer server(size);
+	Mutex mutex;
+
+	auto is = OpenReady(server.GetUrl(), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+
+	/* receive the whole response, which leaves the connection
+	   idle */
+	uint8_t buffer[65536];
+	while (!is->IsEOF())
+		is->Read(lock, buffer, sizeof(buffer));
+
+	/* this is too far away for the running response, and it
+	   sends a new "Range" request on the same connection */
+	static constexpr uint64_t offset = 1024 * 1024 + 4096;
+	is->Seek(lock, offset);
+	ExpectRead(*is, lock, offset, 64 * 1024);
+
+	EXPECT_EQ(2u, server.GetRequests());
+	EXPECT_EQ(1u, server.GetConnections());
+}
+
+TEST_F(CurlInputStreamTest, BackwardSeekFromCache)
+{
+	static constexpr uint64_t size = 4 * 1024 * 1024;
+	TestHttpServer server(size);
+	Mutex mutex;
+
+	auto is = OpenReady(server.GetUrl(), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+	ExpectRead(*is, lock, 0, 256 * 1024);
+
+	/* this part has been read already and must not be
+	   requested again */
+	is->Seek(lock, 1000);
+	ExpectRead(*is, lock, 1000, 64 * 1024);
+
+	/* continue reading beyond the cached part, which switches
+	   back to the buffer */
+	is->Seek(lock, 200 * 1024);
+	ExpectRead(*is, lock, 200 * 1024, 512 * 1024);
+
+	EXPECT_EQ(1u, server.GetRequests());
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "input/InputStream.hxx"
+#include "input/plugins/FileInputPlugin.hxx"
+#include "fs/Path.hxx"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static constexpr size_t FILE_SIZE = 3 * 1024 * 1024 + 123;
+
+static uint8_t
+MakeByte(size_t offset) noexcept
+{
+	return uint8_t(offset % 251);
+}
+
+static void
+WriteTestData(int fd)
+{
+	std::unique_ptr<uint8_t[]> data(new uint8_t[FILE_SIZE]);
+	for (size_t i = 0; i < FILE_SIZE; ++i)
+		data[i] = MakeByte(i);
+
+	ASSERT_EQ(ssize_t(FILE_SIZE), write(fd, data.get(), FILE_SIZE));
+}
+
+class FileInputStreamTest : public ::testing::Test {
+protected:
+	char path[64] = "/tmp/TestFileInputStream.XXXXXX";
+
+	/**
+	 * A file which cannot shrink (a memfd with F_SEAL_SHRINK),
+	 * which is the only kind of file that may be mapped in this
+	 * test environment.
+	 */
+	char sealed_path[64];
+	int sealed_fd = -1;
+
+	void SetUp() override {
+		int fd = mkstemp(path);
+		ASSERT_GE(fd, 0);
+		WriteTestData(fd);
+		close(fd);
+
+		sealed_fd = memfd_create("TestFileInputStream",
+					 MFD_ALLOW_SEALING);
+		ASSERT_GE(sealed_fd, 0);
+		WriteTestData(sealed_fd);
+		ASSERT_EQ(0, fcntl(sealed_fd, F_ADD_SEALS, F_SEAL_SHRINK));
+		snprintf(sealed_path, sizeof(sealed_path),
+			 "/proc/self/fd/%d", sealed_fd);
+	}
+
+	void TearDown() override {
+		unlink(path);
+		if (sealed_fd >= 0)
+			close(sealed_fd);
+		SetFileInputMmap(false);
+	}
+};
+
+static void
+TestRead(const char *path)
+{
+	Mutex mutex;
+	auto is = OpenFileInputStream(Path::FromFS(path), mutex);
+	ASSERT_TRUE(is);
+	EXPECT_TRUE(is->IsReady());
+	EXPECT_TRUE(is->IsSeekable());
+	EXPECT_EQ(offset_type(FILE_SIZE), is->GetSize());
+
+	std::unique_lock<Mutex> lock(mutex);
+
+	/* read everything */
+	size_t offset = 0;
+	uint8_t buffer[10000];
+	while (true) {
+		size_t nbytes = is->Read(lock, buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		for (size_t i = 0; i < nbytes; ++i)
+			ASSERT_EQ(MakeByte(offset + i), buffer[i]);
+
+		offset += nbytes;
+	}
+
+	EXPECT_EQ(FILE_SIZE, offset);
+	EXPECT_TRUE(is->IsEOF());
+
+	/* seek back */
+	is->Seek(lock, 1000);
+	EXPECT_FALSE(is->IsEOF());
+	ASSERT_EQ(size_t(3), is->Read(lock, buffer, 3));
+	EXPECT_EQ(MakeByte(1000), buffer[0]);
+	EXPECT_EQ(MakeByte(1002), buffer[2]);
+	EXPECT_EQ(offset_type(1003), is->GetOffset());
+}
+
+TEST_F(FileInputStreamTest, Read)
+{
+	TestRead(path);
+}
+
+TEST_F(FileInputStreamTest, ReadMmap)
+{
+	SetFileInputMmap(true);
+	TestRead(sealed_path);
+}
+
+TEST_F(FileInputStreamTest, ReadMmapFallback)
+{
+	SetFileInputMmap(true);
+
+	Mutex mutex;
+	auto is = OpenFileInputStream(Path::FromFS(path), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+
+	/* this file may be truncated, so it is read with read() */
+	EXPECT_TRUE(is->Peek(lock).empty());
+
+	lock.unlock();
+	TestRead(path);
+}
+
+TEST_F(FileInputStreamTest, Peek)
+{
+	Mutex mutex;
+	auto is = OpenFileInputStream(Path::FromFS(path), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+
+	/* not supported with read() */
+	EXPECT_TRUE(is->Peek(lock).empty());
+}
+
+TEST_F(FileInputStreamTest, PeekMmap)
+{
+	SetFileInputMmap(true);
+
+	Mutex mutex;
+	auto is = OpenFileInputStream(Path::FromFS(sealed_path), mutex);
+	std::unique_lock<Mutex> lock(mutex);
+
+	auto p = is->Peek(lock);
+	ASSERT_EQ(FILE_SIZE, p.size);
+	EXPECT_EQ(MakeByte(0), ((const uint8_t *)p.data)[0]);
+
+	is->Skip(lock, 2 * 1024 * 1024);
+	p = is->Peek(lock);
+	ASSERT_EQ(FILE_SIZE - 2 * 1024 * 1024, p.size);
+	EXPECT_EQ(MakeByte(2 * 1024 * 1024), ((const uint8_t *)p.data)[0]);
+
+	is->Seek(lock, FILE_SIZE);
+	EXPECT_TRUE(is->IsEOF());
+	EXPECT_TRUE(is->Peek(lock).empty());
+}
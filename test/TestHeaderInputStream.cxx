@@ -0,0 +1,145 @@
+/*
+ * Unit tests for class HeaderInputStream.
+ */
+
+#include "input/HeaderInputStream.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+/**
+ * A seekable #InputStream which counts the calls to the underlying
+ * "I/O".
+ */
+class MemoryInputStream final : public InputStream {
+	const char *const data;
+
+public:
+	unsigned n_reads = 0, n_seeks = 0;
+
+	MemoryInputStream(Mutex &_mutex, const char *_data)
+		:InputStream("foo://", _mutex), data(_data) {
+		size = strlen(data);
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() const noexcept override {
+		return offset >= size;
+	}
+
+	size_t Read(std::unique_lock<Mutex> &,
+		    void *ptr, size_t read_size) override {
+		++n_reads;
+		size_t nbytes = std::min<size_t>(size - offset, read_size);
+		memcpy(ptr, data + offset, nbytes);
+		offset += nbytes;
+		return nbytes;
+	}
+
+	void Seek(std::unique_lock<Mutex> &,
+		  offset_type new_offset) override {
+		++n_seeks;
+		offset = new_offset;
+	}
+};
+
+static std::string
+ReadString(InputStream &is, std::unique_lock<Mutex> &lock, size_t length)
+{
+	char buffer[64];
+	size_t nbytes = is.Read(lock, buffer, std::min(length, sizeof(buffer)));
+	return std::string(buffer, nbytes);
+}
+
+TEST(HeaderInputStream, Window)
+{
+	Mutex mutex;
+
+	auto *mis = new MemoryInputStream(mutex, "0123456789abcdef");
+	HeaderInputStream his(InputStreamPtr(mis), 8);
+
+	std::unique_lock<Mutex> lock(mutex);
+	his.Fill(lock);
+	EXPECT_TRUE(his.IsReady());
+	EXPECT_TRUE(his.IsSeekable());
+	EXPECT_EQ(offset_type(16), his.GetSize());
+	EXPECT_EQ(offset_type(0), his.GetOffset());
+
+	const unsigned n_reads = mis->n_reads;
+
+	auto p = his.Peek(lock);
+	ASSERT_EQ(size_t(8), p.size);
+	EXPECT_EQ(0, memcmp(p.data, "01234567", 8));
+
+	/* reads and seeks within the window are served from memory */
+	EXPECT_EQ("0123", ReadString(his, lock, 4));
+	his.Seek(lock, 2);
+	EXPECT_EQ("234567", ReadString(his, lock, 64));
+	EXPECT_EQ(n_reads, mis->n_reads);
+	EXPECT_EQ(0u, mis->n_seeks);
+	EXPECT_FALSE(his.IsEOF());
+
+	/* continue reading from the underlying stream */
+	EXPECT_EQ("89ab", ReadString(his, lock, 4));
+	EXPECT_EQ(offset_type(12), his.GetOffset());
+	EXPECT_EQ(0u, mis->n_seeks);
+
+	/* seek back into the window and read across its end */
+	his.Seek(lock, 6);
+	EXPECT_EQ("67", ReadString(his, lock, 64));
+	EXPECT_EQ("89abcdef", ReadString(his, lock, 64));
+	EXPECT_EQ(1u, mis->n_seeks);
+	EXPECT_TRUE(his.IsEOF());
+
+	/* seek beyond the window */
+	his.Seek(lock, 14);
+	EXPECT_EQ(offset_type(14), his.GetOffset());
+	EXPECT_EQ("ef", ReadString(his, lock, 64));
+	EXPECT_TRUE(his.IsEOF());
+}
+
+TEST(HeaderInputStream, UpdateAtWindowEnd)
+{
+	Mutex mutex;
+
+	HeaderInputStream his(std::make_unique<MemoryInputStream>(mutex, "0123456789abcdef"),
+			      8);
+
+	std::unique_lock<Mutex> lock(mutex);
+	his.Fill(lock);
+
+	EXPECT_EQ("01234567", ReadString(his, lock, 8));
+	EXPECT_EQ("89ab", ReadString(his, lock, 4));
+
+	/* seek back into the window and read up to its end, while
+	   the underlying stream remains at offset 12 */
+	his.Seek(lock, 6);
+	EXPECT_EQ("67", ReadString(his, lock, 2));
+	EXPECT_EQ(offset_type(8), his.GetOffset());
+
+	his.Update();
+	EXPECT_EQ(offset_type(8), his.GetOffset());
+	EXPECT_EQ("89ab", ReadString(his, lock, 4));
+}
+
+TEST(HeaderInputStream, Small)
+{
+	Mutex mutex;
+
+	HeaderInputStream his(std::make_unique<MemoryInputStream>(mutex, "foo"),
+			      64);
+
+	std::unique_lock<Mutex> lock(mutex);
+	his.Fill(lock);
+
+	EXPECT_EQ(size_t(3), his.Peek(lock).size);
+	EXPECT_EQ("foo", ReadString(his, lock, 64));
+	EXPECT_TRUE(his.IsEOF());
+	EXPECT_TRUE(his.Peek(lock).empty());
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "client/IdleResponse.hxx"
+#include "client/IdleRateLimiter.hxx"
+#include "IdleFlags.hxx"
+#include "event/Loop.hxx"
+#include "event/TimerEvent.hxx"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(IdleResponse, Format)
+{
+	EXPECT_EQ(GetIdleResponse(0), "OK\n");
+	EXPECT_EQ(GetIdleResponse(IDLE_DATABASE),
+		  "changed: database\nOK\n");
+	EXPECT_EQ(GetIdleResponse(IDLE_PLAYER|IDLE_MIXER),
+		  "changed: player\nchanged: mixer\nOK\n");
+	EXPECT_EQ(GetIdleResponse(IDLE_MIXER|IDLE_PARTITION),
+		  "changed: mixer\nchanged: partition\nOK\n");
+}
+
+TEST(IdleResponse, Cache)
+{
+	/* the same flags return the cached response */
+	const auto &a = GetIdleResponse(IDLE_PLAYLIST|IDLE_OPTIONS);
+	const std::string copy = a;
+	EXPECT_EQ(&GetIdleResponse(IDLE_PLAYLIST|IDLE_OPTIONS), &a);
+	EXPECT_EQ(GetIdleResponse(IDLE_PLAYLIST|IDLE_OPTIONS), copy);
+
+	/* other flags replace it; switching back must not return a
+	   stale response */
+	EXPECT_EQ(GetIdleResponse(IDLE_PLAYLIST),
+		  "changed: playlist\nOK\n");
+	EXPECT_EQ(GetIdleResponse(IDLE_PLAYLIST|IDLE_OPTIONS), copy);
+	EXPECT_EQ(GetIdleResponse(0), "OK\n");
+	EXPECT_EQ(GetIdleResponse(IDLE_PLAYLIST|IDLE_OPTIONS), copy);
+}
+
+TEST(IdleResponse, All)
+{
+	const char *const*names = idle_get_names();
+
+	unsigned all = 0;
+	std::string expected;
+	for (unsigned i = 0; names[i] != nullptr; ++i) {
+		all |= 1u << i;
+		expected += "changed: ";
+		expected += names[i];
+		expected += '\n';
+	}
+
+	expected += "OK\n";
+	EXPECT_EQ(GetIdleResponse(all), expected);
+}
+
+class IdleRateLimiterTest : public ::testing::Test {
+protected:
+	static constexpr std::chrono::steady_clock::duration interval =
+		std::chrono::milliseconds(100);
+
+	EventLoop event_loop;
+
+	/**
+	 * The masks passed to the #IdleRateLimiter callback.
+	 */
+	std::vector<unsigned> postponed;
+
+	IdleRateLimiter limiter{event_loop, IDLE_MIXER,
+				BIND_THIS_METHOD(OnPostponed)};
+
+	void OnPostponed(unsigned mask) noexcept {
+		postponed.push_back(mask);
+	}
+
+	/**
+	 * Run the #EventLoop for the given duration.  This can be
+	 * called only once per test.
+	 */
+	void RunFor(std::chrono::steady_clock::duration d) noexcept {
+		TimerEvent timer(event_loop,
+				 BIND_METHOD(event_loop, &EventLoop::Break));
+		timer.Schedule(d);
+		event_loop.Run();
+	}
+};
+
+constexpr std::chrono::steady_clock::duration IdleRateLimiterTest::interval;
+
+TEST_F(IdleRateLimiterTest, Disabled)
+{
+	const auto zero = std::chrono::steady_clock::duration::zero();
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER, zero), IDLE_MIXER);
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER, zero), IDLE_MIXER);
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER|IDLE_PLAYER, zero),
+		  IDLE_MIXER|IDLE_PLAYER);
+
+	RunFor(std::chrono::milliseconds(50));
+	EXPECT_TRUE(postponed.empty());
+}
+
+TEST_F(IdleRateLimiterTest, OtherFlags)
+{
+	/* other flags are never held back */
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER, interval), IDLE_MIXER);
+	EXPECT_EQ(limiter.Filter(IDLE_PLAYER, interval), IDLE_PLAYER);
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER|IDLE_OUTPUT, interval),
+		  IDLE_OUTPUT);
+
+	RunFor(interval * 3);
+
+	/* the held back event is delivered when the interval
+	   expires */
+	ASSERT_EQ(postponed.size(), 1u);
+	EXPECT_EQ(postponed.front(), IDLE_MIXER);
+}
+
+TEST_F(IdleRateLimiterTest, Combine)
+{
+	/* the first event is passed immediately */
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER, interval), IDLE_MIXER);
+
+	/* all further events within the interval are combined into
+	   one */
+	for (unsigned i = 0; i < 10; ++i)
+		EXPECT_EQ(limiter.Filter(IDLE_MIXER, interval), 0u);
+
+	RunFor(interval * 3);
+
+	ASSERT_EQ(postponed.size(), 1u);
+	EXPECT_EQ(postponed.front(), IDLE_MIXER);
+}
+
+TEST_F(IdleRateLimiterTest, Single)
+{
+	/* a single event is not repeated when the interval
+	   expires */
+	EXPECT_EQ(limiter.Filter(IDLE_MIXER, interval), IDLE_MIXER);
+
+	RunFor(interval * 3);
+	EXPECT_TRUE(postponed.empty());
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "input/SegmentCache.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+static void
+Fill(uint8_t *p, offset_type offset, size_t size) noexcept
+{
+	for (size_t i = 0; i < size; ++i)
+		p[i] = uint8_t((offset + i) % 251);
+}
+
+static void
+Put(InputSegmentCache &cache, offset_type offset, size_t size)
+{
+	std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+	Fill(data.get(), offset, size);
+	cache.Put(offset, data.get(), size);
+}
+
+/**
+ * Read the given range from the cache and verify its contents.
+ *
+ * @return true if the whole range was found in the cache
+ */
+static bool
+Check(InputSegmentCache &cache, offset_type offset, size_t size)
+{
+	while (size > 0) {
+		auto r = cache.Read(offset);
+		if (r.empty())
+			return false;
+
+		const size_t nbytes = std::min(size, r.size);
+		for (size_t i = 0; i < nbytes; ++i)
+			if (r.data[i] != uint8_t((offset + i) % 251))
+				return false;
+
+		offset += nbytes;
+		size -= nbytes;
+	}
+
+	return true;
+}
+
+TEST(InputSegmentCache, Disabled)
+{
+	InputSegmentCache cache(0);
+	EXPECT_FALSE(cache.IsEnabled());
+
+	Put(cache, 0, 1000);
+	EXPECT_FALSE(cache.Contains(0));
+	EXPECT_TRUE(cache.Read(0).empty());
+}
+
+TEST(InputSegmentCache, Basic)
+{
+	InputSegmentCache cache(1024 * 1024);
+	EXPECT_TRUE(cache.IsEnabled());
+	EXPECT_FALSE(cache.Contains(0));
+
+	/* many small sequential writes */
+	for (offset_type offset = 0; offset < 200000; offset += 1000)
+		Put(cache, offset, 1000);
+
+	EXPECT_TRUE(cache.Contains(0));
+	EXPECT_TRUE(cache.Contains(199999));
+	EXPECT_FALSE(cache.Contains(200000));
+	EXPECT_TRUE(Check(cache, 0, 200000));
+	EXPECT_TRUE(Check(cache, 12345, 100000));
+
+	/* a disjoint range */
+	Put(cache, 500000, 1000);
+	EXPECT_TRUE(Check(cache, 500000, 1000));
+	EXPECT_FALSE(cache.Contains(499999));
+	EXPECT_FALSE(cache.Contains(501000));
+
+	/* fill the gap, overlapping both neighbours */
+	Put(cache, 199000, 302000);
+	EXPECT_TRUE(Check(cache, 0, 501000));
+
+	EXPECT_EQ(offset_type(1000 + 1000), cache.GetRefetchedBytes());
+}
+
+TEST(InputSegmentCache, Evict)
+{
+	static constexpr size_t max_size = 256 * 1024;
+	InputSegmentCache cache(max_size);
+
+	Put(cache, 0, max_size);
+	EXPECT_TRUE(Check(cache, 0, max_size));
+
+	/* use the beginning, so it is not evicted */
+	EXPECT_TRUE(Check(cache, 0, 1000));
+
+	Put(cache, max_size, 64 * 1024);
+	EXPECT_TRUE(cache.Contains(0));
+	EXPECT_FALSE(cache.Contains(64 * 1024));
+	EXPECT_TRUE(Check(cache, max_size, 64 * 1024));
+
+	/* re-fetching the evicted part is counted */
+	EXPECT_EQ(offset_type(0), cache.GetRefetchedBytes());
+	Put(cache, 64 * 1024, 1000);
+	EXPECT_EQ(offset_type(1000), cache.GetRefetchedBytes());
+	EXPECT_TRUE(Check(cache, 64 * 1024, 1000));
+}
+
+TEST(InputSegmentCache, FetchedBounded)
+{
+	/* room for 4 segments */
+	InputSegmentCache cache(256 * 1024);
+
+	/* many small disjoint ranges; the gaps grow, so the first
+	   ones are the closest */
+	offset_type offset = 0;
+	for (unsigned i = 0; i < 1000; ++i) {
+		Put(cache, offset, 10);
+		offset += 10 + 100 + i;
+	}
+
+	EXPECT_LE(cache.GetFetchedRangeCount(), size_t(8));
+	EXPECT_EQ(offset_type(0), cache.GetRefetchedBytes());
+
+	/* the first range is still known after coalescing */
+	Put(cache, 0, 10);
+	EXPECT_EQ(offset_type(10), cache.GetRefetchedBytes());
+
+	/* so is the last one */
+	Put(cache, offset - (10 + 100 + 999), 10);
+	EXPECT_EQ(offset_type(20), cache.GetRefetchedBytes());
+	EXPECT_LE(cache.GetFetchedRangeCount(), size_t(8));
+}
+
+TEST(InputSegmentCache, Served)
+{
+	InputSegmentCache cache(1024 * 1024);
+	Put(cache, 0, 1000);
+
+	auto r = cache.Read(100);
+	EXPECT_EQ(size_t(900), r.size);
+	cache.Consume(r.size);
+	EXPECT_EQ(offset_type(900), cache.GetServedBytes());
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "util/PeakBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <string.h>
+
+static std::string
+ReadAll(PeakBuffer &buffer)
+{
+	std::string result;
+
+	while (true) {
+		const auto r = buffer.Read();
+		if (r.empty())
+			break;
+
+		result.append((const char *)r.data, r.size);
+		buffer.Consume(r.size);
+	}
+
+	return result;
+}
+
+static void
+WriteString(PeakBuffer &buffer, const char *s)
+{
+	const size_t length = strlen(s);
+	const auto w = buffer.Write(length);
+	ASSERT_FALSE(w.IsNull());
+	ASSERT_GE(w.size, length);
+	memcpy(w.data, s, length);
+	buffer.Append(length);
+}
+
+TEST(PeakBuffer, Write)
+{
+	PeakBuffer buffer(8, 16);
+
+	WriteString(buffer, "abcdef");
+
+	/* does not fit into the normal buffer, goes to the peak
+	   buffer */
+	WriteString(buffer, "ghij");
+
+	/* the normal buffer has space again, but this must not be
+	   used before the peak buffer is empty */
+	EXPECT_TRUE(buffer.Append("k", 1));
+	WriteString(buffer, "lm");
+	EXPECT_EQ(buffer.GetSize(), size_t(13));
+
+	EXPECT_EQ(ReadAll(buffer), "abcdefghijklm");
+	EXPECT_TRUE(buffer.empty());
+
+	/* too large for both buffers */
+	EXPECT_TRUE(buffer.Write(17).IsNull());
+
+	/* cancel */
+	auto w = buffer.Write(4);
+	ASSERT_FALSE(w.IsNull());
+	memcpy(w.data, "xxxx", 4);
+	buffer.Append(size_t(0));
+	EXPECT_TRUE(buffer.empty());
+
+	WriteString(buffer, "nop");
+	EXPECT_EQ(ReadAll(buffer), "nop");
+}
+
+TEST(PeakBuffer, WriteShift)
+{
+	PeakBuffer buffer(8, 0);
+
+	WriteString(buffer, "abcdef");
+	EXPECT_EQ(buffer.Read().size, 6u);
+	buffer.Consume(4);
+
+	/* this shifts the remaining data to the beginning of the
+	   normal buffer */
+	WriteString(buffer, "ghijkl");
+	EXPECT_EQ(ReadAll(buffer), "efghijkl");
+
+	/* no peak buffer */
+	EXPECT_TRUE(buffer.Write(9).IsNull());
+}
+
+TEST(PeakBuffer, ReadAll)
+{
+	PeakBuffer buffer(8, 16);
+
+	WritableBuffer<void> v[2];
+	EXPECT_EQ(buffer.ReadAll(v), 0u);
+
+	WriteString(buffer, "abcdef");
+	ASSERT_EQ(buffer.ReadAll(v), 1u);
+	EXPECT_EQ(v[0].size, 6u);
+
+	/* goes to the peak buffer */
+	WriteString(buffer, "ghij");
+	ASSERT_EQ(buffer.ReadAll(v), 2u);
+	EXPECT_EQ(std::string((const char *)v[0].data, v[0].size), "abcdef");
+	EXPECT_EQ(std::string((const char *)v[1].data, v[1].size), "ghij");
+
+	/* consume across both chunks */
+	buffer.Consume(8);
+	ASSERT_EQ(buffer.ReadAll(v), 1u);
+	EXPECT_EQ(std::string((const char *)v[0].data, v[0].size), "ij");
+
+	EXPECT_EQ(ReadAll(buffer), "ij");
+	EXPECT_TRUE(buffer.empty());
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PlaylistFile.hxx"
+#include "PlaylistSave.hxx"
+#include "PlaylistError.hxx"
+#include "Mapper.hxx"
+#include "Idle.hxx"
+#include "SongLoader.hxx"
+#include "queue/Queue.hxx"
+#include "song/DetachedSong.hxx"
+#include "db/PlaylistInfo.hxx"
+#include "db/PlaylistVector.hxx"
+#include "config/Data.hxx"
+#include "event/Loop.hxx"
+#include "event/TimerEvent.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "util/BindMethod.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static AllocatedPath playlist_dir = nullptr;
+
+static unsigned idle_count;
+
+const AllocatedPath &
+map_spl_path() noexcept
+{
+	return playlist_dir;
+}
+
+AllocatedPath
+map_spl_utf8_to_fs(const char *name) noexcept
+{
+	if (playlist_dir.IsNull())
+		return nullptr;
+
+	return playlist_dir / AllocatedPath::FromUTF8(std::string(name) +
+						      PLAYLIST_FILE_SUFFIX);
+}
+
+#ifdef ENABLE_DATABASE
+
+AllocatedPath
+map_uri_fs(const char *) noexcept
+{
+	return nullptr;
+}
+
+std::string
+map_fs_to_utf8(Path path_fs) noexcept
+{
+	if (path_fs.IsAbsolute())
+		return std::string();
+
+	return path_fs.ToUTF8();
+}
+
+#endif
+
+void
+idle_add(unsigned)
+{
+	++idle_count;
+}
+
+DetachedSong
+SongLoader::LoadSong(const char *uri_utf8) const
+{
+	return DetachedSong(uri_utf8);
+}
+
+class PlaylistFileTest : public ::testing::Test {
+protected:
+	char dir[64] = "/tmp/TestPlaylistFile.XXXXXX";
+
+	EventLoop event_loop;
+
+	void SetUp() override {
+		ASSERT_NE(mkdtemp(dir), nullptr);
+		playlist_dir = AllocatedPath::FromFS(dir);
+		spl_global_init(ConfigData(), &event_loop);
+	}
+
+	void TearDown() override {
+		spl_global_finish();
+
+		DirectoryReader reader(playlist_dir);
+		while (reader.ReadEntry()) {
+			const auto name = reader.GetEntry();
+			if (!PathTraitsFS::IsSpecialFilename(name.c_str()))
+				unlink((playlist_dir / name).c_str());
+		}
+
+		rmdir(dir);
+		playlist_dir = nullptr;
+	}
+
+	std::string GetPath(const char *name) const {
+		return map_spl_utf8_to_fs(name).c_str();
+	}
+
+	void WriteFile(const char *name, const char *contents) const {
+		std::ofstream(GetPath(name)) << contents;
+	}
+
+	std::string ReadFile(const char *name) const {
+		std::ifstream f(GetPath(name));
+		std::stringstream s;
+		s << f.rdbuf();
+		return s.str();
+	}
+
+	bool Exists(const char *name) const {
+		return access(GetPath(name).c_str(), F_OK) == 0;
+	}
+
+	/**
+	 * Return the sorted names of ListPlaylistFiles().
+	 */
+	static std::vector<std::string> ListNames() {
+		std::vector<std::string> names;
+		for (const auto &i : ListPlaylistFiles())
+			names.push_back(i.name);
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	/**
+	 * Run the #EventLoop for the given duration.  This can be
+	 * called only once per test.
+	 */
+	void RunFor(std::chrono::steady_clock::duration d) noexcept {
+		TimerEvent timer(event_loop,
+				 BIND_METHOD(event_loop, &EventLoop::Break));
+		timer.Schedule(d);
+		event_loop.Run();
+	}
+};
+
+TEST_F(PlaylistFileTest, EditCoalescing)
+{
+	WriteFile("a", "1\n2\n3\n4\n");
+
+	spl_move_index("a", 0, 3);
+	spl_remove_index("a", 0);
+	spl_move_index("a", 2, 0);
+
+	/* nothing has been written yet */
+	EXPECT_EQ(ReadFile("a"), "1\n2\n3\n4\n");
+
+	/* but the edits are visible */
+	const PlaylistFileContents expected{"1", "3", "4"};
+	EXPECT_EQ(LoadPlaylistFile("a"), expected);
+
+	/* all of them are written at once */
+	spl_flush("a");
+	EXPECT_EQ(ReadFile("a"), "1\n3\n4\n");
+
+	/* a range error does not modify anything */
+	EXPECT_THROW(spl_remove_index("a", 3), PlaylistError);
+	EXPECT_EQ(LoadPlaylistFile("a"), expected);
+}
+
+TEST_F(PlaylistFileTest, FlushOnTimer)
+{
+	WriteFile("a", "1\n2\n3\n");
+	WriteFile("b", "x\ny\n");
+
+	spl_remove_index("a", 1);
+	spl_move_index("b", 0, 1);
+	spl_remove_index("a", 0);
+
+	EXPECT_EQ(ReadFile("a"), "1\n2\n3\n");
+	EXPECT_EQ(ReadFile("b"), "x\ny\n");
+
+	/* the write delay is two seconds */
+	RunFor(std::chrono::seconds(3));
+
+	EXPECT_EQ(ReadFile("a"), "3\n");
+	EXPECT_EQ(ReadFile("b"), "y\nx\n");
+}
+
+TEST_F(PlaylistFileTest, RetryWrite)
+{
+	WriteFile("a", "1\n2\n3\n");
+	spl_remove_index("a", 0);
+
+	/* a directory in place of the file makes writing it fail */
+	const auto path = GetPath("a");
+	ASSERT_EQ(unlink(path.c_str()), 0);
+	ASSERT_EQ(mkdir(path.c_str(), 0700), 0);
+
+	/* the first attempt fails after two seconds; the directory
+	   is removed before the retry two seconds later */
+	struct Unblock {
+		const std::string &path;
+
+		void OnTimer() noexcept {
+			rmdir(path.c_str());
+		}
+	} unblock{path};
+
+	TimerEvent timer(event_loop, BIND_METHOD(unblock, &Unblock::OnTimer));
+	timer.Schedule(std::chrono::seconds(3));
+	RunFor(std::chrono::seconds(5));
+
+	EXPECT_EQ(ReadFile("a"), "2\n3\n");
+}
+
+TEST_F(PlaylistFileTest, Rename)
+{
+	WriteFile("a", "1\n2\n3\n");
+
+	/* pending edits are written before renaming */
+	spl_remove_index("a", 0);
+	spl_rename("a", "b");
+
+	EXPECT_FALSE(Exists("a"));
+	EXPECT_EQ(ReadFile("b"), "2\n3\n");
+
+	const PlaylistFileContents expected{"2", "3"};
+	EXPECT_EQ(LoadPlaylistFile("b"), expected);
+	EXPECT_THROW(LoadPlaylistFile("a"), PlaylistError);
+}
+
+TEST_F(PlaylistFileTest, Delete)
+{
+	WriteFile("a", "1\n2\n3\n");
+
+	/* pending edits are discarded; they must not bring the file
+	   back */
+	spl_remove_index("a", 0);
+	spl_delete("a");
+	EXPECT_FALSE(Exists("a"));
+
+	RunFor(std::chrono::seconds(3));
+	EXPECT_FALSE(Exists("a"));
+}
+
+TEST_F(PlaylistFileTest, SaveQueue)
+{
+	WriteFile("a", "1\n2\n3\n");
+
+	Queue queue(16);
+	queue.Append(DetachedSong("x"), 0);
+	queue.Append(DetachedSong("y"), 0);
+
+	/* an existing playlist is not overwritten */
+	EXPECT_THROW(spl_save_queue("a", queue), PlaylistError);
+
+	/* edit it, and then delete the file behind our back */
+	spl_remove_index("a", 0);
+	ASSERT_EQ(unlink(GetPath("a").c_str()), 0);
+
+	/* the pending edits must not overwrite the saved queue */
+	spl_save_queue("a", queue);
+	EXPECT_EQ(ReadFile("a"), "x\ny\n");
+
+	RunFor(std::chrono::seconds(3));
+	EXPECT_EQ(ReadFile("a"), "x\ny\n");
+
+	const PlaylistFileContents expected{"x", "y"};
+	EXPECT_EQ(LoadPlaylistFile("a"), expected);
+}
+
+TEST_F(PlaylistFileTest, Resolved)
+{
+	WriteFile("a", "1\n2\n");
+
+	ResolvedPlaylist songs;
+	songs.push_back({DetachedSong("1"), true});
+	songs.push_back({DetachedSong("2"), false});
+	spl_put_resolved("a", std::move(songs));
+
+	const auto *resolved = spl_get_resolved("a");
+	ASSERT_NE(resolved, nullptr);
+	ASSERT_EQ(resolved->size(), 2u);
+	EXPECT_STREQ((*resolved)[0].song.GetURI(), "1");
+	EXPECT_TRUE((*resolved)[0].found);
+	EXPECT_FALSE((*resolved)[1].found);
+
+	/* editing the playlist discards them */
+	spl_move_index("a", 0, 1);
+	EXPECT_EQ(spl_get_resolved("a"), nullptr);
+
+	/* so does a database update */
+	spl_flush("a");
+	songs.clear();
+	songs.push_back({DetachedSong("2"), true});
+	songs.push_back({DetachedSong("1"), true});
+	spl_put_resolved("a", std::move(songs));
+	EXPECT_NE(spl_get_resolved("a"), nullptr);
+	spl_invalidate_resolved();
+	EXPECT_EQ(spl_get_resolved("a"), nullptr);
+
+	/* songs of a file which is not in the playlist directory are
+	   not remembered */
+	songs.clear();
+	songs.push_back({DetachedSong("1"), true});
+	spl_put_resolved("b", std::move(songs));
+	EXPECT_EQ(spl_get_resolved("b"), nullptr);
+}
+
+TEST_F(PlaylistFileTest, List)
+{
+	WriteFile("a", "1\n");
+	WriteFile("b", "2\n");
+
+	/* files without the suffix are ignored */
+	std::ofstream((playlist_dir / Path::FromFS("c.txt")).c_str()) << "3\n";
+
+	using Names = std::vector<std::string>;
+	EXPECT_EQ(ListNames(), (Names{"a", "b"}));
+
+	/* MPD's own modifications update the cached listing */
+	Queue queue(16);
+	queue.Append(DetachedSong("x"), 0);
+	spl_save_queue("c", queue);
+	EXPECT_EQ(ListNames(), (Names{"a", "b", "c"}));
+
+	spl_rename("a", "d");
+	EXPECT_EQ(ListNames(), (Names{"b", "c", "d"}));
+
+	spl_delete("b");
+	EXPECT_EQ(ListNames(), (Names{"c", "d"}));
+
+	/* pending edits are written before listing */
+	spl_remove_index("d", 0);
+	EXPECT_EQ(ListNames(), (Names{"c", "d"}));
+	EXPECT_EQ(ReadFile("d"), "");
+
+	/* files created by somebody else are noticed */
+	WriteFile("e", "5\n");
+	unlink(GetPath("c").c_str());
+	RunFor(std::chrono::milliseconds(100));
+	EXPECT_EQ(ListNames(), (Names{"d", "e"}));
+}
@@ -0,0 +1,546 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "event/RemoteSocketWriter.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/DeferEvent.hxx"
+#include "event/Loop.hxx"
+#include "event/Thread.hxx"
+#include "event/TimerEvent.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <string.h>
+#include <sys/socket.h>
+
+/**
+ * The byte at the given position of the test data stream.
+ */
+static constexpr uint8_t
+Pattern(size_t position) noexcept
+{
+	return uint8_t(position % 251);
+}
+
+static void
+FillPattern(uint8_t *p, size_t position, size_t length) noexcept
+{
+	for (size_t i = 0; i < length; ++i)
+		p[i] = Pattern(position + i);
+}
+
+/**
+ * Read from the peer socket (in a separate thread) and verify the
+ * pattern.
+ */
+class PatternReader {
+	SocketDescriptor fd;
+
+	/**
+	 * Read slowly, to let the sender's buffers fill up?
+	 */
+	const bool slow;
+
+public:
+	std::atomic_size_t received{0};
+	std::atomic_bool ok{true};
+
+private:
+	std::thread thread;
+
+public:
+	explicit PatternReader(SocketDescriptor _fd, bool _slow=false) noexcept
+		:fd(_fd), slow(_slow), thread([this]{ Run(); }) {}
+
+	~PatternReader() noexcept {
+		Join();
+	}
+
+	/**
+	 * Wait until the other side has closed the socket.
+	 */
+	void Join() noexcept {
+		if (thread.joinable())
+			thread.join();
+	}
+
+private:
+	void Run() noexcept {
+		uint8_t buffer[65536];
+		const size_t size = slow ? 4096 : sizeof(buffer);
+		ssize_t nbytes;
+		/* blocking, unlike SocketDescriptor::Read() */
+		while ((nbytes = recv(fd.Get(), buffer, size, 0)) > 0) {
+			if (slow)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+
+			for (ssize_t i = 0; i < nbytes; ++i)
+				if (buffer[i] != Pattern(received + i))
+					ok = false;
+			received += nbytes;
+		}
+	}
+};
+
+class RemoteSocketWriterTest
+	: public ::testing::Test, public RemoteSocketWriterHandler {
+protected:
+	static constexpr size_t BUFFER_SIZE = 4096;
+
+	EventLoop event_loop;
+	EventThread writer_thread;
+
+	UniqueSocketDescriptor socket, peer;
+
+	unsigned n_written = 0, n_errors = 0;
+	socket_error_t error_code = 0;
+
+	void SetUp() override {
+		ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+								     SOCK_STREAM,
+								     0, socket,
+								     peer));
+		socket.SetNonBlocking();
+	}
+
+	/* virtual methods from class RemoteSocketWriterHandler */
+	void OnRemoteSocketWritten() noexcept override {
+		++n_written;
+		event_loop.Break();
+	}
+
+	void OnRemoteSocketError(socket_error_t code) noexcept override {
+		++n_errors;
+		error_code = code;
+		event_loop.Break();
+	}
+};
+
+TEST_F(RemoteSocketWriterTest, Backpressure)
+{
+	RemoteSocketWriter writer(socket, event_loop,
+				  writer_thread.GetEventLoop(),
+				  BUFFER_SIZE, *this);
+
+	/* the writer thread isn't running yet, so nothing gets sent,
+	   and the buffer fills up */
+	uint8_t data[BUFFER_SIZE * 3];
+	FillPattern(data, 0, sizeof(data));
+
+	EXPECT_EQ(writer.Append(data, sizeof(data)), BUFFER_SIZE);
+	EXPECT_EQ(writer.GetSize(), BUFFER_SIZE);
+	EXPECT_EQ(writer.Append(data + BUFFER_SIZE, sizeof(data)), 0u);
+	EXPECT_EQ(writer.GetWriteStats().n_calls, 0u);
+
+	PatternReader reader(peer);
+	writer_thread.Start();
+
+	/* wait for OnRemoteSocketWritten() */
+	TimerEvent timeout(event_loop, BIND_METHOD(event_loop, &EventLoop::Break));
+	timeout.Schedule(std::chrono::seconds(5));
+	event_loop.Run();
+	timeout.Cancel();
+
+	EXPECT_EQ(n_written, 1u);
+	EXPECT_EQ(n_errors, 0u);
+	EXPECT_EQ(writer.GetSize(), 0u);
+
+	/* there is room again */
+	EXPECT_EQ(writer.Append(data + BUFFER_SIZE, BUFFER_SIZE * 2),
+		  BUFFER_SIZE);
+
+	/* Stop() makes one last attempt to send pending data */
+	writer.Stop();
+	EXPECT_EQ(writer.GetSize(), 0u);
+	EXPECT_EQ(writer.Append(data, 1), 0u);
+
+	const auto stats = writer.GetWriteStats();
+	EXPECT_GE(stats.n_calls, 2u);
+	EXPECT_EQ(stats.n_bytes, BUFFER_SIZE * 2);
+
+	socket.Close();
+	reader.Join();
+	EXPECT_EQ(reader.received, BUFFER_SIZE * 2);
+	EXPECT_TRUE(reader.ok);
+}
+
+TEST_F(RemoteSocketWriterTest, PeerClosed)
+{
+	RemoteSocketWriter writer(socket, event_loop,
+				  writer_thread.GetEventLoop(),
+				  BUFFER_SIZE, *this);
+
+	peer.Close();
+	writer_thread.Start();
+
+	uint8_t data[256];
+	FillPattern(data, 0, sizeof(data));
+	EXPECT_EQ(writer.Append(data, sizeof(data)), sizeof(data));
+
+	TimerEvent timeout(event_loop, BIND_METHOD(event_loop, &EventLoop::Break));
+	timeout.Schedule(std::chrono::seconds(5));
+	event_loop.Run();
+	timeout.Cancel();
+
+	EXPECT_EQ(n_errors, 1u);
+	EXPECT_EQ(n_written, 0u);
+	EXPECT_TRUE(IsSocketErrorClosed(error_code));
+
+	/* no more data is accepted after an error */
+	EXPECT_EQ(writer.Append(data, sizeof(data)), 0u);
+
+	writer.Stop();
+}
+
+TEST_F(RemoteSocketWriterTest, StopPending)
+{
+	/* make the socket buffer full, so the writer thread cannot
+	   send */
+	uint8_t data[BUFFER_SIZE];
+	std::fill_n(data, sizeof(data), 0);
+	size_t filled = 0;
+	ssize_t nbytes;
+	while ((nbytes = socket.Write(data, sizeof(data))) > 0)
+		filled += nbytes;
+
+	RemoteSocketWriter writer(socket, event_loop,
+				  writer_thread.GetEventLoop(),
+				  BUFFER_SIZE, *this);
+	writer_thread.Start();
+
+	FillPattern(data, 0, sizeof(data));
+	EXPECT_EQ(writer.Append(data, 100), 100u);
+
+	/* Stop() must not block, even though nothing can be sent;
+	   the pending data is discarded */
+	writer.Stop();
+	EXPECT_EQ(writer.GetSize(), 0u);
+	EXPECT_EQ(writer.Append(data, 100), 0u);
+
+	/* Stop() has unregistered the socket from the writer
+	   thread, but has not closed it */
+	EXPECT_TRUE(socket.IsDefined());
+	EXPECT_EQ(n_written + n_errors, 0u);
+
+	/* only the data which was written directly arrives */
+	socket.Close();
+	size_t received = 0;
+	char buffer[65536];
+	while ((nbytes = peer.Read(buffer, sizeof(buffer))) > 0)
+		received += nbytes;
+	EXPECT_EQ(received, filled);
+}
+
+/**
+ * Streams a large response like a background command (e.g.
+ * "listallinfo"): it fills the output buffer up to a threshold and
+ * continues after OnOutputDrained().
+ */
+class StreamSocket final : public FullyBufferedSocket {
+	static constexpr size_t THRESHOLD = 16384;
+
+	DeferEvent defer_fill;
+
+	const size_t total;
+
+	size_t written = 0;
+
+public:
+	bool error = false, closed = false;
+
+	/**
+	 * Has OnOutputDrained() been called after everything had
+	 * been sent?
+	 */
+	bool drained_empty = false;
+
+	StreamSocket(SocketDescriptor _fd, EventLoop &_loop,
+		     EventLoop &writer_loop, size_t _total) noexcept
+		:FullyBufferedSocket(_fd, _loop, 16384, 1024 * 1024,
+				     &writer_loop),
+		 defer_fill(_loop, BIND_THIS_METHOD(Fill)),
+		 total(_total) {}
+
+	~StreamSocket() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	using FullyBufferedSocket::Close;
+	using FullyBufferedSocket::GetOutputSize;
+
+	bool IsFinished() const noexcept {
+		return written == total;
+	}
+
+	void Start() noexcept {
+		defer_fill.Schedule();
+	}
+
+private:
+	void Fill() noexcept {
+		while (written < total) {
+			if (GetOutputSize() >= THRESHOLD) {
+				/* see DatabaseStreamPrint::ScheduleFill() */
+				if (GetOutputSize() == 0)
+					defer_fill.Schedule();
+				/* else wait for OnOutputDrained() */
+				return;
+			}
+
+			uint8_t buffer[1000];
+			const size_t n = std::min(sizeof(buffer),
+						  total - written);
+			FillPattern(buffer, written, n);
+			if (!Write(buffer, n))
+				return;
+
+			written += n;
+		}
+	}
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *, size_t) noexcept override {
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(std::exception_ptr) noexcept override {
+		error = true;
+	}
+
+	void OnSocketClosed() noexcept override {
+		closed = true;
+	}
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnOutputDrained() noexcept override {
+		if (IsFinished() && GetOutputSize() == 0)
+			drained_empty = true;
+
+		defer_fill.Schedule();
+	}
+};
+
+TEST(FullyBufferedSocket, RemoteStream)
+{
+	constexpr size_t TOTAL = 1024 * 1024;
+
+	UniqueSocketDescriptor socket, peer;
+	ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+							     SOCK_STREAM,
+							     0, socket, peer));
+	socket.SetNonBlocking();
+
+	EventThread writer_thread;
+	writer_thread.Start();
+
+	EventLoop event_loop;
+	StreamSocket s(socket.Release(), event_loop,
+		       writer_thread.GetEventLoop(), TOTAL);
+
+	/* a slow peer keeps the writer thread's buffer full */
+	PatternReader reader(peer, true);
+
+	/* poll for completion */
+	struct Poll {
+		StreamSocket &s;
+		EventLoop &loop;
+		const std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() +
+			std::chrono::seconds(10);
+		TimerEvent timer{loop, BIND_THIS_METHOD(OnTimer)};
+
+		void OnTimer() noexcept {
+			if ((s.IsFinished() && s.GetOutputSize() == 0) ||
+			    s.error || s.closed ||
+			    std::chrono::steady_clock::now() >= deadline) {
+				loop.Break();
+				return;
+			}
+
+			timer.Schedule(std::chrono::milliseconds(10));
+		}
+	} poll{s, event_loop};
+
+	s.Start();
+	poll.timer.Schedule(std::chrono::milliseconds(10));
+	event_loop.Run();
+
+	EXPECT_TRUE(s.IsFinished());
+	EXPECT_EQ(s.GetOutputSize(), 0u);
+	EXPECT_FALSE(s.error);
+	EXPECT_FALSE(s.closed);
+
+	const auto stats = s.GetWriteStats();
+	EXPECT_EQ(stats.n_bytes, TOTAL);
+
+	s.Close();
+	reader.Join();
+
+	EXPECT_EQ(reader.received, TOTAL);
+	EXPECT_TRUE(reader.ok);
+}
+
+TEST(FullyBufferedSocket, RemoteDrained)
+{
+	UniqueSocketDescriptor socket, peer;
+	ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+							     SOCK_STREAM,
+							     0, socket, peer));
+	socket.SetNonBlocking();
+
+	EventThread writer_thread;
+	writer_thread.Start();
+
+	EventLoop event_loop;
+	StreamSocket s(socket.Release(), event_loop,
+		       writer_thread.GetEventLoop(), 100);
+
+	PatternReader reader(peer);
+
+	/* OnOutputDrained() must be called once the writer thread
+	   has sent the last byte, not only when the data is handed
+	   over to it */
+	struct Poll {
+		StreamSocket &s;
+		EventLoop &loop;
+		const std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() +
+			std::chrono::seconds(5);
+		TimerEvent timer{loop, BIND_THIS_METHOD(OnTimer)};
+
+		void OnTimer() noexcept {
+			if (s.drained_empty ||
+			    std::chrono::steady_clock::now() >= deadline) {
+				loop.Break();
+				return;
+			}
+
+			timer.Schedule(std::chrono::milliseconds(1));
+		}
+	} poll{s, event_loop};
+
+	s.Start();
+	poll.timer.Schedule(std::chrono::milliseconds(1));
+	event_loop.Run();
+
+	EXPECT_TRUE(s.drained_empty);
+	EXPECT_EQ(s.GetOutputSize(), 0u);
+
+	s.Close();
+	reader.Join();
+	EXPECT_EQ(reader.received, 100u);
+	EXPECT_TRUE(reader.ok);
+}
+
+/**
+ * A #FullyBufferedSocket which sends from the main thread, with a
+ * small normal buffer, so larger responses spill into the peak
+ * buffer.
+ */
+class PeakSocket final : public FullyBufferedSocket {
+public:
+	static constexpr size_t NORMAL_SIZE = 4096;
+
+	bool error = false, closed = false, drained = false;
+
+	PeakSocket(SocketDescriptor _fd, EventLoop &_loop) noexcept
+		:FullyBufferedSocket(_fd, _loop, NORMAL_SIZE, 65536) {}
+
+	~PeakSocket() noexcept {
+		if (IsDefined())
+			Close();
+	}
+
+	using FullyBufferedSocket::Close;
+	using FullyBufferedSocket::GetOutputSize;
+	using FullyBufferedSocket::Write;
+
+private:
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *, size_t) noexcept override {
+		return InputResult::MORE;
+	}
+
+	void OnSocketError(std::exception_ptr) noexcept override {
+		error = true;
+	}
+
+	void OnSocketClosed() noexcept override {
+		closed = true;
+	}
+
+	/* virtual methods from class FullyBufferedSocket */
+	void OnOutputDrained() noexcept override {
+		drained = true;
+		GetEventLoop().Break();
+	}
+};
+
+TEST(FullyBufferedSocket, PeakFlush)
+{
+	constexpr size_t TOTAL = 3 * PeakSocket::NORMAL_SIZE;
+
+	UniqueSocketDescriptor socket, peer;
+	ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+							     SOCK_STREAM,
+							     0, socket, peer));
+	socket.SetNonBlocking();
+
+	EventLoop event_loop;
+	PeakSocket s(socket.Release(), event_loop);
+
+	/* fills the normal buffer and the rest goes to the peak
+	   buffer */
+	uint8_t buffer[TOTAL];
+	FillPattern(buffer, 0, TOTAL);
+	ASSERT_TRUE(s.Write(buffer, TOTAL));
+
+	/* break the loop if the output doesn't drain */
+	TimerEvent timeout(event_loop, BIND_METHOD(event_loop, &EventLoop::Break));
+	timeout.Schedule(std::chrono::seconds(5));
+	event_loop.Run();
+
+	EXPECT_TRUE(s.drained);
+	EXPECT_FALSE(s.error);
+	EXPECT_FALSE(s.closed);
+	EXPECT_EQ(s.GetOutputSize(), 0u);
+
+	/* both chunks have been sent with one sendmsg() call */
+	const auto stats = s.GetWriteStats();
+	EXPECT_EQ(stats.n_calls, 1u);
+	EXPECT_EQ(stats.n_bytes, TOTAL);
+
+	s.Close();
+
+	uint8_t received[TOTAL + 1];
+	size_t position = 0;
+	ssize_t nbytes;
+	while ((nbytes = recv(peer.Get(), received + position,
+			      sizeof(received) - position, 0)) > 0)
+		position += nbytes;
+
+	ASSERT_EQ(position, TOTAL);
+	EXPECT_EQ(memcmp(received, buffer, TOTAL), 0);
+}
@@ -0,0 +1,100 @@
+/*
+ * Unit tests for SniffAudioFormat().
+ */
+
+#include "decoder/Sniff.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+static SniffedFormat
+Sniff(const char *data, size_t size) noexcept
+{
+	return SniffAudioFormat({data, size});
+}
+
+template<size_t size>
+static SniffedFormat
+Sniff(const char (&data)[size]) noexcept
+{
+	/* without the null terminator */
+	return Sniff(data, size - 1);
+}
+
+static std::string
+ToString(const SniffedFormat &f)
+{
+	if (f.suffix != nullptr)
+		return f.suffix;
+
+	if (f.mime_type != nullptr)
+		return f.mime_type;
+
+	return {};
+}
+
+TEST(Sniff, Unknown)
+{
+	EXPECT_FALSE(Sniff("").IsDefined());
+	EXPECT_FALSE(Sniff("fLa").IsDefined());
+	EXPECT_FALSE(Sniff("hello world").IsDefined());
+}
+
+TEST(Sniff, Simple)
+{
+	EXPECT_EQ("flac", ToString(Sniff("fLaC\0\0\0\x22")));
+	EXPECT_EQ("wav", ToString(Sniff("RIFF\0\0\0\0WAVEfmt ")));
+	EXPECT_EQ("aiff", ToString(Sniff("FORM\0\0\0\0AIFFCOMM")));
+	EXPECT_EQ("dsf", ToString(Sniff("DSD \x1c\0\0\0")));
+	EXPECT_EQ("dff", ToString(Sniff("FRM8\0\0\0\0\0\0\0\0DSD ")));
+	EXPECT_EQ("wv", ToString(Sniff("wvpk")));
+	EXPECT_EQ("m4a", ToString(Sniff("\0\0\0\x20" "ftypM4A ")));
+}
+
+TEST(Sniff, Ogg)
+{
+	static constexpr char page_header[] =
+		"OggS\0\x02\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\x01\x13";
+	static constexpr size_t page_header_size = sizeof(page_header) - 1;
+
+	const auto Page = [](const char *packet){
+		std::string s(page_header, page_header_size);
+		s.append(packet);
+		return s;
+	};
+
+	auto s = Page("OpusHead");
+	EXPECT_EQ("opus", ToString(Sniff(s.data(), s.size())));
+
+	s = Page("\x01vorbis");
+	EXPECT_EQ("audio/x-vorbis+ogg", ToString(Sniff(s.data(), s.size())));
+
+	s = Page("\x7f" "FLAC");
+	EXPECT_EQ("audio/x-flac+ogg", ToString(Sniff(s.data(), s.size())));
+
+	s = Page("Speex   ");
+	EXPECT_FALSE(Sniff(s.data(), s.size()).IsDefined());
+}
+
+TEST(Sniff, Mpeg)
+{
+	/* MPEG-1 layer III, 128 kbit/s, 44.1 kHz */
+	EXPECT_EQ("mp3", ToString(Sniff("\xff\xfb\x90\x64")));
+
+	/* ADTS */
+	EXPECT_EQ("aac", ToString(Sniff("\xff\xf1\x50\x80")));
+
+	/* "bad" bit rate index */
+	EXPECT_FALSE(Sniff("\xff\xfb\xf0\x64").IsDefined());
+}
+
+TEST(Sniff, Id3)
+{
+	/* an ID3v2 tag with 4 bytes of payload before a FLAC stream */
+	EXPECT_EQ("flac", ToString(Sniff("ID3\x04\0\0\0\0\0\x04" "abcd" "fLaC")));
+
+	/* the tag is larger than the buffer */
+	EXPECT_FALSE(Sniff("ID3\x04\0\0\0\0\x01\0" "abcd" "fLaC").IsDefined());
+}
@@ -0,0 +1,445 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Encode songs with the "binary_songs" protocol feature and decode
+ * the "songrec" records again.
+ */
+
+#include "MakeTag.hxx"
+#include "SongPrint.hxx"
+#include "client/Client.hxx"
+#include "client/BackgroundCommand.hxx"
+#include "client/Response.hxx"
+#include "protocol/SongRecord.hxx"
+#include "song/LightSong.hxx"
+#include "song/DetachedSong.hxx"
+#include "event/Loop.hxx"
+#include "net/UniqueSocketDescriptor.hxx"
+#include "util/WritableBuffer.hxx"
+#include "config.h"
+
+#ifdef ENABLE_ZLIB
+#include "client/Deflate.hxx"
+#endif
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+#include <sys/socket.h>
+
+/**
+ * Replaces the client's output buffer.
+ */
+static std::string received;
+
+static char write_buffer[64 * 1024];
+
+/* stubs for the Client class */
+
+Client::Client(EventLoop &_loop, Partition &_partition,
+	       UniqueSocketDescriptor _fd,
+	       int _uid, unsigned _permission,
+	       int _num) noexcept
+	:FullyBufferedSocket(_fd.Release(), _loop, 16384),
+	 timeout_event(_loop, BIND_THIS_METHOD(OnTimeout)),
+	 partition(&_partition),
+	 permission(_permission),
+	 uid(_uid),
+	 num(_num)
+{
+}
+
+Client::~Client() noexcept
+{
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
+BufferedSocket::InputResult
+Client::OnSocketInput(void *, size_t) noexcept
+{
+	return InputResult::PAUSE;
+}
+
+void
+Client::OnSocketError(std::exception_ptr) noexcept
+{
+}
+
+void
+Client::OnSocketClosed() noexcept
+{
+}
+
+void
+Client::OnOutputDrained() noexcept
+{
+}
+
+void
+Client::OnIdle() noexcept
+{
+	FullyBufferedSocket::OnIdle();
+}
+
+void
+Client::OnTimeout() noexcept
+{
+}
+
+WritableBuffer<void>
+Client::BeginWrite(size_t) noexcept
+{
+	return {write_buffer, sizeof(write_buffer)};
+}
+
+void
+Client::CommitWrite(size_t length) noexcept
+{
+	received.append(write_buffer, length);
+}
+
+bool
+Client::Write(const void *data, size_t length) noexcept
+{
+	received.append((const char *)data, length);
+	return true;
+}
+
+bool
+Client::Write(const char *data) noexcept
+{
+	return Write(data, strlen(data));
+}
+
+typedef std::vector<std::pair<unsigned, std::string>> DecodedRecord;
+
+/**
+ * A minimal "songrec" parser, as a client would implement it.
+ */
+class RecordParser {
+	const std::string &s;
+	size_t position = 0;
+
+public:
+	explicit RecordParser(const std::string &_s) noexcept:s(_s) {}
+
+	bool IsEnd() const noexcept {
+		return position == s.size();
+	}
+
+	std::string ReadLine() {
+		const auto end = s.find('\n', position);
+		if (end == s.npos)
+			throw std::runtime_error("Line not terminated");
+
+		std::string line = s.substr(position, end - position);
+		position = end + 1;
+		return line;
+	}
+
+	DecodedRecord ReadRecord() {
+		const auto line = ReadLine();
+		if (line.compare(0, 9, "songrec: ") != 0)
+			throw std::runtime_error("Not a songrec: " + line);
+
+		const size_t size = std::stoul(line.substr(9));
+		if (position + size + 1 > s.size() ||
+		    s[position + size] != '\n')
+			throw std::runtime_error("Bad record size");
+
+		const size_t end = position + size;
+		DecodedRecord record;
+		while (position < end) {
+			const unsigned id = (uint8_t)s[position++];
+			const size_t length = ReadLEB128(end);
+			if (length > end - position)
+				throw std::runtime_error("Field too long");
+
+			record.emplace_back(id, s.substr(position, length));
+			position += length;
+		}
+
+		/* skip the newline */
+		++position;
+		return record;
+	}
+
+private:
+	size_t ReadLEB128(size_t end) {
+		size_t value = 0;
+		for (unsigned shift = 0;; shift += 7) {
+			if (position >= end)
+				throw std::runtime_error("Truncated length");
+
+			const uint8_t byte = s[position++];
+			value |= size_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+	}
+};
+
+static uint64_t
+DecodeLE(const std::string &value) noexcept
+{
+	uint64_t result = 0;
+	for (size_t i = value.size(); i > 0; --i)
+		result = (result << 8) | uint8_t(value[i - 1]);
+	return result;
+}
+
+static unsigned
+Id(SongRecordField field) noexcept
+{
+	return unsigned(field);
+}
+
+/**
+ * Return all values of the given field id.
+ */
+static std::vector<std::string>
+Find(const DecodedRecord &record, unsigned id)
+{
+	std::vector<std::string> values;
+	for (const auto &[i, value] : record)
+		if (i == id)
+			values.push_back(value);
+	return values;
+}
+
+class SongRecordTest : public ::testing::Test {
+	UniqueSocketDescriptor a, b;
+
+	EventLoop loop;
+
+	alignas(std::max_align_t) char partition[1];
+
+	std::unique_ptr<Client> client;
+
+protected:
+	void SetUp() override {
+		ASSERT_TRUE(UniqueSocketDescriptor::CreateSocketPair(AF_LOCAL,
+								     SOCK_STREAM,
+								     0, a, b));
+		client = std::make_unique<Client>(loop,
+						  *(Partition *)(void *)partition,
+						  std::move(a), 0, 0, 0);
+		client->binary_songs = true;
+		received.clear();
+	}
+
+	void TearDown() override {
+		client.reset();
+	}
+
+	Client &GetClient() noexcept {
+		return *client;
+	}
+
+	/**
+	 * Print the song and decode the one record.
+	 */
+	template<typename S>
+	DecodedRecord Print(const S &song, bool base=false) {
+		received.clear();
+
+		{
+			Response r(*client, 0);
+			song_print_info(r, song, base);
+		}
+
+		RecordParser parser(received);
+		auto record = parser.ReadRecord();
+		EXPECT_TRUE(parser.IsEnd());
+		return record;
+	}
+};
+
+TEST_F(SongRecordTest, Light)
+{
+	const Tag tag = MakeTag(TAG_ARTIST, "Artist",
+				TAG_TITLE, "Title",
+				TAG_TRACK, "3");
+	LightSong song("song.flac", tag);
+	song.directory = "Artist/Album";
+	song.mtime = std::chrono::system_clock::from_time_t(1500000000);
+	song.audio_format = AudioFormat(44100, SampleFormat::S16, 2);
+	song.start_time = SongTime::FromMS(1000);
+	song.end_time = SongTime::FromMS(61500);
+
+	const auto record = Print(song);
+
+	EXPECT_EQ(Find(record, Id(SongRecordField::URI)),
+		  std::vector<std::string>{"Artist/Album/song.flac"});
+
+	const auto range = Find(record, Id(SongRecordField::RANGE));
+	ASSERT_EQ(range.size(), 1u);
+	ASSERT_EQ(range.front().size(), 8u);
+	EXPECT_EQ(DecodeLE(range.front().substr(0, 4)), 1000u);
+	EXPECT_EQ(DecodeLE(range.front().substr(4)), 61500u);
+
+	const auto mtime = Find(record, Id(SongRecordField::LAST_MODIFIED));
+	ASSERT_EQ(mtime.size(), 1u);
+	EXPECT_EQ(DecodeLE(mtime.front()), 1500000000u);
+
+	EXPECT_EQ(Find(record, Id(SongRecordField::FORMAT)),
+		  std::vector<std::string>{"44100:16:2"});
+
+	/* the tag has no duration */
+	EXPECT_TRUE(Find(record, Id(SongRecordField::DURATION)).empty());
+
+	EXPECT_EQ(Find(record, TAG_ARTIST),
+		  std::vector<std::string>{"Artist"});
+	EXPECT_EQ(Find(record, TAG_TITLE),
+		  std::vector<std::string>{"Title"});
+	EXPECT_EQ(Find(record, TAG_TRACK),
+		  std::vector<std::string>{"3"});
+
+	/* only the base name */
+	EXPECT_EQ(Find(Print(song, true), Id(SongRecordField::URI)),
+		  std::vector<std::string>{"song.flac"});
+}
+
+TEST_F(SongRecordTest, Detached)
+{
+	Tag tag = MakeTag(TAG_NAME, "Stream");
+	tag.duration = SignedSongTime::FromMS(123456);
+	const DetachedSong song("http://example.com/stream", std::move(tag));
+
+	const auto record = Print(song);
+
+	EXPECT_EQ(Find(record, Id(SongRecordField::URI)),
+		  std::vector<std::string>{"http://example.com/stream"});
+	EXPECT_TRUE(Find(record, Id(SongRecordField::RANGE)).empty());
+	EXPECT_TRUE(Find(record, Id(SongRecordField::LAST_MODIFIED)).empty());
+	EXPECT_TRUE(Find(record, Id(SongRecordField::FORMAT)).empty());
+
+	const auto duration = Find(record, Id(SongRecordField::DURATION));
+	ASSERT_EQ(duration.size(), 1u);
+	ASSERT_EQ(duration.front().size(), 4u);
+	EXPECT_EQ(DecodeLE(duration.front()), 123456u);
+
+	EXPECT_EQ(Find(record, TAG_NAME),
+		  std::vector<std::string>{"Stream"});
+}
+
+TEST_F(SongRecordTest, DetachedFromLight)
+{
+	/* a queued song from the database has the same attributes
+	   as the database song */
+	const Tag tag = MakeTag(TAG_TITLE, "Title");
+	LightSong light("song.flac", tag);
+	light.audio_format = AudioFormat(48000, SampleFormat::S24_P32, 2);
+	const DetachedSong song(light);
+
+	EXPECT_EQ(Find(Print(song), Id(SongRecordField::FORMAT)),
+		  std::vector<std::string>{"48000:24:2"});
+	EXPECT_EQ(Find(Print(light), Id(SongRecordField::FORMAT)),
+		  std::vector<std::string>{"48000:24:2"});
+}
+
+TEST_F(SongRecordTest, MultiValue)
+{
+	const Tag tag = MakeTag(TAG_ARTIST, "First",
+				TAG_GENRE, "Rock",
+				TAG_ARTIST, "Second",
+				TAG_ARTIST, "Third");
+	const LightSong song("song.flac", tag);
+
+	const auto record = Print(song);
+
+	/* all values are sent, in their original order */
+	const std::vector<std::string> artists{"First", "Second", "Third"};
+	EXPECT_EQ(Find(record, TAG_ARTIST), artists);
+	EXPECT_EQ(Find(record, TAG_GENRE),
+		  std::vector<std::string>{"Rock"});
+}
+
+TEST_F(SongRecordTest, LongValues)
+{
+	/* lengths which need two and three LEB128 bytes; the last
+	   one is larger than SongRecordWriter's buffer */
+	for (const size_t length : {127u, 128u, 300u, 16383u, 16384u, 70000u}) {
+		const std::string title(length, 'x');
+		const std::string album(length + 1, 'y');
+		const Tag tag = MakeTag(TAG_TITLE, title.c_str(),
+					TAG_ALBUM, album.c_str());
+		const LightSong song("song.flac", tag);
+
+		const auto record = Print(song);
+		EXPECT_EQ(Find(record, TAG_TITLE),
+			  std::vector<std::string>{title});
+		EXPECT_EQ(Find(record, TAG_ALBUM),
+			  std::vector<std::string>{album});
+	}
+
+	const std::string uri(200, 'u');
+	const LightSong song(uri.c_str(), Tag());
+	EXPECT_EQ(Find(Print(song), Id(SongRecordField::URI)),
+		  std::vector<std::string>{uri});
+}
+
+TEST_F(SongRecordTest, TagMask)
+{
+	const Tag tag = MakeTag(TAG_ARTIST, "Artist",
+				TAG_TITLE, "Title");
+	const LightSong song("song.flac", tag);
+
+	GetClient().tag_mask = TagMask(TAG_TITLE);
+
+	const auto record = Print(song);
+	EXPECT_TRUE(Find(record, TAG_ARTIST).empty());
+	EXPECT_EQ(Find(record, TAG_TITLE),
+		  std::vector<std::string>{"Title"});
+}
+
+TEST_F(SongRecordTest, Sequence)
+{
+	/* several records in a row, surrounded by text lines, as in
+	   "listallinfo" */
+	const Tag tag = MakeTag(TAG_TITLE, "Title");
+	const LightSong song1("1.flac", tag), song2("2.flac", tag);
+
+	received.clear();
+
+	{
+		Response r(GetClient(), 0);
+		r.Write("directory: foo\n");
+		song_print_info(r, song1);
+		song_print_info(r, song2);
+		r.Write("OK\n");
+	}
+
+	RecordParser parser(received);
+	EXPECT_EQ(parser.ReadLine(), "directory: foo");
+	EXPECT_EQ(Find(parser.ReadRecord(), Id(SongRecordField::URI)),
+		  std::vector<std::string>{"1.flac"});
+	EXPECT_EQ(Find(parser.ReadRecord(), Id(SongRecordField::URI)),
+		  std::vector<std::string>{"2.flac"});
+	EXPECT_EQ(parser.ReadLine(), "OK");
+	EXPECT_TRUE(parser.IsEnd());
+}
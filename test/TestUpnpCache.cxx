@@ -0,0 +1,206 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "db/plugins/upnp/Cache.hxx"
+
+#include <gtest/gtest.h>
+
+using Clock = UpnpContentCache::Clock;
+
+static UpnpContentCache::ContentPtr
+MakeContent(const char *id)
+{
+	UPnPDirContent content;
+	auto &object = content.objects.emplace_back();
+	object.id = id;
+	object.parent_id = "0";
+	object.name = id;
+	object.type = UPnPDirObject::Type::CONTAINER;
+	object.item_class = UPnPDirObject::ItemClass::UNKNOWN;
+	return std::make_shared<const UPnPDirContent>(std::move(content));
+}
+
+TEST(UpnpCache, Expire)
+{
+	UpnpContentCache cache(std::chrono::seconds(10), 16);
+	const auto now = Clock::now();
+	const auto key = UpnpContentCache::MakeBrowseKey("0");
+
+	EXPECT_FALSE(cache.Get("s", key, now));
+
+	cache.Put("s", key, MakeContent("a"), now);
+
+	auto c = cache.Get("s", key, now + std::chrono::seconds(9));
+	ASSERT_TRUE(c);
+	EXPECT_EQ(c->objects.front().id, "a");
+
+	/* different server, different key */
+	EXPECT_FALSE(cache.Get("t", key, now));
+	EXPECT_FALSE(cache.Get("s", UpnpContentCache::MakeMetadataKey("0"),
+			       now));
+
+	EXPECT_FALSE(cache.Get("s", key, now + std::chrono::seconds(10)));
+	EXPECT_EQ(cache.GetSize(), 0u);
+}
+
+TEST(UpnpCache, Disabled)
+{
+	UpnpContentCache cache(Clock::duration::zero(), 16);
+	EXPECT_FALSE(cache.IsEnabled());
+
+	const auto key = UpnpContentCache::MakeBrowseKey("0");
+	cache.Put("s", key, MakeContent("a"));
+	EXPECT_FALSE(cache.Get("s", key));
+
+	unsigned n = 0;
+	auto fetch = [&n]{
+		++n;
+		return UPnPDirContent();
+	};
+
+	cache.GetOrFetch("s", key, fetch);
+	cache.GetOrFetch("s", key, fetch);
+	EXPECT_EQ(n, 2u);
+}
+
+TEST(UpnpCache, GetOrFetch)
+{
+	UpnpContentCache cache(std::chrono::minutes(1), 16);
+
+	unsigned n = 0;
+	auto fetch = [&n]{
+		++n;
+		UPnPDirContent content;
+		content.objects.emplace_back().id = "x";
+		return content;
+	};
+
+	const auto key = UpnpContentCache::MakeSearchKey("0",
+							 "upnp:artist = \"A\"");
+	auto a = cache.GetOrFetch("s", key, fetch);
+	auto b = cache.GetOrFetch("s", key, fetch);
+	EXPECT_EQ(n, 1u);
+	EXPECT_EQ(a, b);
+
+	/* a different search expression is a different entry */
+	cache.GetOrFetch("s", UpnpContentCache::MakeSearchKey("0", "x"),
+			 fetch);
+	EXPECT_EQ(n, 2u);
+}
+
+TEST(UpnpCache, UpdateId)
+{
+	UpnpContentCache cache(std::chrono::minutes(1), 16);
+	const auto now = Clock::now();
+	const auto interval = std::chrono::seconds(5);
+	const auto key = UpnpContentCache::MakeBrowseKey("0");
+
+	EXPECT_TRUE(cache.NeedUpdateIdCheck("s", interval, now));
+	cache.SetUpdateId("s", 1, now);
+	EXPECT_FALSE(cache.NeedUpdateIdCheck("s", interval, now));
+	EXPECT_TRUE(cache.NeedUpdateIdCheck("s", interval, now + interval));
+
+	cache.Put("s", key, MakeContent("a"), now);
+	cache.Put("t", key, MakeContent("b"), now);
+
+	/* unchanged */
+	EXPECT_FALSE(cache.SetUpdateId("s", 1, now));
+	EXPECT_TRUE(cache.Get("s", key, now));
+
+	/* changed: only this server's entries are discarded */
+	EXPECT_TRUE(cache.SetUpdateId("s", 2, now));
+	EXPECT_FALSE(cache.Get("s", key, now));
+	EXPECT_TRUE(cache.Get("t", key, now));
+}
+
+TEST(UpnpCache, UpdateIdUnsupported)
+{
+	UpnpContentCache cache(std::chrono::minutes(1), 16);
+	const auto now = Clock::now();
+	const auto interval = std::chrono::seconds(5);
+	const auto key = UpnpContentCache::MakeBrowseKey("0");
+
+	cache.Put("s", key, MakeContent("a"), now);
+
+	/* the server is never asked again */
+	cache.SetUpdateIdUnsupported("s");
+	EXPECT_FALSE(cache.NeedUpdateIdCheck("s", interval, now));
+	EXPECT_FALSE(cache.NeedUpdateIdCheck("s", interval,
+					     now + std::chrono::hours(1)));
+
+	/* other servers are not affected */
+	EXPECT_TRUE(cache.NeedUpdateIdCheck("t", interval, now));
+
+	/* the entries expire by their age only */
+	EXPECT_TRUE(cache.Get("s", key, now + std::chrono::seconds(59)));
+	EXPECT_FALSE(cache.Get("s", key, now + std::chrono::minutes(1)));
+}
+
+TEST(UpnpCache, SearchCapabilities)
+{
+	UpnpContentCache cache(std::chrono::minutes(1), 16);
+
+	unsigned n = 0;
+	auto fetch = [&n]{
+		++n;
+		UpnpContentCache::SearchCaps caps;
+		caps.emplace_front("upnp:artist");
+		return caps;
+	};
+
+	EXPECT_FALSE(cache.GetSearchCapabilities("s"));
+
+	auto a = cache.GetOrFetchSearchCapabilities("s", fetch);
+	auto b = cache.GetOrFetchSearchCapabilities("s", fetch);
+	EXPECT_EQ(n, 1u);
+	EXPECT_EQ(a, b);
+	EXPECT_EQ(a->front(), "upnp:artist");
+
+	/* they survive a "SystemUpdateID" change */
+	cache.SetUpdateId("s", 1);
+	cache.SetUpdateId("s", 2);
+	EXPECT_EQ(cache.GetSearchCapabilities("s"), a);
+
+	cache.GetOrFetchSearchCapabilities("t", fetch);
+	EXPECT_EQ(n, 2u);
+}
+
+TEST(UpnpCache, LRU)
+{
+	UpnpContentCache cache(std::chrono::minutes(1), 3);
+	const auto now = Clock::now();
+
+	const auto k1 = UpnpContentCache::MakeBrowseKey("1");
+	const auto k2 = UpnpContentCache::MakeBrowseKey("2");
+	const auto k3 = UpnpContentCache::MakeBrowseKey("3");
+	const auto k4 = UpnpContentCache::MakeBrowseKey("4");
+
+	cache.Put("s", k1, MakeContent("1"), now);
+	cache.Put("s", k2, MakeContent("2"), now);
+	cache.Put("s", k3, MakeContent("3"), now);
+
+	/* touch "1", so "2" is the least recently used one */
+	EXPECT_TRUE(cache.Get("s", k1, now));
+
+	cache.Put("s", k4, MakeContent("4"), now);
+	EXPECT_EQ(cache.GetSize(), 3u);
+	EXPECT_TRUE(cache.Get("s", k1, now));
+	EXPECT_FALSE(cache.Get("s", k2, now));
+	EXPECT_TRUE(cache.Get("s", k3, now));
+	EXPECT_TRUE(cache.Get("s", k4, now));
+}
@@ -35,9 +35,10 @@ static constexpr unsigned IN_MASK =
 
 static void
 my_inotify_callback([[maybe_unused]] int wd, unsigned mask,
+		    unsigned cookie,
 		    const char *name, [[maybe_unused]] void *ctx)
 {
-	printf("mask=0x%x name='%s'\n", mask, name);
+	printf("mask=0x%x cookie=%u name='%s'\n", mask, cookie, name);
 }
 
 int main(int argc, char **argv)
@@ -18,16 +18,20 @@
  */
 
 /*
- * This program is a command line interface to MPD's normalize library
- * (based on AudioCompress).
+ * This program is a command line interface to MPD's loudness
+ * normalization library (PcmNormalizer).  It reads raw PCM samples
+ * from stdin, writes the normalized samples to stdout and prints the
+ * throughput to stderr.
  *
  */
 
-#include "AudioCompress/compress.h"
+#include "pcm/Normalizer.hxx"
 #include "pcm/AudioParser.hxx"
 #include "pcm/AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/PrintException.hxx"
 
+#include <chrono>
 #include <stdexcept>
 
 #include <stddef.h>
@@ -36,10 +40,25 @@
 #include <unistd.h>
 #include <string.h>
 
+static void
+WriteOrThrow(ConstBuffer<void> src)
+{
+	const auto *p = (const char *)src.data;
+	size_t size = src.size;
+
+	while (size > 0) {
+		ssize_t nbytes = write(1, p, size);
+		if (nbytes <= 0)
+			throw std::runtime_error("Write failed");
+
+		p += nbytes;
+		size -= nbytes;
+	}
+}
+
 int main(int argc, char **argv)
 try {
-	struct Compressor *compressor;
-	static char buffer[4096];
+	static char buffer[65536];
 	ssize_t nbytes;
 
 	if (argc > 2) {
@@ -51,16 +70,49 @@ try {
 	if (argc > 1)
 		audio_format = ParseAudioFormat(argv[1], false);
 
-	compressor = Compressor_new(0);
+	if (PcmNormalizer::GetSupportedFormat(audio_format.format) !=
+	    audio_format.format)
+		throw std::runtime_error("Sample format not supported");
+
+	PcmNormalizer normalizer;
+	normalizer.Open(audio_format, PcmNormalizer::Config());
+
+	const size_t frame_size = audio_format.GetFrameSize();
+	size_t fill = 0, total = 0;
+	std::chrono::steady_clock::duration duration{};
 
-	while ((nbytes = read(0, buffer, sizeof(buffer))) > 0) {
-		Compressor_Process_int16(compressor,
-					 (int16_t *)buffer, nbytes / 2);
+	while ((nbytes = read(0, buffer + fill, sizeof(buffer) - fill)) > 0) {
+		fill += nbytes;
 
-		[[maybe_unused]] ssize_t ignored = write(1, buffer, nbytes);
+		const size_t size = fill - fill % frame_size;
+		if (size == 0)
+			continue;
+
+		const auto start = std::chrono::steady_clock::now();
+		auto dest = normalizer.Process({buffer, size});
+		duration += std::chrono::steady_clock::now() - start;
+		total += size;
+
+		WriteOrThrow(dest);
+
+		fill -= size;
+		memmove(buffer, buffer + size, fill);
 	}
 
-	Compressor_delete(compressor);
+	const auto start = std::chrono::steady_clock::now();
+	auto dest = normalizer.Flush();
+	duration += std::chrono::steady_clock::now() - start;
+
+	if (!dest.IsNull())
+		WriteOrThrow(dest);
+
+	const double seconds =
+		std::chrono::duration_cast<std::chrono::duration<double>>(duration).count();
+	fprintf(stderr, "processed %zu bytes in %.3f s (%.1f MB/s), loudness %.1f LUFS\n",
+		total, seconds,
+		seconds > 0 ? total / seconds / (1024 * 1024) : 0.,
+		normalizer.GetLoudness());
+
 	return EXIT_SUCCESS;
 } catch (...) {
 	PrintException(std::current_exception());
@@ -19,12 +19,15 @@
 
 #include "config.h"
 #include "pcm/Export.hxx"
+#include "pcm/ExportWords.hxx"
 #include "pcm/Traits.hxx"
 #include "util/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include <string.h>
 
 TEST(PcmTest, ExportShift8)
@@ -167,8 +170,140 @@ TEST(PcmTest, ExportReverseEndian)
 			 sizeof(expected_silence)), 0);
 }
 
+static constexpr PcmWordExport word_export_modes[] = {
+	PcmWordExport::REVERSE,
+	PcmWordExport::SHIFT8,
+	PcmWordExport::SHIFT8_REVERSE,
+	PcmWordExport::PACK24,
+	PcmWordExport::PACK24_REVERSE,
+};
+
+TEST(PcmTest, ExportWords)
+{
+	static constexpr uint32_t src[] = { 0x00123456, 0xfffedcba };
+
+	static constexpr uint8_t expected_shift8_reverse_le[] = {
+		0x12, 0x34, 0x56, 0x00,
+		0xfe, 0xdc, 0xba, 0x00,
+	};
+
+	static constexpr uint8_t expected_pack24_reverse_le[] = {
+		0x12, 0x34, 0x56,
+		0xfe, 0xdc, 0xba,
+	};
+
+	uint8_t dest[8];
+
+	if (IsLittleEndian()) {
+		PcmSelectWordExport(PcmWordExport::SHIFT8_REVERSE)(dest, src, 2);
+		EXPECT_EQ(memcmp(dest, expected_shift8_reverse_le, 8), 0);
+
+		PcmSelectWordExport(PcmWordExport::PACK24_REVERSE)(dest, src, 2);
+		EXPECT_EQ(memcmp(dest, expected_pack24_reverse_le, 6), 0);
+	}
+}
+
+/**
+ * Compare the optimized kernels with the portable ones, for all
+ * lengths up to 37 words (to cover the tail loop), and verify that
+ * they do not write beyond the end.
+ */
+TEST(PcmTest, ExportWordsOptimized)
+{
+	uint32_t src[37];
+	for (size_t i = 0; i < std::size(src); ++i)
+		src[i] = 0x01030507 * (i + 1) ^ (i << 28);
+
+	for (const auto mode : word_export_modes) {
+		const auto optimized = PcmSelectWordExport(mode);
+		const auto generic = PcmGenericWordExport(mode);
+
+		for (size_t n = 0; n <= std::size(src); ++n) {
+			uint8_t a[sizeof(src) + 16], b[sizeof(src) + 16];
+			memset(a, 0xaa, sizeof(a));
+			memset(b, 0xaa, sizeof(b));
+
+			optimized(a, src, n);
+			generic(b, src, n);
+
+			EXPECT_EQ(memcmp(a, b, sizeof(a)), 0);
+		}
+	}
+}
+
 #ifdef ENABLE_DSD
 
+/**
+ * Verify that the fused DSD conversion produces the same output as
+ * converting the unmodified DSD export output with the portable
+ * word kernel.
+ */
+static void
+TestDsdFused(PcmExport::DsdMode dsd_mode, PcmExport::Params params,
+	     PcmWordExport mode)
+{
+	static constexpr unsigned channels = 2;
+
+	std::vector<uint8_t> src(100000);
+	for (size_t i = 0; i < src.size(); ++i)
+		src[i] = i * 7 + (i >> 8);
+
+	params.dsd_mode = dsd_mode;
+	PcmExport fused;
+	fused.Open(SampleFormat::DSD, channels, params);
+
+	PcmExport::Params plain_params;
+	plain_params.dsd_mode = dsd_mode;
+	PcmExport plain;
+	plain.Open(SampleFormat::DSD, channels, plain_params);
+
+	const auto generic = PcmGenericWordExport(mode);
+
+	/* odd chunk sizes to exercise the rest buffer */
+	static constexpr size_t chunks[] = { 2, 8194, 30, 40000, 6, 51768 };
+
+	size_t position = 0;
+	for (const size_t chunk : chunks) {
+		ASSERT_LE(position + chunk, src.size());
+		const ConstBuffer<void> in(&src[position], chunk);
+		position += chunk;
+
+		const auto words = ConstBuffer<uint32_t>::FromVoid(plain.Export(in));
+		std::vector<uint8_t> expected(words.size * PcmWordExportSize(mode));
+		generic(expected.data(), words.data, words.size);
+
+		const auto dest = fused.Export(in);
+		ASSERT_EQ(dest.size, expected.size());
+		EXPECT_EQ(memcmp(dest.data, expected.data(), dest.size), 0);
+	}
+
+	ASSERT_EQ(position, src.size());
+}
+
+TEST(PcmTest, ExportDsdFused)
+{
+	PcmExport::Params params;
+	params.reverse_endian = true;
+	TestDsdFused(PcmExport::DsdMode::U32, params,
+		     PcmWordExport::REVERSE);
+	TestDsdFused(PcmExport::DsdMode::DOP, params,
+		     PcmWordExport::REVERSE);
+
+	params.pack24 = true;
+	TestDsdFused(PcmExport::DsdMode::DOP, params,
+		     PcmWordExport::PACK24_REVERSE);
+
+	params = {};
+	params.pack24 = true;
+	TestDsdFused(PcmExport::DsdMode::DOP, params,
+		     PcmWordExport::PACK24);
+
+	params = {};
+	params.shift8 = true;
+	TestDsdFused(PcmExport::DsdMode::DOP, params,
+		     PcmWordExport::SHIFT8);
+}
+
 TEST(PcmTest, ExportDsdU16)
 {
 	static constexpr uint8_t src[] = {
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/LoudnessMeter.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+static std::vector<float>
+MakeSine(unsigned sample_rate, unsigned channels, double seconds,
+	 double frequency, double amplitude, double phase=0)
+{
+	const std::size_t n_frames = sample_rate * seconds;
+	std::vector<float> v;
+	v.reserve(n_frames * channels);
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		const float x = amplitude *
+			std::sin(phase + i * 2 * M_PI * frequency / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			v.push_back(x);
+	}
+
+	return v;
+}
+
+TEST(LoudnessMeter, Sine)
+{
+	/* EBU Tech 3341: a stereo 1 kHz sine at -23 dBFS reads as
+	   -23 LUFS */
+	const auto src = MakeSine(48000, 2, 20, 1000,
+				  std::pow(10.0, -23.0 / 20));
+
+	LoudnessMeter m;
+	m.Open(48000, 2);
+	m.Feed(src.data(), src.size() / 2);
+
+	EXPECT_NEAR(m.GetIntegratedLoudness(), -23.0, 0.1);
+}
+
+TEST(LoudnessMeter, Gating)
+{
+	/* silence must not lower the integrated loudness */
+	auto src = MakeSine(44100, 2, 10, 1000, std::pow(10.0, -20.0 / 20));
+	src.insert(src.end(), 44100 * 2 * 10, 0.0f);
+
+	LoudnessMeter m;
+	m.Open(44100, 2);
+	m.Feed(src.data(), src.size() / 2);
+
+	EXPECT_NEAR(m.GetIntegratedLoudness(), -20.0, 0.1);
+}
+
+TEST(LoudnessMeter, Silence)
+{
+	const std::vector<float> src(48000 * 5);
+
+	LoudnessMeter m;
+	m.Open(48000, 1);
+	m.Feed(src.data(), src.size());
+
+	EXPECT_EQ(m.GetIntegratedLoudness(), -HUGE_VAL);
+	EXPECT_EQ(m.GetTruePeak(), 0.0f);
+}
+
+TEST(LoudnessMeter, TruePeak)
+{
+	/* a sine at a quarter of the sample rate, sampled 45 degrees
+	   off its peaks: the sample peak is only 0.707, but the true
+	   peak is 1.0 */
+	const auto src = MakeSine(48000, 1, 1, 12000, 1.0, M_PI / 4);
+
+	LoudnessMeter m;
+	m.Open(48000, 1);
+	m.Feed(src.data(), src.size());
+
+	EXPECT_GT(m.GetTruePeak(), 0.95f);
+	EXPECT_LT(m.GetTruePeak(), 1.05f);
+}
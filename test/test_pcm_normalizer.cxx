@@ -0,0 +1,208 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/Normalizer.hxx"
+#include "pcm/Traits.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+template<typename T>
+static std::vector<T>
+Normalize(PcmNormalizer &n, const std::vector<T> &src,
+	  std::size_t chunk_samples=1000)
+{
+	std::vector<T> result;
+
+	for (std::size_t i = 0; i < src.size(); i += chunk_samples) {
+		const std::size_t size = std::min(chunk_samples,
+						  src.size() - i);
+		auto dest = ConstBuffer<T>::FromVoid(n.Process(ConstBuffer<T>(&src[i], size).ToVoid()));
+		result.insert(result.end(), dest.begin(), dest.end());
+	}
+
+	auto dest = ConstBuffer<T>::FromVoid(n.Flush());
+	if (!dest.IsNull())
+		result.insert(result.end(), dest.begin(), dest.end());
+
+	return result;
+}
+
+template<typename T>
+static std::vector<T>
+MakeSine(std::size_t n, double amplitude)
+{
+	std::vector<T> v(n);
+	for (std::size_t i = 0; i < n; ++i)
+		v[i] = T(amplitude * std::sin(i * 2 * M_PI * 1000 / 48000));
+	return v;
+}
+
+template<typename T>
+gcc_pure
+static double
+Peak(const T *p, std::size_t n) noexcept
+{
+	double peak = 0;
+	for (std::size_t i = 0; i < n; ++i)
+		peak = std::max(peak, std::fabs(double(p[i])));
+	return peak;
+}
+
+TEST(PcmNormalizer, SupportedFormat)
+{
+	EXPECT_EQ(SampleFormat::S16,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::S16));
+	EXPECT_EQ(SampleFormat::S24_P32,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::S24_P32));
+	EXPECT_EQ(SampleFormat::S32,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::S32));
+	EXPECT_EQ(SampleFormat::FLOAT,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::FLOAT));
+	EXPECT_EQ(SampleFormat::FLOAT,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::S8));
+	EXPECT_EQ(SampleFormat::FLOAT,
+		  PcmNormalizer::GetSupportedFormat(SampleFormat::DSD));
+}
+
+TEST(PcmNormalizer, Amplify)
+{
+	PcmNormalizer n;
+	n.Open(AudioFormat(48000, SampleFormat::FLOAT, 1),
+	       PcmNormalizer::Config());
+
+	const auto src = MakeSine<float>(48000 * 10, 0.01);
+	const auto dest = Normalize(n, src);
+	ASSERT_EQ(src.size(), dest.size());
+
+	/* the last second must have been amplified substantially */
+	const std::size_t last = src.size() - 48000;
+	EXPECT_GT(Peak(&dest[last], 48000), 10 * Peak(&src[last], 48000));
+	EXPECT_LE(Peak(&dest[last], 48000), 1.0);
+}
+
+TEST(PcmNormalizer, NoClipping)
+{
+	PcmNormalizer n;
+	n.Open(AudioFormat(48000, SampleFormat::FLOAT, 2),
+	       PcmNormalizer::Config());
+
+	/* a long quiet passage raises the gain, then a sudden loud
+	   burst must be limited by the look-ahead */
+	auto src = MakeSine<float>(48000 * 2 * 8, 0.005);
+	const auto loud = MakeSine<float>(48000 * 2, 0.9);
+	src.insert(src.end(), loud.begin(), loud.end());
+
+	const auto dest = Normalize(n, src);
+	ASSERT_EQ(src.size(), dest.size());
+	EXPECT_LE(Peak(dest.data(), dest.size()), 1.0);
+}
+
+TEST(PcmNormalizer, Delay)
+{
+	PcmNormalizer n;
+	n.Open(AudioFormat(48000, SampleFormat::S16, 2),
+	       PcmNormalizer::Config());
+
+	const std::vector<int16_t> src(48000 * 2);
+	auto dest = n.Process(ConstBuffer<int16_t>(src.data(), src.size()).ToVoid());
+
+	/* the look-ahead holds back at least 100 ms */
+	EXPECT_LE(dest.size + 9600 * sizeof(int16_t),
+		  src.size() * sizeof(int16_t));
+
+	auto rest = n.Flush();
+	EXPECT_EQ(src.size() * sizeof(int16_t), dest.size + rest.size);
+	EXPECT_TRUE(n.Flush().IsNull());
+}
+
+TEST(PcmNormalizer, Reset)
+{
+	PcmNormalizer n;
+	n.Open(AudioFormat(48000, SampleFormat::FLOAT, 1),
+	       PcmNormalizer::Config());
+
+	/* a long quiet passage raises the gain */
+	const auto quiet = MakeSine<float>(48000 * 10, 0.01);
+	const auto before = Normalize(n, quiet);
+	ASSERT_EQ(quiet.size(), before.size());
+	const std::size_t last = quiet.size() - 48000;
+	const double gain = Peak(&before[last], 48000) /
+		Peak(&quiet[last], 48000);
+	ASSERT_GT(gain, 10);
+
+	/* a loud burst which is still in the look-ahead buffer is
+	   discarded */
+	const auto loud = MakeSine<float>(2400, 0.9);
+	const auto quiet2 = MakeSine<float>(48000 * 10, 0.01);
+	n.Process(ConstBuffer<float>(quiet2.data(), 48000).ToVoid());
+	n.Process(ConstBuffer<float>(loud.data(), loud.size()).ToVoid());
+	n.Reset();
+	EXPECT_TRUE(n.Flush().IsNull());
+
+	/* ... and must neither lower the gain nor limit the peaks of
+	   the quiet signal which follows */
+	const std::vector<float> after_src(quiet2.begin() + 48000,
+					   quiet2.begin() + 48000 * 2);
+	const auto after = Normalize(n, after_src);
+	ASSERT_EQ(after_src.size(), after.size());
+	const std::size_t tail = after.size() - 4800;
+	EXPECT_GT(Peak(&after[tail], 4800),
+		  0.9 * gain * Peak(&after_src[tail], 4800));
+	EXPECT_LE(Peak(after.data(), after.size()), 1.0);
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+TestIntegerFormat()
+{
+	using value_type = typename Traits::value_type;
+
+	PcmNormalizer n;
+	n.Open(AudioFormat(44100, F, 2), PcmNormalizer::Config());
+
+	const auto src = MakeSine<value_type>(44100 * 2 * 4,
+					      0.9 * Traits::MAX);
+	const auto dest = Normalize(n, src, 777);
+	ASSERT_EQ(src.size(), dest.size());
+
+	/* a loud signal is never attenuated and must not clip */
+	EXPECT_LE(Peak(dest.data(), dest.size()), double(Traits::MAX));
+	EXPECT_GE(Peak(dest.data(), dest.size()),
+		  0.99 * Peak(src.data(), src.size()));
+}
+
+TEST(PcmNormalizer, S16)
+{
+	TestIntegerFormat<SampleFormat::S16>();
+}
+
+TEST(PcmNormalizer, S24_P32)
+{
+	TestIntegerFormat<SampleFormat::S24_P32>();
+}
+
+TEST(PcmNormalizer, S32)
+{
+	TestIntegerFormat<SampleFormat::S32>();
+}
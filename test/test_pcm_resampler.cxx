@@ -0,0 +1,229 @@
+/*
+ * Copyright 2003-2020 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "pcm/PolyphaseResampler.hxx"
+#include "pcm/SplitResampler.hxx"
+#include "pcm/AudioFormat.hxx"
+#include "config/Block.hxx"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+static std::vector<float>
+MakeSine(unsigned sample_rate, unsigned channels, std::size_t n_frames,
+	 double frequency, double amplitude)
+{
+	std::vector<float> v;
+	v.reserve(n_frames * channels);
+
+	for (std::size_t i = 0; i < n_frames; ++i) {
+		const float x = amplitude *
+			std::sin(i * 2 * M_PI * frequency / sample_rate);
+		for (unsigned c = 0; c < channels; ++c)
+			v.push_back(x);
+	}
+
+	return v;
+}
+
+static std::vector<float>
+Resample(PcmResampler &r, unsigned from, unsigned to, unsigned channels,
+	 const std::vector<float> &src, std::size_t chunk_frames=1000)
+{
+	AudioFormat af(from, SampleFormat::FLOAT, channels);
+	const auto out_format = r.Open(af, to);
+	EXPECT_EQ(out_format.sample_rate, to);
+	EXPECT_EQ(out_format.format, SampleFormat::FLOAT);
+
+	std::vector<float> result;
+
+	const std::size_t chunk = chunk_frames * channels;
+	for (std::size_t i = 0; i < src.size(); i += chunk) {
+		const std::size_t n = std::min(chunk, src.size() - i);
+		const auto dest = ConstBuffer<float>::FromVoid(r.Resample(ConstBuffer<float>(&src[i], n).ToVoid()));
+		result.insert(result.end(), dest.begin(), dest.end());
+	}
+
+	while (true) {
+		const auto dest = ConstBuffer<float>::FromVoid(r.Flush());
+		if (dest.IsNull())
+			break;
+
+		result.insert(result.end(), dest.begin(), dest.end());
+	}
+
+	r.Close();
+	return result;
+}
+
+static std::vector<float>
+Resample(unsigned from, unsigned to, unsigned channels,
+	 const std::vector<float> &src, std::size_t chunk_frames=1000)
+{
+	PolyphasePcmResampler r;
+	return Resample(r, from, to, channels, src, chunk_frames);
+}
+
+/**
+ * Calculate THD+N [dB] of a sine with the given frequency: fit a
+ * sine to the signal (least squares) and compare the residual with
+ * it.  The edges are skipped.
+ */
+static double
+CalculateThdN(const std::vector<float> &v, unsigned channels,
+	      unsigned sample_rate, double frequency)
+{
+	const std::size_t n_frames = v.size() / channels;
+	const std::size_t skip = sample_rate / 10;
+	const double w = 2 * M_PI * frequency / sample_rate;
+
+	/* the sine is orthogonal to the cosine over whole periods,
+	   which is approximately the case here */
+	double ss = 0, sc = 0, s2 = 0, c2 = 0;
+	for (std::size_t i = skip; i < n_frames - skip; ++i) {
+		const double x = v[i * channels];
+		const double s = std::sin(i * w), c = std::cos(i * w);
+		ss += x * s;
+		sc += x * c;
+		s2 += s * s;
+		c2 += c * c;
+	}
+
+	const double a = ss / s2, b = sc / c2;
+
+	double signal = 0, residual = 0;
+	for (std::size_t i = skip; i < n_frames - skip; ++i) {
+		const double fit = a * std::sin(i * w) + b * std::cos(i * w);
+		const double e = v[i * channels] - fit;
+		signal += fit * fit;
+		residual += e * e;
+	}
+
+	return 10 * std::log10(residual / signal);
+}
+
+static void
+TestThdN(unsigned from, unsigned to, double frequency, double max_thd_n)
+{
+	const std::size_t n_frames = from * 2;
+	const auto src = MakeSine(from, 2, n_frames, frequency, 0.5);
+	const auto dest = Resample(from, to, 2, src);
+
+	/* the output length matches the ratio */
+	const double expected = double(n_frames) * to / from;
+	EXPECT_NEAR(double(dest.size() / 2), expected, 1.0);
+
+	EXPECT_LT(CalculateThdN(dest, 2, to, frequency), max_thd_n);
+
+	/* the amplitude is preserved */
+	float peak = 0;
+	for (const float i : dest)
+		peak = std::max(peak, std::fabs(i));
+	EXPECT_NEAR(peak, 0.5f, 0.01f);
+}
+
+TEST(PolyphaseResampler, CD2DAT)
+{
+	TestThdN(44100, 48000, 1000, -90);
+}
+
+TEST(PolyphaseResampler, DAT2CD)
+{
+	TestThdN(48000, 44100, 1000, -90);
+}
+
+TEST(PolyphaseResampler, Up2)
+{
+	TestThdN(48000, 96000, 997, -90);
+}
+
+TEST(PolyphaseResampler, Down4)
+{
+	TestThdN(192000, 48000, 1000, -90);
+}
+
+TEST(PolyphaseResampler, InterpolatedPhases)
+{
+	/* a ratio with too many phases for a full table */
+	TestThdN(44100, 48001, 1000, -80);
+}
+
+TEST(PolyphaseResampler, StopBand)
+{
+	/* a 20 kHz tone must be removed when downsampling to
+	   32 kHz */
+	const auto src = MakeSine(48000, 1, 48000, 20000, 0.5);
+	const auto dest = Resample(48000, 32000, 1, src);
+
+	double sum = 0;
+	for (std::size_t i = 3200; i < dest.size() - 3200; ++i)
+		sum += double(dest[i]) * dest[i];
+
+	const double rms = std::sqrt(sum / (dest.size() - 6400));
+	EXPECT_LT(20 * std::log10(rms / (0.5 / std::sqrt(2.0))), -80);
+}
+
+TEST(PolyphaseResampler, Quality)
+{
+	ConfigBlock block;
+	block.AddBlockParam("quality", "low");
+	pcm_resample_polyphase_global_init(block);
+
+	const auto src = MakeSine(44100, 1, 44100, 1000, 0.5);
+	EXPECT_LT(CalculateThdN(Resample(44100, 48000, 1, src), 1,
+				48000, 1000), -50);
+
+	ConfigBlock invalid;
+	invalid.AddBlockParam("quality", "foo");
+	EXPECT_ANY_THROW(pcm_resample_polyphase_global_init(invalid));
+
+	/* restore the default */
+	pcm_resample_polyphase_global_init(ConfigBlock());
+}
+
+static PcmResampler *
+CreatePolyphaseResampler()
+{
+	return new PolyphasePcmResampler();
+}
+
+/**
+ * Splitting the channels across threads must not change the
+ * result.
+ */
+TEST(SplitResampler, Identical)
+{
+	static constexpr unsigned channels = 8;
+
+	/* a different signal on each channel */
+	std::vector<float> src(20000 * channels);
+	for (std::size_t i = 0; i < src.size(); ++i)
+		src[i] = 0.4 * std::sin(i * (0.001 + 0.0003 * (i % channels)));
+
+	const auto expected = Resample(176400, 96000, channels, src);
+
+	for (unsigned n_threads : {2, 3, 8, 16}) {
+		SplitPcmResampler r(CreatePolyphaseResampler, n_threads);
+		const auto result = Resample(r, 176400, 96000, channels,
+					     src, 777);
+		EXPECT_EQ(result, expected);
+	}
+}